@@ -0,0 +1,64 @@
+@echo off
+echo Building pathfinding microbenchmarks...
+
+REM Setup Visual Studio x64 environment (adjust path to your VS installation)
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvars64.bat"
+if %ERRORLEVEL% NEQ 0 (
+    echo Visual Studio x64 environment setup failed!
+    pause
+    exit /b 1
+)
+
+cl /std:c++17 /O2 /MD /EHsc json-parse-bench.cpp /OUT:json-parse-bench.exe
+
+if %ERRORLEVEL% EQU 0 (
+    echo Build successful! Run json-parse-bench.exe [iterations]
+) else (
+    echo Build failed!
+)
+
+REM The navmesh benchmark links Detour like the service (see ..\buildpathfinding.bat)
+set DETOUR_INCLUDE=M:\H1_Tool_Projects\recastnavigation-main\Detour\Include
+set DETOUR_LIB=M:\H1_Tool_Projects\recastnavigation-main\build
+
+cl /std:c++17 ^
+   /O2 ^
+   /MD ^
+   /EHsc ^
+   /I"%DETOUR_INCLUDE%" ^
+   /I"M:\H1_Tool_Projects\recastnavigation-main\DetourCrowd\Include" ^
+   /DT_POLYREF64=1 ^
+   navmesh-bench.cpp ^
+   /link ^
+   "%DETOUR_LIB%\Detour\Release\Detour.lib" ^
+   "%DETOUR_LIB%\DetourCrowd\Release\DetourCrowd.lib" ^
+   ws2_32.lib ^
+   /OUT:navmesh-bench.exe
+
+if %ERRORLEVEL% EQU 0 (
+    echo Build successful! Run navmesh-bench.exe [--tiles n] [--seconds s] [--threads n] [--navmesh file] [--out file]
+) else (
+    echo Build failed!
+)
+
+cl /std:c++17 ^
+   /O2 ^
+   /MD ^
+   /EHsc ^
+   /I"%DETOUR_INCLUDE%" ^
+   /I"M:\H1_Tool_Projects\recastnavigation-main\DetourCrowd\Include" ^
+   /DT_POLYREF64=1 ^
+   trace-replay.cpp ^
+   /link ^
+   "%DETOUR_LIB%\Detour\Release\Detour.lib" ^
+   "%DETOUR_LIB%\DetourCrowd\Release\DetourCrowd.lib" ^
+   ws2_32.lib ^
+   /OUT:trace-replay.exe
+
+if %ERRORLEVEL% EQU 0 (
+    echo Build successful! Run trace-replay.exe ^<trace^> [--navmesh file] [--speed x] [--max-agents n] [--out file]
+) else (
+    echo Build failed!
+)
+
+pause
@@ -0,0 +1,57 @@
+#!/bin/sh
+echo "Building pathfinding microbenchmarks (POSIX)..."
+
+${CXX:-g++} -std=c++17 -O2 json-parse-bench.cpp -o json-parse-bench
+
+if [ $? -eq 0 ]; then
+    echo "Build successful! Run ./json-parse-bench [iterations]"
+else
+    echo "Build failed!"
+    exit 1
+fi
+
+# The navmesh benchmark links Detour like the service (see ../buildpathfinding.sh)
+RECAST_ROOT=${RECAST_ROOT:-$HOME/recastnavigation-main}
+DETOUR_INCLUDE=${DETOUR_INCLUDE:-$RECAST_ROOT/Detour/Include}
+DETOUR_CROWD_INCLUDE=${DETOUR_CROWD_INCLUDE:-$RECAST_ROOT/DetourCrowd/Include}
+DETOUR_LIB=${DETOUR_LIB:-$RECAST_ROOT/build}
+
+${CXX:-g++} -std=c++17 \
+   -O2 \
+   -pthread \
+   -I"$DETOUR_INCLUDE" \
+   -I"$DETOUR_CROWD_INCLUDE" \
+   -DDT_POLYREF64=1 \
+   navmesh-bench.cpp \
+   -L"$DETOUR_LIB/Detour" \
+   -L"$DETOUR_LIB/DetourCrowd" \
+   -lDetourCrowd \
+   -lDetour \
+   -o navmesh-bench
+
+if [ $? -eq 0 ]; then
+    echo "Build successful! Run ./navmesh-bench [--tiles n] [--seconds s] [--threads n] [--navmesh file] [--out file]"
+else
+    echo "Build failed!"
+    exit 1
+fi
+
+${CXX:-g++} -std=c++17 \
+   -O2 \
+   -pthread \
+   -I"$DETOUR_INCLUDE" \
+   -I"$DETOUR_CROWD_INCLUDE" \
+   -DDT_POLYREF64=1 \
+   trace-replay.cpp \
+   -L"$DETOUR_LIB/Detour" \
+   -L"$DETOUR_LIB/DetourCrowd" \
+   -lDetourCrowd \
+   -lDetour \
+   -o trace-replay
+
+if [ $? -eq 0 ]; then
+    echo "Build successful! Run ./trace-replay <trace> [--navmesh file] [--speed x] [--max-agents n] [--out file]"
+else
+    echo "Build failed!"
+    exit 1
+fi
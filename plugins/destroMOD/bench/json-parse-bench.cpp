@@ -0,0 +1,223 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Request parsing microbenchmark
+// Compares the previous std::regex extractors and ostringstream responses against
+// pathfinding-json.h on representative request bodies for each endpoint.
+//
+//   g++ -std=c++17 -O2 json-parse-bench.cpp -o json-parse-bench
+//   cl /std:c++17 /O2 /EHsc json-parse-bench.cpp
+// ===================================================================================
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <regex>
+#include <chrono>
+#include <functional>
+
+#include "../pathfinding-json.h"
+
+// ---- Previous implementation (baseline) --------------------------------------------
+
+static std::string extractString(const std::string& json, const std::string& key) {
+    std::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]+)\"");
+    std::smatch match;
+    return std::regex_search(json, match, pattern) ? match[1].str() : "";
+}
+
+static float extractFloat(const std::string& json, const std::string& key) {
+    std::regex pattern("\"" + key + "\"\\s*:\\s*(-?\\d*\\.?\\d+)");
+    std::smatch match;
+    return std::regex_search(json, match, pattern) ? std::stof(match[1].str()) : 0.0f;
+}
+
+static std::vector<float> extractArray(const std::string& json, const std::string& key) {
+    std::vector<float> result;
+    std::regex pattern("\"" + key + "\"\\s*:\\s*\\[([^\\]]+)\\]");
+    std::smatch match;
+    if (std::regex_search(json, match, pattern)) {
+        std::string content = match[1].str();
+        std::regex floatPattern("(-?\\d*\\.?\\d+)");
+        auto it = std::sregex_iterator(content.begin(), content.end(), floatPattern);
+        for (; it != std::sregex_iterator(); ++it) {
+            result.push_back(std::stof((*it)[1].str()));
+        }
+    }
+    return result;
+}
+
+static std::vector<std::string> extractStringArray(const std::string& json, const std::string& key) {
+    std::vector<std::string> result;
+    std::regex pattern("\"" + key + "\"\\s*:\\s*\\[([^\\]]*)\\]");
+    std::smatch match;
+    if (std::regex_search(json, match, pattern)) {
+        std::string content = match[1].str();
+        std::regex stringPattern("\"([^\"]+)\"");
+        auto it = std::sregex_iterator(content.begin(), content.end(), stringPattern);
+        for (; it != std::sregex_iterator(); ++it) {
+            result.push_back((*it)[1].str());
+        }
+    }
+    return result;
+}
+
+static std::vector<std::string> extractObjectArray(const std::string& json, const std::string& key) {
+    std::vector<std::string> result;
+    size_t keyPos = json.find("\"" + key + "\"");
+    if (keyPos == std::string::npos) return result;
+    size_t pos = json.find('[', keyPos);
+    if (pos == std::string::npos) return result;
+
+    int depth = 0;
+    bool inString = false;
+    size_t objectStart = 0;
+    for (pos = pos + 1; pos < json.size(); pos++) {
+        char c = json[pos];
+        if (inString) {
+            if (c == '\\') pos++;
+            else if (c == '"') inString = false;
+            continue;
+        }
+        if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            if (depth++ == 0) objectStart = pos;
+        } else if (c == '}') {
+            if (--depth == 0) result.push_back(json.substr(objectStart, pos - objectStart + 1));
+        } else if (c == ']' && depth == 0) {
+            break;
+        }
+    }
+    return result;
+}
+
+// ---- Harness -----------------------------------------------------------------------
+
+static volatile float sink = 0.0f;
+
+static double nsPerOp(const std::function<void()>& body, int iterations) {
+    for (int i = 0; i < iterations / 10 + 1; i++) body(); // Warm up
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) body();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+static void report(const char* name, double legacy, double current) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << legacy << std::setw(12) << current
+              << std::setprecision(1) << std::setw(10) << legacy / current << "x" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    const std::string closestBody = "{\"x\": 1234.56, \"y\": 78.9, \"z\": -4321.0}";
+    const std::string losBody = "{\"start\": [1234.5, 80.2, -4321.0], \"end\": [1250.25, 81.0, -4300.75]}";
+    const std::string targetBody = "{\"npcId\": \"zombie_123456\", \"target\": [1234.5, 80.2, -4321.0]}";
+    const std::string forceStopBody = "{\"npcId\": \"zombie_123456\", \"brakeForce\": 15}";
+
+    std::string statesBody = "{\"threshold\": 2, \"npcIds\": [";
+    for (int i = 0; i < 50; i++) statesBody += (i ? ", \"zombie_" : "\"zombie_") + std::to_string(100000 + i) + "\"";
+    statesBody += "]}";
+
+    std::string batchBody = "{\"commands\": [";
+    for (int i = 0; i < 20; i++) {
+        if (i) batchBody += ", ";
+        batchBody += "{\"op\": \"setTarget\", \"npcId\": \"zombie_" + std::to_string(100000 + i) + "\", \"target\": [1234.5, 80.2, -4321.0]}";
+    }
+    batchBody += "]}";
+
+    RequestFields fields;
+    std::string buffer;
+
+    std::cout << std::left << std::setw(28) << "endpoint (ns/op)" << std::right
+              << std::setw(12) << "regex" << std::setw(12) << "single-pass" << std::setw(11) << "speedup" << std::endl;
+
+    report("/getClosestNavPoint",
+        nsPerOp([&] { sink = extractFloat(closestBody, "x") + extractFloat(closestBody, "y") + extractFloat(closestBody, "z"); }, iterations),
+        nsPerOp([&] { parseRequestFields(closestBody, fields); sink = fields.x + fields.y + fields.z; }, iterations));
+
+    report("/hasLineOfSight",
+        nsPerOp([&] { auto s = extractArray(losBody, "start"), e = extractArray(losBody, "end"); sink = s[0] + e[0]; }, iterations),
+        nsPerOp([&] { parseRequestFields(losBody, fields); sink = fields.start[0] + fields.end[0]; }, iterations));
+
+    report("/setNPCTarget",
+        nsPerOp([&] {
+            auto target = extractArray(targetBody, "target");
+            if (!extractString(targetBody, "npcId").empty() && target.size() >= 3) sink = (float)extractString(targetBody, "npcId").size() + target[0];
+        }, iterations),
+        nsPerOp([&] { parseRequestFields(targetBody, fields); std::string npcId(fields.npcId); sink = (float)npcId.size() + fields.target[0]; }, iterations));
+
+    report("/forceStopNPC",
+        nsPerOp([&] { sink = (float)extractString(forceStopBody, "npcId").size() + extractFloat(forceStopBody, "brakeForce"); }, iterations),
+        nsPerOp([&] { parseRequestFields(forceStopBody, fields); sink = (float)fields.npcId.size() + fields.brakeForce; }, iterations));
+
+    report("/getAgentStates (50 ids)",
+        nsPerOp([&] { auto ids = extractStringArray(statesBody, "npcIds"); sink = extractFloat(statesBody, "threshold") + (float)ids.size(); }, iterations / 10),
+        nsPerOp([&] { parseRequestFields(statesBody, fields); sink = fields.threshold + (float)fields.npcIds.size(); }, iterations / 10));
+
+    report("/batch (20 setTarget)",
+        nsPerOp([&] {
+            float total = 0.0f;
+            for (const auto& object : extractObjectArray(batchBody, "commands")) {
+                std::string op = extractString(object, "op");
+                std::string npcId = extractString(object, "npcId");
+                auto target = extractArray(object, "target");
+                total += (float)(op.size() + npcId.size()) + target[0];
+            }
+            sink = total;
+        }, iterations / 20),
+        nsPerOp([&] {
+            parseRequestFields(batchBody, fields);
+            float total = 0.0f;
+            for (const auto& command : fields.commands) total += (float)(command.op.size() + command.npcId.size()) + command.target[0];
+            sink = total;
+        }, iterations / 20));
+
+    // Response building: 50-agent /getAgentStates payload
+    const float pos[3] = {1234.5678f, 80.25f, -4321.125f};
+    const float vel[3] = {1.5f, 0.0f, -2.25f};
+    report("getAgentStates response",
+        nsPerOp([&] {
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(3);
+            json << "{\"success\": true, \"tick\": " << 123456ULL << ", \"agents\": {";
+            for (int i = 0; i < 50; i++) {
+                if (i > 0) json << ",";
+                json << "\"zombie_" << (100000 + i) << "\":["
+                     << pos[0] << "," << pos[1] << "," << pos[2] << ","
+                     << vel[0] << "," << vel[1] << "," << vel[2] << "," << 3 << "," << 0 << "]";
+            }
+            json << "}}";
+            sink = (float)json.str().size();
+        }, iterations / 10),
+        nsPerOp([&] {
+            JsonWriter json(buffer);
+            json.raw("{\"success\": true, \"tick\": ").number(123456ULL).raw(", \"agents\": {");
+            for (int i = 0; i < 50; i++) {
+                if (i > 0) json.raw(',');
+                json.raw("\"zombie_").number(100000 + i).raw("\":[");
+                for (int k = 0; k < 3; k++) json.fixed(pos[k], 3).raw(',');
+                for (int k = 0; k < 3; k++) json.fixed(vel[k], 3).raw(',');
+                json.number(3).raw(',').raw('0').raw(']');
+            }
+            json.raw("}}");
+            sink = (float)json.str().size();
+        }, iterations / 10));
+
+    report("getAgentPosition response",
+        nsPerOp([&] {
+            std::ostringstream json;
+            json << "{\"success\": true, \"position\": " << "[" + std::to_string(pos[0]) + "," + std::to_string(pos[1]) + "," + std::to_string(pos[2]) + "]" << "}";
+            sink = (float)json.str().size();
+        }, iterations),
+        nsPerOp([&] {
+            JsonWriter json(buffer);
+            json.raw("{\"success\": true, \"position\": ").floats(pos, 3).raw('}');
+            sink = (float)json.str().size();
+        }, iterations));
+
+    return 0;
+}
@@ -0,0 +1,444 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Navmesh, query, crowd and HTTP benchmarks
+// Runs the real PathfindingService against a synthetic navmesh (or a given one) and
+// writes the results as JSON, so runs before and after a change can be diffed:
+//   - startup: initialize() from the TESM dump and from the indexed file
+//   - queries: getClosestNavPoint, hasLineOfSight and testNavMesh on random valid
+//     points, on one thread and on every hardware thread
+//   - crowd: update() cost with 50, 200 and 1000 moving agents
+//   - http: keep-alive request throughput against the event-loop server
+//
+//   navmesh-bench [--tiles n] [--seconds s] [--threads n] [--port p] [--navmesh file] [--out file]
+// ===================================================================================
+
+#define PATHFINDING_SERVICE_NO_MAIN
+#include "../pathfinding-service.cpp"
+#include "synthetic-navmesh.h"
+
+#include <random>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchConfig {
+    int tiles = 16;
+    double seconds = 2.0;
+    int threads = 0;            // 0 = hardware threads
+    int port = 18080;
+    std::string navmeshPath;    // Empty = generate the synthetic mesh
+    std::string outPath = "navmesh-bench.json";
+};
+
+struct LatencySummary {
+    unsigned long long ops = 0;
+    double opsPerSec = 0.0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+};
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(q * (double)(sorted.size() - 1) + 0.5))];
+}
+
+// Runs op(thread, rng) on every thread until the time is up; latency is sampled on every call
+template <typename Op>
+LatencySummary runTimed(int threads, double seconds, Op op) {
+    static const size_t MAX_SAMPLES = 1 << 20;
+    std::vector<std::vector<double>> samples((size_t)threads);
+    std::vector<unsigned long long> counts((size_t)threads, 0);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(1234u + (unsigned)t);
+            std::vector<double>& local = samples[(size_t)t];
+            local.reserve(65536);
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto opStart = Clock::now();
+                op(t, rng);
+                double us = std::chrono::duration<double, std::micro>(Clock::now() - opStart).count();
+                if (local.size() < MAX_SAMPLES) local.push_back(us);
+                counts[(size_t)t]++;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& worker : workers) worker.join();
+    double elapsed = msSince(start) / 1000.0;
+
+    std::vector<double> all;
+    LatencySummary summary;
+    for (int t = 0; t < threads; t++) {
+        summary.ops += counts[(size_t)t];
+        all.insert(all.end(), samples[(size_t)t].begin(), samples[(size_t)t].end());
+    }
+    std::sort(all.begin(), all.end());
+    summary.opsPerSec = summary.ops / elapsed;
+    summary.p50Us = percentile(all, 0.5);
+    summary.p99Us = percentile(all, 0.99);
+    summary.maxUs = all.empty() ? 0.0 : all.back();
+    return summary;
+}
+
+void writeSummary(JsonWriter& json, const LatencySummary& summary) {
+    json.raw("\"ops\": ").number(summary.ops)
+        .raw(", \"opsPerSec\": ").number((float)summary.opsPerSec)
+        .raw(", \"p50Us\": ").number((float)summary.p50Us)
+        .raw(", \"p99Us\": ").number((float)summary.p99Us)
+        .raw(", \"maxUs\": ").number((float)summary.maxUs);
+}
+
+// Horizontal offset of up to 40 units either way
+float jitter(std::mt19937& rng) {
+    return ((float)(rng() & 0xffff) / 65535.0f - 0.5f) * 80.0f;
+}
+
+// Valid points: random positions inside the bounds snapped onto the mesh
+std::vector<float> samplePoints(PathfindingService& service, const float* bmin, const float* bmax, size_t count) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> rx(bmin[0], bmax[0]), rz(bmin[2], bmax[2]);
+    float y = (bmin[1] + bmax[1]) * 0.5f;
+    std::vector<float> points;
+    for (size_t attempts = 0; points.size() < count * 3 && attempts < count * 20; attempts++) {
+        auto point = service.getClosestNavPoint(rx(rng), y, rz(rng));
+        if (point.size() == 3) points.insert(points.end(), point.begin(), point.end());
+    }
+    return points;
+}
+
+// Union of the tile bounds of a TESM dump or an indexed file
+bool readMeshBounds(const std::string& path, float* bmin, float* bmax) {
+    std::vector<unsigned char> data;
+    std::vector<NavTileSpan> spans;
+    if (IndexedNavMeshFile::isIndexed(path)) {
+        std::ifstream file(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        NavIndexHeader header;
+        if (data.size() < sizeof(header)) return false;
+        memcpy(&header, data.data(), sizeof(header));
+        for (uint32_t i = 0; i < header.tileCount; i++) {
+            NavIndexTile entry;
+            size_t at = (size_t)header.directoryOffset + i * sizeof(NavIndexTile);
+            if (at + sizeof(entry) > data.size()) return false;
+            memcpy(&entry, data.data() + at, sizeof(entry));
+            if (entry.offset + entry.size <= data.size()) spans.push_back({(size_t)entry.offset, entry.size});
+        }
+    } else {
+        dtNavMeshParams params;
+        if (!readTesmFile(path, data, params, spans)) return false;
+    }
+
+    bool found = false;
+    for (const auto& span : spans) {
+        if (span.size < sizeof(dtMeshHeader)) continue;
+        dtMeshHeader header;
+        memcpy(&header, data.data() + span.offset, sizeof(header));
+        for (int k = 0; k < 3; k++) {
+            bmin[k] = found ? std::min(bmin[k], header.bmin[k]) : header.bmin[k];
+            bmax[k] = found ? std::max(bmax[k], header.bmax[k]) : header.bmax[k];
+        }
+        found = true;
+    }
+    return found;
+}
+
+// Minimal blocking keep-alive HTTP/1.1 client for the throughput run
+class BenchHttpClient {
+private:
+    socket_t s;
+    std::string in;
+
+public:
+    BenchHttpClient() : s(PF_INVALID_SOCKET) {}
+    ~BenchHttpClient() {
+        if (s != PF_INVALID_SOCKET) pfCloseSocket(s);
+    }
+
+    bool connect(int port) {
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s == PF_INVALID_SOCKET) return false;
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((unsigned short)port);
+        return ::connect(s, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    // Returns false on a broken connection; the response body is discarded
+    bool post(const std::string& path, const std::string& body) {
+        std::string request = "POST " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n"
+                              "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        for (size_t sent = 0; sent < request.size();) {
+            int n = (int)send(s, request.data() + sent, (int)(request.size() - sent), 0);
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+
+        char buffer[16384];
+        size_t headerEnd;
+        while ((headerEnd = in.find("\r\n\r\n")) == std::string::npos) {
+            int n = (int)recv(s, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            in.append(buffer, (size_t)n);
+        }
+        size_t lengthAt = in.find("Content-Length: ");
+        size_t length = lengthAt < headerEnd ? (size_t)strtoul(in.c_str() + lengthAt + 16, nullptr, 10) : 0;
+        size_t total = headerEnd + 4 + length;
+        while (in.size() < total) {
+            int n = (int)recv(s, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            in.append(buffer, (size_t)n);
+        }
+        in.erase(0, total);
+        return true;
+    }
+};
+
+std::string pairBody(const float* a, const float* b) {
+    std::string body;
+    JsonWriter json(body);
+    json.raw("{\"start\": ").floats(a, 3).raw(", \"end\": ").floats(b, 3).raw('}');
+    return body;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tiles") config.tiles = atoi(argv[++i]);
+        else if (arg == "--seconds") config.seconds = atof(argv[++i]);
+        else if (arg == "--threads") config.threads = atoi(argv[++i]);
+        else if (arg == "--port") config.port = atoi(argv[++i]);
+        else if (arg == "--navmesh") config.navmeshPath = argv[++i];
+        else if (arg == "--out") config.outPath = argv[++i];
+    }
+    int threads = config.threads > 0 ? config.threads : std::max(2, (int)std::thread::hardware_concurrency());
+
+    std::string results;
+    JsonWriter json(results);
+    json.raw("{\"benchmark\": \"navmesh\", \"seconds\": ").number((float)config.seconds)
+        .raw(", \"threads\": ").number(threads);
+
+    // ---- Navmesh ----
+    std::string tesmPath = config.navmeshPath;
+    std::string indexedPath;
+    float bmin[3], bmax[3];
+    if (tesmPath.empty()) {
+        SyntheticNavMeshConfig meshConfig;
+        meshConfig.tilesX = meshConfig.tilesZ = config.tiles;
+        SyntheticNavMeshInfo info;
+        tesmPath = "navmesh-bench-synthetic.bin";
+        auto start = Clock::now();
+        if (!SyntheticNavMesh(meshConfig).writeTesm(tesmPath, info)) {
+            std::cerr << "Failed to generate the synthetic navmesh" << std::endl;
+            return 1;
+        }
+        json.raw(", \"navmesh\": {\"synthetic\": true, \"tiles\": ").number(info.tiles)
+            .raw(", \"polys\": ").number(info.polys)
+            .raw(", \"bytes\": ").number((unsigned long long)info.bytes)
+            .raw(", \"generateMs\": ").number((float)msSince(start)).raw('}');
+        memcpy(bmin, info.bmin, sizeof(bmin));
+        memcpy(bmax, info.bmax, sizeof(bmax));
+    } else {
+        json.raw(", \"navmesh\": {\"synthetic\": false, \"path\": ").string(tesmPath).raw('}');
+    }
+    if (!IndexedNavMeshFile::isIndexed(tesmPath)) {
+        indexedPath = tesmPath + ".navidx";
+        if (!convertTesmToIndexed(tesmPath, indexedPath)) indexedPath.clear();
+    } else {
+        indexedPath = tesmPath;
+        tesmPath.clear();
+    }
+
+    // ---- Startup ----
+    json.raw(", \"startup\": {");
+    bool firstStartup = true;
+    for (const std::string* path : {&tesmPath, &indexedPath}) {
+        if (path->empty()) continue;
+        auto start = Clock::now();
+        PathfindingService probe;
+        bool ok = probe.initialize(*path);
+        double elapsed = msSince(start);
+        if (!firstStartup) json.raw(", ");
+        firstStartup = false;
+        json.raw(path == &tesmPath ? "\"tesmMs\": " : "\"indexedMs\": ").number(ok ? (float)elapsed : -1.0f);
+    }
+    json.raw('}');
+
+    const std::string& servicePath = indexedPath.empty() ? tesmPath : indexedPath;
+    PathfindingService service;
+    service.setCrowdCapacity(1000, 0);
+    if (!service.initialize(servicePath)) {
+        std::cerr << "Failed to initialize the service with " << servicePath << std::endl;
+        return 1;
+    }
+    if (!config.navmeshPath.empty() && !readMeshBounds(config.navmeshPath, bmin, bmax)) {
+        std::cerr << "Could not read tile bounds from " << config.navmeshPath << std::endl;
+        return 1;
+    }
+
+    std::vector<float> points = samplePoints(service, bmin, bmax, 4096);
+    const size_t pointCount = points.size() / 3;
+    if (pointCount < 2) {
+        std::cerr << "Could not find valid points on the navmesh" << std::endl;
+        return 1;
+    }
+    json.raw(", \"samplePoints\": ").number((unsigned long long)pointCount);
+
+    // ---- Queries ----
+    // Pairs are drawn at random per call, so the path cache and the LOS memo rarely hit and
+    // the numbers reflect the Detour work itself
+    auto randomPoint = [&](std::mt19937& rng) { return &points[(rng() % pointCount) * 3]; };
+    json.raw(", \"queries\": {");
+    const char* names[3] = {"getClosestNavPoint", "hasLineOfSight", "testNavMesh"};
+    for (int q = 0; q < 3; q++) {
+        if (q > 0) json.raw(", ");
+        json.raw('"').raw(names[q]).raw("\": [");
+        const int threadCounts[2] = {1, threads};
+        for (int run = 0; run < 2; run++) {
+            LatencySummary summary = runTimed(threadCounts[run], config.seconds, [&](int, std::mt19937& rng) {
+                const float* a = randomPoint(rng);
+                if (q == 0) {
+                    service.getClosestNavPoint(a[0] + jitter(rng), a[1], a[2] + jitter(rng));
+                } else if (q == 1) {
+                    service.hasLineOfSight(a[0], a[1] + 1.0f, a[2], a[0] + jitter(rng), a[1] + 1.0f, a[2] + jitter(rng));
+                } else {
+                    const float* b = randomPoint(rng);
+                    service.testNavMesh(a[0], a[1], a[2], b[0], b[1], b[2]);
+                }
+            });
+            if (run > 0) json.raw(", ");
+            json.raw("{\"threads\": ").number(threadCounts[run]).raw(", ");
+            writeSummary(json, summary);
+            json.raw('}');
+        }
+        json.raw(']');
+    }
+    json.raw('}');
+
+    // ---- Crowd ----
+    // Every agent walks to a random point and is sent somewhere new every 100 ticks. The
+    // bench steps the crowd itself, so each batch is drained on this thread.
+    json.raw(", \"crowd\": [");
+    const int agentCounts[3] = {50, 200, 1000};
+    for (int c = 0; c < 3; c++) {
+        const int agents = agentCounts[c];
+        std::mt19937 rng(7u + (unsigned)agents);
+        auto applyToAll = [&](PathfindingService::CommandOp op) {
+            std::vector<PathfindingService::CrowdCommand> commands(agents);
+            for (int i = 0; i < agents; i++) {
+                commands[i].op = op;
+                commands[i].npcId = "bench_" + std::to_string(i);
+                const float* p = randomPoint(rng);
+                std::copy(p, p + 3, commands[i].pos);
+            }
+            unsigned long long tick = 0;
+            service.applyBatch(commands, tick);
+        };
+        auto retarget = [&]() { applyToAll(PathfindingService::CommandOp::SetTarget); };
+        applyToAll(PathfindingService::CommandOp::Add);
+        service.update(0.025f);
+        retarget();
+        for (int i = 0; i < 40; i++) service.update(0.025f);
+
+        const int ticks = std::max(100, (int)(config.seconds * 40.0));
+        std::vector<double> tickMs, crowdMs;
+        for (int tick = 0; tick < ticks; tick++) {
+            if (tick > 0 && tick % 100 == 0) retarget();
+            auto start = Clock::now();
+            service.update(0.025f);
+            tickMs.push_back(msSince(start));
+            crowdMs.push_back(service.getCrowdStats().lastUpdateMs);
+        }
+        double tickTotal = 0.0, crowdTotal = 0.0;
+        for (double ms : tickMs) tickTotal += ms;
+        for (double ms : crowdMs) crowdTotal += ms;
+        std::sort(tickMs.begin(), tickMs.end());
+        std::sort(crowdMs.begin(), crowdMs.end());
+
+        if (c > 0) json.raw(", ");
+        json.raw("{\"agents\": ").number(service.getCrowdStats().agents)
+            .raw(", \"ticks\": ").number(ticks)
+            .raw(", \"tickMsAvg\": ").number((float)(tickTotal / ticks))
+            .raw(", \"tickMsP50\": ").number((float)percentile(tickMs, 0.5))
+            .raw(", \"tickMsP99\": ").number((float)percentile(tickMs, 0.99))
+            .raw(", \"crowdUpdateMsAvg\": ").number((float)(crowdTotal / ticks))
+            .raw(", \"crowdUpdateMsP99\": ").number((float)percentile(crowdMs, 0.99)).raw('}');
+
+        applyToAll(PathfindingService::CommandOp::Remove);
+        service.update(0.025f);
+    }
+    json.raw(']');
+
+    // ---- HTTP ----
+    HttpServer server([&service](const HttpRequest& request) {
+        return handleHttpRequest(request.method, request.path, request.body, service);
+    });
+    json.raw(", \"http\": [");
+    if (server.listen(config.port)) {
+        std::thread serverThread([&server]() { server.run(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const char* paths[3] = {"/getClosestNavPoint", "/hasLineOfSight", "/testNavMesh"};
+        for (int e = 0; e < 3; e++) {
+            std::vector<std::unique_ptr<BenchHttpClient>> clients;
+            for (int t = 0; t < threads; t++) {
+                clients.emplace_back(new BenchHttpClient());
+                if (!clients.back()->connect(config.port)) clients.pop_back();
+            }
+            if (clients.empty()) break;
+            std::atomic<unsigned long long> errors(0);
+            LatencySummary summary = runTimed((int)clients.size(), config.seconds, [&](int t, std::mt19937& rng) {
+                const float* a = randomPoint(rng);
+                std::string body;
+                if (e == 0) {
+                    JsonWriter writer(body);
+                    writer.raw("{\"x\": ").number(a[0] + jitter(rng)).raw(", \"y\": ").number(a[1]).raw(", \"z\": ").number(a[2] + jitter(rng)).raw('}');
+                } else if (e == 1) {
+                    const float from[3] = {a[0], a[1] + 1.0f, a[2]};
+                    const float to[3] = {a[0] + jitter(rng), a[1] + 1.0f, a[2] + jitter(rng)};
+                    body = pairBody(from, to);
+                } else {
+                    body = pairBody(a, randomPoint(rng));
+                }
+                if (!clients[(size_t)t]->post(paths[e], body)) {
+                    errors++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            });
+            if (e > 0) json.raw(", ");
+            json.raw("{\"endpoint\": ").string(paths[e])
+                .raw(", \"connections\": ").number((unsigned long long)clients.size())
+                .raw(", \"errors\": ").number(errors.load()).raw(", ");
+            writeSummary(json, summary);
+            json.raw('}');
+        }
+        server.stop();
+        serverThread.join();
+    } else {
+        std::cerr << "HTTP benchmark skipped: port " << config.port << " unavailable" << std::endl;
+    }
+    json.raw("]}");
+
+    std::ofstream out(config.outPath, std::ios::trunc);
+    out << json.str() << std::endl;
+    std::cout << json.str() << std::endl;
+    std::cout << "Results written to " << config.outPath << std::endl;
+    return out ? 0 : 1;
+}
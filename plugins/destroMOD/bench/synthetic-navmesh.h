@@ -0,0 +1,209 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Synthetic navmesh generator
+// Builds a tiled grid navmesh with dtCreateNavMeshData so the benchmarks run without
+// game data: every tile is a grid of square polys over gently rolling ground, with a
+// deterministic scatter of missing polys acting as obstacles. The result is written
+// as a TESM dump, the same container the game exporter produces.
+// ===================================================================================
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourAlloc.h"
+#include "../pathfinding-navmesh.h"
+
+struct SyntheticNavMeshConfig {
+    int tilesX = 16;
+    int tilesZ = 16;
+    int quadsPerTile = 16;      // Polys along each tile edge
+    int cellsPerQuad = 8;
+    float cellSize = 0.5f;      // 16 * 8 * 0.5 = 64 world units per tile
+    float cellHeight = 0.2f;
+    float hillHeight = 4.0f;    // Amplitude of the rolling ground
+    float blockedRatio = 0.15f; // Share of quads left out as obstacles
+    unsigned int seed = 1;
+};
+
+struct SyntheticNavMeshInfo {
+    int tiles = 0;
+    int polys = 0;
+    size_t bytes = 0;
+    float bmin[3] = {0.0f, 0.0f, 0.0f};
+    float bmax[3] = {0.0f, 0.0f, 0.0f};
+};
+
+class SyntheticNavMesh {
+private:
+    SyntheticNavMeshConfig config;
+
+    static const unsigned short NULL_INDEX = 0xffff;
+    static const int VERTS_PER_POLY = 6;
+    static constexpr float GROUND_MIN = -8.0f;
+    static constexpr float GROUND_MAX = 8.0f;
+
+    float tileSize() const { return config.quadsPerTile * config.cellsPerQuad * config.cellSize; }
+
+    bool blocked(int quadX, int quadZ) const {
+        uint32_t h = (uint32_t)quadX * 73856093u ^ (uint32_t)quadZ * 19349663u ^ config.seed * 83492791u;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return (float)(h & 0xffff) / 65536.0f < config.blockedRatio;
+    }
+
+    // Height from global cell coordinates, so vertices shared across tile edges agree
+    float groundHeight(int cellX, int cellZ) const {
+        float x = cellX * config.cellSize, z = cellZ * config.cellSize;
+        return config.hillHeight * std::sin(x / 40.0f) * std::cos(z / 40.0f);
+    }
+
+    // dtCreateNavMeshData output for one tile, or empty when the tile has no polys
+    std::vector<unsigned char> buildTile(int tileX, int tileZ) const {
+        const int quads = config.quadsPerTile;
+        const int side = quads + 1;
+        const int cellsPerTile = quads * config.cellsPerQuad;
+
+        std::vector<unsigned short> verts((size_t)side * side * 3);
+        for (int j = 0; j < side; j++) {
+            for (int i = 0; i < side; i++) {
+                unsigned short* v = &verts[((size_t)j * side + i) * 3];
+                int cellX = i * config.cellsPerQuad, cellZ = j * config.cellsPerQuad;
+                float height = groundHeight(tileX * cellsPerTile + cellX, tileZ * cellsPerTile + cellZ);
+                v[0] = (unsigned short)cellX;
+                v[1] = (unsigned short)std::lround((height - GROUND_MIN) / config.cellHeight);
+                v[2] = (unsigned short)cellZ;
+            }
+        }
+
+        std::vector<int> polyIndex((size_t)quads * quads, -1);
+        int polyCount = 0;
+        for (int j = 0; j < quads; j++) {
+            for (int i = 0; i < quads; i++) {
+                if (!blocked(tileX * quads + i, tileZ * quads + j)) polyIndex[(size_t)j * quads + i] = polyCount++;
+            }
+        }
+        if (polyCount == 0) return {};
+
+        auto neighbour = [&](int i, int j, unsigned short portal) -> unsigned short {
+            if (i < 0 || j < 0 || i >= quads || j >= quads) return portal;
+            int index = polyIndex[(size_t)j * quads + i];
+            return index < 0 ? NULL_INDEX : (unsigned short)index;
+        };
+
+        // Recast winding: (x0,z0) (x0,z1) (x1,z1) (x1,z0); edge e borders x-, z+, x+, z- in turn,
+        // which is also the order of Recast's tile-edge portal codes
+        std::vector<unsigned short> polys((size_t)polyCount * VERTS_PER_POLY * 2, NULL_INDEX);
+        for (int j = 0; j < quads; j++) {
+            for (int i = 0; i < quads; i++) {
+                int index = polyIndex[(size_t)j * quads + i];
+                if (index < 0) continue;
+                unsigned short* p = &polys[(size_t)index * VERTS_PER_POLY * 2];
+                p[0] = (unsigned short)(j * side + i);
+                p[1] = (unsigned short)((j + 1) * side + i);
+                p[2] = (unsigned short)((j + 1) * side + i + 1);
+                p[3] = (unsigned short)(j * side + i + 1);
+                p[VERTS_PER_POLY + 0] = neighbour(i - 1, j, 0x8000 | 0);
+                p[VERTS_PER_POLY + 1] = neighbour(i, j + 1, 0x8000 | 1);
+                p[VERTS_PER_POLY + 2] = neighbour(i + 1, j, 0x8000 | 2);
+                p[VERTS_PER_POLY + 3] = neighbour(i, j - 1, 0x8000 | 3);
+            }
+        }
+        std::vector<unsigned short> flags((size_t)polyCount, 1);
+        std::vector<unsigned char> areas((size_t)polyCount, 0);
+
+        dtNavMeshCreateParams params;
+        memset(&params, 0, sizeof(params));
+        params.verts = verts.data();
+        params.vertCount = side * side;
+        params.polys = polys.data();
+        params.polyFlags = flags.data();
+        params.polyAreas = areas.data();
+        params.polyCount = polyCount;
+        params.nvp = VERTS_PER_POLY;
+        params.walkableHeight = 2.0f;
+        params.walkableRadius = 0.6f;
+        params.walkableClimb = 0.9f;
+        params.tileX = tileX;
+        params.tileY = tileZ;
+        params.tileLayer = 0;
+        params.bmin[0] = tileX * tileSize();
+        params.bmin[1] = GROUND_MIN;
+        params.bmin[2] = tileZ * tileSize();
+        params.bmax[0] = params.bmin[0] + tileSize();
+        params.bmax[1] = GROUND_MAX;
+        params.bmax[2] = params.bmin[2] + tileSize();
+        params.cs = config.cellSize;
+        params.ch = config.cellHeight;
+        params.buildBvTree = true;
+
+        unsigned char* data = nullptr;
+        int dataSize = 0;
+        if (!dtCreateNavMeshData(&params, &data, &dataSize)) return {};
+        std::vector<unsigned char> tile(data, data + dataSize);
+        dtFree(data);
+        return tile;
+    }
+
+    static int nextPow2(int v) {
+        int p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+public:
+    explicit SyntheticNavMesh(const SyntheticNavMeshConfig& meshConfig = SyntheticNavMeshConfig()) : config(meshConfig) {}
+
+    // Writes magic, version and tile count, dtNavMeshParams, then the tiles back to back
+    bool writeTesm(const std::string& path, SyntheticNavMeshInfo& info) const {
+        dtNavMeshParams params;
+        memset(&params, 0, sizeof(params));
+        params.tileWidth = tileSize();
+        params.tileHeight = tileSize();
+        params.maxTiles = nextPow2(config.tilesX * config.tilesZ);
+        params.maxPolys = nextPow2(config.quadsPerTile * config.quadsPerTile);
+
+        std::vector<std::vector<unsigned char>> tiles;
+        info = SyntheticNavMeshInfo();
+        for (int z = 0; z < config.tilesZ; z++) {
+            for (int x = 0; x < config.tilesX; x++) {
+                std::vector<unsigned char> tile = buildTile(x, z);
+                if (tile.empty()) continue;
+                const dtMeshHeader* header = reinterpret_cast<const dtMeshHeader*>(tile.data());
+                info.polys += header->polyCount;
+                info.bytes += tile.size();
+                tiles.push_back(std::move(tile));
+            }
+        }
+        if (tiles.empty()) return false;
+        info.tiles = (int)tiles.size();
+        info.bmin[1] = GROUND_MIN;
+        info.bmax[0] = config.tilesX * tileSize();
+        info.bmax[1] = GROUND_MAX;
+        info.bmax[2] = config.tilesZ * tileSize();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "[ERROR] Could not create file: " << path << std::endl;
+            return false;
+        }
+        const int32_t header[3] = {(int32_t)TESM_MAGIC, 1, (int32_t)tiles.size()};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&params), sizeof(params));
+        for (const auto& tile : tiles) out.write(reinterpret_cast<const char*>(tile.data()), (std::streamsize)tile.size());
+        return (bool)out;
+    }
+
+    // Height of the ground under (x, z), for picking sample points
+    float heightAt(float x, float z) const {
+        return groundHeight((int)std::lround(x / config.cellSize), (int)std::lround(z / config.cellSize));
+    }
+};
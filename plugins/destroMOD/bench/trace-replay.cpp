@@ -0,0 +1,192 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Capture trace replay
+// Feeds a trace recorded with --capture or POST /capture back into a fresh service,
+// in order, at the original pace, sped up, or as fast as possible. The crowd is stepped
+// by hand so every request lands on the same tick it arrived on in production; agent
+// positions are compared with the trace's snapshots at the matching ticks. Requests
+// are replayed on one thread, so latency is per request, not under production load.
+//
+//   trace-replay <trace> [--navmesh file] [--speed x (0 = no waiting)] [--max-agents n] [--out file]
+// ===================================================================================
+
+#define PATHFINDING_SERVICE_NO_MAIN
+#include "../pathfinding-service.cpp"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct EndpointTiming {
+    std::vector<double> us;
+};
+
+double percentile(std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(q * (double)(sorted.size() - 1) + 0.5))];
+}
+
+bool seedsTarget(int targetState) {
+    return targetState == DT_CROWDAGENT_TARGET_VALID || targetState == DT_CROWDAGENT_TARGET_REQUESTING ||
+           targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE || targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: trace-replay <trace> [--navmesh file] [--speed x] [--max-agents n] [--out file]" << std::endl;
+        return 1;
+    }
+    std::string tracePath = argv[1];
+    std::string navmeshPath = std::ifstream("all_tiles_navmesh_v10_64bit.navidx").good() ? "all_tiles_navmesh_v10_64bit.navidx" : "all_tiles_navmesh_v10_64bit.bin";
+    std::string outPath = "trace-replay.json";
+    double speed = 1.0;
+    int maxAgents = 0;
+    for (int i = 2; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--navmesh") navmeshPath = argv[++i];
+        else if (arg == "--speed") speed = atof(argv[++i]);
+        else if (arg == "--max-agents") maxAgents = atoi(argv[++i]);
+        else if (arg == "--out") outPath = argv[++i];
+    }
+
+    TraceReader reader;
+    if (!reader.open(tracePath)) {
+        std::cerr << "Not a capture trace: " << tracePath << std::endl;
+        return 1;
+    }
+    const unsigned long long startTick = reader.header().startTick;
+
+    PathfindingService service;
+    service.setCrowdCapacity(maxAgents, 0);
+    if (!service.initialize(navmeshPath)) {
+        std::cerr << "Failed to initialize the service with " << navmeshPath << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, EndpointTiming> timings;
+    std::vector<double> divergence;
+    unsigned long long records = 0, snapshots = 0, missingAgents = 0, extraAgents = 0, lateRecords = 0, seeded = 0;
+    std::vector<TraceAgent> recorded;
+    std::string method, path, body;
+    bool first = true;
+    TraceRecord record;
+    auto wallStart = Clock::now();
+
+    while (reader.next(record)) {
+        records++;
+        if (speed > 0.0) {
+            std::this_thread::sleep_until(wallStart + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds((long long)(record.timeNs / speed))));
+        }
+
+        // Step the crowd up to the tick the record was taken on
+        const unsigned long long tick = record.tick >= startTick ? record.tick - startTick : 0;
+        if (service.getTick() > tick) lateRecords++;
+        while (service.getTick() < tick) service.update(0.025f);
+
+        if (record.kind == TRACE_SNAPSHOT) {
+            if (!TraceReader::parseSnapshot(record.payload, recorded)) continue;
+            // A capture started mid-session opens with the crowd as it was: recreate it in one
+            // batch, drained on this thread since the replay steps the crowd itself
+            if (first) {
+                std::vector<PathfindingService::CrowdCommand> commands;
+                for (const auto& agent : recorded) {
+                    PathfindingService::CrowdCommand command;
+                    command.op = PathfindingService::CommandOp::Add;
+                    command.npcId = agent.npcId;
+                    std::copy(agent.pos, agent.pos + 3, command.pos);
+                    commands.push_back(command);
+                    if (seedsTarget(agent.targetState)) {
+                        command.op = PathfindingService::CommandOp::SetTarget;
+                        std::copy(agent.targetPos, agent.targetPos + 3, command.pos);
+                        commands.push_back(command);
+                    }
+                    seeded++;
+                }
+                unsigned long long seedTick = 0;
+                service.applyBatch(commands, seedTick);
+                first = false;
+                continue;
+            }
+            unsigned long long snapshotTick = 0;
+            std::vector<PathfindingService::AgentState> states = service.getAgentStates(std::vector<std::string>(), snapshotTick);
+            std::unordered_map<std::string, const PathfindingService::AgentState*> replayed;
+            for (const auto& state : states) replayed[state.npcId] = &state;
+            for (const auto& agent : recorded) {
+                auto it = replayed.find(agent.npcId);
+                if (it == replayed.end()) {
+                    missingAgents++;
+                    continue;
+                }
+                float dx = it->second->pos[0] - agent.pos[0];
+                float dy = it->second->pos[1] - agent.pos[1];
+                float dz = it->second->pos[2] - agent.pos[2];
+                divergence.push_back(std::sqrt(dx * dx + dy * dy + dz * dz));
+                replayed.erase(it);
+            }
+            extraAgents += replayed.size();
+            snapshots++;
+            continue;
+        }
+        first = false;
+
+        std::string label;
+        auto start = Clock::now();
+        if (record.kind == TRACE_HTTP) {
+            if (!TraceReader::parseHttp(record.payload, method, path, body)) continue;
+            handleHttpRequest(method, path, body, service);
+            label = method + " " + path;
+        } else if (record.kind == TRACE_IPC) {
+            handleBinaryRequest(record.payload, service);
+            uint16_t opcode = 0xffff;
+            if (record.payload.size() >= 6) memcpy(&opcode, record.payload.data() + 4, sizeof(opcode));
+            label = "ipc " + std::to_string(opcode);
+        } else {
+            continue;
+        }
+        timings[label].us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - wallStart).count();
+
+    std::string results;
+    JsonWriter json(results);
+    json.raw("{\"trace\": ").string(tracePath)
+        .raw(", \"speed\": ").number((float)speed)
+        .raw(", \"records\": ").number(records)
+        .raw(", \"ticks\": ").number(service.getTick())
+        .raw(", \"wallMs\": ").number((float)wallMs)
+        .raw(", \"lateRecords\": ").number(lateRecords)
+        .raw(", \"seededAgents\": ").number(seeded)
+        .raw(", \"endpoints\": {");
+    bool firstEndpoint = true;
+    for (auto& entry : timings) {
+        std::vector<double>& us = entry.second.us;
+        std::sort(us.begin(), us.end());
+        double total = 0.0;
+        for (double value : us) total += value;
+        if (!firstEndpoint) json.raw(", ");
+        firstEndpoint = false;
+        json.string(entry.first).raw(": {\"count\": ").number((unsigned long long)us.size())
+            .raw(", \"avgUs\": ").number((float)(total / us.size()))
+            .raw(", \"p50Us\": ").number((float)percentile(us, 0.5))
+            .raw(", \"p99Us\": ").number((float)percentile(us, 0.99))
+            .raw(", \"maxUs\": ").number((float)us.back()).raw('}');
+    }
+    std::sort(divergence.begin(), divergence.end());
+    double divergenceTotal = 0.0;
+    for (double d : divergence) divergenceTotal += d;
+    json.raw("}, \"divergence\": {\"snapshots\": ").number(snapshots)
+        .raw(", \"samples\": ").number((unsigned long long)divergence.size())
+        .raw(", \"mean\": ").number((float)(divergence.empty() ? 0.0 : divergenceTotal / divergence.size()))
+        .raw(", \"p50\": ").number((float)percentile(divergence, 0.5))
+        .raw(", \"p95\": ").number((float)percentile(divergence, 0.95))
+        .raw(", \"max\": ").number((float)(divergence.empty() ? 0.0 : divergence.back()))
+        .raw(", \"missingAgents\": ").number(missingAgents)
+        .raw(", \"extraAgents\": ").number(extraAgents).raw("}}");
+
+    std::ofstream out(outPath, std::ios::trunc);
+    out << json.str() << std::endl;
+    std::cout << json.str() << std::endl;
+    std::cout << "Results written to " << outPath << std::endl;
+    return out ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+echo "Building 64-bit Pathfinding Service (POSIX)..."
+
+# Set paths to your Detour libraries and includes (recastnavigation built with CMake)
+RECAST_ROOT=${RECAST_ROOT:-$HOME/recastnavigation-main}
+DETOUR_INCLUDE=${DETOUR_INCLUDE:-$RECAST_ROOT/Detour/Include}
+DETOUR_CROWD_INCLUDE=${DETOUR_CROWD_INCLUDE:-$RECAST_ROOT/DetourCrowd/Include}
+DETOUR_LIB=${DETOUR_LIB:-$RECAST_ROOT/build}
+
+# DT_POLYREF64 must match the define Detour itself was built with
+${CXX:-g++} -std=c++17 \
+   -O2 \
+   -pthread \
+   -I"$DETOUR_INCLUDE" \
+   -I"$DETOUR_CROWD_INCLUDE" \
+   -DDT_POLYREF64=1 \
+   pathfinding-service.cpp \
+   -L"$DETOUR_LIB/Detour" \
+   -L"$DETOUR_LIB/DetourCrowd" \
+   -lDetourCrowd \
+   -lDetour \
+   -o pathfinding-service
+
+if [ $? -eq 0 ]; then
+    echo "Build successful! Run ./pathfinding-service"
+else
+    echo "Build failed!"
+    exit 1
+fi
@@ -291,7 +291,7 @@ class HumanAI {
             const now = Date.now();
             if (!npc.lastPathfindTime || now - npc.lastPathfindTime > 100) { // changed to 200ms, may need to lower a bit
                 npc.lastPathfindTime = now;
-                this.plugin.pathfinding.setNPCTarget(npc.characterId, target.state.position);
+                this.plugin.pathfinding.setNPCTarget(npc.characterId, target.state.position, target.characterId);
             }
         }
     }
@@ -494,6 +494,10 @@ class HumanAI {
 
     findClosestPlayer(npc, aiManager) {
         const aggroRadius = npc.personalAggroRadius || this.plugin.AGGRO_RADIUS_MAX;
+        // The service answers from its player grid, line of sight included
+        const target = this.plugin.pathfinding?.nearestTarget?.(npc.characterId, npc.state.position, aggroRadius);
+        if (target !== undefined) return target;
+
         let closestPlayer = null;
         let minDistance = aggroRadius;
         
@@ -501,8 +505,8 @@ class HumanAI {
             if (!player.isAlive) return;
             const distance = getDistance(npc.state.position, player.state.position);
             if (distance <= minDistance) {
-                if (this.plugin.pathfinding && this.plugin.pathfinding.hasLineOfSight) {
-                    const hasLOS = this.plugin.pathfinding.hasLineOfSight(npc.state.position, player.state.position);
+                if (this.plugin.pathfinding && this.plugin.pathfinding.lineOfSight) {
+                    const hasLOS = this.plugin.pathfinding.lineOfSight(npc.characterId, player.characterId, npc.state.position, player.state.position);
                     if (!hasLOS) return;
                 }
                 minDistance = distance;
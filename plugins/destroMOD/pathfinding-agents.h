@@ -0,0 +1,266 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Agent table
+// Every crowd agent owns one slot of a flat array holding its npc id and current crowd
+// handle. Callers get a 32-bit AgentHandle back from the add: the slot index plus a
+// generation that is bumped whenever the slot is freed, so a handle kept past its
+// agent's removal stops resolving instead of reaching whoever reused the slot. Lookups
+// by handle are an array index; the legacy string ids go through AgentIdIndex, an
+// open-addressing table that compares against the ids already stored in the slots and
+// never allocates per lookup. A reverse array from crowd handle to slot lets shard
+// migration re-key only the agents that moved.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// 0 is never a valid handle, so it doubles as "no handle" in requests and results
+typedef uint32_t AgentHandle;
+static const AgentHandle AGENT_HANDLE_NONE = 0;
+
+static const int AGENT_SLOT_BITS = 20;                              // Up to ~1M agents
+static const uint32_t AGENT_SLOT_MASK = (1u << AGENT_SLOT_BITS) - 1;
+static const uint32_t AGENT_GENERATION_MASK = (1u << (32 - AGENT_SLOT_BITS)) - 1;
+
+inline int agentHandleSlot(AgentHandle handle) { return (int)(handle & AGENT_SLOT_MASK); }
+inline uint32_t agentHandleGeneration(AgentHandle handle) { return handle >> AGENT_SLOT_BITS; }
+inline AgentHandle makeAgentHandle(int slot, uint32_t generation) {
+    return (generation << AGENT_SLOT_BITS) | ((uint32_t)slot & AGENT_SLOT_MASK);
+}
+
+// String id -> int with linear probing and backward-shift deletion. Only the values and
+// their hashes are stored; keyOf(value) returns the id a value stands for, so the ids
+// live once, wherever the caller already keeps them.
+class AgentIdIndex {
+private:
+    struct Bucket {
+        uint32_t hash;
+        int32_t value;      // -1 = empty
+    };
+
+    std::vector<Bucket> buckets;
+    size_t count;
+    size_t mask;
+
+    static uint32_t hashId(std::string_view id) {
+        uint32_t h = 2166136261u;   // FNV-1a
+        for (char c : id) {
+            h ^= (uint8_t)c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // Power of two, at most half full
+    void rehash(size_t minimum) {
+        size_t size = 16;
+        while (size < minimum * 2) size <<= 1;
+        std::vector<Bucket> old;
+        old.swap(buckets);
+        buckets.assign(size, Bucket{0, -1});
+        mask = size - 1;
+        for (const Bucket& bucket : old) {
+            if (bucket.value < 0) continue;
+            size_t at = bucket.hash & mask;
+            while (buckets[at].value >= 0) at = (at + 1) & mask;
+            buckets[at] = bucket;
+        }
+    }
+
+    template <typename KeyOf>
+    size_t locate(std::string_view id, uint32_t hash, const KeyOf& keyOf) const {
+        if (buckets.empty()) return SIZE_MAX;
+        for (size_t at = hash & mask;; at = (at + 1) & mask) {
+            const Bucket& bucket = buckets[at];
+            if (bucket.value < 0) return SIZE_MAX;
+            if (bucket.hash == hash && std::string_view(keyOf(bucket.value)) == id) return at;
+        }
+    }
+
+public:
+    AgentIdIndex() : count(0), mask(0) {}
+
+    size_t size() const { return count; }
+
+    // Keeps the bucket array; reserve(n) afterwards only grows it
+    void clear() {
+        for (Bucket& bucket : buckets) bucket.value = -1;
+        count = 0;
+    }
+
+    void reserve(size_t entries) {
+        if (entries * 2 > buckets.size()) rehash(entries);
+    }
+
+    // Value stored for id, or -1
+    template <typename KeyOf>
+    int find(std::string_view id, const KeyOf& keyOf) const {
+        size_t at = locate(id, hashId(id), keyOf);
+        return at == SIZE_MAX ? -1 : buckets[at].value;
+    }
+
+    // id must not be present yet
+    void insert(std::string_view id, int value) {
+        reserve(count + 1);
+        const uint32_t hash = hashId(id);
+        size_t at = hash & mask;
+        while (buckets[at].value >= 0) at = (at + 1) & mask;
+        buckets[at] = Bucket{hash, value};
+        count++;
+    }
+
+    template <typename KeyOf>
+    bool erase(std::string_view id, const KeyOf& keyOf) {
+        size_t hole = locate(id, hashId(id), keyOf);
+        if (hole == SIZE_MAX) return false;
+        // Pull later entries of the probe run back so no lookup stops early at the hole
+        for (size_t at = (hole + 1) & mask; buckets[at].value >= 0; at = (at + 1) & mask) {
+            size_t home = buckets[at].hash & mask;
+            if (((at - home) & mask) >= ((at - hole) & mask)) {
+                buckets[hole] = buckets[at];
+                hole = at;
+            }
+        }
+        buckets[hole].value = -1;
+        count--;
+        return true;
+    }
+};
+
+// Update thread only
+class AgentTable {
+private:
+    struct Slot {
+        std::string npcId;
+        int crowdHandle;        // -1 while the slot is free
+        uint32_t generation;    // 1..AGENT_GENERATION_MASK
+        int nextFree;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<int> slotOfCrowdHandle;    // Crowd handle -> slot, -1 = none
+    AgentIdIndex ids;
+    int freeHead;
+    size_t count;
+
+    std::string_view idOf(int slot) const { return slots[slot].npcId; }
+
+    void bindCrowdHandle(int crowdHandle, int slot) {
+        if (crowdHandle < 0) return;
+        if ((size_t)crowdHandle >= slotOfCrowdHandle.size()) slotOfCrowdHandle.resize((size_t)crowdHandle + 1, -1);
+        slotOfCrowdHandle[crowdHandle] = slot;
+    }
+
+public:
+    AgentTable() : freeHead(-1), count(0) {}
+
+    // Sizes the arrays for the crowd up front, so steady-state adds do not reallocate
+    void reserve(int agents, int crowdHandles) {
+        slots.reserve(agents);
+        slotOfCrowdHandle.resize(crowdHandles, -1);
+        ids.reserve(agents);
+    }
+
+    size_t size() const { return count; }
+
+    // Slots in use are those with crowdHandle(slot) >= 0
+    int slotCount() const { return (int)slots.size(); }
+
+    // -1 when npcId has no agent
+    int find(std::string_view npcId) const {
+        return ids.find(npcId, [this](int slot) { return idOf(slot); });
+    }
+
+    // -1 for AGENT_HANDLE_NONE, a freed slot or a slot reused since the handle was issued
+    int resolve(AgentHandle handle) const {
+        int slot = agentHandleSlot(handle);
+        if (handle == AGENT_HANDLE_NONE || slot >= (int)slots.size()) return -1;
+        const Slot& entry = slots[slot];
+        return entry.crowdHandle >= 0 && entry.generation == agentHandleGeneration(handle) ? slot : -1;
+    }
+
+    AgentHandle handleOf(int slot) const { return makeAgentHandle(slot, slots[slot].generation); }
+    int crowdHandle(int slot) const { return slots[slot].crowdHandle; }
+    const std::string& npcId(int slot) const { return slots[slot].npcId; }
+
+    // npcId must not have an agent already; returns its slot, or -1 when the handle space is used up
+    int add(std::string_view npcId, int crowdHandle) {
+        int slot = freeHead;
+        if (slot >= 0) {
+            freeHead = slots[slot].nextFree;
+        } else {
+            if (slots.size() > AGENT_SLOT_MASK) return -1;
+            slot = (int)slots.size();
+            slots.push_back(Slot{std::string(), -1, 1, -1});
+        }
+        Slot& entry = slots[slot];
+        entry.npcId.assign(npcId.data(), npcId.size());
+        entry.crowdHandle = crowdHandle;
+        entry.nextFree = -1;
+        ids.insert(npcId, slot);
+        bindCrowdHandle(crowdHandle, slot);
+        count++;
+        return slot;
+    }
+
+    // Like add, but takes the slot and generation of handle when that slot is free, so an
+    // agent restored from a saved crowd keeps the handle callers already hold. Falls back
+    // to add() otherwise. Walks the free list; restores are rare.
+    int addAt(std::string_view npcId, int crowdHandle, AgentHandle handle) {
+        const int slot = agentHandleSlot(handle);
+        const uint32_t generation = agentHandleGeneration(handle);
+        if (handle == AGENT_HANDLE_NONE || generation == 0) return add(npcId, crowdHandle);
+        while ((int)slots.size() <= slot) {
+            slots.push_back(Slot{std::string(), -1, 1, freeHead});
+            freeHead = (int)slots.size() - 1;
+        }
+        if (slots[slot].crowdHandle >= 0) return add(npcId, crowdHandle);
+
+        int* link = &freeHead;
+        while (*link != slot) link = &slots[*link].nextFree;
+        *link = slots[slot].nextFree;
+
+        Slot& entry = slots[slot];
+        entry.npcId.assign(npcId.data(), npcId.size());
+        entry.crowdHandle = crowdHandle;
+        entry.generation = generation;
+        entry.nextFree = -1;
+        ids.insert(npcId, slot);
+        bindCrowdHandle(crowdHandle, slot);
+        count++;
+        return slot;
+    }
+
+    void remove(int slot) {
+        Slot& entry = slots[slot];
+        if (entry.crowdHandle < 0) return;
+        ids.erase(entry.npcId, [this](int s) { return idOf(s); });
+        if ((size_t)entry.crowdHandle < slotOfCrowdHandle.size()) slotOfCrowdHandle[entry.crowdHandle] = -1;
+        entry.crowdHandle = -1;
+        entry.generation = entry.generation >= AGENT_GENERATION_MASK ? 1 : entry.generation + 1;
+        entry.nextFree = freeHead;
+        freeHead = slot;
+        count--;
+    }
+
+    // (old, new) crowd handle pairs from one ShardedCrowd::migrate pass. A new handle can be
+    // another mover's old one, so every old handle is resolved before any is rebound.
+    void migrate(const std::vector<std::pair<int, int>>& moved) {
+        static thread_local std::vector<int> movedSlots;
+        movedSlots.clear();
+        for (const auto& move : moved) {
+            bool known = move.first >= 0 && (size_t)move.first < slotOfCrowdHandle.size();
+            movedSlots.push_back(known ? slotOfCrowdHandle[move.first] : -1);
+            if (known) slotOfCrowdHandle[move.first] = -1;
+        }
+        for (size_t i = 0; i < moved.size(); i++) {
+            if (movedSlots[i] < 0) continue;
+            slots[movedSlots[i]].crowdHandle = moved[i].second;
+            bindCrowdHandle(moved[i].second, movedSlots[i]);
+        }
+    }
+};
@@ -0,0 +1,237 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Agent state stream
+// Subscribers of GET /agentStream get one frame per crowd tick instead of polling
+// /getAgentStates. A frame only carries the agents whose position or velocity moved
+// past a threshold since what was last sent for them (or whose target state changed),
+// quantized to fixed steps, positions as deltas from the last sent value. Events
+// report agents reaching their target and agents leaving the crowd. Any subscriber
+// can start from a keyframe, which lists every agent in full; the encoder emits one
+// whenever requestKeyframe() was called (a new or resyncing subscriber).
+//
+// Layout, little-endian; frames follow each other on the stream:
+//   frame   u32 size (bytes after this field), u8 kind (1 keyframe, 2 delta), u8 reserved,
+//           u16 reserved, u64 tick, f32 position step, f32 velocity step,
+//           u32 agent count, u32 event count, agents, events
+//   agent   u32 handle, u8 fields, then the fields present, in this order:
+//     AGENT_STREAM_ID         u16 id length, id (keyframes and agents new to the stream)
+//     AGENT_STREAM_POS_ABS    i32 x, y, z in position steps
+//     AGENT_STREAM_POS_DELTA  i16 x, y, z in position steps, added to the last position
+//     AGENT_STREAM_VEL        i16 x, y, z in velocity steps
+//     AGENT_STREAM_STATE      u8 target state, | 0x80 while at target
+//   event   u8 type, u32 handle
+// Agents missing from a delta frame are unchanged; a keyframe replaces the whole table.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "pathfinding-agents.h"
+
+enum AgentStreamFrameKind : uint8_t {
+    AGENT_STREAM_KEYFRAME = 1,
+    AGENT_STREAM_DELTA = 2
+};
+
+enum AgentStreamField : uint8_t {
+    AGENT_STREAM_ID = 1,
+    AGENT_STREAM_POS_ABS = 2,
+    AGENT_STREAM_POS_DELTA = 4,
+    AGENT_STREAM_VEL = 8,
+    AGENT_STREAM_STATE = 16
+};
+
+enum AgentStreamEvent : uint8_t {
+    AGENT_STREAM_TARGET_REACHED = 1,
+    AGENT_STREAM_REMOVED = 2
+};
+
+struct AgentStreamConfig {
+    float positionStep = 1.0f / 64.0f;
+    float velocityStep = 1.0f / 256.0f;
+    float positionThreshold = 0.05f;    // World units an agent moves before it is resent
+    float velocityThreshold = 0.1f;
+};
+
+struct AgentStreamStats {
+    unsigned long long frames = 0;
+    unsigned long long keyframes = 0;
+    unsigned long long bytes = 0;
+    unsigned long long agentsSent = 0;
+    unsigned long long events = 0;
+};
+
+// Update thread only, except requestKeyframe() and getStats()
+class AgentStreamEncoder {
+private:
+    // What subscribers last got for the agent in a slot (see AgentTable)
+    struct Baseline {
+        AgentHandle handle;         // AGENT_HANDLE_NONE = nothing sent for this slot
+        int32_t pos[3];
+        int16_t vel[3];
+        uint8_t state;
+        unsigned long long seen;    // Last tick the agent was in the crowd
+    };
+
+    AgentStreamConfig config;
+    std::vector<Baseline> baselines;
+    std::atomic<bool> keyframeRequested;
+    std::string frame;
+    std::string events;
+
+    std::mutex statsMutex;
+    AgentStreamStats stats;
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void patch(std::string& out, size_t at, T value) {
+        memcpy(&out[at], &value, sizeof(T));
+    }
+
+    static int32_t quantize(float value, float step) {
+        double q = std::floor((double)value / step + 0.5);
+        return (int32_t)std::max(-2147483647.0, std::min(2147483647.0, q));
+    }
+
+    static int16_t quantize16(float value, float step) {
+        return (int16_t)std::max<int32_t>(-32767, std::min<int32_t>(32767, quantize(value, step)));
+    }
+
+    void addEvent(AgentStreamEvent type, AgentHandle handle) {
+        put<uint8_t>(events, type);
+        put<uint32_t>(events, handle);
+    }
+
+public:
+    AgentStreamEncoder() : keyframeRequested(true) {}
+
+    void configure(const AgentStreamConfig& streamConfig) { config = streamConfig; }
+
+    // Any thread: the next encode() writes a keyframe
+    void requestKeyframe() { keyframeRequested = true; }
+
+    // Agents: anything with handle, npcId, pos, vel, targetState and atTarget. Returns the
+    // frame, valid until the next call; keyframe says whether it stands on its own.
+    template <typename Agents>
+    const std::string& encode(unsigned long long tick, const Agents& agents, bool& keyframe) {
+        keyframe = keyframeRequested.exchange(false);
+        const float positionThreshold2 = config.positionThreshold * config.positionThreshold;
+        const float velocityThreshold2 = config.velocityThreshold * config.velocityThreshold;
+
+        frame.clear();
+        events.clear();
+        put<uint32_t>(frame, 0);
+        put<uint8_t>(frame, keyframe ? AGENT_STREAM_KEYFRAME : AGENT_STREAM_DELTA);
+        put<uint8_t>(frame, 0);
+        put<uint16_t>(frame, 0);
+        put<uint64_t>(frame, tick);
+        put<float>(frame, config.positionStep);
+        put<float>(frame, config.velocityStep);
+        const size_t countsAt = frame.size();
+        put<uint32_t>(frame, 0);
+        put<uint32_t>(frame, 0);
+
+        uint32_t sent = 0;
+        for (const auto& agent : agents) {
+            const int slot = agentHandleSlot(agent.handle);
+            if ((size_t)slot >= baselines.size()) baselines.resize((size_t)slot + 1, Baseline{AGENT_HANDLE_NONE, {0, 0, 0}, {0, 0, 0}, 0, 0});
+            Baseline& base = baselines[slot];
+            // A different handle in the slot means the previous agent went away first
+            if (base.handle != agent.handle && base.handle != AGENT_HANDLE_NONE) addEvent(AGENT_STREAM_REMOVED, base.handle);
+            const bool fresh = keyframe || base.handle != agent.handle;
+            const uint8_t state = (uint8_t)((agent.targetState & 0x7f) | (agent.atTarget ? 0x80 : 0));
+
+            uint8_t fields = fresh ? (AGENT_STREAM_ID | AGENT_STREAM_VEL | AGENT_STREAM_STATE) : 0;
+            float dp2 = 0.0f, dv2 = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                float dp = agent.pos[i] - base.pos[i] * config.positionStep;
+                float dv = agent.vel[i] - base.vel[i] * config.velocityStep;
+                dp2 += dp * dp;
+                dv2 += dv * dv;
+            }
+            int32_t pos[3];
+            for (int i = 0; i < 3; i++) pos[i] = quantize(agent.pos[i], config.positionStep);
+            if (fresh) {
+                fields |= AGENT_STREAM_POS_ABS;
+            } else if (dp2 > positionThreshold2) {
+                bool small = true;
+                for (int i = 0; i < 3; i++) small = small && std::abs((long long)pos[i] - base.pos[i]) <= 32767;
+                fields |= small ? AGENT_STREAM_POS_DELTA : AGENT_STREAM_POS_ABS;
+            }
+            if (!fresh && dv2 > velocityThreshold2) fields |= AGENT_STREAM_VEL;
+            if (!fresh && state != base.state) fields |= AGENT_STREAM_STATE;
+            if (base.handle == agent.handle && (state & 0x80) && !(base.state & 0x80)) addEvent(AGENT_STREAM_TARGET_REACHED, agent.handle);
+
+            base.handle = agent.handle;
+            base.seen = tick;
+            if (!fields) continue;
+
+            put<uint32_t>(frame, agent.handle);
+            put<uint8_t>(frame, fields);
+            if (fields & AGENT_STREAM_ID) {
+                const size_t idLength = std::min<size_t>(agent.npcId.size(), 65535);
+                put<uint16_t>(frame, (uint16_t)idLength);
+                frame.append(agent.npcId.data(), idLength);
+            }
+            if (fields & AGENT_STREAM_POS_ABS) {
+                for (int i = 0; i < 3; i++) put<int32_t>(frame, pos[i]);
+            } else if (fields & AGENT_STREAM_POS_DELTA) {
+                for (int i = 0; i < 3; i++) put<int16_t>(frame, (int16_t)(pos[i] - base.pos[i]));
+            }
+            if (fields & (AGENT_STREAM_POS_ABS | AGENT_STREAM_POS_DELTA)) memcpy(base.pos, pos, sizeof(pos));
+            if (fields & AGENT_STREAM_VEL) {
+                for (int i = 0; i < 3; i++) {
+                    base.vel[i] = quantize16(agent.vel[i], config.velocityStep);
+                    put<int16_t>(frame, base.vel[i]);
+                }
+            }
+            if (fields & AGENT_STREAM_STATE) put<uint8_t>(frame, state);
+            base.state = state;
+            sent++;
+        }
+
+        // Slots not refreshed this tick lost their agent
+        for (Baseline& base : baselines) {
+            if (base.handle == AGENT_HANDLE_NONE || base.seen == tick) continue;
+            addEvent(AGENT_STREAM_REMOVED, base.handle);
+            base.handle = AGENT_HANDLE_NONE;
+        }
+
+        const uint32_t eventCount = (uint32_t)(events.size() / 5);
+        frame.append(events);
+        patch<uint32_t>(frame, 0, (uint32_t)(frame.size() - sizeof(uint32_t)));
+        patch<uint32_t>(frame, countsAt, sent);
+        patch<uint32_t>(frame, countsAt + sizeof(uint32_t), eventCount);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.frames++;
+        if (keyframe) stats.keyframes++;
+        stats.bytes += frame.size();
+        stats.agentsSent += sent;
+        stats.events += eventCount;
+        return frame;
+    }
+
+    // Forget what was sent; the next frame is a keyframe
+    void reset() {
+        baselines.clear();
+        keyframeRequested = true;
+    }
+
+    AgentStreamStats getStats() {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+};
@@ -0,0 +1,213 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Crowd state snapshot
+// The whole crowd as one compact binary file: every agent's id, handle, position,
+// velocity, steering parameters and what it was heading for. The service writes one on
+// request (and every few seconds with --crowd-state) and reads it back at startup, so a
+// restart or a deploy resumes the crowd where it was, with the same agent handles,
+// instead of the game server adding every agent again. The in-memory form also carries
+// the crowd across a navmesh reload.
+//
+// Layout, little-endian:
+//   header  u32 magic 'PFCS', u32 version, u64 tick, u64 saved unix ms, u32 agent count,
+//           u32 reserved
+//   agent   u16 id length, id, u32 handle, f32 pos[3], f32 vel[3], f32 target[3],
+//           u8 target state, u16 chase target length, chase target,
+//           f32 radius, height, max acceleration, max speed, collision query range,
+//           path optimization range, separation weight,
+//           u8 update flags, u8 obstacle avoidance type, u8 query filter type, u8 reserved
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#include "DetourCrowd.h"
+#include "pathfinding-agents.h"
+
+static const uint32_t CROWD_STATE_MAGIC = 0x53434650;  // 'PFCS'
+static const uint32_t CROWD_STATE_VERSION = 1;
+
+struct CrowdStateAgent {
+    std::string npcId;
+    AgentHandle handle = AGENT_HANDLE_NONE;
+    float pos[3] = {0.0f, 0.0f, 0.0f};
+    float vel[3] = {0.0f, 0.0f, 0.0f};
+    float targetPos[3] = {0.0f, 0.0f, 0.0f};
+    int targetState = DT_CROWDAGENT_TARGET_NONE;
+    std::string chaseTarget;            // Flow field target the agent chases, empty for a plain target
+    dtCrowdAgentParams params;          // Full quality, before crowd LOD
+};
+
+struct CrowdState {
+    unsigned long long tick = 0;
+    unsigned long long savedUnixMs = 0;
+    std::vector<CrowdStateAgent> agents;
+};
+
+struct CrowdStateStats {
+    unsigned long long saves = 0;
+    unsigned long long restores = 0;
+    size_t lastSavedAgents = 0;
+    size_t lastRestoredAgents = 0;
+    size_t lastDroppedAgents = 0;       // Saved agents with no navmesh under them on restore
+    double lastSaveMs = 0.0;
+    double lastRestoreMs = 0.0;
+};
+
+namespace crowdstate {
+
+template <typename T>
+inline void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void putString(std::string& out, const std::string& value) {
+    const size_t length = std::min<size_t>(value.size(), 65535);
+    put<uint16_t>(out, (uint16_t)length);
+    out.append(value.data(), length);
+}
+
+// Reads forward through a buffer; every take fails once the buffer ran out
+class Cursor {
+private:
+    const std::string& data;
+    size_t at;
+
+public:
+    explicit Cursor(const std::string& buffer) : data(buffer), at(0) {}
+
+    template <typename T>
+    bool take(T& value) {
+        if (data.size() - at < sizeof(T)) return false;
+        memcpy(&value, data.data() + at, sizeof(T));
+        at += sizeof(T);
+        return true;
+    }
+
+    bool takeFloats(float* values, int count) {
+        for (int i = 0; i < count; i++) {
+            if (!take(values[i])) return false;
+        }
+        return true;
+    }
+
+    bool takeString(std::string& value) {
+        uint16_t length;
+        if (!take(length) || data.size() - at < length) return false;
+        value.assign(data, at, length);
+        at += length;
+        return true;
+    }
+};
+
+} // namespace crowdstate
+
+inline void encodeCrowdState(const CrowdState& state, std::string& out) {
+    using namespace crowdstate;
+    out.clear();
+    put<uint32_t>(out, CROWD_STATE_MAGIC);
+    put<uint32_t>(out, CROWD_STATE_VERSION);
+    put<uint64_t>(out, state.tick);
+    put<uint64_t>(out, state.savedUnixMs);
+    put<uint32_t>(out, (uint32_t)state.agents.size());
+    put<uint32_t>(out, 0);
+    for (const auto& agent : state.agents) {
+        putString(out, agent.npcId);
+        put<uint32_t>(out, agent.handle);
+        for (int i = 0; i < 3; i++) put<float>(out, agent.pos[i]);
+        for (int i = 0; i < 3; i++) put<float>(out, agent.vel[i]);
+        for (int i = 0; i < 3; i++) put<float>(out, agent.targetPos[i]);
+        put<uint8_t>(out, (uint8_t)agent.targetState);
+        putString(out, agent.chaseTarget);
+        const dtCrowdAgentParams& params = agent.params;
+        put<float>(out, params.radius);
+        put<float>(out, params.height);
+        put<float>(out, params.maxAcceleration);
+        put<float>(out, params.maxSpeed);
+        put<float>(out, params.collisionQueryRange);
+        put<float>(out, params.pathOptimizationRange);
+        put<float>(out, params.separationWeight);
+        put<uint8_t>(out, params.updateFlags);
+        put<uint8_t>(out, params.obstacleAvoidanceType);
+        put<uint8_t>(out, params.queryFilterType);
+        put<uint8_t>(out, 0);
+    }
+}
+
+// False on a foreign or truncated buffer
+inline bool decodeCrowdState(const std::string& data, CrowdState& state) {
+    crowdstate::Cursor cursor(data);
+    uint32_t magic = 0, version = 0, count = 0, reserved = 0;
+    uint64_t tick = 0, savedUnixMs = 0;
+    if (!cursor.take(magic) || !cursor.take(version) || magic != CROWD_STATE_MAGIC || version != CROWD_STATE_VERSION) return false;
+    if (!cursor.take(tick) || !cursor.take(savedUnixMs) || !cursor.take(count) || !cursor.take(reserved)) return false;
+    state.tick = tick;
+    state.savedUnixMs = savedUnixMs;
+    state.agents.clear();
+    state.agents.reserve(std::min<size_t>(count, data.size() / 64));
+    for (uint32_t i = 0; i < count; i++) {
+        CrowdStateAgent agent;
+        dtCrowdAgentParams& params = agent.params;
+        memset(&params, 0, sizeof(params));
+        uint8_t targetState = 0, pad = 0;
+        if (!cursor.takeString(agent.npcId) || !cursor.take(agent.handle) || !cursor.takeFloats(agent.pos, 3) ||
+            !cursor.takeFloats(agent.vel, 3) || !cursor.takeFloats(agent.targetPos, 3) || !cursor.take(targetState) ||
+            !cursor.takeString(agent.chaseTarget)) return false;
+        if (!cursor.take(params.radius) || !cursor.take(params.height) || !cursor.take(params.maxAcceleration) ||
+            !cursor.take(params.maxSpeed) || !cursor.take(params.collisionQueryRange) || !cursor.take(params.pathOptimizationRange) ||
+            !cursor.take(params.separationWeight) || !cursor.take(params.updateFlags) || !cursor.take(params.obstacleAvoidanceType) ||
+            !cursor.take(params.queryFilterType) || !cursor.take(pad)) return false;
+        agent.targetState = targetState;
+        state.agents.push_back(std::move(agent));
+    }
+    return true;
+}
+
+// Writes next to path and renames over it, so a crash mid-write leaves the previous file
+inline bool writeCrowdState(const std::string& path, const CrowdState& state) {
+    std::string data;
+    encodeCrowdState(state, data);
+    const std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    return MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+}
+
+inline bool readCrowdState(const std::string& path, CrowdState& state) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::string data;
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, read);
+    fclose(file);
+    return decodeCrowdState(data, state);
+}
+
+inline unsigned long long crowdStateUnixMs() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,321 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Shared-goal flow fields
+// A FlowField is a reverse Dijkstra expansion from a goal poly over a bounded region,
+// storing next hop and cost-to-goal per poly. FlowFieldRouter keeps one field per
+// chased target (e.g. a player) and steers every crowd agent chasing it by handing the
+// agent a corridor read straight out of the field, so the search cost scales with the
+// number of distinct targets instead of the number of chasers.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCrowd.h"
+#include "pathfinding-pathcache.h"
+#include "pathfinding-shards.h"
+
+class FlowField {
+public:
+    struct Node {
+        dtPolyRef next;     // Neighbour one step closer to the goal (0 at the goal)
+        float cost;         // Cost to reach the goal
+        float pos[3];       // Poly centroid (goal position for the goal poly)
+        bool closed;
+    };
+
+private:
+    std::unordered_map<dtPolyRef, Node> nodes;
+    dtPolyRef goalRef;
+
+    static void polyCentroid(const dtMeshTile* tile, const dtPoly* poly, float* out) {
+        out[0] = out[1] = out[2] = 0.0f;
+        for (int i = 0; i < poly->vertCount; i++) {
+            const float* v = &tile->verts[poly->verts[i] * 3];
+            out[0] += v[0];
+            out[1] += v[1];
+            out[2] += v[2];
+        }
+        float scale = poly->vertCount > 0 ? 1.0f / poly->vertCount : 0.0f;
+        out[0] *= scale;
+        out[1] *= scale;
+        out[2] *= scale;
+    }
+
+public:
+    FlowField() : goalRef(0) {}
+
+    dtPolyRef goal() const { return goalRef; }
+    size_t size() const { return nodes.size(); }
+    bool contains(dtPolyRef ref) const { return nodes.count(ref) != 0; }
+
+    // Expands outward from goalRef until maxNodes polys are settled or the cost passes maxCost.
+    // Links are followed in reverse, which matches Detour's symmetric ground links; one-way
+    // off-mesh connections are left out.
+    void build(const dtNavMesh* navMesh, const dtQueryFilter* filter, dtPolyRef goal, const float* goalPos, int maxNodes, float maxCost) {
+        nodes.clear();
+        goalRef = goal;
+        if (!goal) return;
+        nodes.reserve((size_t)maxNodes);
+
+        typedef std::pair<float, dtPolyRef> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+        Node& start = nodes[goal];
+        start.next = 0;
+        start.cost = 0.0f;
+        memcpy(start.pos, goalPos, sizeof(start.pos));
+        start.closed = false;
+        open.push(Entry(0.0f, goal));
+
+        int settled = 0;
+        while (!open.empty() && settled < maxNodes) {
+            Entry top = open.top();
+            open.pop();
+            Node& current = nodes[top.second];
+            if (current.closed || top.first > current.cost) continue;
+            current.closed = true;
+            settled++;
+
+            const dtMeshTile* tile = nullptr;
+            const dtPoly* poly = nullptr;
+            navMesh->getTileAndPolyByRefUnsafe(top.second, &tile, &poly);
+            const float currentPos[3] = {current.pos[0], current.pos[1], current.pos[2]};
+            const float currentCost = current.cost;
+
+            for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next) {
+                dtPolyRef neighbourRef = tile->links[i].ref;
+                if (!neighbourRef) continue;
+
+                const dtMeshTile* neighbourTile = nullptr;
+                const dtPoly* neighbourPoly = nullptr;
+                navMesh->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+                if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION) continue;
+                if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly)) continue;
+
+                float neighbourPos[3];
+                polyCentroid(neighbourTile, neighbourPoly, neighbourPos);
+                float dx = neighbourPos[0] - currentPos[0];
+                float dy = neighbourPos[1] - currentPos[1];
+                float dz = neighbourPos[2] - currentPos[2];
+                float cost = currentCost + sqrtf(dx * dx + dy * dy + dz * dz) * filter->getAreaCost(neighbourPoly->getArea());
+                if (cost > maxCost) continue;
+
+                auto it = nodes.find(neighbourRef);
+                if (it != nodes.end() && (it->second.closed || it->second.cost <= cost)) continue;
+                Node& neighbour = nodes[neighbourRef];
+                neighbour.next = top.second;
+                neighbour.cost = cost;
+                memcpy(neighbour.pos, neighbourPos, sizeof(neighbour.pos));
+                neighbour.closed = false;
+                open.push(Entry(cost, neighbourRef));
+            }
+        }
+
+        // Drop polys that were reached but never settled - their next hop is not final
+        for (auto it = nodes.begin(); it != nodes.end();) {
+            if (it->second.closed) ++it;
+            else it = nodes.erase(it);
+        }
+    }
+
+    // Poly corridor from start to the goal by following next hops; 0 if start is outside the field
+    int extractPath(dtPolyRef start, dtPolyRef* path, int maxPath) const {
+        int count = 0;
+        dtPolyRef ref = start;
+        while (ref && count < maxPath) {
+            auto it = nodes.find(ref);
+            if (it == nodes.end()) return 0;
+            path[count++] = ref;
+            ref = it->second.next;
+        }
+        return count;
+    }
+};
+
+struct FlowFieldStats {
+    size_t targets = 0;
+    size_t chasers = 0;
+    size_t fieldPolys = 0;                  // Settled polys over all live fields
+    unsigned long long builds = 0;
+    unsigned long long steered = 0;         // Corridors handed out from a field
+    unsigned long long fallbacks = 0;       // Chasers outside their field, sent through the crowd's own pathfinder
+};
+
+// Update thread only, apart from getStats
+class FlowFieldRouter {
+private:
+    struct Target {
+        float goalPos[3] = {0.0f, 0.0f, 0.0f};     // Last requested goal
+        bool goalMoved = false;
+        dtPolyRef goalRef = 0;                      // Goal snapped to the navmesh
+        float goalPoint[3] = {0.0f, 0.0f, 0.0f};
+        unsigned long long tileGeneration = 0;
+        FlowField field;
+        std::vector<int> chasers;
+    };
+
+    std::unordered_map<std::string, Target> targets;
+    std::unordered_map<int, std::string> chaserTargets;     // agent index -> target id
+    std::vector<int> unsteered;                             // Chasers that need a fresh corridor
+    int maxNodes;
+    float maxCost;
+    int maxPath;
+
+    mutable std::mutex statsMutex;
+    FlowFieldStats stats;
+
+public:
+    FlowFieldRouter(int fieldMaxPolys, float fieldMaxDistance, int corridorMaxPath)
+        : maxNodes(fieldMaxPolys), maxCost(fieldMaxDistance), maxPath(corridorMaxPath) {}
+
+    // Makes agentIndex chase targetId; every call also moves the target's goal (latest wins)
+    void chase(int agentIndex, const std::string& targetId, const float* goalPos) {
+        auto current = chaserTargets.find(agentIndex);
+        if (current != chaserTargets.end() && current->second != targetId) release(agentIndex);
+
+        Target& target = targets[targetId];
+        memcpy(target.goalPos, goalPos, sizeof(target.goalPos));
+        target.goalMoved = true;
+
+        if (chaserTargets.count(agentIndex) == 0) {
+            chaserTargets[agentIndex] = targetId;
+            target.chasers.push_back(agentIndex);
+            unsteered.push_back(agentIndex);
+        }
+    }
+
+    // Agent stopped chasing (new plain target, stop, removal)
+    void release(int agentIndex) {
+        auto it = chaserTargets.find(agentIndex);
+        if (it == chaserTargets.end()) return;
+        auto target = targets.find(it->second);
+        if (target != targets.end()) {
+            auto& chasers = target->second.chasers;
+            for (size_t i = 0; i < chasers.size(); i++) {
+                if (chasers[i] == agentIndex) {
+                    chasers[i] = chasers.back();
+                    chasers.pop_back();
+                    break;
+                }
+            }
+            if (chasers.empty()) targets.erase(target);
+        }
+        chaserTargets.erase(it);
+    }
+
+    // Target id agentIndex chases, or null
+    const std::string* chaseTargetOf(int agentIndex) const {
+        auto it = chaserTargets.find(agentIndex);
+        return it == chaserTargets.end() ? nullptr : &it->second;
+    }
+
+    // The crowd was rebuilt: every chaser is gone, chasers are added back with chase()
+    void clear() {
+        targets.clear();
+        chaserTargets.clear();
+        unsteered.clear();
+    }
+
+    // The agent moved to another crowd shard and has a new handle; its corridor came along
+    void migrate(int oldIndex, int newIndex) {
+        auto it = chaserTargets.find(oldIndex);
+        if (it == chaserTargets.end()) return;
+        std::string targetId = it->second;
+        chaserTargets.erase(it);
+        chaserTargets[newIndex] = targetId;
+        for (int& chaser : targets[targetId].chasers) {
+            if (chaser == oldIndex) chaser = newIndex;
+        }
+        for (int& chaser : unsteered) {
+            if (chaser == oldIndex) chaser = newIndex;
+        }
+    }
+
+    // Before crowd->update: rebuild fields whose goal poly or tiles changed, then hand corridors
+    // to chasers that need one and slide the others' corridor end to the new goal position
+    void update(ShardedCrowd& crowd, dtNavMeshQuery* navQuery, const dtQueryFilter* filter, unsigned long long tileGeneration) {
+        static const float extents[3] = {20.0f, 10.0f, 20.0f};
+        const dtNavMesh* navMesh = navQuery->getAttachedNavMesh();
+        unsigned long long builds = 0, steered = 0, fallbacks = 0;
+
+        std::vector<int> pending;
+        pending.swap(unsteered);
+
+        for (auto& entry : targets) {
+            Target& target = entry.second;
+            if (!target.goalMoved && target.tileGeneration == tileGeneration) continue;
+
+            dtPolyRef goalRef = 0;
+            float goalPoint[3];
+            navQuery->findNearestPoly(target.goalPos, extents, filter, &goalRef, goalPoint);
+            target.goalMoved = false;
+            if (!goalRef) continue;
+            memcpy(target.goalPoint, goalPoint, sizeof(goalPoint));
+
+            if (goalRef != target.goalRef || target.tileGeneration != tileGeneration) {
+                target.goalRef = goalRef;
+                target.tileGeneration = tileGeneration;
+                target.field.build(navMesh, filter, goalRef, goalPoint, maxNodes, maxCost);
+                builds++;
+                pending.insert(pending.end(), target.chasers.begin(), target.chasers.end());
+                continue;
+            }
+
+            // Same goal poly: only the end point moved
+            for (int agentIndex : target.chasers) {
+                dtCrowdAgent* agent = crowd.getEditableAgent(agentIndex);
+                if (!agent || !agent->active || agent->targetState != DT_CROWDAGENT_TARGET_VALID) continue;
+                if (agent->corridor.getLastPoly() != goalRef) continue;
+                agent->corridor.moveTargetPosition(goalPoint, navQuery, filter);
+                memcpy(agent->targetPos, goalPoint, sizeof(goalPoint));
+            }
+        }
+
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        std::vector<dtPolyRef> path((size_t)maxPath);
+        for (int agentIndex : pending) {
+            auto chaser = chaserTargets.find(agentIndex);
+            if (chaser == chaserTargets.end()) continue;
+            Target& target = targets[chaser->second];
+            dtCrowdAgent* agent = crowd.getEditableAgent(agentIndex);
+            if (!agent || !agent->active || !target.goalRef) continue;
+
+            int count = target.field.extractPath(agent->corridor.getFirstPoly(), path.data(), maxPath);
+            if (count == 0) {
+                crowd.requestMoveTarget(agentIndex, target.goalRef, target.goalPoint);
+                fallbacks++;
+                continue;
+            }
+
+            applyAgentCorridor(agent, path.data(), count, target.goalRef, target.goalPoint);
+            steered++;
+        }
+
+        size_t fieldPolys = 0;
+        for (const auto& entry : targets) fieldPolys += entry.second.field.size();
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.targets = targets.size();
+        stats.chasers = chaserTargets.size();
+        stats.fieldPolys = fieldPolys;
+        stats.builds += builds;
+        stats.steered += steered;
+        stats.fallbacks += fallbacks;
+    }
+
+    FlowFieldStats getStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+};
@@ -0,0 +1,866 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Event-loop HTTP/1.1 server
+// One I/O thread (epoll on Linux, WSAPoll on Windows) + fixed worker pool.
+// Supports keep-alive, pipelining and Content-Length framed bodies.
+// Can also listen for length-prefixed binary frames (see pathfinding-ipc.h), and
+// serve long-lived chunked streams that any thread can broadcast frames to.
+// Handlers can hand their answer to another thread instead of waiting for it.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#define PF_INVALID_SOCKET INVALID_SOCKET
+#define pfCloseSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+typedef int socket_t;
+#define PF_INVALID_SOCKET (-1)
+#define pfCloseSocket close
+#endif
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string body;
+    bool keepAlive;
+};
+
+// Returns the complete HTTP response (status line, headers and body)
+typedef std::function<std::string(const HttpRequest&)> HttpHandler;
+
+// Receives one binary frame without its u32 length prefix, returns the complete response frame
+typedef std::function<std::string(const std::string&)> BinaryHandler;
+
+// Answers a request whose handler deferred it (see HttpServer::deferResponse). Any thread;
+// only the first call counts, and calls after the server is gone are dropped.
+typedef std::function<void(const std::string& response)> HttpResponder;
+
+class HttpServer {
+private:
+    static const size_t MAX_HEADER_BYTES = 64 * 1024;
+    static const size_t MAX_BODY_BYTES = 16 * 1024 * 1024;
+    static const size_t RECV_CHUNK = 16 * 1024;
+    static const size_t MAX_STREAM_BACKLOG = 1024 * 1024;   // Unsent bytes before a subscriber skips frames
+
+    struct Listener {
+        socket_t socket;
+        bool binary;
+    };
+
+    struct Stream {
+        std::string path;
+        std::string contentType;
+        std::function<void()> onResync;
+        std::vector<unsigned long long> subscribers;    // I/O thread only
+        std::atomic<size_t> subscriberCount;
+        std::atomic<unsigned long long> skipped;         // Frames not sent to lagging subscribers
+    };
+
+    struct Connection {
+        socket_t socket;
+        unsigned long long id;
+        bool binary;
+        std::string in;
+        std::string out;
+        size_t outOffset;
+        bool busy;          // A request from this connection is on a worker; keeps pipelined responses in order
+        bool closeAfterWrite;
+        Stream* stream;     // Set once the connection has subscribed; it takes no more requests
+        bool lagging;       // Skipping frames until the next resync frame fits its backlog
+    };
+
+    struct Broadcast {
+        Stream* stream;
+        std::shared_ptr<const std::string> chunk;
+        bool resync;
+    };
+
+    struct Job {
+        unsigned long long connectionId;
+        bool binary;
+        HttpRequest request;
+        std::string frame;
+    };
+
+    struct Completion {
+        unsigned long long connectionId;
+        std::string response;
+        bool keepAlive;
+        bool releases;      // Ends the connection's in-flight request; false for a late binary answer
+    };
+
+    // Where deferred answers are posted. Responders share it, so one that fires after the
+    // server is gone finds it detached instead of a dangling server.
+    struct ResponseSink {
+        std::mutex mutex;
+        HttpServer* server;
+    };
+
+    // The job a worker thread is running, for deferResponse
+    struct WorkerJob {
+        std::shared_ptr<ResponseSink> sink;
+        unsigned long long connectionId;
+        bool binary;
+        bool keepAlive;
+        std::shared_ptr<std::atomic<bool>> answered;    // Set once deferred
+    };
+
+    HttpHandler handler;
+    BinaryHandler binaryHandler;
+    int workerCount;
+    std::vector<Listener> listeners;
+    bool pollerReady;
+    std::atomic<bool> running;
+
+    std::unordered_map<unsigned long long, Connection> connections;
+    std::unordered_map<socket_t, unsigned long long> socketToConnection;
+    unsigned long long nextConnectionId;
+
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<Job> jobs;
+
+    std::mutex completionMutex;
+    std::vector<Completion> completions;
+    std::shared_ptr<ResponseSink> responseSink;
+
+    std::vector<std::unique_ptr<Stream>> streams;       // Fixed before run()
+    std::mutex broadcastMutex;
+    std::vector<Broadcast> broadcasts;
+
+#ifdef _WIN32
+    socket_t wakeSocket;        // Loopback UDP socket the workers poke to interrupt WSAPoll
+    sockaddr_in wakeAddr;
+#else
+    int epollFd;
+    int wakeFd;                 // eventfd the workers poke to interrupt epoll_wait
+#endif
+
+public:
+    HttpServer(HttpHandler requestHandler, int workers = 0)
+        : handler(requestHandler), workerCount(workers), pollerReady(false), running(false), nextConnectionId(1),
+          responseSink(std::make_shared<ResponseSink>()) {
+        responseSink->server = this;
+        if (workerCount <= 0) {
+            workerCount = (int)std::thread::hardware_concurrency();
+            if (workerCount < 2) workerCount = 2;
+        }
+#ifdef _WIN32
+        wakeSocket = PF_INVALID_SOCKET;
+        memset(&wakeAddr, 0, sizeof(wakeAddr));
+#else
+        epollFd = -1;
+        wakeFd = -1;
+#endif
+    }
+
+    ~HttpServer() {
+        stop();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(responseSink->mutex);
+            responseSink->server = nullptr;
+        }
+        for (auto& entry : connections) pfCloseSocket(entry.second.socket);
+        for (auto& listener : listeners) pfCloseSocket(listener.socket);
+#ifdef _WIN32
+        if (wakeSocket != PF_INVALID_SOCKET) closesocket(wakeSocket);
+        if (pollerReady) WSACleanup();
+#else
+        if (wakeFd >= 0) close(wakeFd);
+        if (epollFd >= 0) close(epollFd);
+#endif
+    }
+
+    // HTTP on a TCP port
+    bool listen(int port) {
+        return listenTcp(port, false);
+    }
+
+    // Binary frames on a loopback TCP port
+    bool listenBinaryTcp(int port, BinaryHandler frameHandler) {
+        binaryHandler = frameHandler;
+        return listenTcp(port, true);
+    }
+
+    // Binary frames on a Unix domain socket
+    bool listenBinaryUnix(const std::string& socketPath, BinaryHandler frameHandler) {
+        binaryHandler = frameHandler;
+        if (!initPoller()) return false;
+
+        socket_t s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s == PF_INVALID_SOCKET) {
+            std::cerr << "[HttpServer] Failed to create Unix socket" << std::endl;
+            return false;
+        }
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+#ifdef _WIN32
+        DeleteFileA(socketPath.c_str());
+#else
+        unlink(socketPath.c_str());
+#endif
+        if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(s, SOMAXCONN) != 0) {
+            std::cerr << "[HttpServer] Failed to bind Unix socket " << socketPath << std::endl;
+            pfCloseSocket(s);
+            return false;
+        }
+        addListener(s, true);
+        return true;
+    }
+
+    // Chunked stream: a GET to path is answered with chunked headers and then every frame
+    // later broadcast to path, until the client goes away. onResync runs on the I/O thread
+    // whenever a subscriber needs a frame it can start from: when it subscribes, and when
+    // it fell behind and has caught up again. Call before run().
+    void addStream(const std::string& path, const std::string& contentType, std::function<void()> onResync) {
+        std::unique_ptr<Stream> stream(new Stream());
+        stream->path = path;
+        stream->contentType = contentType;
+        stream->onResync = onResync;
+        stream->subscriberCount = 0;
+        stream->skipped = 0;
+        streams.push_back(std::move(stream));
+    }
+
+    // Any thread. resync marks a frame that stands on its own (a subscriber that skipped
+    // frames resumes at the next one). Frames to a path without a stream are dropped.
+    void broadcast(const std::string& path, const std::string& frame, bool resync) {
+        Stream* stream = findStream(path);
+        if (!stream || stream->subscriberCount == 0) return;
+
+        char size[20];
+        int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", frame.size());
+        auto chunk = std::make_shared<std::string>();
+        chunk->reserve(sizeLength + frame.size() + 2);
+        chunk->append(size, sizeLength);
+        chunk->append(frame);
+        chunk->append("\r\n");
+        {
+            std::lock_guard<std::mutex> lock(broadcastMutex);
+            broadcasts.push_back(Broadcast{stream, chunk, resync});
+        }
+        wake();
+    }
+
+    size_t subscriberCount(const std::string& path) const {
+        const Stream* stream = findStream(path);
+        return stream ? stream->subscriberCount.load() : 0;
+    }
+
+    unsigned long long skippedFrames(const std::string& path) const {
+        const Stream* stream = findStream(path);
+        return stream ? stream->skipped.load() : 0;
+    }
+
+    // Blocks running the I/O loop until stop() is called
+    void run() {
+        running = true;
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+        std::cout << "[HttpServer] Event loop running with " << workerCount << " workers" << std::endl;
+
+        std::vector<std::pair<socket_t, int>> events;
+        while (running) {
+            pollEvents(events, 1000);
+            for (const auto& event : events) {
+                const Listener* listener = findListener(event.first);
+                if (listener) {
+                    acceptConnections(*listener);
+                } else {
+                    handleSocketEvent(event.first, event.second);
+                }
+            }
+            drainCompletions();
+            drainBroadcasts();
+        }
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        jobReady.notify_all();
+        wake();
+    }
+
+    // Worker thread, inside a handler: the request is answered later through the returned
+    // responder, and the handler's return value is ignored. So no worker sleeps on a slow
+    // answer. An HTTP connection takes no further requests until then. A binary connection
+    // carries on, since its answers are matched by request id. Returns an empty responder
+    // outside a server worker (tools calling a handler directly), which answer right away.
+    static HttpResponder deferResponse() {
+        WorkerJob* job = currentJob();
+        if (!job) return HttpResponder();
+        if (!job->answered) job->answered = std::make_shared<std::atomic<bool>>(false);
+        std::shared_ptr<ResponseSink> sink = job->sink;
+        std::shared_ptr<std::atomic<bool>> answered = job->answered;
+        const unsigned long long connectionId = job->connectionId;
+        const bool keepAlive = job->keepAlive;
+        const bool releases = !job->binary;
+        return [sink, answered, connectionId, keepAlive, releases](const std::string& response) {
+            if (answered->exchange(true)) return;
+            std::lock_guard<std::mutex> lock(sink->mutex);
+            if (sink->server) sink->server->complete(connectionId, response, keepAlive, releases);
+        };
+    }
+
+private:
+    enum { EVENT_READ = 1, EVENT_WRITE = 2, EVENT_ERROR = 4 };
+
+    bool listenTcp(int port, bool binary) {
+        if (!initPoller()) {
+            std::cerr << "[HttpServer] Failed to initialize event loop" << std::endl;
+            return false;
+        }
+        socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s == PF_INVALID_SOCKET) {
+            std::cerr << "[HttpServer] Failed to create listen socket" << std::endl;
+            return false;
+        }
+        int opt = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
+        sockaddr_in serverAddr;
+        memset(&serverAddr, 0, sizeof(serverAddr));
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = binary ? htonl(INADDR_LOOPBACK) : INADDR_ANY;
+        serverAddr.sin_port = htons((unsigned short)port);
+
+        if (bind(s, (sockaddr*)&serverAddr, sizeof(serverAddr)) != 0 || ::listen(s, SOMAXCONN) != 0) {
+            std::cerr << "[HttpServer] Failed to bind port " << port << std::endl;
+            pfCloseSocket(s);
+            return false;
+        }
+        addListener(s, binary);
+        return true;
+    }
+
+    void addListener(socket_t s, bool binary) {
+        setNonBlocking(s);
+        Listener listener;
+        listener.socket = s;
+        listener.binary = binary;
+        listeners.push_back(listener);
+        watch(s, false);
+    }
+
+    Stream* findStream(const std::string& path) const {
+        for (const auto& stream : streams) {
+            if (stream->path == path) return stream.get();
+        }
+        return nullptr;
+    }
+
+    const Listener* findListener(socket_t s) const {
+        for (const auto& listener : listeners) {
+            if (listener.socket == s) return &listener;
+        }
+        return nullptr;
+    }
+
+    static void setNonBlocking(socket_t s) {
+#ifdef _WIN32
+        u_long mode = 1;
+        ioctlsocket(s, FIONBIO, &mode);
+#else
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+
+    static bool wouldBlock() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    // ---- Platform poller -------------------------------------------------------
+
+#ifdef _WIN32
+    std::unordered_map<socket_t, bool> pollInterest; // socket -> wants write
+
+    bool initPoller() {
+        if (pollerReady) return true;
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+        pollerReady = true;
+        wakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (wakeSocket == PF_INVALID_SOCKET) return false;
+        wakeAddr.sin_family = AF_INET;
+        wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        wakeAddr.sin_port = 0;
+        if (bind(wakeSocket, (sockaddr*)&wakeAddr, sizeof(wakeAddr)) != 0) return false;
+        int addrLen = sizeof(wakeAddr);
+        getsockname(wakeSocket, (sockaddr*)&wakeAddr, &addrLen);
+        setNonBlocking(wakeSocket);
+        return true;
+    }
+
+    void watch(socket_t s, bool wantWrite) { pollInterest[s] = wantWrite; }
+    void unwatch(socket_t s) { pollInterest.erase(s); }
+
+    void wake() {
+        if (wakeSocket == PF_INVALID_SOCKET) return;
+        char byte = 1;
+        sendto(wakeSocket, &byte, 1, 0, (sockaddr*)&wakeAddr, sizeof(wakeAddr));
+    }
+
+    void pollEvents(std::vector<std::pair<socket_t, int>>& events, int timeoutMs) {
+        events.clear();
+        std::vector<WSAPOLLFD> fds;
+        fds.reserve(pollInterest.size() + 1);
+        WSAPOLLFD wakeFd = { wakeSocket, POLLRDNORM, 0 };
+        fds.push_back(wakeFd);
+        for (const auto& entry : pollInterest) {
+            WSAPOLLFD fd = { entry.first, (short)(POLLRDNORM | (entry.second ? POLLWRNORM : 0)), 0 };
+            fds.push_back(fd);
+        }
+        if (WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs) <= 0) return;
+
+        if (fds[0].revents) {
+            char drain[64];
+            while (recv(wakeSocket, drain, sizeof(drain), 0) > 0) {}
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (!fds[i].revents) continue;
+            int flags = 0;
+            if (fds[i].revents & POLLRDNORM) flags |= EVENT_READ;
+            if (fds[i].revents & POLLWRNORM) flags |= EVENT_WRITE;
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) flags |= EVENT_ERROR;
+            events.push_back(std::make_pair(fds[i].fd, flags));
+        }
+    }
+#else
+    bool initPoller() {
+        if (pollerReady) return true;
+        epollFd = epoll_create1(0);
+        wakeFd = eventfd(0, EFD_NONBLOCK);
+        if (epollFd < 0 || wakeFd < 0) return false;
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        pollerReady = true;
+        return true;
+    }
+
+    void watch(socket_t s, bool wantWrite) {
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        if (wantWrite) ev.events |= EPOLLOUT;
+        ev.data.fd = s;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, s, &ev) != 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, s, &ev);
+        }
+    }
+
+    void unwatch(socket_t s) { epoll_ctl(epollFd, EPOLL_CTL_DEL, s, nullptr); }
+
+    void wake() {
+        if (wakeFd < 0) return;
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void pollEvents(std::vector<std::pair<socket_t, int>>& events, int timeoutMs) {
+        events.clear();
+        epoll_event ready[128];
+        int count = epoll_wait(epollFd, ready, 128, timeoutMs);
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.fd == wakeFd) {
+                uint64_t value;
+                ssize_t drained = read(wakeFd, &value, sizeof(value));
+                (void)drained;
+                continue;
+            }
+            int flags = 0;
+            if (ready[i].events & EPOLLIN) flags |= EVENT_READ;
+            if (ready[i].events & EPOLLOUT) flags |= EVENT_WRITE;
+            if (ready[i].events & (EPOLLERR | EPOLLHUP)) flags |= EVENT_ERROR;
+            events.push_back(std::make_pair((socket_t)ready[i].data.fd, flags));
+        }
+    }
+#endif
+
+    // ---- Connection handling ---------------------------------------------------
+
+    void acceptConnections(const Listener& listener) {
+        while (true) {
+            socket_t client = accept(listener.socket, nullptr, nullptr);
+            if (client == PF_INVALID_SOCKET) return;
+            setNonBlocking(client);
+            int noDelay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay)); // Harmless failure on Unix sockets
+
+            unsigned long long id = nextConnectionId++;
+            Connection& conn = connections[id];
+            conn.socket = client;
+            conn.id = id;
+            conn.binary = listener.binary;
+            conn.outOffset = 0;
+            conn.busy = false;
+            conn.closeAfterWrite = false;
+            conn.stream = nullptr;
+            conn.lagging = false;
+            socketToConnection[client] = id;
+            watch(client, false);
+        }
+    }
+
+    void closeConnection(Connection& conn) {
+        if (conn.stream) {
+            auto& subscribers = conn.stream->subscribers;
+            subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), conn.id), subscribers.end());
+            conn.stream->subscriberCount = subscribers.size();
+        }
+        unwatch(conn.socket);
+        pfCloseSocket(conn.socket);
+        socketToConnection.erase(conn.socket);
+        connections.erase(conn.id); // conn is dangling after this
+    }
+
+    void handleSocketEvent(socket_t s, int flags) {
+        auto mapping = socketToConnection.find(s);
+        if (mapping == socketToConnection.end()) return;
+        Connection& conn = connections[mapping->second];
+
+        if (flags & EVENT_READ) {
+            char buffer[RECV_CHUNK];
+            while (true) {
+                int received = (int)recv(conn.socket, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    conn.in.append(buffer, received);
+                    continue;
+                }
+                if (received < 0 && wouldBlock()) break;
+                // Peer closed or hard error - drop unless a response is still owed
+                if (conn.busy) {
+                    conn.closeAfterWrite = true;
+                    unwatch(conn.socket); // Stop level-triggered EOF wakeups until the response is ready
+                    return;
+                }
+                closeConnection(conn);
+                return;
+            }
+        } else if (flags & EVENT_ERROR) {
+            if (conn.busy) {
+                conn.closeAfterWrite = true;
+            } else {
+                closeConnection(conn);
+            }
+            return;
+        }
+
+        if ((flags & EVENT_WRITE) && !flushConnection(conn)) return;
+        dispatchNext(conn);
+    }
+
+    // Returns false if the connection was closed
+    bool flushConnection(Connection& conn) {
+        while (conn.outOffset < conn.out.size()) {
+            int sent = (int)send(conn.socket, conn.out.data() + conn.outOffset, (int)(conn.out.size() - conn.outOffset), 0);
+            if (sent > 0) {
+                conn.outOffset += sent;
+                continue;
+            }
+            if (sent < 0 && wouldBlock()) {
+                watch(conn.socket, true);
+                return true;
+            }
+            closeConnection(conn);
+            return false;
+        }
+        conn.out.clear();
+        conn.outOffset = 0;
+        watch(conn.socket, false);
+        if (conn.closeAfterWrite && !conn.busy) {
+            closeConnection(conn);
+            return false;
+        }
+        return true;
+    }
+
+    // Parses one complete request off the front of conn.in and hands it to a worker.
+    // Only one request per connection is in flight, which keeps pipelined responses ordered.
+    void dispatchNext(Connection& conn) {
+        if (conn.stream) {
+            conn.in.clear(); // Subscribers only listen
+            return;
+        }
+        if (conn.busy || conn.closeAfterWrite) return;
+        if (conn.binary) {
+            dispatchNextFrame(conn);
+            return;
+        }
+
+        size_t headerEnd = conn.in.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (conn.in.size() > MAX_HEADER_BYTES) rejectConnection(conn, "431 Request Header Fields Too Large");
+            return;
+        }
+
+        HttpRequest request;
+        size_t lineEnd = conn.in.find("\r\n");
+        std::string requestLine = conn.in.substr(0, lineEnd);
+        size_t firstSpace = requestLine.find(' ');
+        size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+        if (firstSpace == std::string::npos || secondSpace == std::string::npos) {
+            rejectConnection(conn, "400 Bad Request");
+            return;
+        }
+        request.method = requestLine.substr(0, firstSpace);
+        request.path = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+        std::string version = requestLine.substr(secondSpace + 1);
+        request.keepAlive = version != "HTTP/1.0";
+
+        size_t contentLength = 0;
+        size_t pos = lineEnd + 2;
+        while (pos < headerEnd) {
+            size_t next = conn.in.find("\r\n", pos);
+            std::string line = conn.in.substr(pos, next - pos);
+            pos = next + 2;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+            while (!value.empty() && (value[0] == ' ' || value[0] == '\t')) value.erase(0, 1);
+            for (auto& c : name) c = (char)tolower((unsigned char)c);
+            for (auto& c : value) c = (char)tolower((unsigned char)c);
+
+            if (name == "content-length") {
+                contentLength = (size_t)strtoull(value.c_str(), nullptr, 10);
+            } else if (name == "connection") {
+                if (value.find("close") != std::string::npos) request.keepAlive = false;
+                if (value.find("keep-alive") != std::string::npos) request.keepAlive = true;
+            } else if (name == "transfer-encoding" && value != "identity") {
+                rejectConnection(conn, "501 Not Implemented");
+                return;
+            }
+        }
+
+        if (contentLength > MAX_BODY_BYTES) {
+            rejectConnection(conn, "413 Payload Too Large");
+            return;
+        }
+        size_t bodyStart = headerEnd + 4;
+        if (conn.in.size() < bodyStart + contentLength) return; // Wait for the rest of the body
+
+        request.body = conn.in.substr(bodyStart, contentLength);
+        conn.in.erase(0, bodyStart + contentLength);
+
+        Stream* stream = request.method == "GET" ? findStream(request.path) : nullptr;
+        if (stream) {
+            subscribe(conn, *stream);
+            return;
+        }
+        conn.busy = true;
+
+        Job job;
+        job.connectionId = conn.id;
+        job.binary = false;
+        job.request = std::move(request);
+        pushJob(std::move(job));
+    }
+
+    // Binary framing: u32 little-endian payload length, then the payload
+    void dispatchNextFrame(Connection& conn) {
+        if (conn.in.size() < 4) return;
+        uint32_t frameLength;
+        memcpy(&frameLength, conn.in.data(), 4);
+        if (frameLength > MAX_BODY_BYTES) {
+            conn.in.clear();
+            closeConnection(conn);
+            return;
+        }
+        if (conn.in.size() < 4 + (size_t)frameLength) return;
+
+        Job job;
+        job.connectionId = conn.id;
+        job.binary = true;
+        job.request.keepAlive = true;
+        job.frame = conn.in.substr(4, frameLength);
+        conn.in.erase(0, 4 + (size_t)frameLength);
+        conn.busy = true;
+        pushJob(std::move(job));
+    }
+
+    void pushJob(Job&& job) {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobs.push_back(std::move(job));
+        }
+        jobReady.notify_one();
+    }
+
+    void rejectConnection(Connection& conn, const std::string& status) {
+        conn.out += "HTTP/1.1 " + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        conn.closeAfterWrite = true;
+        conn.in.clear();
+        flushConnection(conn);
+    }
+
+    void drainCompletions() {
+        std::vector<Completion> ready;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            ready.swap(completions);
+        }
+        for (auto& completion : ready) {
+            auto it = connections.find(completion.connectionId);
+            if (it == connections.end()) continue; // Client went away while the worker ran
+            Connection& conn = it->second;
+            if (completion.releases) conn.busy = false;
+            conn.out += completion.response;
+            if (!completion.keepAlive) conn.closeAfterWrite = true;
+            if (!flushConnection(conn)) continue;
+            dispatchNext(conn);
+        }
+    }
+
+    // I/O thread: answers with the chunked headers; frames follow from drainBroadcasts
+    void subscribe(Connection& conn, Stream& stream) {
+        conn.out += "HTTP/1.1 200 OK\r\nContent-Type: " + stream.contentType +
+                    "\r\nTransfer-Encoding: chunked\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\n\r\n";
+        conn.stream = &stream;
+        conn.lagging = true; // Nothing to apply deltas to until the first resync frame
+        conn.in.clear();
+        stream.subscribers.push_back(conn.id);
+        stream.subscriberCount = stream.subscribers.size();
+        if (stream.onResync) stream.onResync();
+        flushConnection(conn);
+    }
+
+    void drainBroadcasts() {
+        std::vector<Broadcast> ready;
+        {
+            std::lock_guard<std::mutex> lock(broadcastMutex);
+            ready.swap(broadcasts);
+        }
+        std::vector<unsigned long long> targets;
+        for (const auto& frame : ready) {
+            Stream& stream = *frame.stream;
+            bool wantResync = false;
+            targets = stream.subscribers; // flushConnection may close, and so unsubscribe, a connection
+            for (unsigned long long id : targets) {
+                auto it = connections.find(id);
+                if (it == connections.end()) continue;
+                Connection& conn = it->second;
+                bool backlogged = conn.out.size() - conn.outOffset > MAX_STREAM_BACKLOG;
+                if (backlogged || (conn.lagging && !frame.resync)) {
+                    // A lagging subscriber that has drained its backlog asks for a frame to resume from
+                    if (!backlogged) wantResync = true;
+                    conn.lagging = true;
+                    stream.skipped++;
+                    continue;
+                }
+                conn.lagging = false;
+                conn.out += *frame.chunk;
+                flushConnection(conn);
+            }
+            if (wantResync && stream.onResync) stream.onResync();
+        }
+    }
+
+    static WorkerJob*& currentJob() {
+        static thread_local WorkerJob* job = nullptr;
+        return job;
+    }
+
+    // Any thread
+    void complete(unsigned long long connectionId, const std::string& response, bool keepAlive, bool releases) {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            completions.push_back(Completion{connectionId, response, keepAlive, releases});
+        }
+        wake();
+    }
+
+    void workerLoop() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobReady.wait(lock, [this]() { return !jobs.empty() || !running; });
+                if (!running) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            WorkerJob context;
+            context.sink = responseSink;
+            context.connectionId = job.connectionId;
+            context.binary = job.binary;
+            context.keepAlive = job.request.keepAlive;
+            currentJob() = &context;
+            std::string response;
+            bool keepAlive = job.request.keepAlive;
+            bool failed = false;
+            try {
+                response = job.binary ? binaryHandler(job.frame) : handler(job.request);
+            } catch (const std::exception& e) {
+                std::cerr << "[HttpServer] Handler failed for " << (job.binary ? "binary frame" : job.request.path) << ": " << e.what() << std::endl;
+                failed = true;
+                if (job.binary) {
+                    keepAlive = false;
+                } else {
+                    response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+                }
+            }
+            currentJob() = nullptr;
+
+            if (!context.answered) {
+                complete(job.connectionId, response, keepAlive, true);
+            } else if (failed) {
+                // Deferred, then threw: answer now unless the responder already has
+                if (!context.answered->exchange(true)) complete(job.connectionId, response, keepAlive, true);
+                else if (job.binary) complete(job.connectionId, std::string(), true, true);
+            } else if (job.binary) {
+                complete(job.connectionId, std::string(), true, true); // Frees the connection for the next frame
+            }
+        }
+    }
+};
@@ -0,0 +1,308 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Binary IPC transport
+// Length-prefixed binary frames for tick-critical calls, plus a shared-memory ring
+// of per-tick agent state. All integers and floats are little-endian.
+//
+// Request frame:  u32 length | u32 requestId | u16 opcode | u16 zone   | payload
+// Response frame: u32 length | u32 requestId | u16 opcode | u16 status | payload
+// (length counts every byte after the length field itself; zone is the index from
+// GET /zones, 0 for a single-zone service)
+// Strings are u16 byte count + UTF-8 bytes.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+enum IpcOpcode : uint16_t {
+    IPC_OP_HEALTH = 0,                  // -> u32 protocol version
+    IPC_OP_GET_CLOSEST_NAV_POINT = 1,   // f32 x,y,z -> u8 found, f32 x,y,z
+    IPC_OP_HAS_LINE_OF_SIGHT = 2,       // f32 start[3], end[3] -> u8 hasLineOfSight
+    IPC_OP_BATCH = 3,                   // u16 count, count * command -> u64 tick, u16 count, count * u8 success, count * u32 handle
+    IPC_OP_GET_AGENT_STATES = 4,        // f32 threshold, u16 idCount, ids, u16 handleCount, handleCount * u32 handle
+                                        //   -> u64 tick, u16 count, count * agent record
+    IPC_OP_TEST_NAVMESH = 5,            // f32 start[3], end[3] -> u16 count, count * f32 x,y,z
+    IPC_OP_FIND_PATH = 6,               // f32 start[3], end[3] -> u8 found, u8 partial, u8 cached, u16 count, count * f32 x,y,z
+    IPC_OP_LINE_OF_SIGHT_BATCH = 7,     // u16 count, count * f32 start[3], end[3] -> u16 count, ceil(count / 8) bytes, bit i = pair i visible
+    IPC_OP_REQUEST_PATH = 8,            // f32 start[3], end[3] -> u64 ticket
+    IPC_OP_PATH_RESULT = 9,             // u64 ticket, u32 waitMs -> u8 state (0 unknown, 1 pending, 2 done, 3 failed), u8 partial,
+                                        //   u32 polyCount, u32 count, count * f32 x,y,z. A non-zero waitMs parks the poll
+                                        //   off the connection, so frames sent after it may be answered first
+    IPC_OP_SET_PLAYERS = 10,            // u16 count, count * (string playerId, f32 x,y,z) -> u32 count
+    IPC_OP_NEAREST_TARGETS = 11         // u8 lineOfSight, u16 count, count * f32 x,y,z,radius
+                                        //   -> u16 count, count * (string playerId (empty = none), f32 distance)
+};
+
+// Batch command: u8 op (0 add, 1 remove, 2 setTarget, 3 stop, 4 forceStop, 5 chase), string npcId, f32 x,y,z, f32 brakeForce,
+// u32 handle (0 = address the agent by npcId; ignored for add) and, for chase only, a trailing string targetId.
+// The handle of result i is the agent command i addressed (the new one for add), 0 where it failed.
+// Agent record: string npcId, f32 pos[3], f32 vel[3], u8 targetState, u8 atTarget, u32 handle
+
+enum IpcStatus : uint16_t {
+    IPC_STATUS_OK = 0,
+    IPC_STATUS_BAD_REQUEST = 1,
+    IPC_STATUS_UNKNOWN_OPCODE = 2,
+    IPC_STATUS_UNKNOWN_ZONE = 3
+};
+
+static const uint32_t IPC_PROTOCOL_VERSION = 3;
+static const size_t IPC_HEADER_BYTES = 8; // requestId + opcode + zone/status
+
+class IpcReader {
+private:
+    const char* data;
+    size_t size;
+    size_t offset;
+    bool valid;
+
+public:
+    IpcReader(const std::string& frame, size_t start = 0) : data(frame.data()), size(frame.size()), offset(start), valid(start <= frame.size()) {}
+
+    bool ok() const { return valid; }
+
+    template <typename T>
+    T read() {
+        T value = T();
+        if (!valid || offset + sizeof(T) > size) {
+            valid = false;
+            return value;
+        }
+        memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    void readFloats(float* out, int count) {
+        for (int i = 0; i < count; i++) out[i] = read<float>();
+    }
+
+    std::string readString() {
+        uint16_t length = read<uint16_t>();
+        if (!valid || offset + length > size) {
+            valid = false;
+            return "";
+        }
+        std::string value(data + offset, length);
+        offset += length;
+        return value;
+    }
+};
+
+class IpcWriter {
+private:
+    std::string buffer;
+
+public:
+    // Starts a response frame; the length is patched in by finish()
+    IpcWriter(uint32_t requestId, uint16_t opcode, uint16_t status) {
+        buffer.reserve(64);
+        write<uint32_t>(0);
+        write<uint32_t>(requestId);
+        write<uint16_t>(opcode);
+        write<uint16_t>(status);
+    }
+
+    template <typename T>
+    void write(T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeFloats(const float* values, int count) {
+        buffer.append(reinterpret_cast<const char*>(values), sizeof(float) * count);
+    }
+
+    void writeString(const std::string& value) {
+        uint16_t length = (uint16_t)std::min<size_t>(value.size(), 0xffff);
+        write<uint16_t>(length);
+        buffer.append(value.data(), length);
+    }
+
+    void reserve(size_t bytes) { buffer.reserve(buffer.size() + bytes); }
+
+    std::string finish() {
+        uint32_t length = (uint32_t)(buffer.size() - 4);
+        memcpy(&buffer[0], &length, 4);
+        return std::move(buffer);
+    }
+};
+
+// -------------------------------------------------------------------------------------
+// Shared-memory agent state ring
+//
+// The crowd update thread publishes one slot per tick; readers map the same region and
+// read the newest slot in place. Slot consistency uses a sequence pair: the writer stores
+// the trailing seqBegin, writes the records, then stores the leading seqEnd. A reader that
+// sees seqEnd == N first and seqBegin == N last has a complete, untorn tick N - which
+// also holds for a plain front-to-back copy of the slot.
+//
+// Layout: RingHeader | slotCount * (SlotHeader | maxAgents * AgentRecord | u64 seqBegin)
+// -------------------------------------------------------------------------------------
+
+class SharedAgentRing {
+public:
+    static const uint32_t MAGIC = 0x52474144; // 'DAGR'
+    static const uint32_t VERSION = 1;
+    static const int ID_BYTES = 32;
+
+    struct RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotBytes;
+        uint32_t maxAgents;
+        uint32_t recordBytes;
+        std::atomic<uint64_t> latestSeq;    // Last fully published sequence number (0 = none yet)
+        uint8_t reserved[32];
+    };
+
+    struct SlotHeader {
+        std::atomic<uint64_t> seqEnd;
+        uint64_t tick;
+        uint32_t agentCount;
+        uint32_t reserved;
+    };
+
+    struct AgentRecord {
+        char npcId[ID_BYTES];   // NUL padded, truncated to 31 bytes
+        float pos[3];
+        float vel[3];
+        uint8_t targetState;
+        uint8_t atTarget;
+        uint8_t reserved[6];
+    };
+
+private:
+    std::string name;
+    unsigned char* base;
+    size_t mappedBytes;
+    RingHeader* header;
+    uint32_t slotCount;
+    uint32_t maxAgents;
+    uint64_t writeSeq;
+    SlotHeader* currentSlot;
+    std::atomic<uint64_t>* currentSeqBegin;
+    AgentRecord* currentRecords;
+    uint32_t currentCount;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+
+public:
+    SharedAgentRing() : base(nullptr), mappedBytes(0), header(nullptr), slotCount(0), maxAgents(0), writeSeq(0),
+                        currentSlot(nullptr), currentSeqBegin(nullptr), currentRecords(nullptr), currentCount(0) {
+#ifdef _WIN32
+        mapping = nullptr;
+#endif
+    }
+
+    ~SharedAgentRing() {
+        close();
+    }
+
+    // name: POSIX shm name without the leading slash (appears as /dev/shm/<name>) or Windows "Local\\<name>"
+    bool create(const std::string& ringName, uint32_t slots, uint32_t agents) {
+        name = ringName;
+        slotCount = slots;
+        maxAgents = agents;
+        size_t slotBytes = sizeof(SlotHeader) + sizeof(AgentRecord) * (size_t)maxAgents + sizeof(uint64_t);
+        mappedBytes = sizeof(RingHeader) + slotBytes * slotCount;
+
+#ifdef _WIN32
+        std::string mappingName = "Local\\" + name;
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)mappedBytes, mappingName.c_str());
+        if (!mapping) return false;
+        base = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappedBytes);
+#else
+        std::string shmName = "/" + name;
+        int fd = shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, (off_t)mappedBytes) != 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        base = mapped == MAP_FAILED ? nullptr : (unsigned char*)mapped;
+#endif
+        if (!base) return false;
+
+        memset(base, 0, mappedBytes);
+        header = reinterpret_cast<RingHeader*>(base);
+        header->magic = MAGIC;
+        header->version = VERSION;
+        header->slotCount = slotCount;
+        header->slotBytes = (uint32_t)slotBytes;
+        header->maxAgents = maxAgents;
+        header->recordBytes = sizeof(AgentRecord);
+        header->latestSeq.store(0, std::memory_order_release);
+        return true;
+    }
+
+    void close() {
+        if (!base) return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(base, mappedBytes);
+        shm_unlink(("/" + name).c_str());
+#endif
+        base = nullptr;
+        header = nullptr;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    // Single writer: beginFrame, append per agent, commitFrame
+    void beginFrame(uint64_t tick) {
+        if (!base) return;
+        writeSeq++;
+        size_t slotBytes = header->slotBytes;
+        unsigned char* slot = base + sizeof(RingHeader) + slotBytes * (writeSeq % slotCount);
+        currentSlot = reinterpret_cast<SlotHeader*>(slot);
+        currentRecords = reinterpret_cast<AgentRecord*>(slot + sizeof(SlotHeader));
+        currentSeqBegin = reinterpret_cast<std::atomic<uint64_t>*>(slot + slotBytes - sizeof(uint64_t));
+        currentCount = 0;
+        currentSeqBegin->store(writeSeq, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        currentSlot->tick = tick;
+    }
+
+    bool append(const std::string& npcId, const float* pos, const float* vel, int targetState, bool atTarget) {
+        if (!currentSlot || currentCount >= maxAgents) return false;
+        AgentRecord& record = currentRecords[currentCount++];
+        memset(record.npcId, 0, ID_BYTES);
+        memcpy(record.npcId, npcId.data(), std::min<size_t>(npcId.size(), ID_BYTES - 1));
+        memcpy(record.pos, pos, sizeof(record.pos));
+        memcpy(record.vel, vel, sizeof(record.vel));
+        record.targetState = (uint8_t)targetState;
+        record.atTarget = atTarget ? 1 : 0;
+        return true;
+    }
+
+    void commitFrame() {
+        if (!currentSlot) return;
+        currentSlot->agentCount = currentCount;
+        currentSlot->seqEnd.store(writeSeq, std::memory_order_release);
+        header->latestSeq.store(writeSeq, std::memory_order_release);
+        currentSlot = nullptr;
+    }
+};
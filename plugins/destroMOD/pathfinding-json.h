@@ -0,0 +1,438 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Request parsing and response building
+// Single-pass, non-allocating JSON scanner that fills a typed request struct, and a
+// writer that appends into a reusable buffer with shortest round-trip float output.
+// Strings are returned as views into the request body without unescaping (npc ids and
+// op names never contain escapes).
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+class JsonCursor {
+private:
+    const char* p;
+    const char* end;
+
+public:
+    explicit JsonCursor(std::string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    bool atEnd() {
+        skipWhitespace();
+        return p >= end;
+    }
+
+    char peek() {
+        skipWhitespace();
+        return p < end ? *p : '\0';
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool readString(std::string_view& out) {
+        if (!consume('"')) return false;
+        const char* start = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        if (p >= end) return false;
+        out = std::string_view(start, (size_t)(p - start));
+        p++;
+        return true;
+    }
+
+    bool readFloat(float& out) {
+        skipWhitespace();
+        auto result = std::from_chars(p, end, out);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+
+    bool readUnsigned(unsigned long long& out) {
+        skipWhitespace();
+        auto result = std::from_chars(p, end, out);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+
+    // Anything but true reads as false
+    bool readBool(bool& out) {
+        out = peek() == 't';
+        return out ? readLiteral("true") : skipValue();
+    }
+
+    bool readLiteral(const char* literal) {
+        skipWhitespace();
+        size_t length = strlen(literal);
+        if ((size_t)(end - p) < length || memcmp(p, literal, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    // Skips any value, including nested objects and arrays
+    bool skipValue() {
+        char c = peek();
+        if (c == '"') {
+            std::string_view ignored;
+            return readString(ignored);
+        }
+        if (c == '{' || c == '[') {
+            int depth = 0;
+            while (p < end) {
+                char current = *p;
+                if (current == '"') {
+                    std::string_view ignored;
+                    if (!readString(ignored)) return false;
+                    continue;
+                }
+                if (current == '{' || current == '[') depth++;
+                else if (current == '}' || current == ']') {
+                    if (--depth == 0) {
+                        p++;
+                        return true;
+                    }
+                }
+                p++;
+            }
+            return false;
+        }
+        if (c == 't') return readLiteral("true");
+        if (c == 'f') return readLiteral("false");
+        if (c == 'n') return readLiteral("null");
+        float ignored;
+        return readFloat(ignored);
+    }
+
+    // Calls onField(key, cursor) for every member; onField must consume the value
+    template <typename OnField>
+    bool parseObject(OnField onField) {
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!readString(key) || !consume(':')) return false;
+            if (!onField(key, *this)) return false;
+        } while (consume(','));
+        return consume('}');
+    }
+
+    // Calls onElement(cursor) for every element; onElement must consume the value
+    template <typename OnElement>
+    bool parseArray(OnElement onElement) {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            if (!onElement(*this)) return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+    // Reads up to maxCount numbers of a flat array; extra elements are skipped
+    bool readFloatArray(float* out, int maxCount, int& count) {
+        count = 0;
+        return parseArray([&](JsonCursor& c) {
+            float value;
+            if (!c.readFloat(value)) return c.skipValue();
+            if (count < maxCount) out[count++] = value;
+            return true;
+        });
+    }
+
+    bool readStringArray(std::vector<std::string_view>& out) {
+        return parseArray([&](JsonCursor& c) {
+            std::string_view value;
+            if (!c.readString(value)) return c.skipValue();
+            out.push_back(value);
+            return true;
+        });
+    }
+};
+
+// One entry of a /batch "commands" array
+struct CommandFields {
+    std::string_view op;
+    std::string_view npcId;
+    std::string_view targetId;
+    unsigned long long handle;      // Agent handle from an earlier add; used instead of npcId when set
+    float x, y, z;
+    float target[3];
+    int targetCount;
+    float brakeForce;
+};
+
+// One entry of /obstacles: a box takes halfExtents, a cylinder radius and height
+struct ObstacleFields {
+    std::string_view id;
+    std::string_view shape;
+    float center[3];
+    int centerCount;
+    float halfExtents[3];
+    int halfExtentsCount;
+    float radius, height;
+    float yaw;
+};
+
+// Every field any endpoint reads. Vectors keep their capacity across clear(), so a
+// thread_local instance parses steady-state traffic without allocating.
+struct RequestFields {
+    std::string_view op;
+    std::string_view npcId;
+    unsigned long long handle;
+    float x, y, z;
+    float brakeForce;
+    float threshold;
+    float radius;
+    bool lineOfSight;
+    unsigned long long ticket;
+    float waitMs;
+    float start[3];
+    float end[3];
+    float target[3];
+    int startCount, endCount, targetCount;
+    std::vector<std::string_view> npcIds;
+    std::vector<std::string_view> playerIds;
+    std::vector<uint32_t> handles;
+    std::vector<CommandFields> commands;
+    std::vector<ObstacleFields> obstacles;
+    std::vector<float> points;              // [[x,y,z], ...] flattened
+    std::vector<float> pairs;               // [[sx,sy,sz,ex,ey,ez], ...] flattened
+    std::vector<float> radii;
+
+    void clear() {
+        op = std::string_view();
+        npcId = std::string_view();
+        handle = 0;
+        x = y = z = 0.0f;
+        brakeForce = 0.0f;
+        threshold = 0.0f;
+        radius = 0.0f;
+        lineOfSight = false;
+        ticket = 0;
+        waitMs = 0.0f;
+        startCount = endCount = targetCount = 0;
+        npcIds.clear();
+        playerIds.clear();
+        handles.clear();
+        commands.clear();
+        obstacles.clear();
+        points.clear();
+        pairs.clear();
+        radii.clear();
+    }
+};
+
+inline bool parseCommandFields(JsonCursor& cursor, CommandFields& command) {
+    command.op = std::string_view();
+    command.npcId = std::string_view();
+    command.targetId = std::string_view();
+    command.handle = 0;
+    command.x = command.y = command.z = 0.0f;
+    command.targetCount = 0;
+    command.brakeForce = 0.0f;
+    return cursor.parseObject([&](std::string_view key, JsonCursor& c) {
+        if (key == "op") return c.readString(command.op);
+        if (key == "npcId") return c.readString(command.npcId);
+        if (key == "targetId") return c.readString(command.targetId);
+        if (key == "handle") return c.readUnsigned(command.handle);
+        if (key == "x") return c.readFloat(command.x);
+        if (key == "y") return c.readFloat(command.y);
+        if (key == "z") return c.readFloat(command.z);
+        if (key == "target") return c.readFloatArray(command.target, 3, command.targetCount);
+        if (key == "brakeForce") return c.readFloat(command.brakeForce);
+        return c.skipValue();
+    });
+}
+
+inline bool parseObstacleFields(JsonCursor& cursor, ObstacleFields& obstacle) {
+    obstacle.id = std::string_view();
+    obstacle.shape = std::string_view();
+    obstacle.centerCount = obstacle.halfExtentsCount = 0;
+    obstacle.radius = obstacle.height = obstacle.yaw = 0.0f;
+    return cursor.parseObject([&](std::string_view key, JsonCursor& c) {
+        if (key == "id") return c.readString(obstacle.id);
+        if (key == "shape") return c.readString(obstacle.shape);
+        if (key == "center") return c.readFloatArray(obstacle.center, 3, obstacle.centerCount);
+        if (key == "halfExtents") return c.readFloatArray(obstacle.halfExtents, 3, obstacle.halfExtentsCount);
+        if (key == "radius") return c.readFloat(obstacle.radius);
+        if (key == "height") return c.readFloat(obstacle.height);
+        if (key == "yaw") return c.readFloat(obstacle.yaw);
+        return c.skipValue();
+    });
+}
+
+// Returns false on malformed JSON; fields parsed before the error are kept
+inline bool parseRequestFields(std::string_view body, RequestFields& fields) {
+    fields.clear();
+    JsonCursor cursor(body);
+    if (cursor.atEnd()) return true;
+    return cursor.parseObject([&](std::string_view key, JsonCursor& c) {
+        if (key == "op") return c.readString(fields.op);
+        if (key == "npcId") return c.readString(fields.npcId);
+        if (key == "handle") return c.readUnsigned(fields.handle);
+        if (key == "x") return c.readFloat(fields.x);
+        if (key == "y") return c.readFloat(fields.y);
+        if (key == "z") return c.readFloat(fields.z);
+        if (key == "brakeForce") return c.readFloat(fields.brakeForce);
+        if (key == "threshold") return c.readFloat(fields.threshold);
+        if (key == "radius") return c.readFloat(fields.radius);
+        if (key == "lineOfSight") return c.readBool(fields.lineOfSight);
+        if (key == "ticket") return c.readUnsigned(fields.ticket);
+        if (key == "waitMs") return c.readFloat(fields.waitMs);
+        if (key == "start") return c.readFloatArray(fields.start, 3, fields.startCount);
+        if (key == "end") return c.readFloatArray(fields.end, 3, fields.endCount);
+        if (key == "target") return c.readFloatArray(fields.target, 3, fields.targetCount);
+        if (key == "npcIds") return c.readStringArray(fields.npcIds);
+        if (key == "playerIds") return c.readStringArray(fields.playerIds);
+        if (key == "radii") {
+            return c.parseArray([&](JsonCursor& element) {
+                float value = 0.0f;
+                if (!element.readFloat(value)) return false;
+                fields.radii.push_back(value);
+                return true;
+            });
+        }
+        if (key == "handles") {
+            return c.parseArray([&](JsonCursor& element) {
+                unsigned long long handle = 0;
+                if (!element.readUnsigned(handle)) return false;
+                fields.handles.push_back((uint32_t)handle);
+                return true;
+            });
+        }
+        if (key == "points") {
+            return c.parseArray([&](JsonCursor& element) {
+                float point[3];
+                int count = 0;
+                if (!element.readFloatArray(point, 3, count)) return false;
+                if (count == 3) fields.points.insert(fields.points.end(), point, point + 3);
+                return true;
+            });
+        }
+        if (key == "pairs") {
+            return c.parseArray([&](JsonCursor& element) {
+                float pair[6];
+                int count = 0;
+                if (!element.readFloatArray(pair, 6, count)) return false;
+                if (count == 6) fields.pairs.insert(fields.pairs.end(), pair, pair + 6);
+                return true;
+            });
+        }
+        if (key == "obstacles") {
+            return c.parseArray([&](JsonCursor& element) {
+                ObstacleFields obstacle;
+                if (!parseObstacleFields(element, obstacle)) return false;
+                fields.obstacles.push_back(obstacle);
+                return true;
+            });
+        }
+        if (key == "commands") {
+            return c.parseArray([&](JsonCursor& element) {
+                CommandFields command;
+                if (!parseCommandFields(element, command)) return false;
+                fields.commands.push_back(command);
+                return true;
+            });
+        }
+        return c.skipValue();
+    });
+}
+
+class JsonWriter {
+private:
+    std::string& out;
+
+public:
+    // Clears the buffer but keeps its capacity
+    explicit JsonWriter(std::string& buffer) : out(buffer) {
+        out.clear();
+    }
+
+    JsonWriter& raw(std::string_view text) {
+        out.append(text.data(), text.size());
+        return *this;
+    }
+
+    JsonWriter& raw(char c) {
+        out.push_back(c);
+        return *this;
+    }
+
+    // Shortest representation that round-trips to the same float
+    JsonWriter& number(float value) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+        return *this;
+    }
+
+    // Fixed-point with the given number of decimals, for compact bulk payloads
+    JsonWriter& fixed(float value, int decimals) {
+        char buffer[48];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, decimals);
+        if (result.ec != std::errc()) return number(value);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+        return *this;
+    }
+
+    JsonWriter& number(unsigned long long value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+        return *this;
+    }
+
+    JsonWriter& number(int value) {
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+        return *this;
+    }
+
+    JsonWriter& boolean(bool value) {
+        return raw(value ? std::string_view("true") : std::string_view("false"));
+    }
+
+    JsonWriter& string(std::string_view value) {
+        out.push_back('"');
+        for (char c : value) {
+            if (c == '"' || c == '\\') out.push_back('\\');
+            if ((unsigned char)c < 0x20) continue;
+            out.push_back(c);
+        }
+        out.push_back('"');
+        return *this;
+    }
+
+    // [a,b,c]
+    JsonWriter& floats(const float* values, int count) {
+        out.push_back('[');
+        for (int i = 0; i < count; i++) {
+            if (i > 0) out.push_back(',');
+            number(values[i]);
+        }
+        out.push_back(']');
+        return *this;
+    }
+
+    const std::string& str() const { return out; }
+};
@@ -0,0 +1,117 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Line-of-sight memo
+// AI code asks the same NPC/player pairs for line of sight every few hundred ms while
+// both sides barely move. LosMemo remembers each raycast result for a few crowd ticks
+// and hands it back as long as both ends are still within a small distance of where
+// they were when it was computed. Tile changes drop everything.
+// ===================================================================================
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+
+struct LosStats {
+    unsigned long long batches = 0;
+    unsigned long long pairs = 0;
+    unsigned long long memoHits = 0;
+    unsigned long long startLookups = 0;    // findNearestPoly calls after origin dedup
+    unsigned long long raycasts = 0;
+    unsigned long long parallelBatches = 0; // Batches fanned out over the worker pool
+    size_t memoEntries = 0;
+};
+
+// Thread-safe
+class LosMemo {
+private:
+    struct Entry {
+        float ends[6];
+        unsigned long long tick;
+        bool visible;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    unsigned long long generation;
+    float threshold;
+    unsigned long long maxAge;      // In crowd ticks
+    size_t maxEntries;
+    mutable std::mutex mutex;
+
+    int cell(float v) const {
+        return (int)std::floor(v / threshold);
+    }
+
+    uint64_t keyOf(const float* ends) const {
+        uint64_t h = 1469598103934665603ULL;
+        for (int i = 0; i < 6; i++) {
+            h ^= (uint32_t)cell(ends[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bool near(const Entry& entry, const float* ends) const {
+        for (int side = 0; side < 6; side += 3) {
+            float dx = entry.ends[side] - ends[side];
+            float dy = entry.ends[side + 1] - ends[side + 1];
+            float dz = entry.ends[side + 2] - ends[side + 2];
+            if (dx * dx + dy * dy + dz * dz > threshold * threshold) return false;
+        }
+        return true;
+    }
+
+    // Caller holds mutex
+    void syncGeneration(unsigned long long tileGeneration) {
+        if (tileGeneration == generation) return;
+        generation = tileGeneration;
+        entries.clear();
+    }
+
+public:
+    LosMemo(float moveThreshold, unsigned long long maxAgeTicks, size_t capacity)
+        : generation(0), threshold(moveThreshold), maxAge(maxAgeTicks), maxEntries(capacity) {}
+
+    // resolved[i]: 0 unknown, 1 visible, 2 blocked. Only pairs still at 0 are looked up.
+    size_t lookup(const float* pairs, size_t count, unsigned long long tick, unsigned long long tileGeneration, std::vector<uint8_t>& resolved) {
+        size_t hits = 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        syncGeneration(tileGeneration);
+        for (size_t i = 0; i < count; i++) {
+            if (resolved[i]) continue;
+            auto it = entries.find(keyOf(pairs + i * 6));
+            if (it == entries.end() || tick - it->second.tick > maxAge || !near(it->second, pairs + i * 6)) continue;
+            resolved[i] = it->second.visible ? 1 : 2;
+            hits++;
+        }
+        return hits;
+    }
+
+    // Stores the pairs flagged in computed, with results in resolved
+    void store(const float* pairs, size_t count, const std::vector<uint8_t>& computed, const std::vector<uint8_t>& resolved,
+               unsigned long long tick, unsigned long long tileGeneration) {
+        std::lock_guard<std::mutex> lock(mutex);
+        syncGeneration(tileGeneration);
+        if (entries.size() + count > maxEntries) {
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (tick - it->second.tick > maxAge) it = entries.erase(it);
+                else ++it;
+            }
+            if (entries.size() + count > maxEntries) entries.clear();
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!computed[i]) continue;
+            Entry& entry = entries[keyOf(pairs + i * 6)];
+            for (int k = 0; k < 6; k++) entry.ends[k] = pairs[i * 6 + k];
+            entry.tick = tick;
+            entry.visible = resolved[i] == 1;
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+};
@@ -0,0 +1,317 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Metrics
+// Request counts, latency histograms and crowd tick timing, exported by GET /metrics
+// in the Prometheus text format. Each recording thread gets its own block of counters
+// the first time it records and only ever adds to that block with relaxed atomics, so
+// the hot path never shares a cache line or takes a lock; a scrape sums every block.
+// ===================================================================================
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+// Appends Prometheus text exposition lines to a caller-owned buffer
+class MetricsWriter {
+private:
+    std::string& out;
+
+    void value(unsigned long long v) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+    }
+
+    void value(double v) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        out.append(buffer, (size_t)(result.ptr - buffer));
+    }
+
+    void name(const char* metric, const char* suffix, const std::string& labels) {
+        out += metric;
+        out += suffix;
+        if (!labels.empty()) {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+    }
+
+public:
+    explicit MetricsWriter(std::string& buffer) : out(buffer) { out.clear(); }
+
+    MetricsWriter& family(const char* metric, const char* type, const char* help) {
+        out += "# HELP ";
+        out += metric;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += metric;
+        out += ' ';
+        out += type;
+        out += '\n';
+        return *this;
+    }
+
+    MetricsWriter& sample(const char* metric, const char* suffix, const std::string& labels, unsigned long long v) {
+        name(metric, suffix, labels);
+        value(v);
+        out += '\n';
+        return *this;
+    }
+
+    MetricsWriter& sample(const char* metric, const char* suffix, const std::string& labels, double v) {
+        name(metric, suffix, labels);
+        value(v);
+        out += '\n';
+        return *this;
+    }
+
+    // Single unlabelled gauge or counter with its HELP/TYPE header
+    MetricsWriter& single(const char* metric, const char* type, const char* help, unsigned long long v) {
+        return family(metric, type, help).sample(metric, "", std::string(), v);
+    }
+
+    MetricsWriter& single(const char* metric, const char* type, const char* help, double v) {
+        return family(metric, type, help).sample(metric, "", std::string(), v);
+    }
+
+    const std::string& str() const { return out; }
+};
+
+// Most recent durations of one periodic job, for percentiles. One writer thread; readers
+// may see a sample being overwritten, which only skews a scrape by one sample.
+class TimingWindow {
+public:
+    static const int SAMPLES = 1024;
+
+private:
+    std::atomic<uint64_t> samples[SAMPLES];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNanos;
+
+public:
+    TimingWindow() : count(0), totalNanos(0) {
+        for (auto& sample : samples) sample.store(0, std::memory_order_relaxed);
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        uint64_t index = count.load(std::memory_order_relaxed);
+        samples[index % SAMPLES].store(nanos, std::memory_order_relaxed);
+        totalNanos.store(totalNanos.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+        count.store(index + 1, std::memory_order_release);
+    }
+
+    // Summary over the window: quantile samples plus lifetime _sum and _count
+    void write(MetricsWriter& out, const char* metric, const char* help) const {
+        uint64_t total = count.load(std::memory_order_acquire);
+        std::vector<uint64_t> window((size_t)std::min<uint64_t>(total, SAMPLES));
+        for (size_t i = 0; i < window.size(); i++) window[i] = samples[i].load(std::memory_order_relaxed);
+        std::sort(window.begin(), window.end());
+
+        static const char* const labels[] = {"quantile=\"0.5\"", "quantile=\"0.9\"", "quantile=\"0.99\"", "quantile=\"1\""};
+        static const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+        out.family(metric, "summary", help);
+        for (int q = 0; q < 4; q++) {
+            double seconds = 0.0;
+            if (!window.empty()) {
+                size_t rank = std::min(window.size() - 1, (size_t)(quantiles[q] * (double)(window.size() - 1) + 0.5));
+                seconds = (double)window[rank] / 1e9;
+            }
+            out.sample(metric, "", labels[q], seconds);
+        }
+        out.sample(metric, "_sum", std::string(), (double)totalNanos.load(std::memory_order_relaxed) / 1e9);
+        out.sample(metric, "_count", std::string(), (unsigned long long)total);
+    }
+};
+
+// Endpoints are declared before serving starts and never change afterwards, so recording
+// only indexes fixed arrays
+class ServiceMetrics {
+public:
+    enum Counter {
+        FIND_PATH_OUT_OF_NODES = 0,     // findPath searches that exhausted the query's node pool
+        COUNTER_COUNT
+    };
+
+    static const int MAX_ENDPOINTS = 64;
+    static const int BUCKETS = 13;      // Finite latency bounds; one more bucket holds +Inf
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct ThreadBlock {
+        std::atomic<uint64_t> requests[MAX_ENDPOINTS];
+        std::atomic<uint64_t> nanos[MAX_ENDPOINTS];
+        std::atomic<uint64_t> buckets[MAX_ENDPOINTS][BUCKETS + 1];  // Not cumulative; summed on scrape
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+        ThreadBlock() {
+            for (int i = 0; i < MAX_ENDPOINTS; i++) {
+                requests[i].store(0, std::memory_order_relaxed);
+                nanos[i].store(0, std::memory_order_relaxed);
+                for (auto& bucket : buckets[i]) bucket.store(0, std::memory_order_relaxed);
+            }
+            for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    static const uint64_t* bucketBounds() {
+        // 50us .. 1s, in nanoseconds
+        static const uint64_t bounds[BUCKETS] = {
+            50000ULL, 100000ULL, 250000ULL, 500000ULL, 1000000ULL, 2500000ULL, 5000000ULL,
+            10000000ULL, 25000000ULL, 50000000ULL, 100000000ULL, 250000000ULL, 1000000000ULL
+        };
+        return bounds;
+    }
+
+    static uint64_t nextInstanceId() {
+        static std::atomic<uint64_t> ids(1);
+        return ids.fetch_add(1);
+    }
+
+    const uint64_t instanceId;
+    std::vector<std::string> endpointLabels;
+
+    // Blocks outlive the threads that wrote them so their counts stay in the totals
+    mutable std::mutex blocksMutex;
+    std::vector<std::unique_ptr<ThreadBlock>> blocks;
+
+    TimingWindow crowdUpdate;
+    TimingWindow tick;
+
+    ThreadBlock& local() {
+        thread_local uint64_t owner = 0;
+        thread_local ThreadBlock* block = nullptr;
+        if (owner != instanceId) {
+            std::lock_guard<std::mutex> lock(blocksMutex);
+            blocks.push_back(std::unique_ptr<ThreadBlock>(new ThreadBlock()));
+            block = blocks.back().get();
+            owner = instanceId;
+        }
+        return *block;
+    }
+
+    static void add(std::atomic<uint64_t>& value, uint64_t amount) {
+        // Single writer per block: a plain load/store pair is enough and avoids a locked add
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+public:
+    ServiceMetrics() : instanceId(nextInstanceId()) {}
+
+    // Before serving: returns the id to record against, or -1 once MAX_ENDPOINTS are taken
+    int addEndpoint(const std::string& transport, const std::string& name) {
+        if ((int)endpointLabels.size() >= MAX_ENDPOINTS) return -1;
+        endpointLabels.push_back("transport=\"" + transport + "\",endpoint=\"" + name + "\"");
+        return (int)endpointLabels.size() - 1;
+    }
+
+    void recordRequest(int endpoint, Clock::duration elapsed) {
+        if (endpoint < 0 || endpoint >= (int)endpointLabels.size()) return;
+        uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        const uint64_t* bounds = bucketBounds();
+        int bucket = (int)(std::lower_bound(bounds, bounds + BUCKETS, nanos) - bounds);
+        ThreadBlock& block = local();
+        add(block.requests[endpoint], 1);
+        add(block.nanos[endpoint], nanos);
+        add(block.buckets[endpoint][bucket], 1);
+    }
+
+    void count(Counter counter, uint64_t amount = 1) {
+        add(local().counters[counter], amount);
+    }
+
+    // Update thread only
+    void recordCrowdUpdate(Clock::duration elapsed) { crowdUpdate.record(elapsed); }
+    void recordTick(Clock::duration elapsed) { tick.record(elapsed); }
+
+    uint64_t total(Counter counter) const {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        uint64_t sum = 0;
+        for (const auto& block : blocks) sum += block->counters[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Request histograms and tick summaries; gauges are written by the caller
+    void write(MetricsWriter& out) const {
+        const size_t endpoints = endpointLabels.size();
+        std::vector<uint64_t> requests(endpoints, 0), nanos(endpoints, 0), buckets(endpoints * (BUCKETS + 1), 0);
+        {
+            std::lock_guard<std::mutex> lock(blocksMutex);
+            for (const auto& block : blocks) {
+                for (size_t e = 0; e < endpoints; e++) {
+                    requests[e] += block->requests[e].load(std::memory_order_relaxed);
+                    nanos[e] += block->nanos[e].load(std::memory_order_relaxed);
+                    for (int b = 0; b <= BUCKETS; b++) buckets[e * (BUCKETS + 1) + b] += block->buckets[e][b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        const uint64_t* bounds = bucketBounds();
+        out.family("pathfinding_request_duration_seconds", "histogram", "Time spent handling a request, by transport and endpoint");
+        for (size_t e = 0; e < endpoints; e++) {
+            if (requests[e] == 0) continue;
+            const std::string& labels = endpointLabels[e];
+            uint64_t cumulative = 0;
+            for (int b = 0; b <= BUCKETS; b++) {
+                cumulative += buckets[e * (BUCKETS + 1) + b];
+                std::string le = labels + ",le=\"";
+                if (b < BUCKETS) {
+                    char buffer[32];
+                    auto result = std::to_chars(buffer, buffer + sizeof(buffer), (double)bounds[b] / 1e9);
+                    le.append(buffer, (size_t)(result.ptr - buffer));
+                } else {
+                    le += "+Inf";
+                }
+                le += '"';
+                out.sample("pathfinding_request_duration_seconds", "_bucket", le, (unsigned long long)cumulative);
+            }
+            out.sample("pathfinding_request_duration_seconds", "_sum", labels, (double)nanos[e] / 1e9);
+            out.sample("pathfinding_request_duration_seconds", "_count", labels, (unsigned long long)requests[e]);
+        }
+
+        crowdUpdate.write(out, "pathfinding_crowd_update_seconds", "dtCrowd::update wall time per tick over every shard, last 1024 ticks");
+        tick.write(out, "pathfinding_tick_seconds", "Whole update tick wall time, last 1024 ticks");
+        out.single("pathfinding_find_path_out_of_nodes_total", "counter", "findPath searches that ran out of query nodes (DT_OUT_OF_NODES)",
+                   (unsigned long long)total(FIND_PATH_OUT_OF_NODES));
+    }
+};
+
+// Resident set size of this process in bytes, 0 if unknown
+inline unsigned long long processResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (unsigned long long)counters.WorkingSetSize;
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    unsigned long long size = 0, resident = 0;
+    int read = fscanf(statm, "%llu %llu", &size, &resident);
+    fclose(statm);
+    if (read != 2) return 0;
+    return resident * (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+}
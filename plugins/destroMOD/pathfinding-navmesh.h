@@ -0,0 +1,437 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Navmesh file formats
+// Reads the legacy TESM dump (tiles found by scanning for the DNAV magic) and the
+// indexed container, which carries a tile directory so loading is O(tiles) and tiles
+// can be handed to Detour straight out of a private file mapping.
+//
+// Indexed layout (little-endian):
+//   NavIndexHeader (64 bytes) | tileCount * NavIndexTile (32 bytes) | tile data...
+// Every tile starts at a NAV_INDEX_ALIGNMENT boundary so Detour can use it in place.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+
+static const uint32_t TESM_MAGIC = 0x4D534554;        // 'TESM'
+static const uint32_t TESM_TILE_MAGIC = 0x444E4156;   // 'DNAV' as stored by the exporter
+static const uint32_t NAV_INDEX_MAGIC = 0x58444E44;   // 'DNDX'
+static const uint32_t NAV_INDEX_VERSION = 1;
+static const uint32_t NAV_INDEX_ALIGNMENT = 16;
+
+struct NavIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tileCount;
+    uint32_t tileAlignment;
+    uint64_t directoryOffset;
+    float orig[3];
+    float tileWidth;
+    float tileHeight;
+    int32_t maxTiles;
+    int32_t maxPolys;
+    uint32_t reserved[3];
+};
+
+struct NavIndexTile {
+    uint64_t offset;
+    uint32_t size;
+    int32_t x;
+    int32_t y;
+    int32_t layer;
+    uint32_t reserved[2];
+};
+
+static_assert(sizeof(NavIndexHeader) == 64, "NavIndexHeader layout");
+static_assert(sizeof(NavIndexTile) == 32, "NavIndexTile layout");
+
+// Byte range of one tile inside a loaded file
+struct NavTileSpan {
+    size_t offset;
+    size_t size;
+};
+
+// Reads a TESM file fully into memory and returns the params and the tile spans found by
+// scanning for the tile magic. This is the slow path the indexed format replaces.
+inline bool readTesmFile(const std::string& filepath, std::vector<unsigned char>& data, dtNavMeshParams& params, std::vector<NavTileSpan>& tiles) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        std::cout << "[ERROR] Could not open file: " << filepath << std::endl;
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    data.resize(fileSize);
+    file.read(reinterpret_cast<char*>(data.data()), fileSize);
+    file.close();
+
+    if (fileSize < sizeof(int) * 3 + sizeof(dtNavMeshParams) || *reinterpret_cast<const uint32_t*>(data.data()) != TESM_MAGIC) {
+        std::cout << "[ERROR] Not a TESM format file" << std::endl;
+        return false;
+    }
+    const unsigned char* d = data.data() + sizeof(int) * 3;
+    memcpy(&params, d, sizeof(dtNavMeshParams));
+    d += sizeof(dtNavMeshParams);
+
+    tiles.clear();
+    const unsigned char* begin = data.data();
+    const unsigned char* end = begin + fileSize;
+    while (d < end - 8) {
+        if (*reinterpret_cast<const uint32_t*>(d) == TESM_TILE_MAGIC) {
+            const unsigned char* tileStart = d;
+            const unsigned char* nextTile = d + 8;
+            while (nextTile < end - 4 && *reinterpret_cast<const uint32_t*>(nextTile) != TESM_TILE_MAGIC) nextTile++;
+            size_t tileSize = (nextTile >= end - 4) ? (end - tileStart) : (nextTile - tileStart);
+            tiles.push_back({(size_t)(tileStart - begin), tileSize});
+            d = nextTile;
+        } else {
+            d++;
+        }
+    }
+    return true;
+}
+
+// Writes the indexed container. Tile coordinates come from each tile's own dtMeshHeader.
+inline bool convertTesmToIndexed(const std::string& inputPath, const std::string& outputPath) {
+    std::vector<unsigned char> data;
+    dtNavMeshParams params;
+    std::vector<NavTileSpan> spans;
+    if (!readTesmFile(inputPath, data, params, spans)) return false;
+    spans.erase(std::remove_if(spans.begin(), spans.end(), [](const NavTileSpan& span) { return span.size < sizeof(dtMeshHeader); }), spans.end());
+
+    NavIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = NAV_INDEX_MAGIC;
+    header.version = NAV_INDEX_VERSION;
+    header.tileAlignment = NAV_INDEX_ALIGNMENT;
+    header.directoryOffset = sizeof(NavIndexHeader);
+    memcpy(header.orig, params.orig, sizeof(header.orig));
+    header.tileWidth = params.tileWidth;
+    header.tileHeight = params.tileHeight;
+    header.maxTiles = params.maxTiles;
+    header.maxPolys = params.maxPolys;
+
+    std::vector<NavIndexTile> directory;
+    directory.reserve(spans.size());
+    uint64_t offset = sizeof(NavIndexHeader) + sizeof(NavIndexTile) * spans.size();
+    for (const auto& span : spans) {
+        dtMeshHeader meshHeader;
+        memcpy(&meshHeader, data.data() + span.offset, sizeof(dtMeshHeader));
+
+        NavIndexTile entry;
+        memset(&entry, 0, sizeof(entry));
+        offset = (offset + NAV_INDEX_ALIGNMENT - 1) & ~(uint64_t)(NAV_INDEX_ALIGNMENT - 1);
+        entry.offset = offset;
+        entry.size = (uint32_t)span.size;
+        entry.x = meshHeader.x;
+        entry.y = meshHeader.y;
+        entry.layer = meshHeader.layer;
+        directory.push_back(entry);
+        offset += span.size;
+    }
+    header.tileCount = (uint32_t)directory.size();
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "[ERROR] Could not create file: " << outputPath << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(directory.data()), sizeof(NavIndexTile) * directory.size());
+
+    static const char padding[NAV_INDEX_ALIGNMENT] = {};
+    uint64_t written = sizeof(NavIndexHeader) + sizeof(NavIndexTile) * directory.size();
+    for (size_t i = 0; i < spans.size(); i++) {
+        const NavTileSpan& span = spans[i];
+        const NavIndexTile& entry = directory[i];
+        out.write(padding, (std::streamsize)(entry.offset - written));
+        out.write(reinterpret_cast<const char*>(data.data() + span.offset), (std::streamsize)span.size);
+        written = entry.offset + span.size;
+    }
+    if (!out) {
+        std::cout << "[ERROR] Failed writing: " << outputPath << std::endl;
+        return false;
+    }
+
+    std::cout << "[Convert] Wrote " << directory.size() << " tiles to " << outputPath << " (" << written << " bytes)" << std::endl;
+    return true;
+}
+
+// Private (copy-on-write) read-write mapping of a whole file. Detour writes link data into
+// tiles when they are added, so only the pages it touches get copied; the file is never
+// modified.
+class MappedFile {
+private:
+    unsigned char* base;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+public:
+    MappedFile() : base(nullptr), length(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        length = (size_t)fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        base = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        length = (size_t)info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        base = mapped == MAP_FAILED ? nullptr : (unsigned char*)mapped;
+#endif
+        if (!base) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(base, length);
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    unsigned char* data() const { return base; }
+    size_t size() const { return length; }
+    bool isOpen() const { return base != nullptr; }
+};
+
+// Indexed navmesh backed by a file mapping. The mapping must outlive the dtNavMesh, since
+// aligned tiles are added without DT_TILE_FREE_DATA and point straight into it.
+class IndexedNavMeshFile {
+public:
+    enum TileCheck : uint8_t { TILE_OK = 0, TILE_NEEDS_COPY = 1, TILE_INVALID = 2 };
+
+private:
+    MappedFile file;
+    NavIndexHeader header;
+    std::vector<NavIndexTile> directory;
+    std::vector<uint8_t> checks;
+
+    static TileCheck checkTile(const NavIndexTile& entry, const unsigned char* base, size_t fileSize) {
+        if (entry.size < sizeof(dtMeshHeader) || entry.offset > fileSize || entry.size > fileSize - entry.offset) return TILE_INVALID;
+        dtMeshHeader meshHeader;
+        memcpy(&meshHeader, base + entry.offset, sizeof(dtMeshHeader));
+        if (meshHeader.magic != DT_NAVMESH_MAGIC || meshHeader.version != DT_NAVMESH_VERSION) return TILE_INVALID;
+        if (meshHeader.x != entry.x || meshHeader.y != entry.y || meshHeader.layer != entry.layer) return TILE_INVALID;
+        return (entry.offset % NAV_INDEX_ALIGNMENT) == 0 ? TILE_OK : TILE_NEEDS_COPY;
+    }
+
+public:
+    static bool isIndexed(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        uint32_t magic = 0;
+        file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        return file && magic == NAV_INDEX_MAGIC;
+    }
+
+    // Maps the file and validates the directory on validateThreads threads. Only tile headers
+    // are read, so untouched tile pages stay on disk.
+    bool open(const std::string& path, int validateThreads) {
+        directory.clear();
+        checks.clear();
+        if (!file.open(path)) {
+            std::cout << "[ERROR] Could not map file: " << path << std::endl;
+            return false;
+        }
+
+        const unsigned char* base = file.data();
+        size_t fileSize = file.size();
+        if (fileSize < sizeof(NavIndexHeader)) {
+            file.close();
+            return false;
+        }
+        memcpy(&header, base, sizeof(header));
+        if (header.magic != NAV_INDEX_MAGIC || header.version != NAV_INDEX_VERSION ||
+            header.directoryOffset > fileSize || (fileSize - header.directoryOffset) / sizeof(NavIndexTile) < header.tileCount) {
+            std::cout << "[ERROR] Invalid indexed navmesh header: " << path << std::endl;
+            file.close();
+            return false;
+        }
+
+        directory.resize(header.tileCount);
+        memcpy(directory.data(), base + header.directoryOffset, sizeof(NavIndexTile) * directory.size());
+
+        checks.resize(directory.size());
+        if (validateThreads < 1) validateThreads = 1;
+        size_t perThread = (directory.size() + validateThreads - 1) / validateThreads;
+        std::vector<std::thread> validators;
+        for (int t = 0; t < validateThreads && (size_t)t * perThread < directory.size(); t++) {
+            validators.emplace_back([&, t]() {
+                size_t first = (size_t)t * perThread;
+                size_t last = std::min(directory.size(), first + perThread);
+                for (size_t i = first; i < last; i++) checks[i] = checkTile(directory[i], base, fileSize);
+            });
+        }
+        for (auto& validator : validators) validator.join();
+        return true;
+    }
+
+    // Empty navmesh with the file's params - tiles are added by loadAll or a streamer
+    dtNavMesh* createNavMesh() const {
+        dtNavMeshParams params;
+        memcpy(params.orig, header.orig, sizeof(params.orig));
+        params.tileWidth = header.tileWidth;
+        params.tileHeight = header.tileHeight;
+        params.maxTiles = header.maxTiles;
+        params.maxPolys = header.maxPolys;
+
+        dtNavMesh* navMesh = dtAllocNavMesh();
+        if (!navMesh || dtStatusFailed(navMesh->init(&params))) {
+            if (navMesh) dtFreeNavMesh(navMesh);
+            return nullptr;
+        }
+        return navMesh;
+    }
+
+    // Adds every valid tile in place. addTile stitches links into neighbours, so it stays on one thread.
+    int loadAll(dtNavMesh* navMesh) {
+        int tilesLoaded = 0;
+        for (size_t i = 0; i < directory.size(); i++) {
+            const NavIndexTile& entry = directory[i];
+            if (checks[i] == TILE_INVALID) continue;
+            unsigned char* tileData = file.data() + entry.offset;
+            int flags = 0;
+            if (checks[i] == TILE_NEEDS_COPY) {
+                tileData = copyTile(i);
+                flags = DT_TILE_FREE_DATA;
+            }
+            if (dtStatusSucceed(navMesh->addTile(tileData, (int)entry.size, flags, 0, nullptr))) {
+                tilesLoaded++;
+            } else if (flags & DT_TILE_FREE_DATA) {
+                dtFree(tileData);
+            }
+        }
+        return tilesLoaded;
+    }
+
+    // Owned copy of one tile, for addTile with DT_TILE_FREE_DATA
+    unsigned char* copyTile(size_t index) const {
+        const NavIndexTile& entry = directory[index];
+        unsigned char* copy = (unsigned char*)dtAlloc(entry.size, DT_ALLOC_PERM);
+        if (copy) memcpy(copy, file.data() + entry.offset, entry.size);
+        return copy;
+    }
+
+    const std::vector<NavIndexTile>& tiles() const { return directory; }
+    bool isTileValid(size_t index) const { return checks[index] != TILE_INVALID; }
+    float tileWidth() const { return header.tileWidth; }
+    float tileHeight() const { return header.tileHeight; }
+    const float* origin() const { return header.orig; }
+
+    // Call only after the navmesh using the mapping has been freed
+    void close() {
+        file.close();
+        directory.clear();
+        checks.clear();
+    }
+};
+
+// Indexed files open in the process, one per path. Zones that stream the same map share
+// the mapping, directory and tile checks: streamers only copy tiles out of it. A zone that
+// adds every tile in place needs a mapping of its own, since Detour writes links into the
+// tiles; the pages it never touches are still shared through the page cache.
+class NavMeshFileCache {
+private:
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<IndexedNavMeshFile>> files;
+
+public:
+    // fresh: map the file again even if it is open (a reload after the file changed); later
+    // opens get the new mapping, zones holding the old one keep it until they let it go
+    std::shared_ptr<IndexedNavMeshFile> open(const std::string& path, int validateThreads, bool fresh = false) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fresh) {
+            auto it = files.find(path);
+            if (it != files.end()) {
+                if (auto file = it->second.lock()) return file;
+            }
+        }
+        auto file = std::make_shared<IndexedNavMeshFile>();
+        if (!file->open(path, validateThreads)) return nullptr;
+        files[path] = file;
+        return file;
+    }
+
+    // Files some zone still holds
+    size_t openFiles() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t open = 0;
+        for (const auto& entry : files) {
+            if (!entry.second.expired()) open++;
+        }
+        return open;
+    }
+};
@@ -0,0 +1,415 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Dynamic obstacle overlay
+// Player constructions and vehicles are not in the baked navmesh. Instead of rebuilding
+// tiles, each obstacle (a yawed box or an upright cylinder) marks the polys under it:
+// polys whose centre it covers get POLY_FLAG_OBSTACLE, which every query filter and the
+// crowd exclude, and polys it only clips get POLY_AREA_OBSTACLE_EDGE, which is passable
+// but costly. Marks are reference counted per poly and remember the baked flags and
+// area, so overlapping obstacles and removals restore exactly what was there.
+//
+// Adds, moves and removes are queued from any thread and applied by the update thread in
+// two steps: plan() finds the polys under the changed obstacles under the shared navmesh
+// lock, and commit() only writes their flags under the exclusive one, so readers are held
+// off for the writes alone. A streamed tile comes back without marks, so obstacles
+// remember the tiles they touched and are re-marked when one of them is swapped.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+static const unsigned short POLY_FLAG_OBSTACLE = 0x8000;   // Must not be used by the baked navmesh
+static const unsigned char POLY_AREA_OBSTACLE_EDGE = 62;
+static const float OBSTACLE_EDGE_COST = 10.0f;
+
+enum ObstacleShape : uint8_t {
+    OBSTACLE_BOX = 0,
+    OBSTACLE_CYLINDER = 1
+};
+
+struct ObstacleSpec {
+    std::string id;
+    ObstacleShape shape = OBSTACLE_BOX;
+    float center[3] = {0.0f, 0.0f, 0.0f};
+    float halfExtents[3] = {0.5f, 0.5f, 0.5f};  // Box half sizes along its own x, y, z; cylinders use x as radius, y as half height
+    float yaw = 0.0f;                           // Radians about +y, boxes only
+};
+
+struct ObstacleStats {
+    size_t obstacles = 0;
+    size_t blockedPolys = 0;
+    size_t edgePolys = 0;
+    size_t pending = 0;
+    unsigned long long applied = 0;         // Adds, moves and removes applied
+    unsigned long long tileRemarks = 0;     // Obstacles re-marked after a tile swap
+    double lastApplyMs = 0.0;
+};
+
+class ObstacleOverlay {
+private:
+    struct Op {
+        bool remove;
+        ObstacleSpec spec;
+    };
+
+    struct Obstacle {
+        ObstacleSpec spec;
+        std::vector<dtPolyRef> blocked;
+        std::vector<dtPolyRef> edge;
+        std::vector<dtTileRef> tiles;   // Tiles under the bounds when the polys were marked
+        int tileMin[2], tileMax[2];
+    };
+
+public:
+    // Marks worked out by plan() for commit(): one entry per re-marked obstacle and per op
+    struct Plan {
+        struct Change {
+            bool remove = false;
+            Obstacle next;              // Spec and polys to mark, unless remove
+        };
+        std::vector<Change> changes;
+        size_t ops = 0;
+        unsigned long long remarks = 0;
+        unsigned long long tileGeneration = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+
+    // Baked values of a marked poly and how many obstacles mark it
+    struct PolyMark {
+        unsigned short flags;
+        unsigned char area;
+        uint16_t blockers;
+        uint16_t edges;
+    };
+
+    class PolyCollector : public dtPolyQuery {
+    public:
+        std::vector<dtPolyRef> refs;
+        void process(const dtMeshTile*, dtPoly**, dtPolyRef* polyRefs, int count) override {
+            refs.insert(refs.end(), polyRefs, polyRefs + count);
+        }
+    };
+
+    std::mutex queueMutex;
+    std::vector<Op> queue;
+    std::atomic<size_t> queued;
+    std::atomic<unsigned long long> generation;
+
+    // Update thread only
+    std::unordered_map<std::string, Obstacle> obstacles;
+    std::unordered_map<dtPolyRef, PolyMark> marks;
+    size_t blockedPolys, edgePolys;
+    dtQueryFilter anyPoly;      // Finds polys whatever their flags, marked ones included
+    unsigned long long streamGeneration;
+
+    mutable std::mutex statsMutex;
+    ObstacleStats stats;
+
+    static void footprintBounds(const ObstacleSpec& spec, float* halfExtents) {
+        if (spec.shape == OBSTACLE_CYLINDER) {
+            halfExtents[0] = halfExtents[2] = spec.halfExtents[0];
+        } else {
+            const float c = std::fabs(std::cos(spec.yaw)), s = std::fabs(std::sin(spec.yaw));
+            halfExtents[0] = spec.halfExtents[0] * c + spec.halfExtents[2] * s;
+            halfExtents[2] = spec.halfExtents[0] * s + spec.halfExtents[2] * c;
+        }
+        halfExtents[1] = spec.halfExtents[1] + 1.0f;    // Polys sit a little off the ground the obstacle stands on
+    }
+
+    static bool insideFootprint(const ObstacleSpec& spec, float x, float z) {
+        const float dx = x - spec.center[0], dz = z - spec.center[2];
+        if (spec.shape == OBSTACLE_CYLINDER) return dx * dx + dz * dz <= spec.halfExtents[0] * spec.halfExtents[0];
+        const float c = std::cos(spec.yaw), s = std::sin(spec.yaw);
+        return std::fabs(dx * c - dz * s) <= spec.halfExtents[0] && std::fabs(dx * s + dz * c) <= spec.halfExtents[2];
+    }
+
+    // Points on the footprint outline, for obstacles smaller than the polys they stand on
+    static int footprintPoints(const ObstacleSpec& spec, float* points) {
+        const float cx = spec.center[0], cz = spec.center[2];
+        points[0] = cx;
+        points[1] = cz;
+        if (spec.shape == OBSTACLE_CYLINDER) {
+            const float r = spec.halfExtents[0];
+            const float ring[4][2] = {{r, 0.0f}, {-r, 0.0f}, {0.0f, r}, {0.0f, -r}};
+            for (int i = 0; i < 4; i++) {
+                points[2 + i * 2] = cx + ring[i][0];
+                points[3 + i * 2] = cz + ring[i][1];
+            }
+            return 5;
+        }
+        const float c = std::cos(spec.yaw), s = std::sin(spec.yaw);
+        const float hx = spec.halfExtents[0], hz = spec.halfExtents[2];
+        const float corners[4][2] = {{hx, hz}, {-hx, hz}, {-hx, -hz}, {hx, -hz}};
+        for (int i = 0; i < 4; i++) {
+            // Inverse of the rotation in insideFootprint
+            points[2 + i * 2] = cx + corners[i][0] * c + corners[i][1] * s;
+            points[3 + i * 2] = cz - corners[i][0] * s + corners[i][1] * c;
+        }
+        return 5;
+    }
+
+    static bool insidePoly(const float* verts, int count, float x, float z) {
+        bool inside = false;
+        for (int i = 0, j = count - 1; i < count; j = i++) {
+            const float* a = verts + i * 3;
+            const float* b = verts + j * 3;
+            if ((a[2] > z) != (b[2] > z) && x < (b[0] - a[0]) * (z - a[2]) / (b[2] - a[2]) + a[0]) inside = !inside;
+        }
+        return inside;
+    }
+
+    void tileRange(const dtNavMesh* navMesh, const Obstacle& obstacle, int* tileMin, int* tileMax) const {
+        float halfExtents[3], low[3], high[3];
+        footprintBounds(obstacle.spec, halfExtents);
+        for (int i = 0; i < 3; i++) {
+            low[i] = obstacle.spec.center[i] - halfExtents[i];
+            high[i] = obstacle.spec.center[i] + halfExtents[i];
+        }
+        navMesh->calcTileLoc(low, &tileMin[0], &tileMin[1]);
+        navMesh->calcTileLoc(high, &tileMax[0], &tileMax[1]);
+    }
+
+    static void tilesUnder(const dtNavMesh* navMesh, const int* tileMin, const int* tileMax, std::vector<dtTileRef>& out) {
+        out.clear();
+        const dtMeshTile* tiles[8];
+        for (int ty = tileMin[1]; ty <= tileMax[1]; ty++) {
+            for (int tx = tileMin[0]; tx <= tileMax[0]; tx++) {
+                int count = navMesh->getTilesAt(tx, ty, tiles, 8);
+                for (int i = 0; i < count; i++) out.push_back(navMesh->getTileRef(tiles[i]));
+            }
+        }
+    }
+
+    void tally(const PolyMark& mark, int delta) {
+        if (mark.blockers) blockedPolys += delta;
+        else if (mark.edges) edgePolys += delta;
+    }
+
+    // Writes the poly's flags and area for its current counts; live is false for polys of
+    // tiles that were unloaded, which are only forgotten (a reloaded tile has baked values)
+    void changeMark(dtNavMesh* navMesh, dtPolyRef ref, bool blocked, int delta, bool live) {
+        auto it = marks.find(ref);
+        if (it == marks.end()) {
+            if (delta < 0) return;
+            PolyMark mark = {0, 0, 0, 0};
+            navMesh->getPolyFlags(ref, &mark.flags);
+            navMesh->getPolyArea(ref, &mark.area);
+            it = marks.emplace(ref, mark).first;
+        }
+        PolyMark& mark = it->second;
+        tally(mark, -1);
+        uint16_t& counter = blocked ? mark.blockers : mark.edges;
+        if (delta > 0) counter++;
+        else if (counter > 0) counter--;
+        tally(mark, 1);
+        if (live) {
+            navMesh->setPolyFlags(ref, mark.blockers ? (unsigned short)(mark.flags | POLY_FLAG_OBSTACLE) : mark.flags);
+            navMesh->setPolyArea(ref, mark.edges && !mark.blockers ? POLY_AREA_OBSTACLE_EDGE : mark.area);
+        }
+        if (!mark.blockers && !mark.edges) marks.erase(it);
+    }
+
+    // Finds the polys obstacle.spec covers or clips, and the tiles under it. Reads the
+    // navmesh only.
+    void collect(const dtNavMesh* navMesh, const dtNavMeshQuery* navQuery, Obstacle& obstacle) const {
+        const ObstacleSpec& spec = obstacle.spec;
+        obstacle.blocked.clear();
+        obstacle.edge.clear();
+        float halfExtents[3];
+        footprintBounds(spec, halfExtents);
+        PolyCollector collector;
+        navQuery->queryPolygons(spec.center, halfExtents, &anyPoly, &collector);
+
+        float outline[10];
+        const int outlineCount = footprintPoints(spec, outline);
+        for (dtPolyRef ref : collector.refs) {
+            const dtMeshTile* tile = nullptr;
+            const dtPoly* poly = nullptr;
+            if (dtStatusFailed(navMesh->getTileAndPolyByRef(ref, &tile, &poly)) || poly->getType() != DT_POLYTYPE_GROUND) continue;
+
+            float verts[DT_VERTS_PER_POLYGON * 3];
+            float centroid[3] = {0.0f, 0.0f, 0.0f};
+            int inside = 0;
+            for (int i = 0; i < poly->vertCount; i++) {
+                const float* v = &tile->verts[poly->verts[i] * 3];
+                for (int k = 0; k < 3; k++) {
+                    verts[i * 3 + k] = v[k];
+                    centroid[k] += v[k] / poly->vertCount;
+                }
+                if (insideFootprint(spec, v[0], v[2])) inside++;
+            }
+            bool blocked = inside == poly->vertCount || insideFootprint(spec, centroid[0], centroid[2]);
+            bool clipped = inside > 0;
+            for (int i = 0; i < outlineCount && !blocked && !clipped; i++) {
+                clipped = insidePoly(verts, poly->vertCount, outline[i * 2], outline[i * 2 + 1]);
+            }
+            if (!blocked && !clipped) continue;
+            (blocked ? obstacle.blocked : obstacle.edge).push_back(ref);
+        }
+        tileRange(navMesh, obstacle, obstacle.tileMin, obstacle.tileMax);
+        tilesUnder(navMesh, obstacle.tileMin, obstacle.tileMax, obstacle.tiles);
+    }
+
+    // Writes the marks collect() found. A tile streamed out since is skipped; its
+    // obstacles are re-marked once the streamer's generation is seen to have moved.
+    void mark(dtNavMesh* navMesh, Obstacle& obstacle) {
+        auto markLive = [&](std::vector<dtPolyRef>& refs, bool blocked) {
+            refs.erase(std::remove_if(refs.begin(), refs.end(), [navMesh](dtPolyRef ref) { return !navMesh->isValidPolyRef(ref); }), refs.end());
+            for (dtPolyRef ref : refs) changeMark(navMesh, ref, blocked, 1, true);
+        };
+        markLive(obstacle.blocked, true);
+        markLive(obstacle.edge, false);
+    }
+
+    void unmark(dtNavMesh* navMesh, Obstacle& obstacle) {
+        for (dtPolyRef ref : obstacle.blocked) changeMark(navMesh, ref, true, -1, navMesh->isValidPolyRef(ref));
+        for (dtPolyRef ref : obstacle.edge) changeMark(navMesh, ref, false, -1, navMesh->isValidPolyRef(ref));
+        obstacle.blocked.clear();
+        obstacle.edge.clear();
+    }
+
+public:
+    ObstacleOverlay() : queued(0), generation(0), blockedPolys(0), edgePolys(0), streamGeneration(0) {
+        anyPoly.setIncludeFlags(0xffff);
+        anyPoly.setExcludeFlags(0);
+    }
+
+    // Makes filter skip blocked polys and price clipped ones; every filter the service
+    // hands to Detour is configured through here
+    static void configureFilter(dtQueryFilter& filter) {
+        filter.setExcludeFlags((unsigned short)(filter.getExcludeFlags() | POLY_FLAG_OBSTACLE));
+        filter.setAreaCost(POLY_AREA_OBSTACLE_EDGE, OBSTACLE_EDGE_COST);
+    }
+
+    // Any thread; adding an id that exists moves it
+    void add(const ObstacleSpec& spec) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(Op{false, spec});
+        queued = queue.size();
+    }
+
+    void remove(const std::string& id) {
+        ObstacleSpec spec;
+        spec.id = id;
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(Op{true, spec});
+        queued = queue.size();
+    }
+
+    bool hasPending() const { return queued.load(std::memory_order_relaxed) > 0; }
+
+    // Bumped whenever marks change; anything cached against the navmesh is stale after it
+    unsigned long long getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+    // Update thread, navmesh locked shared: takes the queued ops and works out their marks.
+    // tileGeneration is the streamer's; when it moved, obstacles whose tiles were swapped
+    // are planned again too.
+    void plan(const dtNavMesh* navMesh, const dtNavMeshQuery* navQuery, unsigned long long tileGeneration, Plan& out) {
+        out = Plan();
+        out.start = std::chrono::steady_clock::now();
+        out.tileGeneration = tileGeneration;
+        std::vector<Op> ops;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            ops.swap(queue);
+            queued = 0;
+        }
+
+        if (tileGeneration != streamGeneration) {
+            std::vector<dtTileRef> current;
+            for (const auto& entry : obstacles) {
+                const Obstacle& obstacle = entry.second;
+                tilesUnder(navMesh, obstacle.tileMin, obstacle.tileMax, current);
+                if (current == obstacle.tiles) continue;
+                Plan::Change change;
+                change.next.spec = obstacle.spec;
+                collect(navMesh, navQuery, change.next);
+                out.changes.push_back(std::move(change));
+                out.remarks++;
+            }
+        }
+
+        for (const Op& op : ops) {
+            Plan::Change change;
+            change.remove = op.remove;
+            change.next.spec = op.spec;
+            if (!op.remove) collect(navMesh, navQuery, change.next);
+            out.changes.push_back(std::move(change));
+        }
+        out.ops = ops.size();
+    }
+
+    // Update thread, navmesh locked exclusively: swaps the planned marks in
+    void commit(dtNavMesh* navMesh, Plan& plan) {
+        streamGeneration = plan.tileGeneration;
+        for (auto& change : plan.changes) {
+            const std::string& id = change.next.spec.id;
+            auto it = obstacles.find(id);
+            if (it != obstacles.end()) {
+                unmark(navMesh, it->second);
+                if (change.remove) obstacles.erase(it);
+            }
+            if (change.remove) continue;
+            Obstacle& obstacle = obstacles[id];
+            obstacle = std::move(change.next);
+            mark(navMesh, obstacle);
+        }
+
+        if (!plan.changes.empty()) generation.fetch_add(1, std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.obstacles = obstacles.size();
+        stats.blockedPolys = blockedPolys;
+        stats.edgePolys = edgePolys;
+        stats.applied += plan.ops;
+        stats.tileRemarks += plan.remarks;
+        stats.lastApplyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - plan.start).count();
+    }
+
+    // Update thread, navmesh locked exclusively: the navmesh was replaced by a reload. The old
+    // one is discarded as it is, so its marks are only forgotten; every obstacle is marked
+    // again on the new one. tileGeneration is the new streamer's.
+    void rebind(dtNavMesh* navMesh, const dtNavMeshQuery* navQuery, unsigned long long tileGeneration) {
+        auto start = std::chrono::steady_clock::now();
+        marks.clear();
+        blockedPolys = edgePolys = 0;
+        for (auto& entry : obstacles) {
+            collect(navMesh, navQuery, entry.second);
+            mark(navMesh, entry.second);
+        }
+        streamGeneration = tileGeneration;
+        generation.fetch_add(1, std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.obstacles = obstacles.size();
+        stats.blockedPolys = blockedPolys;
+        stats.edgePolys = edgePolys;
+        stats.tileRemarks += obstacles.size();
+        stats.lastApplyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Update thread: true when plan() has something to do
+    bool needsApply(unsigned long long tileGeneration) const {
+        return hasPending() || (tileGeneration != streamGeneration && !obstacles.empty());
+    }
+
+    ObstacleStats getStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        ObstacleStats result = stats;
+        result.pending = queued.load();
+        return result;
+    }
+};
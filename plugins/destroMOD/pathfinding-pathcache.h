@@ -0,0 +1,155 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Path result cache
+// Bounded LRU of poly corridors keyed on (start poly, end poly, filter). Two requests
+// whose endpoints land on the same pair of polys share the corridor, so a hit only
+// has to re-run findStraightPath for the exact endpoints. The whole cache is dropped
+// whenever the navmesh tile generation moves, since poly refs of removed tiles can
+// be reused by the tiles that replace them.
+// ===================================================================================
+
+#pragma once
+
+#include <list>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <cstring>
+
+#include "DetourNavMesh.h"
+#include "DetourCrowd.h"
+
+// Filter ids that take part in the cache key. The service's queryFilter and the crowd's
+// filter type 0 are both default-constructed, so they share an id.
+enum PathFilterId : unsigned int {
+    PATH_FILTER_DEFAULT = 0
+};
+
+struct PathCacheKey {
+    dtPolyRef startRef;
+    dtPolyRef endRef;
+    unsigned int filterId;
+
+    bool operator==(const PathCacheKey& other) const {
+        return startRef == other.startRef && endRef == other.endRef && filterId == other.filterId;
+    }
+};
+
+struct PathCacheKeyHash {
+    size_t operator()(const PathCacheKey& key) const {
+        uint64_t h = (uint64_t)key.startRef * 0x9E3779B97F4A7C15ULL;
+        h ^= (uint64_t)key.endRef + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+        h ^= (uint64_t)key.filterId + (h << 6) + (h >> 2);
+        return (size_t)h;
+    }
+};
+
+struct PathCacheStats {
+    size_t entries = 0;
+    size_t capacity = 0;
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long stores = 0;
+    unsigned long long evictions = 0;
+    unsigned long long invalidations = 0;  // Whole-cache drops after tile changes
+};
+
+// Thread-safe; callers hold the navmesh lock shared so the generation they pass in is current
+class PathCache {
+private:
+    struct Entry {
+        PathCacheKey key;
+        std::vector<dtPolyRef> polys;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    EntryList entries;                                                      // Most recently used first
+    std::unordered_map<PathCacheKey, EntryList::iterator, PathCacheKeyHash> index;
+    size_t capacity;
+    unsigned long long generation;
+
+    mutable std::mutex mutex;
+    PathCacheStats stats;
+
+    // Caller holds mutex
+    void syncGeneration(unsigned long long tileGeneration) {
+        if (tileGeneration == generation) return;
+        generation = tileGeneration;
+        if (entries.empty()) return;
+        entries.clear();
+        index.clear();
+        stats.invalidations++;
+    }
+
+public:
+    explicit PathCache(size_t maxEntries) : capacity(maxEntries), generation(0) {
+        stats.capacity = maxEntries;
+    }
+
+    // Copies the corridor into polys on a hit
+    bool lookup(const PathCacheKey& key, unsigned long long tileGeneration, std::vector<dtPolyRef>& polys) {
+        std::lock_guard<std::mutex> lock(mutex);
+        syncGeneration(tileGeneration);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            stats.misses++;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        polys = it->second->polys;
+        stats.hits++;
+        return true;
+    }
+
+    void store(const PathCacheKey& key, unsigned long long tileGeneration, const dtPolyRef* polys, int count) {
+        if (capacity == 0 || count <= 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        syncGeneration(tileGeneration);
+
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            it->second->polys.assign(polys, polys + count);
+            return;
+        }
+
+        if (entries.size() >= capacity) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+            stats.evictions++;
+        }
+        entries.push_front(Entry{key, std::vector<dtPolyRef>(polys, polys + count)});
+        index[key] = entries.begin();
+        stats.stores++;
+    }
+
+    // Explicit drop, e.g. when the navmesh is replaced outright
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.empty()) return;
+        entries.clear();
+        index.clear();
+        stats.invalidations++;
+    }
+
+    PathCacheStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        PathCacheStats result = stats;
+        result.entries = entries.size();
+        return result;
+    }
+};
+
+// Hands an agent a ready-made corridor - the same bookkeeping dtCrowd does when one of its
+// own path requests completes
+inline void applyAgentCorridor(dtCrowdAgent* agent, const dtPolyRef* path, int count, dtPolyRef targetRef, const float* targetPos) {
+    agent->corridor.setCorridor(targetPos, path, count);
+    agent->boundary.reset();
+    agent->partial = path[count - 1] != targetRef;
+    agent->targetRef = targetRef;
+    memcpy(agent->targetPos, targetPos, sizeof(agent->targetPos));
+    agent->targetState = DT_CROWDAGENT_TARGET_VALID;
+    agent->targetPathqRef = 0; // DT_PATHQ_INVALID
+    agent->targetReplan = false;
+    agent->targetReplanTime = 0.0f;
+}
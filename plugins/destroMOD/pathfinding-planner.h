@@ -0,0 +1,422 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Time-sliced long-path planner
+// Path requests get a ticket straight away and are searched on the update thread with
+// Detour's sliced A*, under one iteration budget shared by every request in flight,
+// so a tick never spends more than that on planning however long the routes are.
+// Searches that run out of nodes before reaching the goal continue as a new leg from
+// where they stopped, so corridors can be far longer than one search's node pool.
+// ===================================================================================
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+enum PathTicketState {
+    PATH_TICKET_UNKNOWN = 0,    // Never issued, or already collected/expired
+    PATH_TICKET_PENDING = 1,
+    PATH_TICKET_DONE = 2,
+    PATH_TICKET_FAILED = 3
+};
+
+struct PathTicketResult {
+    PathTicketState state = PATH_TICKET_UNKNOWN;
+    bool partial = false;       // Best effort: the goal was unreachable or the leg limit was hit
+    int polyCount = 0;
+    int legs = 0;
+    std::vector<float> points;  // Straight path, x,y,z triplets
+};
+
+// Receives a parked poll's answer, see SlicedPathPlanner::pollAsync
+typedef std::function<void(PathTicketState state, const PathTicketResult& result)> PathPollCallback;
+
+struct PathPlannerStats {
+    size_t queued = 0;
+    size_t running = 0;
+    size_t finished = 0;                    // Results waiting to be collected
+    unsigned long long issued = 0;
+    unsigned long long completed = 0;
+    unsigned long long failed = 0;
+    unsigned long long restarts = 0;        // Searches restarted because tiles changed under them
+    unsigned long long iterations = 0;
+    unsigned long long outOfNodes = 0;      // Legs that exhausted the node pool (DT_OUT_OF_NODES)
+    size_t parkedPolls = 0;                 // pollAsync callers waiting for a ticket to finish
+    int lastTickIterations = 0;
+    double lastTickMs = 0.0;
+    double maxTickMs = 0.0;
+};
+
+class SlicedPathPlanner {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request {
+        unsigned long long ticket = 0;
+        float start[3] = {0.0f, 0.0f, 0.0f};
+        float end[3] = {0.0f, 0.0f, 0.0f};
+        // Update thread only while running
+        dtPolyRef startRef = 0, endRef = 0;
+        float startPoint[3] = {0.0f, 0.0f, 0.0f};
+        float endPoint[3] = {0.0f, 0.0f, 0.0f};
+        float legStart[3] = {0.0f, 0.0f, 0.0f};
+        std::vector<dtPolyRef> corridor;
+        int legs = 0;
+        PathTicketResult result;
+        Clock::time_point finishedAt;
+    };
+
+    struct Slot {
+        dtNavMeshQuery* query = nullptr;
+        std::shared_ptr<Request> request;
+    };
+
+    struct ParkedPoll {
+        unsigned long long ticket;
+        Clock::time_point deadline;
+        PathPollCallback done;
+    };
+
+    struct Answer {
+        PathPollCallback done;
+        PathTicketState state;
+        PathTicketResult result;
+    };
+
+    std::vector<Slot> slots;
+    int maxNodes;
+    int maxPolys;
+    int maxLegs;
+    unsigned long long generation;
+    std::vector<dtPolyRef> legBuffer;
+    std::vector<float> straightBuffer;
+
+    // Shared with request threads
+    mutable std::mutex mutex;
+    std::condition_variable finishedSignal;
+    std::deque<std::shared_ptr<Request>> queue;
+    std::unordered_map<unsigned long long, std::shared_ptr<Request>> tickets;
+    std::vector<ParkedPoll> parked;
+    unsigned long long nextTicket;
+    PathPlannerStats stats;
+
+    // Under mutex: hands a finished result out once and forgets the ticket
+    PathTicketState collectLocked(unsigned long long ticket, PathTicketResult& out) {
+        auto it = tickets.find(ticket);
+        if (it == tickets.end()) {
+            out = PathTicketResult();
+            return PATH_TICKET_UNKNOWN;
+        }
+        if (it->second->result.state == PATH_TICKET_PENDING) {
+            out = PathTicketResult();
+            out.state = PATH_TICKET_PENDING;
+            return PATH_TICKET_PENDING;
+        }
+        out = std::move(it->second->result);
+        tickets.erase(it);
+        return out.state;
+    }
+
+    // Under mutex: moves the parked polls for ticket (every one, when ticket is 0) whose
+    // deadline is before cutoff into answers
+    void unparkLocked(unsigned long long ticket, Clock::time_point cutoff, std::vector<Answer>& answers) {
+        for (size_t i = 0; i < parked.size();) {
+            ParkedPoll& poll = parked[i];
+            if ((ticket != 0 && poll.ticket != ticket) || poll.deadline >= cutoff) {
+                i++;
+                continue;
+            }
+            Answer answer;
+            answer.done = std::move(poll.done);
+            answer.state = collectLocked(poll.ticket, answer.result);
+            answers.push_back(std::move(answer));
+            parked[i] = std::move(parked.back());
+            parked.pop_back();
+        }
+    }
+
+    static void deliver(std::vector<Answer>& answers) {
+        for (auto& answer : answers) answer.done(answer.state, answer.result);
+    }
+
+    // Update thread: publishes the result and wakes long-pollers
+    void finish(Slot& slot, PathTicketState state, bool partial) {
+        dtNavMeshQuery* query = slot.query;
+        std::shared_ptr<Request> request = slot.request;
+        slot.request.reset();
+
+        PathTicketResult result;
+        result.state = state;
+        result.legs = request->legs;
+        if (state == PATH_TICKET_DONE && !request->corridor.empty()) {
+            const int count = (int)request->corridor.size();
+            float endPoint[3];
+            memcpy(endPoint, request->endPoint, sizeof(endPoint));
+            partial = partial || request->corridor.back() != request->endRef;
+            if (partial) query->closestPointOnPoly(request->corridor.back(), request->endPoint, endPoint, nullptr);
+
+            int straightCount = 0;
+            query->findStraightPath(request->startPoint, endPoint, request->corridor.data(), count,
+                                    straightBuffer.data(), nullptr, nullptr, &straightCount, maxPolys);
+            result.partial = partial;
+            result.polyCount = count;
+            result.points.assign(straightBuffer.begin(), straightBuffer.begin() + straightCount * 3);
+            if (straightCount == 0) result.state = PATH_TICKET_FAILED;
+        } else {
+            result.state = PATH_TICKET_FAILED;
+        }
+
+        std::vector<Answer> answers;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request->result = std::move(result);
+            request->finishedAt = Clock::now();
+            if (request->result.state == PATH_TICKET_DONE) stats.completed++;
+            else stats.failed++;
+            unparkLocked(request->ticket, Clock::time_point::max(), answers);
+        }
+        finishedSignal.notify_all();
+        deliver(answers);
+    }
+
+    // Update thread: snap the endpoints and start the first leg; false if the request failed
+    bool begin(Slot& slot, const dtQueryFilter* filter) {
+        Request& request = *slot.request;
+        const float extents[3] = {10.0f, 10.0f, 10.0f};
+        request.corridor.clear();
+        request.legs = 0;
+        request.startRef = request.endRef = 0;
+        slot.query->findNearestPoly(request.start, extents, filter, &request.startRef, request.startPoint);
+        slot.query->findNearestPoly(request.end, extents, filter, &request.endRef, request.endPoint);
+        if (!request.startRef || !request.endRef) return false;
+        memcpy(request.legStart, request.startPoint, sizeof(request.legStart));
+        request.legs = 1;
+        return !dtStatusFailed(slot.query->initSlicedFindPath(request.startRef, request.endRef, request.startPoint, request.endPoint, filter));
+    }
+
+public:
+    SlicedPathPlanner(int corridorMaxPolys, int corridorMaxLegs)
+        : maxNodes(0), maxPolys(corridorMaxPolys), maxLegs(corridorMaxLegs), generation(0), nextTicket(1) {}
+
+    ~SlicedPathPlanner() {
+        clear();
+    }
+
+    // One dtNavMeshQuery per concurrent search; maxNodes bounds a single leg
+    bool init(const dtNavMesh* navMesh, int concurrentSearches, int searchMaxNodes) {
+        clear();
+        maxNodes = searchMaxNodes;
+        for (int i = 0; i < concurrentSearches; i++) {
+            Slot slot;
+            slot.query = dtAllocNavMeshQuery();
+            if (!slot.query || dtStatusFailed(slot.query->init(navMesh, maxNodes))) {
+                if (slot.query) dtFreeNavMeshQuery(slot.query);
+                clear();
+                return false;
+            }
+            slots.push_back(slot);
+        }
+        legBuffer.resize((size_t)maxPolys);
+        straightBuffer.resize((size_t)maxPolys * 3);
+        return true;
+    }
+
+    // Update thread, navmesh locked exclusively: the navmesh was replaced. Searches in flight
+    // restart on the next update, which sees the generation change.
+    bool rebind(const dtNavMesh* navMesh) {
+        for (auto& slot : slots) {
+            if (dtStatusFailed(slot.query->init(navMesh, maxNodes))) return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        for (auto& slot : slots) dtFreeNavMeshQuery(slot.query);
+        slots.clear();
+    }
+
+    // Any thread: returns the ticket to poll with
+    unsigned long long request(const float* start, const float* end) {
+        auto request = std::make_shared<Request>();
+        memcpy(request->start, start, sizeof(request->start));
+        memcpy(request->end, end, sizeof(request->end));
+        request->result.state = PATH_TICKET_PENDING;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        request->ticket = nextTicket++;
+        tickets[request->ticket] = request;
+        queue.push_back(request);
+        stats.issued++;
+        return request->ticket;
+    }
+
+    // Any thread: waits up to waitMs for the ticket to finish. A finished result is handed
+    // out once and then forgotten.
+    PathTicketState poll(unsigned long long ticket, int waitMs, PathTicketResult& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = tickets.find(ticket);
+        if (it != tickets.end() && waitMs > 0) {
+            std::shared_ptr<Request> request = it->second;
+            finishedSignal.wait_for(lock, std::chrono::milliseconds(waitMs), [&]() { return request->result.state != PATH_TICKET_PENDING; });
+        }
+        return collectLocked(ticket, out);
+    }
+
+    // Any thread: poll without blocking the caller. done runs right here when the ticket is
+    // unknown, finished or waitMs is 0; otherwise the poll is parked and done runs on the
+    // update thread once the ticket finishes, or with PENDING at the first update after
+    // waitMs. done must be quick and must not call back into the planner.
+    void pollAsync(unsigned long long ticket, int waitMs, PathPollCallback done) {
+        PathTicketResult out;
+        PathTicketState state;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            state = collectLocked(ticket, out);
+            if (state == PATH_TICKET_PENDING && waitMs > 0) {
+                parked.push_back(ParkedPoll{ticket, Clock::now() + std::chrono::milliseconds(waitMs), std::move(done)});
+                return;
+            }
+        }
+        done(state, out);
+    }
+
+    // Any thread: answers every parked poll now, with what its ticket has so far. For
+    // shutdown, when no update will come to time them out.
+    void releaseParked() {
+        std::vector<Answer> answers;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            unparkLocked(0, Clock::time_point::max(), answers);
+        }
+        deliver(answers);
+    }
+
+    // Update thread, under the navmesh read lock: spend up to maxIterations on the searches
+    // in flight. Tile changes restart every running search, since their node pools may
+    // point at polys that no longer exist.
+    void update(const dtQueryFilter* filter, unsigned long long tileGeneration, int maxIterations, int expireSeconds) {
+        auto tickStart = Clock::now();
+
+        if (tileGeneration != generation) {
+            generation = tileGeneration;
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = slots.rbegin(); it != slots.rend(); ++it) {
+                if (!it->request) continue;
+                queue.push_front(it->request);
+                it->request.reset();
+                stats.restarts++;
+            }
+        }
+
+        int budget = maxIterations;
+        int spent = 0;
+        unsigned long long outOfNodes = 0;
+        bool progressed = true;
+        while (budget > 0 && progressed) {
+            progressed = false;
+            // Slots freed by finished searches pick up queued requests with the budget left over
+            for (auto& slot : slots) {
+                while (!slot.request) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (queue.empty()) break;
+                        slot.request = queue.front();
+                        queue.pop_front();
+                    }
+                    if (!begin(slot, filter)) finish(slot, PATH_TICKET_FAILED, false);
+                }
+            }
+
+            int active = 0;
+            for (const auto& slot : slots) {
+                if (slot.request) active++;
+            }
+            if (active == 0) break;
+            const int share = std::max(1, budget / active);
+
+            for (auto& slot : slots) {
+                if (!slot.request || budget <= 0) continue;
+                Request& request = *slot.request;
+                int done = 0;
+                dtStatus status = slot.query->updateSlicedFindPath(std::min(share, budget), &done);
+                budget -= std::max(done, 1);
+                spent += done;
+                progressed = true;
+                if (dtStatusInProgress(status)) continue;
+
+                int count = 0;
+                if (dtStatusSucceed(status)) {
+                    status = slot.query->finalizeSlicedFindPath(legBuffer.data(), &count, maxPolys);
+                    if (dtStatusDetail(status, DT_OUT_OF_NODES)) outOfNodes++;
+                }
+                if (count == 0) {
+                    finish(slot, request.corridor.empty() ? PATH_TICKET_FAILED : PATH_TICKET_DONE, true);
+                    continue;
+                }
+
+                // Append the leg, dropping the poly it shares with the previous one
+                const int skip = !request.corridor.empty() && request.corridor.back() == legBuffer[0] ? 1 : 0;
+                const int room = maxPolys - (int)request.corridor.size();
+                const int take = std::min(count - skip, room);
+                request.corridor.insert(request.corridor.end(), legBuffer.begin() + skip, legBuffer.begin() + skip + take);
+                const dtPolyRef last = request.corridor.back();
+
+                const bool reached = last == request.endRef;
+                const bool stalled = skip == 1 && count == 1;
+                if (reached || stalled || take < count - skip || request.legs >= maxLegs) {
+                    finish(slot, PATH_TICKET_DONE, !reached);
+                    continue;
+                }
+
+                // Out of nodes short of the goal: carry on from the closest poly reached
+                slot.query->closestPointOnPoly(last, request.endPoint, request.legStart, nullptr);
+                request.legs++;
+                if (dtStatusFailed(slot.query->initSlicedFindPath(last, request.endRef, request.legStart, request.endPoint, filter))) {
+                    finish(slot, PATH_TICKET_DONE, true);
+                }
+            }
+        }
+
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - tickStart).count();
+        std::vector<Answer> expired;
+        std::unique_lock<std::mutex> lock(mutex);
+        unparkLocked(0, Clock::now(), expired);
+        // Drop results nobody came back for
+        auto expiry = Clock::now() - std::chrono::seconds(expireSeconds);
+        for (auto it = tickets.begin(); it != tickets.end();) {
+            const Request& request = *it->second;
+            if (request.result.state != PATH_TICKET_PENDING && request.finishedAt < expiry) it = tickets.erase(it);
+            else ++it;
+        }
+        size_t running = 0;
+        for (const auto& slot : slots) {
+            if (slot.request) running++;
+        }
+        stats.queued = queue.size();
+        stats.running = running;
+        stats.finished = tickets.size() - running - queue.size();
+        stats.iterations += spent;
+        stats.outOfNodes += outOfNodes;
+        stats.lastTickIterations = spent;
+        stats.lastTickMs = elapsed;
+        stats.maxTickMs = std::max(stats.maxTickMs, elapsed);
+        stats.parkedPolls = parked.size();
+        lock.unlock();
+        deliver(expired);
+    }
+
+    PathPlannerStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
@@ -0,0 +1,262 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Tick scheduling and crowd update LOD
+// FixedStepScheduler drives the update thread from the real clock: wall time is
+// accumulated and consumed in fixed substeps, with a cap on how many substeps one
+// wake-up may run so a stall is dropped instead of replayed. CrowdLod lowers the
+// steering quality of agents far from every player, so crowd CPU goes where players
+// can actually see the result.
+// ===================================================================================
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+
+#include "DetourCrowd.h"
+#include "pathfinding-shards.h"
+
+struct TickSchedulerStats {
+    float stepSeconds = 0.0f;
+    unsigned long long ticks = 0;           // Wake-ups
+    unsigned long long substeps = 0;        // Fixed steps simulated
+    unsigned long long overruns = 0;        // Steps that took longer than the step itself
+    unsigned long long catchUpTicks = 0;    // Wake-ups that ran more than one substep
+    double droppedMs = 0.0;                 // Wall time discarded by the catch-up cap
+    double lastStepMs = 0.0;
+    double maxStepMs = 0.0;
+    double avgStepMs = 0.0;                 // Exponential moving average
+};
+
+class FixedStepScheduler {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    float stepSeconds;
+    int maxSubsteps;
+    std::atomic<bool> running;
+
+    mutable std::mutex statsMutex;
+    TickSchedulerStats stats;
+
+public:
+    FixedStepScheduler(float step = 0.025f, int maxCatchUpSteps = 4)
+        : stepSeconds(step), maxSubsteps(maxCatchUpSteps), running(false) {
+        stats.stepSeconds = step;
+    }
+
+    // Blocks calling step(stepSeconds) at a fixed rate until stop()
+    void run(const std::function<void(float)>& step) {
+        const auto stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(stepSeconds));
+        running = true;
+        auto previous = Clock::now();
+        Clock::duration accumulator = Clock::duration::zero();
+
+        while (running.load()) {
+            auto now = Clock::now();
+            accumulator += now - previous;
+            previous = now;
+
+            double dropped = 0.0;
+            if (accumulator > stepDuration * maxSubsteps) {
+                dropped = std::chrono::duration<double, std::milli>(accumulator - stepDuration * maxSubsteps).count();
+                accumulator = stepDuration * maxSubsteps;
+            }
+
+            int substeps = 0;
+            double slowest = 0.0, total = 0.0;
+            unsigned long long overruns = 0;
+            while (accumulator >= stepDuration) {
+                auto stepStart = Clock::now();
+                step(stepSeconds);
+                double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - stepStart).count();
+                if (elapsed > stepSeconds * 1000.0) overruns++;
+                slowest = std::max(slowest, elapsed);
+                total += elapsed;
+                accumulator -= stepDuration;
+                substeps++;
+            }
+
+            if (substeps > 0 || dropped > 0.0) {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                stats.ticks++;
+                stats.substeps += substeps;
+                stats.overruns += overruns;
+                if (substeps > 1) stats.catchUpTicks++;
+                stats.droppedMs += dropped;
+                if (substeps > 0) {
+                    double average = total / substeps;
+                    stats.lastStepMs = average;
+                    stats.maxStepMs = std::max(stats.maxStepMs, slowest);
+                    stats.avgStepMs = stats.substeps == (unsigned long long)substeps ? average : stats.avgStepMs * 0.95 + average * 0.05;
+                }
+            }
+
+            std::this_thread::sleep_until(previous + (stepDuration - accumulator));
+        }
+    }
+
+    void stop() {
+        running = false;
+    }
+
+    bool isRunning() const { return running.load(); }
+
+    TickSchedulerStats getStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+};
+
+struct CrowdLodConfig {
+    bool enabled = true;
+    float nearDistance = 80.0f;     // Full steering inside this range of a player
+    float farDistance = 200.0f;     // Minimal steering beyond it
+    int farAvoidanceInterval = 8;   // Far agents run obstacle avoidance one tick in this many
+};
+
+struct CrowdLodStats {
+    size_t nearAgents = 0;
+    size_t midAgents = 0;
+    size_t farAgents = 0;
+    unsigned long long paramUpdates = 0;
+};
+
+// Update thread only, apart from getStats
+class CrowdLod {
+public:
+    enum Level { LOD_NEAR = 0, LOD_MID = 1, LOD_FAR = 2 };
+
+private:
+    struct Agent {
+        unsigned char updateFlags;          // Full-quality steering the agent was added with
+        unsigned char obstacleAvoidanceType;
+        float collisionQueryRange;
+        Level level;
+    };
+
+    CrowdLodConfig config;
+    std::unordered_map<int, Agent> agents;     // crowd handle -> full-quality steering
+    std::mutex playersMutex;
+    std::vector<float> players;                 // x,y,z triplets
+
+    mutable std::mutex statsMutex;
+    CrowdLodStats stats;
+
+    Level classify(const float* pos, Level current, const std::vector<float>& points) const {
+        if (points.empty()) return LOD_NEAR;
+        float best = 3.4e38f;
+        for (size_t i = 0; i + 2 < points.size(); i += 3) {
+            float dx = points[i] - pos[0];
+            float dz = points[i + 2] - pos[2];
+            best = std::min(best, dx * dx + dz * dz);
+        }
+        // 10% hysteresis so agents on a boundary do not flip every tick
+        float nearLimit = config.nearDistance * (current == LOD_NEAR ? 1.1f : 1.0f);
+        float farLimit = config.farDistance * (current == LOD_FAR ? 0.9f : 1.0f);
+        if (best <= nearLimit * nearLimit) return LOD_NEAR;
+        if (best >= farLimit * farLimit) return LOD_FAR;
+        return LOD_MID;
+    }
+
+public:
+    explicit CrowdLod(const CrowdLodConfig& lodConfig = CrowdLodConfig()) : config(lodConfig) {}
+
+    void setConfig(const CrowdLodConfig& lodConfig) { config = lodConfig; }
+
+    // Any thread: positions the distances are measured from
+    void setPlayers(const float* points, size_t count) {
+        std::lock_guard<std::mutex> lock(playersMutex);
+        players.assign(points, points + count * 3);
+    }
+
+    // Call right after addAgent, while the agent still has its full-quality parameters
+    void track(int handle, const dtCrowdAgentParams& params) {
+        agents[handle] = Agent{params.updateFlags, params.obstacleAvoidanceType, params.collisionQueryRange, LOD_NEAR};
+    }
+
+    void untrack(int handle) {
+        agents.erase(handle);
+    }
+
+    void clear() {
+        agents.clear();
+    }
+
+    // Puts back the steering the agent was tracked with, undoing any LOD step-down
+    void fullQuality(int handle, dtCrowdAgentParams& params) const {
+        auto it = agents.find(handle);
+        if (it == agents.end()) return;
+        params.updateFlags = it->second.updateFlags;
+        params.obstacleAvoidanceType = it->second.obstacleAvoidanceType;
+        params.collisionQueryRange = it->second.collisionQueryRange;
+    }
+
+    void migrate(int oldHandle, int newHandle) {
+        auto it = agents.find(oldHandle);
+        if (it == agents.end()) return;
+        Agent agent = it->second;
+        agents.erase(it);
+        agents[newHandle] = agent;
+    }
+
+    // Before crowd.update: pick each agent's level and adjust its steering parameters
+    void apply(ShardedCrowd& crowd, unsigned long long tick) {
+        std::vector<float> points;
+        {
+            std::lock_guard<std::mutex> lock(playersMutex);
+            points = players;
+        }
+
+        size_t counts[3] = {0, 0, 0};
+        unsigned long long paramUpdates = 0;
+        for (auto& entry : agents) {
+            dtCrowdAgent* agent = crowd.getEditableAgent(entry.first);
+            if (!agent || !agent->active) continue;
+            Agent& full = entry.second;
+            full.level = config.enabled ? classify(agent->npos, full.level, points) : LOD_NEAR;
+            counts[full.level]++;
+
+            dtCrowdAgentParams params = agent->params;
+            params.updateFlags = full.updateFlags;
+            params.obstacleAvoidanceType = full.obstacleAvoidanceType;
+            params.collisionQueryRange = full.collisionQueryRange;
+            if (full.level == LOD_MID) {
+                params.updateFlags &= ~DT_CROWD_OPTIMIZE_TOPO;
+                params.obstacleAvoidanceType = std::min<unsigned char>(full.obstacleAvoidanceType, 1);
+            } else if (full.level == LOD_FAR) {
+                params.updateFlags &= ~(DT_CROWD_OPTIMIZE_TOPO | DT_CROWD_OPTIMIZE_VIS);
+                params.obstacleAvoidanceType = 0;
+                params.collisionQueryRange = full.collisionQueryRange * 0.5f;
+                // Staggered by handle so the far agents' avoidance passes spread over the interval
+                int interval = std::max(1, config.farAvoidanceInterval);
+                if ((tick + (unsigned long long)entry.first) % (unsigned long long)interval != 0) {
+                    params.updateFlags &= ~DT_CROWD_OBSTACLE_AVOIDANCE;
+                }
+            }
+
+            if (params.updateFlags != agent->params.updateFlags ||
+                params.obstacleAvoidanceType != agent->params.obstacleAvoidanceType ||
+                params.collisionQueryRange != agent->params.collisionQueryRange) {
+                crowd.updateAgentParameters(entry.first, &params);
+                paramUpdates++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.nearAgents = counts[LOD_NEAR];
+        stats.midAgents = counts[LOD_MID];
+        stats.farAgents = counts[LOD_FAR];
+        stats.paramUpdates += paramUpdates;
+    }
+
+    CrowdLodStats getStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+};
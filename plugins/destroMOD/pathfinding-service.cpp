@@ -8,70 +8,422 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <unordered_map>
 #include <chrono>
 #include <cmath> 
 #include <cstring>
-#include <regex>
+#include <algorithm>
 
 // Your 64-bit Detour headers
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourCrowd.h"
 
-// Simple HTTP server - no external dependencies
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#pragma comment(lib, "ws2_32.lib")
+// Event-loop HTTP server - no external dependencies (Winsock on Windows, epoll on Linux)
+#include "pathfinding-http.h"
+// Single-pass request parser and buffer-reusing JSON writer
+#include "pathfinding-json.h"
+// Binary frames over a Unix socket / loopback TCP, plus the shared-memory agent ring
+#include "pathfinding-ipc.h"
+// TESM and indexed (memory-mapped) navmesh files
+#include "pathfinding-navmesh.h"
+// Optional: keep only the tiles around players and agents resident
+#include "pathfinding-streaming.h"
+// LRU of poly corridors keyed on (start poly, end poly, filter)
+#include "pathfinding-pathcache.h"
+// dtCrowd shards by world region, stepped in parallel
+#include "pathfinding-shards.h"
+// Generation-checked agent handles and the flat agent table behind them
+#include "pathfinding-agents.h"
+// Fixed-step update loop and distance-based steering LOD
+#include "pathfinding-scheduler.h"
+// Short-lived memo of line-of-sight results
+#include "pathfinding-los.h"
+// Ticketed long paths searched a slice at a time on the update thread
+#include "pathfinding-planner.h"
+// Prometheus text metrics with per-thread counters
+#include "pathfinding-metrics.h"
+// Request capture for offline replay
+#include "pathfinding-trace.h"
+// One reverse-Dijkstra field per chased target, shared by all of its chasers
+#include "pathfinding-flowfield.h"
+// Per-tick agent state deltas for chunked /agentStream subscribers
+#include "pathfinding-agentstream.h"
+// Player grid for nearest-target picks
+#include "pathfinding-targets.h"
+// Constructions and vehicles marked onto the navmesh as dynamic obstacles
+#include "pathfinding-obstacles.h"
+// Crowd save/restore file format
+#include "pathfinding-crowdstate.h"
+
+// Pool of dtNavMeshQuery instances for read-only queries. Each query object owns its
+// node pool and open list, so two threads must never run searches on the same one.
+class NavQueryPool {
+private:
+    std::vector<dtNavMeshQuery*> queries;
+    std::vector<dtNavMeshQuery*> freeQueries;
+    std::mutex mutex;
+    std::condition_variable available;
+    int maxNodes = 0;
+    
+public:
+    class Lease {
+    private:
+        NavQueryPool* pool;
+        dtNavMeshQuery* query;
+        
+    public:
+        Lease(NavQueryPool* owner, dtNavMeshQuery* leased) : pool(owner), query(leased) {}
+        Lease(Lease&& other) : pool(other.pool), query(other.query) { other.query = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (query) pool->release(query); }
+        
+        dtNavMeshQuery* operator->() const { return query; }
+        dtNavMeshQuery* get() const { return query; }
+    };
+    
+    ~NavQueryPool() {
+        clear();
+    }
+    
+    bool init(const dtNavMesh* nav, int count, int queryMaxNodes) {
+        clear();
+        maxNodes = queryMaxNodes;
+        for (int i = 0; i < count; i++) {
+            dtNavMeshQuery* query = dtAllocNavMeshQuery();
+            if (!query || dtStatusFailed(query->init(nav, maxNodes))) {
+                if (query) dtFreeNavMeshQuery(query);
+                return false;
+            }
+            queries.push_back(query);
+            freeQueries.push_back(query);
+        }
+        return true;
+    }
+    
+    // Blocks while every query is leased out
+    Lease acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this]() { return !freeQueries.empty(); });
+        dtNavMeshQuery* query = freeQueries.back();
+        freeQueries.pop_back();
+        return Lease(this, query);
+    }
+    
+    int size() const { return (int)queries.size(); }
+    
+    // Points every query at a new navmesh. The caller holds the navmesh exclusively; queries
+    // are only leased under the shared lock, so none is in use.
+    bool rebind(const dtNavMesh* nav) {
+        for (auto* query : queries) {
+            if (dtStatusFailed(query->init(nav, maxNodes))) return false;
+        }
+        return true;
+    }
+    
+    void clear() {
+        for (auto* query : queries) dtFreeNavMeshQuery(query);
+        queries.clear();
+        freeQueries.clear();
+    }
+    
+private:
+    void release(dtNavMeshQuery* query) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeQueries.push_back(query);
+        }
+        available.notify_one();
+    }
+};
 
 class PathfindingService {
+public:
+    enum class CommandOp { Add, Remove, SetTarget, Stop, ForceStop, Chase };
+    
+    struct CrowdCommand {
+        CommandOp op = CommandOp::Add;
+        std::string npcId;
+        float pos[3] = {0.0f, 0.0f, 0.0f};     // Add: spawn position, SetTarget/Chase: target position
+        float brakeForce = 0.0f;                // ForceStop only
+        std::string targetId;   // Chase only: agents with the same targetId share one flow field
+        AgentHandle handle = AGENT_HANDLE_NONE;    // Addresses the agent instead of npcId when set (not for Add)
+    };
+    
+    struct AgentState {
+        std::string npcId;
+        AgentHandle handle;
+        float pos[3];
+        float vel[3];
+        float targetPos[3];
+        int targetState;
+        bool atTarget;
+    };
+    
+    struct NavMeshReloadStats {
+        bool reloading = false;
+        unsigned long long reloads = 0;
+        unsigned long long failures = 0;
+        double lastLoadMs = 0.0;        // Building the new navmesh, on the reload thread
+        double lastSwapMs = 0.0;        // Navmesh held exclusively while agents were carried over
+        size_t lastCarried = 0;
+        size_t lastDropped = 0;         // Agents with no navmesh under them after the swap
+    };
+    
+    struct PathResult {
+        bool found = false;
+        bool partial = false;       // Corridor stops short of the end poly
+        bool cached = false;        // Corridor came from the path cache
+        std::vector<float> points;  // Straight path, x,y,z triplets
+    };
+    
 private:
+    struct BatchResult {
+        unsigned long long tick;
+        std::vector<bool> results;
+        std::vector<AgentHandle> handles;   // Agent each command addressed, AGENT_HANDLE_NONE where it failed
+    };
+    
+    struct PendingBatch {
+        std::vector<CrowdCommand> commands;
+        std::promise<BatchResult> done;
+    };
+    
+    // Immutable per-tick view of the crowd, swapped in atomically by the update thread
+    struct CrowdSnapshot {
+        unsigned long long tick;
+        std::vector<AgentState> agents;
+        AgentIdIndex index;         // npcId -> position in agents
+        std::vector<int> bySlot;    // Agent table slot -> position in agents, -1 = none
+    };
+    
+    // A navmesh with whatever backs its tiles, as loadNavMesh builds it. Freed streamer first,
+    // then the mesh, then the mapping its tiles point into. Until it is served, its streamer
+    // locks stagingMutex, so filling it never holds off the queries on the served one.
+    struct LoadedNavMesh {
+        std::shared_mutex stagingMutex;
+        dtNavMesh* navMesh = nullptr;
+        std::shared_ptr<IndexedNavMeshFile> file;
+        std::unique_ptr<TileStreamer> streamer;
+        
+        ~LoadedNavMesh() {
+            streamer.reset();
+            if (navMesh) dtFreeNavMesh(navMesh);
+            file.reset();
+        }
+    };
+    
+    // Zone this service is in a ZoneHost, and what it shares with the other zones there
+    std::string zoneKey;
+    int zoneIndex;
+    NavMeshFileCache* navMeshFiles;
+    ShardWorkerPool* sharedWorkers;
+    
     dtNavMesh* navMesh;
-    dtNavMeshQuery* navQuery;
-    dtCrowd* crowd;
-    std::map<std::string, int> agentMap;
+    std::shared_ptr<IndexedNavMeshFile> navMeshFile;   // Backs navMesh tiles when loaded from the indexed format
+    std::string navMeshPath;
+    NavQueryPool queryPool;
+    
+    // Hot reload: the reload thread builds the next navmesh and parks it in reloadReady; the
+    // update thread swaps it in at a tick boundary and hands the old one back in reloadRetired
+    // for the reload thread to free
+    std::thread reloadThread;
+    std::mutex reloadMutex;
+    std::condition_variable reloadSignal;
+    std::unique_ptr<LoadedNavMesh> reloadReady;
+    std::unique_ptr<LoadedNavMesh> reloadRetired;
+    std::atomic<bool> reloadPending;
+    bool reloadCancelled;
+    NavMeshReloadStats reloadStats;
+    unsigned long long generationBase;  // Keeps tileGeneration() rising across reloads, whose streamers count from 0
+    
+    // Tile streaming swaps tiles under the exclusive lock; every navmesh reader holds it shared
+    std::shared_mutex navMeshMutex;
+    TileStreamingConfig streamingConfig;
+    std::unique_ptr<TileStreamer> tileStreamer;
+    ShardedCrowd crowd;
+    int maxAgents;
+    int crowdShards;
+    dtQueryFilter queryFilter;
+    
+    // Owned by the update thread: only drainCommands/update touch crowd and agents.
+    // Slots hold crowd handles, which change when an agent migrates to another shard.
+    AgentTable agents;
+    unsigned long long tickIndex;
+    
+    // Crowd mutations from request threads, applied at the next tick boundary
+    std::mutex commandMutex;
+    std::vector<std::shared_ptr<PendingBatch>> pendingBatches;
+    bool loopActive;                // Guarded by commandMutex: runUpdateLoop drains the queues
+    std::mutex tickMutex;           // Held while stepping or draining the crowd, by the loop or inline
+    
+    // Whole-crowd jobs from request threads (state save and restore), run at the next tick boundary
+    std::mutex jobMutex;
+    std::vector<std::function<void()>> updateJobs;
     
-    static const int MAX_AGENTS = 50;
+    // Crowd state files; autosaved every crowdStateSeconds once startCrowdAutosave was called
+    std::string crowdStatePath;
+    std::thread autosaveThread;
+    std::mutex autosaveMutex;
+    std::condition_variable autosaveSignal;
+    bool autosaveRunning;
+    std::mutex crowdStateStatsMutex;
+    CrowdStateStats crowdStateStats;
+    CrowdState carried;                 // Update thread only: the crowd while a reload swaps the navmesh
+    
+    std::shared_ptr<const CrowdSnapshot> snapshot;
+    
+    // Optional: per-tick agent state published to shared memory
+    SharedAgentRing* agentRing;
+    
+    // Optional: per-tick delta frames for push subscribers, handed to agentStreamSink
+    AgentStreamEncoder agentStream;
+    std::mutex agentStreamMutex;
+    std::function<bool()> agentStreamWanted;
+    std::function<void(const std::string&, bool)> agentStreamSink;
+    
+    static const int DEFAULT_MAX_AGENTS = 256;
+    static constexpr float CROWD_REGION_SIZE = 512.0f;
     static const int MAX_PATH_POINTS = 256;
+    static const int QUERY_MAX_NODES = 2048;
+    static const int FLOW_FIELD_MAX_POLYS = 4096;
+    static constexpr float FLOW_FIELD_MAX_DISTANCE = 400.0f;
+    static const int PATH_CACHE_ENTRIES = 1024;
+    static constexpr float LOS_MEMO_THRESHOLD = 1.0f;  // Max movement of either end before a memoized result is recomputed
+    static const int LOS_MEMO_TICKS = 4;
+    static const int LOS_MEMO_ENTRIES = 16384;
+    static const int LOS_CHUNK = 32;                    // Pairs (or origins) per worker job
+    static const int PLANNER_SEARCHES = 4;              // Concurrent sliced searches
+    static const int PLANNER_MAX_NODES = 16384;         // Per search leg
+    static const int PLANNER_MAX_POLYS = 8192;          // Longest corridor handed out
+    static const int PLANNER_MAX_LEGS = 16;
+    static const int PLANNER_ITERATIONS_PER_TICK = 2000;
+    static const int PLANNER_RESULT_SECONDS = 30;       // Uncollected results are dropped after this
+    static const int PLANNER_MAX_WAIT_MS = 5000;        // Longest long-poll
+    static constexpr float PLAYER_GRID_CELL = 32.0f;
+    static const int TARGET_LOS_CANDIDATES = 4;         // Nearest players tried per query before giving up on line of sight
+    
+    // Update thread only
+    FlowFieldRouter flowFields;
+    std::unordered_map<int, dtPolyRef> pathHarvest;  // Agents whose crowd path request is in flight -> target poly
+    
+    PathCache pathCache;
+    
+    FixedStepScheduler scheduler;
+    CrowdLod lod;
+    
+    // Batch line of sight: one batch at a time fans out (over sharedWorkers when set),
+    // concurrent ones run on their own thread
+    LosMemo losMemo;
+    ShardWorkerPool losWorkers;
+    std::mutex losFanOutMutex;
+    std::mutex losStatsMutex;
+    LosStats losStats;
+    
+    SlicedPathPlanner planner;
+    
+    // Targetable players, replaced whole by setPlayers
+    std::shared_ptr<const PlayerGrid> players;
+    
+    ObstacleOverlay obstacles;
+    
+    ServiceMetrics metrics;
+    
+    TraceWriter trace;
+    std::string capturePath;
+    static const int TRACE_SNAPSHOT_TICKS = 40;         // Agent positions in the trace once a second
     
 public:
-    PathfindingService() : navMesh(nullptr), navQuery(nullptr), crowd(nullptr) {}
+    PathfindingService() : zoneIndex(0), navMeshFiles(nullptr), sharedWorkers(nullptr), navMesh(nullptr), reloadPending(false), reloadCancelled(false), generationBase(0),
+                           maxAgents(DEFAULT_MAX_AGENTS), crowdShards(0), tickIndex(0), loopActive(false),
+                           crowdStatePath("pathfinding-crowd.state"), autosaveRunning(false), agentRing(nullptr),
+                           flowFields(FLOW_FIELD_MAX_POLYS, FLOW_FIELD_MAX_DISTANCE, MAX_PATH_POINTS),
+                           pathCache(PATH_CACHE_ENTRIES),
+                           losMemo(LOS_MEMO_THRESHOLD, LOS_MEMO_TICKS, LOS_MEMO_ENTRIES),
+                           planner(PLANNER_MAX_POLYS, PLANNER_MAX_LEGS),
+                           capturePath("pathfinding-capture.trace") {
+        snapshot = std::make_shared<CrowdSnapshot>();
+        players = std::make_shared<PlayerGrid>(PLAYER_GRID_CELL);
+    }
     
     ~PathfindingService() {
         cleanup();
     }
     
-    bool initialize(const std::string& navmeshPath) {
+    // queryThreads: number of pooled dtNavMeshQuery objects (0 = one per hardware thread)
+    bool initialize(const std::string& navmeshPath, int queryThreads = 0) {
         std::cout << "[PathfindingService] Loading 64-bit navmesh from: " << navmeshPath << std::endl;
         
-        if (!loadNavMesh(navmeshPath)) {
+        LoadedNavMesh loaded;
+        if (!loadNavMesh(navmeshPath, loaded)) {
             std::cerr << "[PathfindingService] Failed to load navmesh" << std::endl;
             return false;
         }
+        std::swap(navMesh, loaded.navMesh);
+        std::swap(navMeshFile, loaded.file);
+        std::swap(tileStreamer, loaded.streamer);
+        if (tileStreamer) tileStreamer->rebindMutex(navMeshMutex);
+        navMeshPath = navmeshPath;
         
-        navQuery = dtAllocNavMeshQuery();
-        if (!navQuery->init(navMesh, 2048)) {
+        if (queryThreads <= 0) {
+            queryThreads = (int)std::thread::hardware_concurrency();
+            if (queryThreads < 2) queryThreads = 2;
+        }
+        if (!queryPool.init(navMesh, queryThreads, QUERY_MAX_NODES)) {
             std::cerr << "[PathfindingService] Failed to init navmesh query" << std::endl;
             return false;
         }
+        if (!sharedWorkers) losWorkers.start(queryThreads - 1);
+        if (!planner.init(navMesh, PLANNER_SEARCHES, PLANNER_MAX_NODES)) {
+            std::cerr << "[PathfindingService] Failed to init path planner" << std::endl;
+            return false;
+        }
         
-        crowd = dtAllocCrowd();
-        if (!crowd->init(MAX_AGENTS, 0.6f, navMesh)) {
+        if (crowdShards <= 0) {
+            crowdShards = (int)std::thread::hardware_concurrency() / 2;
+            if (crowdShards < 1) crowdShards = 1;
+            if (crowdShards > 8) crowdShards = 8;
+        }
+        if (!crowd.init(crowdShards, maxAgents, 0.6f, navMesh, CROWD_REGION_SIZE, sharedWorkers)) {
             std::cerr << "[PathfindingService] Failed to init crowd" << std::endl;
             return false;
         }
+        agents.reserve(maxAgents, maxAgents * crowdShards);
+        std::cout << "[PathfindingService] Crowd: " << maxAgents << " agents over " << crowdShards << " shards" << std::endl;
+        
+        // One filter for every query and crowd shard, so obstacle marks mean the same everywhere
+        ObstacleOverlay::configureFilter(queryFilter);
+        configureCrowd();
         
-        std::cout << "[PathfindingService] 64-bit pathfinding service ready!" << std::endl;
+        if (tileStreamer) {
+            tileStreamer->start();
+            std::cout << "[PathfindingService] Streaming tiles within " << streamingConfig.radius << " units of players and agents ("
+                      << streamingConfig.budgetBytes / (1024 * 1024) << " MB budget)" << std::endl;
+        }
+        
+        std::cout << "[PathfindingService] 64-bit pathfinding service ready! (" << queryThreads << " pooled queries)" << std::endl;
         return true;
     }
     
+    // ---- Read-only queries: safe from any thread, run in parallel on pooled queries ----
+    
     std::vector<float> getClosestNavPoint(float x, float y, float z) {
         const float pos[3] = {x, y, z};
         const float extents[3] = {10.0f, 10.0f, 10.0f};
         dtPolyRef nearestRef;
         float nearestPt[3];
         
-        dtStatus status = navQuery->findNearestPoly(pos, extents, &dtQueryFilter(), &nearestRef, nearestPt);
+        std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        auto navQuery = queryPool.acquire();
+        dtStatus status = navQuery->findNearestPoly(pos, extents, &queryFilter, &nearestRef, nearestPt);
         if (dtStatusSucceed(status) && nearestRef) {
             return {nearestPt[0], nearestPt[1], nearestPt[2]};
         }
@@ -79,63 +431,1134 @@ public:
     }
     
     bool hasLineOfSight(float startX, float startY, float startZ, float endX, float endY, float endZ) {
-        const float start[3] = {startX, startY, startZ};
-        const float end[3] = {endX, endY, endZ};
-        dtPolyRef startRef;
-        float startPt[3];
-        float extents[3] = {20.0f, 10.0f, 20.0f};
+        const float pair[6] = {startX, startY, startZ, endX, endY, endZ};
+        std::vector<uint8_t> visible;
+        hasLineOfSightBatch(pair, 1, visible);
+        return (visible[0] & 1) != 0;
+    }
+    
+    // pairs: count * (start x,y,z, end x,y,z). Bit i of visible (LSB first) is set when pair i
+    // has line of sight; like the single query, a start off the navmesh counts as visible.
+    // Results are memoized for a few ticks; start polys are looked up once per distinct origin.
+    void hasLineOfSightBatch(const float* pairs, size_t count, std::vector<uint8_t>& visible) {
+        visible.assign((count + 7) / 8, 0);
+        if (count == 0) return;
+        
+        std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        const unsigned long long tick = std::atomic_load(&snapshot)->tick;
+        const unsigned long long generation = tileGeneration();
+        
+        std::vector<uint8_t> resolved(count, 0);
+        size_t memoHits = losMemo.lookup(pairs, count, tick, generation, resolved);
+        
+        // Distinct origins among the pairs still to compute
+        std::vector<size_t> pending;
+        std::vector<int> pairOrigin(count, -1);
+        std::vector<const float*> origins;
+        std::unordered_map<uint64_t, int> originIndex;
+        for (size_t i = 0; i < count; i++) {
+            if (resolved[i]) continue;
+            pending.push_back(i);
+            const float* start = pairs + i * 6;
+            uint32_t bits[3];
+            memcpy(bits, start, sizeof(bits));
+            uint64_t key = ((uint64_t)bits[0] * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)bits[1] << 21) ^ ((uint64_t)bits[2] * 0xC2B2AE3D27D4EB4FULL);
+            auto it = originIndex.find(key);
+            if (it == originIndex.end() || memcmp(origins[it->second], start, sizeof(float) * 3) != 0) {
+                originIndex[key] = (int)origins.size();
+                pairOrigin[i] = (int)origins.size();
+                origins.push_back(start);
+            } else {
+                pairOrigin[i] = it->second;
+            }
+        }
+        
+        if (!pending.empty()) {
+            std::vector<dtPolyRef> originRefs(origins.size(), 0);
+            std::vector<float> originPoints(origins.size() * 3);
+            const float extents[3] = {20.0f, 10.0f, 20.0f};
+            
+            auto findOrigins = [&](size_t begin, size_t end, dtNavMeshQuery* navQuery) {
+                for (size_t o = begin; o < end; o++) {
+                    navQuery->findNearestPoly(origins[o], extents, &queryFilter, &originRefs[o], &originPoints[o * 3]);
+                }
+            };
+            auto castRays = [&](size_t begin, size_t end, dtNavMeshQuery* navQuery) {
+                float t, hitNormal[3];
+                dtPolyRef path[32];
+                for (size_t p = begin; p < end; p++) {
+                    size_t i = pending[p];
+                    int origin = pairOrigin[i];
+                    if (!originRefs[origin]) {
+                        resolved[i] = 1;
+                        continue;
+                    }
+                    int pathCount = 0;
+                    dtStatus status = navQuery->raycast(originRefs[origin], &originPoints[origin * 3], pairs + i * 6 + 3, &queryFilter,
+                                                        &t, hitNormal, path, &pathCount, 32);
+                    resolved[i] = dtStatusSucceed(status) && t >= 1.0f ? 1 : 2;
+                }
+            };
+            
+            bool parallel = pending.size() > (size_t)LOS_CHUNK && losFanOutMutex.try_lock();
+            if (parallel) {
+                std::lock_guard<std::mutex> fanOut(losFanOutMutex, std::adopt_lock);
+                runChunked(origins.size(), findOrigins);
+                runChunked(pending.size(), castRays);
+            } else {
+                auto navQuery = queryPool.acquire();
+                findOrigins(0, origins.size(), navQuery.get());
+                castRays(0, pending.size(), navQuery.get());
+            }
+            
+            std::vector<uint8_t> computed(count, 0);
+            for (size_t i : pending) computed[i] = 1;
+            losMemo.store(pairs, count, computed, resolved, tick, generation);
+            
+            std::lock_guard<std::mutex> lock(losStatsMutex);
+            losStats.startLookups += origins.size();
+            losStats.raycasts += pending.size();
+            if (parallel) losStats.parallelBatches++;
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            if (resolved[i] == 1) visible[i >> 3] |= (uint8_t)(1u << (i & 7));
+        }
         
-        dtStatus status = navQuery->findNearestPoly(start, extents, &dtQueryFilter(), &startRef, startPt);
-        if (dtStatusFailed(status) || !startRef) return true;
+        std::lock_guard<std::mutex> lock(losStatsMutex);
+        losStats.batches++;
+        losStats.pairs += count;
+        losStats.memoHits += memoHits;
+    }
+    
+    // Replaces the players that findNearestTargets picks from; points is count * x,y,z
+    void setPlayers(const std::vector<std::string_view>& ids, const float* points, size_t count) {
+        auto next = std::make_shared<PlayerGrid>(PLAYER_GRID_CELL);
+        next->build(ids, points, count);
+        std::atomic_store(&players, std::shared_ptr<const PlayerGrid>(next));
+    }
+    
+    struct TargetMatch {
+        int player;         // Into the grid returned alongside, -1 = none in range
+        float distance;
+    };
+    
+    // queries: count * (x, y, z, radius). For each, the nearest player within radius; with
+    // lineOfSight, the nearest of the TARGET_LOS_CANDIDATES closest that a navmesh raycast
+    // from the query point reaches. Raycasts for every query go out together, one round per
+    // candidate rank, through the memoized batch. Returns the grid the indices refer to.
+    std::shared_ptr<const PlayerGrid> findNearestTargets(const float* queries, size_t count, bool lineOfSight, std::vector<TargetMatch>& matches) {
+        auto grid = std::atomic_load(&players);
+        matches.assign(count, TargetMatch{-1, 0.0f});
+        
+        const size_t perQuery = lineOfSight ? TARGET_LOS_CANDIDATES : 1;
+        std::vector<std::pair<float, int>> hits;
+        std::vector<std::pair<float, int>> candidates(count * perQuery, std::make_pair(0.0f, -1));
+        for (size_t q = 0; q < count; q++) {
+            grid->query(queries + q * 4, queries[q * 4 + 3], perQuery, hits);
+            std::copy(hits.begin(), hits.end(), candidates.begin() + q * perQuery);
+        }
+        if (!lineOfSight) {
+            for (size_t q = 0; q < count; q++) matches[q] = TargetMatch{candidates[q].second, candidates[q].first};
+            return grid;
+        }
         
-        float t;
-        float hitNormal[3];
-        dtPolyRef path[32];
+        std::vector<float> pairs;
+        std::vector<size_t> asking;
+        std::vector<uint8_t> visible;
+        for (size_t rank = 0; rank < perQuery; rank++) {
+            pairs.clear();
+            asking.clear();
+            for (size_t q = 0; q < count; q++) {
+                const auto& candidate = candidates[q * perQuery + rank];
+                if (matches[q].player >= 0 || candidate.second < 0) continue;
+                pairs.insert(pairs.end(), queries + q * 4, queries + q * 4 + 3);
+                const float* target = grid->position(candidate.second);
+                pairs.insert(pairs.end(), target, target + 3);
+                asking.push_back(q);
+            }
+            if (asking.empty()) break;
+            hasLineOfSightBatch(pairs.data(), asking.size(), visible);
+            for (size_t i = 0; i < asking.size(); i++) {
+                if (!(visible[i >> 3] & (1u << (i & 7)))) continue;
+                const auto& candidate = candidates[asking[i] * perQuery + rank];
+                matches[asking[i]] = TargetMatch{candidate.second, candidate.first};
+            }
+        }
+        return grid;
+    }
+    
+    // Applied at the next tick boundary, all queued changes in one go; adding an id that
+    // exists moves that obstacle
+    void addObstacle(const ObstacleSpec& spec) {
+        obstacles.add(spec);
+    }
+    
+    void removeObstacle(const std::string& id) {
+        obstacles.remove(id);
+    }
+    
+    ObstacleStats getObstacleStats() const {
+        return obstacles.getStats();
+    }
+    
+    LosStats getLosStats() {
+        std::lock_guard<std::mutex> lock(losStatsMutex);
+        LosStats stats = losStats;
+        stats.memoEntries = losMemo.size();
+        return stats;
+    }
+    
+    // Corridors come from pathCache when both endpoints land on polys seen before; only the
+    // straight path is rebuilt for the exact endpoints then
+    bool findPath(const float* start, const float* end, PathResult& result) {
+        const float extents[3] = {10.0f, 10.0f, 10.0f};
+        dtPolyRef startRef = 0, endRef = 0;
+        float startPt[3], endPt[3];
+        result = PathResult();
+        
+        std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        auto navQuery = queryPool.acquire();
+        navQuery->findNearestPoly(start, extents, &queryFilter, &startRef, startPt);
+        navQuery->findNearestPoly(end, extents, &queryFilter, &endRef, endPt);
+        
+        if (!startRef || !endRef) return false;
+        
+        const PathCacheKey key = { startRef, endRef, PATH_FILTER_DEFAULT };
+        const unsigned long long generation = tileGeneration();
+        thread_local std::vector<dtPolyRef> path;
         int pathCount = 0;
+        if (pathCache.lookup(key, generation, path)) {
+            pathCount = (int)path.size();
+            result.cached = true;
+        } else {
+            path.resize(MAX_PATH_POINTS);
+            dtStatus status = navQuery->findPath(startRef, endRef, startPt, endPt, &queryFilter, path.data(), &pathCount, MAX_PATH_POINTS);
+            if (dtStatusDetail(status, DT_OUT_OF_NODES)) metrics.count(ServiceMetrics::FIND_PATH_OUT_OF_NODES);
+            if (pathCount == 0) return false;
+            pathCache.store(key, generation, path.data(), pathCount);
+        }
         
-        status = navQuery->raycast(startRef, startPt, end, &dtQueryFilter(), &t, hitNormal, path, &pathCount, 32);
+        // A partial corridor ends wherever the search got closest; aim at that poly instead
+        result.partial = path[pathCount - 1] != endRef;
+        if (result.partial) navQuery->closestPointOnPoly(path[pathCount - 1], endPt, endPt, nullptr);
         
-        return dtStatusSucceed(status) && t >= 1.0f;
+        float straightPath[MAX_PATH_POINTS * 3];
+        int straightPathCount = 0;
+        navQuery->findStraightPath(startPt, endPt, path.data(), pathCount, straightPath, nullptr, nullptr, &straightPathCount, MAX_PATH_POINTS);
+        if (straightPathCount <= 0) return false;
+        
+        result.points.assign(straightPath, straightPath + straightPathCount * 3);
+        result.found = true;
+        return true;
     }
-
-    bool setNPCTarget(const std::string& npcId, float targetX, float targetY, float targetZ) {
-    auto it = agentMap.find(npcId);
-    if (it == agentMap.end()) return false;
     
-    int agentIndex = it->second;
-    const dtCrowdAgent* agent = crowd->getAgent(agentIndex);
-    if (!agent || !agent->active) return false;
-
-    // CRITICAL FIX: Reset the current move target first
-    crowd->resetMoveTarget(agentIndex);
+    // NEW: Queue a path search of any length; the ticket is polled with pollPath
+    unsigned long long requestPath(const float* start, const float* end) {
+        return planner.request(start, end);
+    }
     
-    const float targetPos[3] = {targetX, targetY, targetZ};
-    dtPolyRef targetRef;
-    float nearestPt[3];
-    const float extents[3] = {20.0f, 10.0f, 20.0f};
+    // Waits up to waitMs (capped) for the ticket; a finished result is returned only once
+    // Without an update loop nothing advances the planner, so a wait would only sleep
+    PathTicketState pollPath(unsigned long long ticket, int waitMs, PathTicketResult& result) {
+        if (!isUpdateLoopRunning()) waitMs = 0;
+        return planner.poll(ticket, std::min(std::max(waitMs, 0), PLANNER_MAX_WAIT_MS), result);
+    }
     
-    dtStatus status = navQuery->findNearestPoly(targetPos, extents, &dtQueryFilter(), &targetRef, nearestPt);
-    if (dtStatusSucceed(status) && targetRef) {
-        return dtStatusSucceed(crowd->requestMoveTarget(agentIndex, targetRef, nearestPt));
+    // Like pollPath, but parks the wait instead of blocking: done runs once the ticket
+    // finishes or waitMs is up, on the update thread (see SlicedPathPlanner::pollAsync)
+    void pollPathAsync(unsigned long long ticket, int waitMs, PathPollCallback done) {
+        if (!isUpdateLoopRunning()) waitMs = 0;
+        planner.pollAsync(ticket, std::min(std::max(waitMs, 0), PLANNER_MAX_WAIT_MS), std::move(done));
+    }
+    
+    PathPlannerStats getPlannerStats() const { return planner.getStats(); }
+    
+    std::vector<std::vector<float>> testNavMesh(float startX, float startY, float startZ, float endX, float endY, float endZ) {
+        const float start[3] = {startX, startY, startZ};
+        const float end[3] = {endX, endY, endZ};
+        PathResult path;
+        if (!findPath(start, end, path)) return {};
+        
+        std::vector<std::vector<float>> result;
+        for (size_t i = 0; i + 2 < path.points.size(); i += 3) {
+            result.push_back({path.points[i], path.points[i + 1], path.points[i + 2]});
+        }
+        return result;
+    }
+    
+    // ---- Crowd mutations: queued and applied by the update thread at the next tick boundary ----
+    // Each takes either the npc id or the AgentHandle addAggroedNPC returned; a handle skips
+    // the string lookup and fails once its agent has been removed.
+    
+    bool setNPCTarget(const std::string& npcId, float targetX, float targetY, float targetZ) {
+        CrowdCommand command = { CommandOp::SetTarget, npcId, {targetX, targetY, targetZ}, 0.0f, std::string(), AGENT_HANDLE_NONE };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    bool setNPCTarget(AgentHandle handle, float targetX, float targetY, float targetZ) {
+        CrowdCommand command = { CommandOp::SetTarget, std::string(), {targetX, targetY, targetZ}, 0.0f, std::string(), handle };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
     }
-    return false;
-}
     
     // ENHANCED: Original stopNPC with immediate velocity zeroing
     bool stopNPC(const std::string& npcId) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return false;
+        CrowdCommand command = { CommandOp::Stop, npcId, {0.0f, 0.0f, 0.0f}, 0.0f, std::string(), AGENT_HANDLE_NONE };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    bool stopNPC(AgentHandle handle) {
+        CrowdCommand command = { CommandOp::Stop, std::string(), {0.0f, 0.0f, 0.0f}, 0.0f, std::string(), handle };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    // NEW: Force stop with immediate velocity zeroing and brake force
+    bool forceStopNPC(const std::string& npcId, float brakeForce = 10.0f) {
+        CrowdCommand command = { CommandOp::ForceStop, npcId, {0.0f, 0.0f, 0.0f}, brakeForce, std::string(), AGENT_HANDLE_NONE };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    bool forceStopNPC(AgentHandle handle, float brakeForce = 10.0f) {
+        CrowdCommand command = { CommandOp::ForceStop, std::string(), {0.0f, 0.0f, 0.0f}, brakeForce, std::string(), handle };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    // ENHANCED: addAggroedNPC with better collision avoidance parameters.
+    // Returns the new agent's handle, AGENT_HANDLE_NONE on failure; re-adding an id replaces its agent.
+    AgentHandle addAggroedNPC(const std::string& npcId, float x, float y, float z) {
+        CrowdCommand command = { CommandOp::Add, npcId, {x, y, z}, 0.0f, std::string(), AGENT_HANDLE_NONE };
+        return submitCommand(command);
+    }
+    
+    bool removeAggroedNPC(const std::string& npcId) {
+        CrowdCommand command = { CommandOp::Remove, npcId, {0.0f, 0.0f, 0.0f}, 0.0f, std::string(), AGENT_HANDLE_NONE };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    bool removeAggroedNPC(AgentHandle handle) {
+        CrowdCommand command = { CommandOp::Remove, std::string(), {0.0f, 0.0f, 0.0f}, 0.0f, std::string(), handle };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    // NEW: Like setNPCTarget, but every agent chasing the same targetId steers from one shared flow field
+    bool chaseTarget(const std::string& npcId, const std::string& targetId, float targetX, float targetY, float targetZ) {
+        CrowdCommand command = { CommandOp::Chase, npcId, {targetX, targetY, targetZ}, 0.0f, targetId, AGENT_HANDLE_NONE };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    bool chaseTarget(AgentHandle handle, const std::string& targetId, float targetX, float targetY, float targetZ) {
+        CrowdCommand command = { CommandOp::Chase, std::string(), {targetX, targetY, targetZ}, 0.0f, targetId, handle };
+        return submitCommand(command) != AGENT_HANDLE_NONE;
+    }
+    
+    // NEW: Apply an ordered list of crowd mutations with no crowd->update in between.
+    // Blocks until the update thread has drained it at the next tick boundary; without a
+    // running update loop (tools, benches, startup) it is drained right here.
+    // handles, when given, receives the agent each command addressed (the new one for adds).
+    std::vector<bool> applyBatch(const std::vector<CrowdCommand>& commands, unsigned long long& tick,
+                                 std::vector<AgentHandle>* handles = nullptr) {
+        auto batch = std::make_shared<PendingBatch>();
+        batch->commands = commands;
+        std::future<BatchResult> done = batch->done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            pendingBatches.push_back(batch);
+        }
+        drainIfIdle();
+        
+        BatchResult result = done.get();
+        tick = result.tick;
+        if (handles) handles->swap(result.handles);
+        return result.results;
+    }
+    
+    // ---- Agent state: read from the last published snapshot, never from the live crowd ----
+    
+    // NEW: Check if agent is at target destination
+    // Agent: npc id or AgentHandle
+    template <typename Agent>
+    bool isAgentAtTarget(const Agent& agent, float threshold = 2.0f) {
+        auto current = std::atomic_load(&snapshot);
+        const AgentState* state = findAgentState(*current, agent);
+        return state && isAtTarget(*state, threshold);
+    }
+    
+    template <typename Agent>
+    std::vector<float> getAgentPosition(const Agent& agent) {
+        auto current = std::atomic_load(&snapshot);
+        const AgentState* state = findAgentState(*current, agent);
+        if (!state) return {};
+        return {state->pos[0], state->pos[1], state->pos[2]};
+    }
+    
+    template <typename Agent>
+    std::vector<float> getAgentVelocity(const Agent& agent) {
+        auto current = std::atomic_load(&snapshot);
+        const AgentState* state = findAgentState(*current, agent);
+        if (!state) return {};
+        return {state->vel[0], state->vel[1], state->vel[2]};
+    }
+    
+    // NEW: One-shot state of every agent (or only the requested ids or handles), taken between two crowd updates
+    template <typename Agent>
+    std::vector<AgentState> getAgentStates(const std::vector<Agent>& agentKeys, unsigned long long& tick, float threshold = 2.0f) {
+        auto current = std::atomic_load(&snapshot);
+        tick = current->tick;
         
-        int agentIndex = it->second;
-        const dtCrowdAgent* agent = crowd->getAgent(agentIndex);
+        std::vector<AgentState> result;
+        if (agentKeys.empty()) {
+            result = current->agents;
+        } else {
+            result.reserve(agentKeys.size());
+            for (const auto& agent : agentKeys) {
+                const AgentState* state = findAgentState(*current, agent);
+                if (state) result.push_back(*state);
+            }
+        }
+        for (auto& state : result) state.atTarget = isAtTarget(state, threshold);
+        return result;
+    }
+    
+    // Update thread only: apply queued mutations, step the crowd, publish the new state
+    void update(float deltaTime = 0.025f) {
+        std::lock_guard<std::mutex> tickLock(tickMutex);
+        if (!crowd.isReady()) {
+            // Nothing to step, but queued requests still get their (failed) answers
+            std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+            drainCommands();
+            runUpdateJobs();
+            return;
+        }
+        auto tickStart = std::chrono::steady_clock::now();
+        if (reloadPending.load()) swapReloadedNavMesh();
+        applyObstacles();
+        {
+            std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+            drainCommands();
+            runUpdateJobs();
+            lod.apply(crowd, tickIndex);
+            {
+                auto navQuery = queryPool.acquire();
+                flowFields.update(crowd, navQuery.get(), &queryFilter, tileGeneration());
+            }
+            auto crowdStart = std::chrono::steady_clock::now();
+            crowd.update(deltaTime);
+            metrics.recordCrowdUpdate(std::chrono::steady_clock::now() - crowdStart);
+            migrateAgents();
+            harvestCrowdPaths();
+            planner.update(&queryFilter, tileGeneration(), PLANNER_ITERATIONS_PER_TICK, PLANNER_RESULT_SECONDS);
+        }
+        tickIndex++;
+        publishSnapshot();
+        publishAgentRing();
+        publishAgentStream();
+        publishAgentInterest();
+        metrics.recordTick(std::chrono::steady_clock::now() - tickStart);
+    }
+    
+    // Blocks running update() at fixed real-time steps until stopUpdateLoop(). Work queued
+    // while the loop wound down is drained before it returns.
+    void runUpdateLoop() {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            loopActive = true;
+        }
+        scheduler.run([this](float deltaTime) { update(deltaTime); });
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            loopActive = false;
+        }
+        drainIfIdle();
+        planner.releaseParked();    // No update left to time them out
+    }
+    
+    void stopUpdateLoop() {
+        scheduler.stop();
+    }
+    
+    bool isUpdateLoopRunning() const { return scheduler.isRunning(); }
+    
+    // Call before initialize
+    void setCrowdLod(const CrowdLodConfig& config) {
+        lod.setConfig(config);
+    }
+    
+    // Call before initialize: name and index of this service's zone, the process-wide indexed
+    // file cache and the worker pool its crowd shards and line-of-sight batches run on
+    void joinZoneHost(const std::string& key, int index, NavMeshFileCache* files, ShardWorkerPool* workers) {
+        zoneKey = key;
+        zoneIndex = index;
+        navMeshFiles = files;
+        sharedWorkers = workers;
+    }
+    
+    const std::string& getZoneKey() const { return zoneKey; }
+    int getZoneIndex() const { return zoneIndex; }
+    
+    TickSchedulerStats getSchedulerStats() const { return scheduler.getStats(); }
+    
+    CrowdLodStats getLodStats() const { return lod.getStats(); }
+    
+    // Call before the update thread starts
+    void attachAgentRing(SharedAgentRing* ring) {
+        agentRing = ring;
+    }
+    
+    // Any time. Every tick that wanted() says someone listens, the tick's frame goes to
+    // sink(frame, keyframe) on the update thread. Pass nullptrs to detach.
+    void attachAgentStream(std::function<bool()> wanted, std::function<void(const std::string&, bool)> sink) {
+        std::lock_guard<std::mutex> lock(agentStreamMutex);
+        agentStreamWanted = wanted;
+        agentStreamSink = sink;
+        agentStream.requestKeyframe();
+    }
+    
+    // Any thread: the next frame lists every agent in full
+    void requestAgentStreamKeyframe() {
+        agentStream.requestKeyframe();
+    }
+    
+    AgentStreamStats getAgentStreamStats() {
+        return agentStream.getStats();
+    }
+    
+    // Call before initialize. shards <= 0 picks one per two hardware threads (at most 8)
+    void setCrowdCapacity(int agents, int shards) {
+        if (agents > 0) maxAgents = agents;
+        crowdShards = shards;
+    }
+    
+    // Call before initialize; needs an indexed navmesh file
+    void setTileStreaming(const TileStreamingConfig& config) {
+        streamingConfig = config;
+    }
+    
+    // Replaces the player positions (flat x,y,z triplets) that tiles are streamed around and
+    // crowd LOD distances are measured from. Crowd agents are added automatically every tick.
+    void setInterestPoints(const float* points, size_t count) {
+        lod.setPlayers(points, count);
+        if (tileStreamer) tileStreamer->setInterestPoints("players", points, count);
+    }
+    
+    // Streaming counters, or a count of the resident tiles when everything is loaded up front
+    TileStreamingStats getTileStats(std::vector<int>* tileCoords = nullptr) {
+        if (tileStreamer) return tileStreamer->getStats(tileCoords);
+        
+        TileStreamingStats stats;
+        std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        if (!navMesh) return stats;
+        const dtNavMesh* mesh = navMesh;
+        for (int i = 0; i < mesh->getMaxTiles(); i++) {
+            const dtMeshTile* tile = mesh->getTile(i);
+            if (!tile || !tile->header) continue;
+            stats.residentTiles++;
+            stats.residentBytes += tile->dataSize;
+            if (tileCoords) {
+                tileCoords->push_back(tile->header->x);
+                tileCoords->push_back(tile->header->y);
+                tileCoords->push_back(tile->header->layer);
+            }
+        }
+        stats.totalTiles = stats.residentTiles;
+        return stats;
+    }
+    
+    FlowFieldStats getFlowFieldStats() const { return flowFields.getStats(); }
+    
+    PathCacheStats getPathCacheStats() const { return pathCache.getStats(); }
+    
+    CrowdShardStats getCrowdStats() const { return crowd.getStats(); }
+    
+    int getMaxAgents() const { return maxAgents; }
+    
+    ServiceMetrics& getMetrics() { return metrics; }
+    
+    // Tick of the last published crowd state
+    unsigned long long getTick() const { return std::atomic_load(&snapshot)->tick; }
+    
+    // Capture: every request from here on goes to path (truncated), see pathfinding-trace.h
+    bool startCapture(const std::string& path) {
+        if (!trace.open(path, getTick(), TRACE_SNAPSHOT_TICKS)) {
+            std::cerr << "[PathfindingService] Could not open capture file " << path << std::endl;
+            return false;
+        }
+        std::cout << "[PathfindingService] Capturing requests to " << path << std::endl;
+        return true;
+    }
+    
+    void stopCapture() {
+        trace.close();
+    }
+    
+    // Where POST /capture {"op": "start"} writes
+    void setCapturePath(const std::string& path) { capturePath = path; }
+    const std::string& getCapturePath() const { return capturePath; }
+    
+    TraceWriter& getTrace() { return trace; }
+    
+    // Any thread: loads the navmesh file the service started with again, on its own thread,
+    // and swaps it in between two ticks. Agents keep their handles and are moved onto the
+    // nearest poly of the new navmesh. False while a reload is still running.
+    bool reloadNavMesh() {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        if (reloadStats.reloading || navMeshPath.empty()) return false;
+        if (reloadThread.joinable()) reloadThread.join();  // Done with its last reload
+        reloadStats.reloading = true;
+        reloadThread = std::thread([this]() { runReload(); });
+        return true;
+    }
+    
+    NavMeshReloadStats getReloadStats() {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        return reloadStats;
+    }
+    
+    const std::string& getNavMeshPath() const { return navMeshPath; }
+    
+    // Any thread: writes the crowd as of the next tick boundary to path. The file is written
+    // on the calling thread, never the update thread.
+    bool saveCrowdState(const std::string& path, size_t* savedAgents = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        CrowdState state;
+        runOnUpdateThread([this, &state]() { captureCrowdState(state); });
+        state.savedUnixMs = crowdStateUnixMs();
+        bool written = writeCrowdState(path, state);
+        if (savedAgents) *savedAgents = state.agents.size();
+        if (!written) {
+            std::cerr << "[PathfindingService] Could not write crowd state to " << path << std::endl;
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(crowdStateStatsMutex);
+        crowdStateStats.saves++;
+        crowdStateStats.lastSavedAgents = state.agents.size();
+        crowdStateStats.lastSaveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+    
+    // Any thread: replaces the crowd with the one saved in path at the next tick boundary.
+    // maxAgeSeconds > 0 refuses files older than that, so a restart after a long outage does
+    // not bring back agents the game server has long forgotten.
+    bool restoreCrowdState(const std::string& path, unsigned long long maxAgeSeconds = 0, size_t* restoredAgents = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        CrowdState state;
+        if (!readCrowdState(path, state)) return false;
+        if (maxAgeSeconds > 0 && crowdStateUnixMs() > state.savedUnixMs + maxAgeSeconds * 1000ULL) {
+            std::cout << "[PathfindingService] Crowd state in " << path << " is too old, starting empty" << std::endl;
+            return false;
+        }
+        size_t restored = 0;
+        runOnUpdateThread([this, &state, &restored]() { restored = restoreCrowdNow(state); });
+        if (restoredAgents) *restoredAgents = restored;
+        std::cout << "[PathfindingService] Restored " << restored << " of " << state.agents.size() << " agents from " << path << std::endl;
+        
+        std::lock_guard<std::mutex> lock(crowdStateStatsMutex);
+        crowdStateStats.restores++;
+        crowdStateStats.lastRestoredAgents = restored;
+        crowdStateStats.lastDroppedAgents = state.agents.size() - restored;
+        crowdStateStats.lastRestoreMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+    
+    // Saves to getCrowdStatePath() every intervalSeconds until cleanup
+    void startCrowdAutosave(int intervalSeconds) {
+        std::lock_guard<std::mutex> lock(autosaveMutex);
+        if (autosaveRunning || intervalSeconds <= 0) return;
+        autosaveRunning = true;
+        autosaveThread = std::thread([this, intervalSeconds]() {
+            std::unique_lock<std::mutex> lock(autosaveMutex);
+            while (!autosaveSignal.wait_for(lock, std::chrono::seconds(intervalSeconds), [this]() { return !autosaveRunning; })) {
+                lock.unlock();
+                saveCrowdState(crowdStatePath);
+                lock.lock();
+            }
+        });
+    }
+    
+    // Where POST /crowdState saves and restores, and the autosave writes; call before initialize
+    void setCrowdStatePath(const std::string& path) { crowdStatePath = path; }
+    const std::string& getCrowdStatePath() const { return crowdStatePath; }
+    
+    CrowdStateStats getCrowdStateStats() {
+        std::lock_guard<std::mutex> lock(crowdStateStatsMutex);
+        return crowdStateStats;
+    }
+
+private:
+    // Splits [0, count) into LOS_CHUNK slices over the worker pool, each slice on its own pooled query.
+    // Caller holds losFanOutMutex and the navmesh lock.
+    template <typename Body>
+    void runChunked(size_t count, Body& body) {
+        int jobs = (int)((count + LOS_CHUNK - 1) / LOS_CHUNK);
+        std::function<void(int)> job = [&](int index) {
+            size_t begin = (size_t)index * LOS_CHUNK;
+            size_t end = std::min(count, begin + LOS_CHUNK);
+            auto navQuery = queryPool.acquire();
+            body(begin, end, navQuery.get());
+        };
+        (sharedWorkers ? *sharedWorkers : losWorkers).run(jobs, job);
+    }
+    
+    // Bumped by every tile add/remove, obstacle change and navmesh reload; cached corridors and
+    // flow fields are only valid within one
+    unsigned long long tileGeneration() const {
+        return generationBase + (tileStreamer ? tileStreamer->getGeneration() : 0) + obstacles.getGeneration();
+    }
+    
+    // Right after every crowd.init: avoidance quality tiers 0 (low) to 3 (high), where agents
+    // ask for 3 and CrowdLod steps far ones down, and the shared query filter
+    void configureCrowd() {
+        static const unsigned char avoidanceTiers[4][3] = {{5, 2, 1}, {5, 2, 2}, {7, 2, 3}, {7, 3, 3}};
+        for (int i = 0; i < 4; i++) {
+            dtObstacleAvoidanceParams params;
+            params.velBias = 0.5f;
+            params.weightDesVel = 2.0f;
+            params.weightCurVel = 0.75f;
+            params.weightSide = 0.75f;
+            params.weightToi = 2.5f;
+            params.horizTime = 2.5f;
+            params.gridSize = 33;
+            params.adaptiveDivs = avoidanceTiers[i][0];
+            params.adaptiveRings = avoidanceTiers[i][1];
+            params.adaptiveDepth = avoidanceTiers[i][2];
+            crowd.setObstacleAvoidanceParams(i, &params);
+        }
+        crowd.setQueryFilter(0, queryFilter);
+    }
+    
+    // Update thread, before anything reads the navmesh this tick. The polys under the
+    // changed obstacles are found alongside the readers; queries are only held off while
+    // their flags are written.
+    void applyObstacles() {
+        const unsigned long long streamed = tileStreamer ? tileStreamer->getGeneration() : 0;
+        if (!obstacles.needsApply(streamed)) return;
+        ObstacleOverlay::Plan plan;
+        {
+            std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+            auto navQuery = queryPool.acquire();
+            obstacles.plan(navMesh, navQuery.get(), streamed, plan);
+        }
+        std::unique_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        obstacles.commit(navMesh, plan);
+    }
+    
+    // Reload thread: builds the next navmesh while the current one keeps serving, then waits
+    // for the update thread to swap it in and frees the one it replaced
+    void runReload() {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<LoadedNavMesh> next(new LoadedNavMesh());
+        bool loaded = loadNavMesh(navMeshPath, *next, true);
+        // A streamed navmesh starts empty: bring in the tiles around everyone before the swap,
+        // under its own staging lock while the served navmesh keeps answering queries
+        if (loaded && next->streamer) {
+            if (tileStreamer) next->streamer->copyInterestPoints(*tileStreamer);
+            next->streamer->pass();
+        }
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        
+        std::unique_ptr<LoadedNavMesh> retired;
+        {
+            std::unique_lock<std::mutex> lock(reloadMutex);
+            reloadStats.lastLoadMs = loadMs;
+            if (!loaded) {
+                reloadStats.failures++;
+                std::cerr << "[PathfindingService] Navmesh reload from " << navMeshPath << " failed, keeping the current one" << std::endl;
+            } else if (!reloadCancelled) {
+                reloadReady = std::move(next);
+                reloadPending = true;
+                reloadSignal.wait(lock, [this]() { return reloadRetired || reloadCancelled; });
+                retired = std::move(reloadRetired);
+            }
+        }
+        retired.reset();
+        next.reset();
+        
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        reloadStats.reloading = false;
+    }
+    
+    // Update thread, at the start of a tick: the crowd is saved, rebuilt on the new navmesh
+    // and put back with the same handles; every other navmesh user is pointed at the new mesh.
+    // Readers are held off for as long as that takes, the load itself happened beforehand.
+    // If the crowd cannot be built on the new mesh, the old mesh and crowd are put back.
+    void swapReloadedNavMesh() {
+        std::unique_ptr<LoadedNavMesh> next;
+        {
+            std::lock_guard<std::mutex> lock(reloadMutex);
+            next = std::move(reloadReady);
+            reloadPending = false;
+        }
+        if (!next) return;
+        auto start = std::chrono::steady_clock::now();
+        
+        captureCrowdState(carried);
+        if (tileStreamer) tileStreamer->stop();
+        size_t dropped = 0;
+        bool swapped = true;
+        {
+            std::unique_lock<std::shared_mutex> tilesLock(navMeshMutex);
+            installNavMesh(*next);
+            if (!rebuildCrowd(dropped)) {
+                swapped = false;
+                installNavMesh(*next);     // next holds the new navmesh again, retired below
+                if (!rebuildCrowd(dropped)) {
+                    // Not even the old navmesh takes a crowd: drop every agent so queued work fails fast
+                    for (int slot = 0; slot < agents.slotCount(); slot++) {
+                        if (agents.crowdHandle(slot) >= 0) agents.remove(slot);
+                    }
+                    dropped = carried.agents.size();
+                }
+            }
+        }
+        if (tileStreamer) tileStreamer->start();
+        double swapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (swapped) {
+            std::cout << "[PathfindingService] Swapped in the reloaded navmesh in " << swapMs << " ms, " << (carried.agents.size() - dropped)
+                      << " agents carried over, " << dropped << " dropped" << std::endl;
+        } else {
+            std::cerr << "[PathfindingService] Failed to init the crowd on the reloaded navmesh, keeping the current one ("
+                      << (carried.agents.size() - dropped) << " agents kept, " << dropped << " dropped)" << std::endl;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(reloadMutex);
+            reloadRetired = std::move(next);    // Holds the navmesh that is not in use now
+            if (swapped) {
+                reloadStats.reloads++;
+                reloadStats.lastSwapMs = swapMs;
+            } else {
+                reloadStats.failures++;
+            }
+            reloadStats.lastCarried = carried.agents.size() - dropped;
+            reloadStats.lastDropped = dropped;
+        }
+        reloadSignal.notify_all();
+    }
+    
+    // Update thread, under the exclusive navmesh lock: trades the served navmesh for the one
+    // in loaded (which receives the old one) and points every navmesh user at it
+    void installNavMesh(LoadedNavMesh& loaded) {
+        generationBase += (tileStreamer ? tileStreamer->getGeneration() : 0) + 1;
+        std::swap(navMesh, loaded.navMesh);
+        std::swap(navMeshFile, loaded.file);
+        std::swap(tileStreamer, loaded.streamer);
+        if (tileStreamer) tileStreamer->rebindMutex(navMeshMutex);
+        if (loaded.streamer) loaded.streamer->rebindMutex(loaded.stagingMutex);
+        queryPool.rebind(navMesh);
+        planner.rebind(navMesh);
+        auto navQuery = queryPool.acquire();
+        obstacles.rebind(navMesh, navQuery.get(), tileStreamer ? tileStreamer->getGeneration() : 0);
+    }
+    
+    // Update thread, under the exclusive navmesh lock: builds a fresh crowd on the current
+    // navmesh and puts the carried agents back in it. False, with the agent table untouched,
+    // if the crowd cannot be built.
+    bool rebuildCrowd(size_t& dropped) {
+        flowFields.clear();
+        pathHarvest.clear();
+        lod.clear();
+        dropped = 0;
+        if (!crowd.init(crowdShards, maxAgents, 0.6f, navMesh, CROWD_REGION_SIZE, sharedWorkers)) return false;
+        configureCrowd();
+        
+        // Old crowd handles are rebound to the new ones in one pass, like a shard migration
+        std::vector<std::pair<int, int>> moved;
+        std::vector<std::pair<int, const CrowdStateAgent*>> resumed;
+        for (const auto& saved : carried.agents) {
+            int slot = agents.resolve(saved.handle);
+            if (slot < 0) continue;
+            int crowdHandle = spawnAgentNow(saved);
+            if (crowdHandle < 0) {
+                agents.remove(slot);
+                dropped++;
+                continue;
+            }
+            moved.push_back(std::make_pair(agents.crowdHandle(slot), crowdHandle));
+            resumed.push_back(std::make_pair(slot, &saved));
+        }
+        agents.migrate(moved);
+        for (const auto& entry : resumed) resumeTargetNow(entry.first, *entry.second);
+        return true;
+    }
+    
+    // Runs job on the update thread at the next tick boundary, under the navmesh read lock,
+    // and waits for it. Without a running update loop (tools, startup) it runs right here.
+    void runOnUpdateThread(const std::function<void()>& job) {
+        std::promise<void> done;
+        std::future<void> finished = done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            updateJobs.push_back([&job, &done]() {
+                job();
+                done.set_value();
+            });
+        }
+        drainIfIdle();
+        finished.wait();
+    }
+    
+    // Runs the queued batches and jobs on the calling thread unless an update loop owns
+    // them. tickMutex keeps a loop that starts meanwhile (or a manual update) out until done.
+    void drainIfIdle() {
+        std::lock_guard<std::mutex> tickLock(tickMutex);
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            if (loopActive) return;
+        }
+        std::shared_lock<std::shared_mutex> tilesLock(navMeshMutex);
+        drainCommands();
+        runUpdateJobs();
+    }
+    
+    void runUpdateJobs() {
+        std::vector<std::function<void()>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (updateJobs.empty()) return;
+            jobs.swap(updateJobs);
+        }
+        for (auto& job : jobs) job();
+    }
+    
+    // Update thread: every agent with the steering it was added with (not its LOD level) and
+    // what it is heading for
+    void captureCrowdState(CrowdState& state) {
+        state.tick = tickIndex;
+        state.agents.clear();
+        state.agents.reserve(agents.size());
+        for (int slot = 0; slot < agents.slotCount(); slot++) {
+            const int crowdHandle = agents.crowdHandle(slot);
+            const dtCrowdAgent* agent = crowdHandle >= 0 ? crowd.getAgent(crowdHandle) : nullptr;
+            if (!agent || !agent->active) continue;
+            
+            CrowdStateAgent saved;
+            saved.npcId = agents.npcId(slot);
+            saved.handle = agents.handleOf(slot);
+            memcpy(saved.pos, agent->npos, sizeof(saved.pos));
+            memcpy(saved.vel, agent->vel, sizeof(saved.vel));
+            memcpy(saved.targetPos, agent->targetPos, sizeof(saved.targetPos));
+            saved.targetState = agent->targetState;
+            saved.params = agent->params;
+            lod.fullQuality(crowdHandle, saved.params);
+            const std::string* chase = flowFields.chaseTargetOf(crowdHandle);
+            if (chase) saved.chaseTarget = *chase;
+            state.agents.push_back(std::move(saved));
+        }
+    }
+    
+    // Update thread: puts a saved agent into the crowd at the nearest point of the current
+    // navmesh, moving as it was. Returns its crowd handle, or -1.
+    int spawnAgentNow(const CrowdStateAgent& saved) {
+        if (!crowd.isReady()) return -1;
+        const float extents[3] = {10.0f, 10.0f, 10.0f};
+        dtPolyRef nearestRef = 0;
+        float navPoint[3];
+        dtStatus status = crowd.crowdAt(saved.pos)->getNavMeshQuery()->findNearestPoly(saved.pos, extents, &queryFilter, &nearestRef, navPoint);
+        if (dtStatusFailed(status) || !nearestRef) return -1;
+        
+        int crowdHandle = crowd.addAgent(navPoint, &saved.params);
+        if (crowdHandle < 0) return -1;
+        dtCrowdAgent* agent = crowd.getEditableAgent(crowdHandle);
+        memcpy(agent->vel, saved.vel, sizeof(agent->vel));
+        memcpy(agent->dvel, saved.vel, sizeof(agent->dvel));
+        lod.track(crowdHandle, saved.params);
+        return crowdHandle;
+    }
+    
+    // Update thread: the agent in slot heads for the saved agent's target again. Corridors
+    // are searched afresh; the old ones named polys of another navmesh.
+    void resumeTargetNow(int slot, const CrowdStateAgent& saved) {
+        if (!saved.chaseTarget.empty()) {
+            flowFields.chase(agents.crowdHandle(slot), saved.chaseTarget, saved.targetPos);
+            return;
+        }
+        switch (saved.targetState) {
+            case DT_CROWDAGENT_TARGET_VALID:
+            case DT_CROWDAGENT_TARGET_REQUESTING:
+            case DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE:
+            case DT_CROWDAGENT_TARGET_WAITING_FOR_PATH:
+                setTargetNow(slot, saved.targetPos[0], saved.targetPos[1], saved.targetPos[2]);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    // Update thread: the crowd becomes the saved one. Returns how many agents found navmesh.
+    size_t restoreCrowdNow(const CrowdState& state) {
+        for (int slot = 0; slot < agents.slotCount(); slot++) {
+            if (agents.crowdHandle(slot) >= 0) removeAgentNow(slot);
+        }
+        size_t restored = 0;
+        for (const auto& saved : state.agents) {
+            if (saved.npcId.empty() || agents.find(saved.npcId) >= 0) continue;
+            int crowdHandle = spawnAgentNow(saved);
+            if (crowdHandle < 0) continue;
+            int slot = agents.addAt(saved.npcId, crowdHandle, saved.handle);
+            if (slot < 0) {
+                lod.untrack(crowdHandle);
+                crowd.removeAgent(crowdHandle);
+                continue;
+            }
+            resumeTargetNow(slot, saved);
+            restored++;
+        }
+        return restored;
+    }
+    
+    // Handle of the agent the command addressed, AGENT_HANDLE_NONE when it failed
+    AgentHandle submitCommand(const CrowdCommand& command) {
+        unsigned long long tick = 0;
+        std::vector<AgentHandle> handles;
+        applyBatch(std::vector<CrowdCommand>(1, command), tick, &handles);
+        return handles[0];
+    }
+    
+    // Tick boundary: run every queued batch in arrival order, then wake the waiting requests
+    void drainCommands() {
+        std::vector<std::shared_ptr<PendingBatch>> batches;
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            batches.swap(pendingBatches);
+        }
+        
+        for (auto& batch : batches) {
+            BatchResult result;
+            result.tick = tickIndex;
+            result.results.reserve(batch->commands.size());
+            result.handles.reserve(batch->commands.size());
+            for (const auto& command : batch->commands) {
+                AgentHandle handle = applyCommand(command);
+                result.results.push_back(handle != AGENT_HANDLE_NONE);
+                result.handles.push_back(handle);
+            }
+            batch->done.set_value(std::move(result));
+        }
+    }
+    
+    // Handle of the agent the command addressed (the new one for Add), AGENT_HANDLE_NONE on failure
+    AgentHandle applyCommand(const CrowdCommand& command) {
+        if (!crowd.isReady()) return AGENT_HANDLE_NONE;    // No crowd after a failed reload
+        if (command.op == CommandOp::Add) {
+            int slot = addAgentNow(command.npcId, command.pos[0], command.pos[1], command.pos[2]);
+            return slot < 0 ? AGENT_HANDLE_NONE : agents.handleOf(slot);
+        }
+        
+        int slot = command.handle != AGENT_HANDLE_NONE ? agents.resolve(command.handle) : agents.find(command.npcId);
+        if (slot < 0) return AGENT_HANDLE_NONE;
+        const AgentHandle handle = agents.handleOf(slot);
+        bool applied = false;
+        switch (command.op) {
+            case CommandOp::Remove:
+                applied = removeAgentNow(slot);
+                break;
+            case CommandOp::SetTarget:
+                applied = setTargetNow(slot, command.pos[0], command.pos[1], command.pos[2]);
+                break;
+            case CommandOp::Stop:
+                applied = stopAgentNow(slot);
+                break;
+            case CommandOp::ForceStop:
+                applied = forceStopAgentNow(slot, command.brakeForce);
+                break;
+            case CommandOp::Chase:
+                applied = chaseNow(slot, command.targetId, command.pos);
+                break;
+            default:
+                break;
+        }
+        return applied ? handle : AGENT_HANDLE_NONE;
+    }
+    
+    // The *Now methods run on the update thread only and take an agent table slot. Poly lookups
+    // use the crowd's own dtNavMeshQuery, which nothing else touches, instead of leasing one from the pool.
+    
+    bool setTargetNow(int slot, float targetX, float targetY, float targetZ) {
+        int agentIndex = agents.crowdHandle(slot);
+        dtCrowdAgent* agent = crowd.getEditableAgent(agentIndex);
+        if (!agent || !agent->active) return false;
+        
+        flowFields.release(agentIndex);
+        pathHarvest.erase(agentIndex);
+        
+        // CRITICAL FIX: Reset the current move target first
+        crowd.resetMoveTarget(agentIndex);
+        
+        const float targetPos[3] = {targetX, targetY, targetZ};
+        dtPolyRef targetRef;
+        float nearestPt[3];
+        const float extents[3] = {20.0f, 10.0f, 20.0f};
+        
+        dtStatus status = crowd.crowdOf(agentIndex)->getNavMeshQuery()->findNearestPoly(targetPos, extents, &queryFilter, &targetRef, nearestPt);
+        if (dtStatusFailed(status) || !targetRef) return false;
+        
+        // Patrol and leash routes repeat: reuse a known corridor instead of queueing a search
+        std::vector<dtPolyRef> path;
+        const PathCacheKey key = { agent->corridor.getFirstPoly(), targetRef, PATH_FILTER_DEFAULT };
+        if (key.startRef && pathCache.lookup(key, tileGeneration(), path)) {
+            applyAgentCorridor(agent, path.data(), (int)path.size(), targetRef, nearestPt);
+            return true;
+        }
+        
+        if (!crowd.requestMoveTarget(agentIndex, targetRef, nearestPt)) return false;
+        pathHarvest[agentIndex] = targetRef;
+        return true;
+    }
+    
+    // Update thread, after crowd.update: agents that crossed into another shard's region get
+    // new handles, so every table keyed by handle follows them
+    void migrateAgents() {
+        static thread_local std::vector<std::pair<int, int>> moved;
+        crowd.migrate(moved);
+        if (moved.empty()) return;
+        
+        agents.migrate(moved);
+        for (const auto& move : moved) {
+            flowFields.migrate(move.first, move.second);
+            lod.migrate(move.first, move.second);
+            auto harvest = pathHarvest.find(move.first);
+            if (harvest == pathHarvest.end()) continue;
+            dtPolyRef targetRef = harvest->second;
+            pathHarvest.erase(harvest);
+            pathHarvest[move.second] = targetRef;
+        }
+    }
+    
+    // Update thread, after crowd.update: cache the corridors of crowd path requests that
+    // reached their target poly, keyed from wherever the agent's corridor starts now
+    void harvestCrowdPaths() {
+        const unsigned long long generation = tileGeneration();
+        for (auto it = pathHarvest.begin(); it != pathHarvest.end();) {
+            const dtCrowdAgent* agent = crowd.getAgent(it->first);
+            bool current = agent && agent->active && agent->targetRef == it->second;
+            if (current && (agent->targetState == DT_CROWDAGENT_TARGET_REQUESTING ||
+                            agent->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE ||
+                            agent->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)) {
+                ++it;
+                continue;
+            }
+            if (current && agent->targetState == DT_CROWDAGENT_TARGET_VALID && !agent->partial &&
+                agent->corridor.getLastPoly() == it->second) {
+                const PathCacheKey key = { agent->corridor.getFirstPoly(), it->second, PATH_FILTER_DEFAULT };
+                pathCache.store(key, generation, agent->corridor.getPath(), agent->corridor.getPathCount());
+            }
+            it = pathHarvest.erase(it);
+        }
+    }
+    
+    bool stopAgentNow(int slot) {
+        int agentIndex = agents.crowdHandle(slot);
+        const dtCrowdAgent* agent = crowd.getAgent(agentIndex);
         if (!agent || !agent->active) return false;
         
         // Reset move target
-        dtStatus result = crowd->resetMoveTarget(agentIndex);
+        flowFields.release(agentIndex);
+        pathHarvest.erase(agentIndex);
+        bool result = crowd.resetMoveTarget(agentIndex);
         
         // NEW: Immediately zero velocity
-        if (crowd->getEditableAgent(agentIndex)) {
-            dtCrowdAgent* editableAgent = crowd->getEditableAgent(agentIndex);
+        if (crowd.getEditableAgent(agentIndex)) {
+            dtCrowdAgent* editableAgent = crowd.getEditableAgent(agentIndex);
             editableAgent->vel[0] = 0.0f;
             editableAgent->vel[1] = 0.0f;
             editableAgent->vel[2] = 0.0f;
@@ -144,24 +1567,22 @@ public:
             editableAgent->dvel[2] = 0.0f;
         }
         
-        return dtStatusSucceed(result);
+        return result;
     }
-
-    // NEW: Force stop with immediate velocity zeroing and brake force
-    bool forceStopNPC(const std::string& npcId, float brakeForce = 10.0f) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return false;
-        
-        int agentIndex = it->second;
-        const dtCrowdAgent* agent = crowd->getAgent(agentIndex);
+    
+    bool forceStopAgentNow(int slot, float brakeForce) {
+        int agentIndex = agents.crowdHandle(slot);
+        const dtCrowdAgent* agent = crowd.getAgent(agentIndex);
         if (!agent || !agent->active) return false;
         
         // Reset move target
-        crowd->resetMoveTarget(agentIndex);
+        flowFields.release(agentIndex);
+        pathHarvest.erase(agentIndex);
+        crowd.resetMoveTarget(agentIndex);
         
         // Apply brake force to immediately zero velocity
-        if (crowd->getEditableAgent(agentIndex)) {
-            dtCrowdAgent* editableAgent = crowd->getEditableAgent(agentIndex);
+        if (crowd.getEditableAgent(agentIndex)) {
+            dtCrowdAgent* editableAgent = crowd.getEditableAgent(agentIndex);
             
             // Zero out velocity immediately
             editableAgent->vel[0] = 0.0f;
@@ -176,40 +1597,27 @@ public:
             // Apply strong deceleration parameters
             dtCrowdAgentParams params = editableAgent->params;
             params.maxAcceleration = brakeForce * 100.0f; // High deceleration
-            crowd->updateAgentParameters(agentIndex, &params);
+            crowd.updateAgentParameters(agentIndex, &params);
             
-            std::cout << "[PathfindingService] Force stopped NPC " << npcId 
+            std::cout << "[PathfindingService] Force stopped NPC " << agents.npcId(slot) 
                       << " with brake force " << brakeForce << std::endl;
         }
         
         return true;
     }
-
-    // NEW: Check if agent is at target destination
-    bool isAgentAtTarget(const std::string& npcId, float threshold = 2.0f) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return false;
-        
-        int agentIndex = it->second;
-        const dtCrowdAgent* agent = crowd->getAgent(agentIndex);
-        if (!agent || !agent->active) return false;
-        
-        // Check if agent has reached its target
-        if (agent->targetState == DT_CROWDAGENT_TARGET_VALID) {
-            float dx = agent->npos[0] - agent->targetPos[0];
-            float dz = agent->npos[2] - agent->targetPos[2];
-            float distance = sqrtf(dx * dx + dz * dz);
-            
-            return distance <= threshold;
-        }
-        
-        return false;
-    }
     
-    // ENHANCED: addAggroedNPC with better collision avoidance parameters
-    bool addAggroedNPC(const std::string& npcId, float x, float y, float z) {
-        auto navPoint = getClosestNavPoint(x, y, z);
-        if (navPoint.empty()) return false;
+    // Returns the agent's slot, or -1. An id that already has an agent gets a fresh one in its place.
+    int addAgentNow(const std::string& npcId, float x, float y, float z) {
+        if (npcId.empty()) return -1;
+        const float pos[3] = {x, y, z};
+        const float extents[3] = {10.0f, 10.0f, 10.0f};
+        dtPolyRef nearestRef;
+        float navPoint[3];
+        dtStatus status = crowd.crowdAt(pos)->getNavMeshQuery()->findNearestPoly(pos, extents, &queryFilter, &nearestRef, navPoint);
+        if (dtStatusFailed(status) || !nearestRef) return -1;
+        
+        int existing = agents.find(npcId);
+        if (existing >= 0) removeAgentNow(existing);
         
         dtCrowdAgentParams params;
         memset(&params, 0, sizeof(params));
@@ -232,278 +1640,957 @@ public:
                             DT_CROWD_SEPARATION |
                             DT_CROWD_OBSTACLE_AVOIDANCE; // Enable obstacle avoidance
 
-        float pos[3] = {navPoint[0], navPoint[1], navPoint[2]};
-        int agentIndex = crowd->addAgent(pos, &params);
+        int agentIndex = crowd.addAgent(navPoint, &params);
         
-        if (agentIndex < 0) return false;
+        if (agentIndex < 0) return -1;
         
-        agentMap[npcId] = agentIndex;
+        int slot = agents.add(npcId, agentIndex);
+        if (slot < 0) {
+            crowd.removeAgent(agentIndex);
+            return -1;
+        }
+        lod.track(agentIndex, params);
+        return slot;
+    }
+    
+    bool removeAgentNow(int slot) {
+        int agentIndex = agents.crowdHandle(slot);
+        flowFields.release(agentIndex);
+        pathHarvest.erase(agentIndex);
+        lod.untrack(agentIndex);
+        crowd.removeAgent(agentIndex);
+        agents.remove(slot);
         return true;
     }
     
-    bool removeAggroedNPC(const std::string& npcId) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return false;
+    // The corridor is handed out by flowFields.update at the end of this tick's drain
+    bool chaseNow(int slot, const std::string& targetId, const float* targetPos) {
+        if (targetId.empty()) return setTargetNow(slot, targetPos[0], targetPos[1], targetPos[2]);
+        
+        int agentIndex = agents.crowdHandle(slot);
+        const dtCrowdAgent* agent = crowd.getAgent(agentIndex);
+        if (!agent || !agent->active) return false;
         
-        crowd->removeAgent(it->second);
-        agentMap.erase(it);
+        pathHarvest.erase(agentIndex);
+        flowFields.chase(agentIndex, targetId, targetPos);
         return true;
     }
     
-    std::vector<float> getAgentPosition(const std::string& npcId) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return {};
-        const dtCrowdAgent* agent = crowd->getAgent(it->second);
-        if (!agent) return {};
-        return {agent->npos[0], agent->npos[1], agent->npos[2]};
+    static const AgentState* findAgentState(const CrowdSnapshot& view, std::string_view npcId) {
+        int at = view.index.find(npcId, [&view](int i) { return std::string_view(view.agents[i].npcId); });
+        return at < 0 ? nullptr : &view.agents[at];
     }
     
-    std::vector<float> getAgentVelocity(const std::string& npcId) {
-        auto it = agentMap.find(npcId);
-        if (it == agentMap.end()) return {};
-        const dtCrowdAgent* agent = crowd->getAgent(it->second);
-        if (!agent) return {};
-        return {agent->vel[0], agent->vel[1], agent->vel[2]};
+    // Null once the handle's agent is gone, even if its slot has been reused
+    static const AgentState* findAgentState(const CrowdSnapshot& view, AgentHandle handle) {
+        int slot = agentHandleSlot(handle);
+        if (handle == AGENT_HANDLE_NONE || slot >= (int)view.bySlot.size() || view.bySlot[slot] < 0) return nullptr;
+        const AgentState& state = view.agents[view.bySlot[slot]];
+        return state.handle == handle ? &state : nullptr;
     }
     
-    void update(float deltaTime = 0.025f) {
-    if (crowd) {
-        crowd->update(deltaTime, nullptr);
+    static bool isAtTarget(const AgentState& state, float threshold) {
+        if (state.targetState != DT_CROWDAGENT_TARGET_VALID) return false;
+        float dx = state.pos[0] - state.targetPos[0];
+        float dz = state.pos[2] - state.targetPos[2];
+        return sqrtf(dx * dx + dz * dz) <= threshold;
     }
-}
     
-    std::vector<std::vector<float>> testNavMesh(float startX, float startY, float startZ, float endX, float endY, float endZ) {
-        const float start[3] = {startX, startY, startZ};
-        const float end[3] = {endX, endY, endZ};
-        const float extents[3] = {10.0f, 10.0f, 10.0f};
-        dtPolyRef startRef, endRef;
-        float startPt[3], endPt[3];
-        
-        navQuery->findNearestPoly(start, extents, &dtQueryFilter(), &startRef, startPt);
-        navQuery->findNearestPoly(end, extents, &dtQueryFilter(), &endRef, endPt);
+    // Update thread, right after crowd.update
+    void publishSnapshot() {
+        auto next = std::make_shared<CrowdSnapshot>();
+        next->tick = tickIndex;
+        next->agents.reserve(agents.size());
+        next->index.reserve(agents.size());
+        next->bySlot.assign(agents.slotCount(), -1);
         
-        if (!startRef || !endRef) return {};
-        
-        dtPolyRef path[MAX_PATH_POINTS];
-        int pathCount = 0;
-        navQuery->findPath(startRef, endRef, startPt, endPt, &dtQueryFilter(), path, &pathCount, MAX_PATH_POINTS);
-        
-        if (pathCount == 0) return {};
-        
-        float straightPath[MAX_PATH_POINTS * 3];
-        int straightPathCount = 0;
-        navQuery->findStraightPath(startPt, endPt, path, pathCount, straightPath, nullptr, nullptr, &straightPathCount, MAX_PATH_POINTS);
-        
-        if (straightPathCount > 0) {
-            std::vector<std::vector<float>> result;
-            for (int i = 0; i < straightPathCount; i++) {
-                result.push_back({straightPath[i*3], straightPath[i*3+1], straightPath[i*3+2]});
-            }
-            return result;
+        for (int slot = 0; slot < agents.slotCount(); slot++) {
+            const dtCrowdAgent* agent = crowd.getAgent(agents.crowdHandle(slot));
+            if (!agent || !agent->active) continue;
+            
+            AgentState state;
+            state.npcId = agents.npcId(slot);
+            state.handle = agents.handleOf(slot);
+            memcpy(state.pos, agent->npos, sizeof(state.pos));
+            memcpy(state.vel, agent->vel, sizeof(state.vel));
+            memcpy(state.targetPos, agent->targetPos, sizeof(state.targetPos));
+            state.targetState = agent->targetState;
+            state.atTarget = isAtTarget(state, 2.0f);
+            next->bySlot[slot] = (int)next->agents.size();
+            next->index.insert(state.npcId, (int)next->agents.size());
+            next->agents.push_back(std::move(state));
         }
-        return {};
+        std::atomic_store(&snapshot, std::shared_ptr<const CrowdSnapshot>(next));
+        if (trace.snapshotDue(next->tick)) trace.recordSnapshot(next->tick, next->agents);
     }
-
-private:
-    bool loadNavMesh(const std::string& filepath) {
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            std::cout << "[ERROR] Could not open file: " << filepath << std::endl;
-            return false;
-        }
+    
+    // Update thread, right after publishSnapshot
+    void publishAgentRing() {
+        if (!agentRing || !agentRing->isOpen()) return;
         
-        file.seekg(0, std::ios::end);
-        size_t fileSize = file.tellg();
-        file.seekg(0, std::ios::beg);
+        auto current = std::atomic_load(&snapshot);
+        agentRing->beginFrame(current->tick);
+        for (const auto& state : current->agents) {
+            agentRing->append(state.npcId, state.pos, state.vel, state.targetState, state.atTarget);
+        }
+        agentRing->commitFrame();
+    }
+    
+    // Update thread, right after publishSnapshot. Skipped while nobody listens; the first
+    // subscriber asks for a keyframe, so the baselines never need to be current before that.
+    void publishAgentStream() {
+        std::lock_guard<std::mutex> lock(agentStreamMutex);
+        if (!agentStreamSink || (agentStreamWanted && !agentStreamWanted())) return;
         
-        unsigned char* data = new unsigned char[fileSize];
-        file.read(reinterpret_cast<char*>(data), fileSize);
-        file.close();
+        auto current = std::atomic_load(&snapshot);
+        bool keyframe = false;
+        const std::string& frame = agentStream.encode(current->tick, current->agents, keyframe);
+        agentStreamSink(frame, keyframe);
+    }
+    
+    // Update thread, after publishSnapshot: keep the tiles under every agent resident
+    void publishAgentInterest() {
+        if (!tileStreamer) return;
         
-        const unsigned char* d = data;
-        if (*reinterpret_cast<const int*>(d) != 0x4D534554) {
-            std::cout << "[ERROR] Not a TESM format file" << std::endl;
-            delete[] data;
-            return false;
+        auto current = std::atomic_load(&snapshot);
+        std::vector<float> points;
+        points.reserve(current->agents.size() * 3);
+        for (const auto& state : current->agents) points.insert(points.end(), state.pos, state.pos + 3);
+        tileStreamer->setInterestPoints("agents", points.data(), current->agents.size());
+    }
+    
+    // Builds a navmesh from filepath into out, touching nothing the service is using; a
+    // streamer is created but not started. A streamed navmesh takes its file from
+    // navMeshFiles when set, so zones on the same map share it; freshFile maps it again.
+    bool loadNavMesh(const std::string& filepath, LoadedNavMesh& out, bool freshFile = false) {
+        if (IndexedNavMeshFile::isIndexed(filepath)) {
+            unsigned int threads = std::thread::hardware_concurrency();
+            const int validateThreads = threads > 0 ? (int)threads : 2;
+            if (streamingConfig.enabled && navMeshFiles) {
+                out.file = navMeshFiles->open(filepath, validateThreads, freshFile);
+                if (!out.file) return false;
+            } else {
+                out.file = std::make_shared<IndexedNavMeshFile>();
+                if (!out.file->open(filepath, validateThreads)) return false;
+            }
+            out.navMesh = out.file->createNavMesh();
+            if (!out.navMesh) return false;
+            if (streamingConfig.enabled) {
+                out.streamer.reset(new TileStreamer(*out.file, out.navMesh, out.stagingMutex, streamingConfig));
+                return true;
+            }
+            return out.file->loadAll(out.navMesh) > 0;
+        }
+        if (streamingConfig.enabled) {
+            std::cout << "[PathfindingService] Tile streaming needs an indexed navmesh (--convert); loading every tile" << std::endl;
         }
-        d += sizeof(int) * 3;
         
+        // Legacy TESM dump: whole-file read, magic scan and a copy per tile.
+        // Run with --convert to produce the indexed format.
+        std::vector<unsigned char> data;
         dtNavMeshParams params;
-        memcpy(&params, d, sizeof(dtNavMeshParams));
-        d += sizeof(dtNavMeshParams);
-        
-        navMesh = dtAllocNavMesh();
-        if (!navMesh || dtStatusFailed(navMesh->init(&params))) {
-            delete[] data;
-            if(navMesh) dtFreeNavMesh(navMesh);
-            navMesh = nullptr;
+        std::vector<NavTileSpan> tiles;
+        if (!readTesmFile(filepath, data, params, tiles)) return false;
+        
+        dtNavMesh* mesh = dtAllocNavMesh();
+        if (!mesh || dtStatusFailed(mesh->init(&params))) {
+            if(mesh) dtFreeNavMesh(mesh);
             return false;
         }
+        out.navMesh = mesh;
         
         int tilesLoaded = 0;
-        const unsigned char* end = data + fileSize;
-        while (d < end - 8) {
-            if (*reinterpret_cast<const int*>(d) == 0x444E4156) {
-                const unsigned char* tileStart = d;
-                const unsigned char* nextTile = d + 8;
-                while (nextTile < end - 4 && *reinterpret_cast<const int*>(nextTile) != 0x444E4156) nextTile++;
-                size_t tileSize = (nextTile >= end - 4) ? (end - tileStart) : (nextTile - tileStart);
-                unsigned char* tileData = (unsigned char*)dtAlloc(tileSize, DT_ALLOC_PERM);
-                memcpy(tileData, tileStart, tileSize);
-                if (dtStatusSucceed(navMesh->addTile(tileData, (int)tileSize, DT_TILE_FREE_DATA, 0, nullptr))) {
+        for (const auto& tile : tiles) {
+            unsigned char* tileData = (unsigned char*)dtAlloc(tile.size, DT_ALLOC_PERM);
+            memcpy(tileData, data.data() + tile.offset, tile.size);
+            if (dtStatusSucceed(mesh->addTile(tileData, (int)tile.size, DT_TILE_FREE_DATA, 0, nullptr))) {
                 tilesLoaded++;
-                } else {
-                dtFree(tileData);  // Use dtFree instead of delete[]
-}
-                d = nextTile;
             } else {
-                d++;
+                dtFree(tileData);  // Use dtFree instead of delete[]
             }
         }
         
-        delete[] data;
         std::cout << "[DEBUG] Loaded " << tilesLoaded << " tiles successfully" << std::endl;
         return tilesLoaded > 0;
     }
     
     void cleanup() {
-        if (crowd) dtFreeCrowd(crowd);
-        if (navQuery) dtFreeNavMeshQuery(navQuery);
+        {
+            std::lock_guard<std::mutex> lock(autosaveMutex);
+            autosaveRunning = false;
+        }
+        autosaveSignal.notify_all();
+        if (autosaveThread.joinable()) autosaveThread.join();
+        {
+            std::lock_guard<std::mutex> lock(reloadMutex);
+            reloadCancelled = true;
+        }
+        reloadSignal.notify_all();
+        if (reloadThread.joinable()) reloadThread.join();
+        reloadReady.reset();
+        trace.close();
+        tileStreamer.reset();
+        crowd.destroy();
+        losWorkers.stop();
+        planner.clear();
+        queryPool.clear();
         if (navMesh) dtFreeNavMesh(navMesh);
-        crowd = nullptr;
-        navQuery = nullptr;
+        navMeshFile.reset(); // Mapped tiles are only released once the navmesh is gone
         navMesh = nullptr;
     }
 };
 
-std::string makeHttpResponse(const std::string& content, const std::string& contentType = "application/json") {
-    std::ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n";
-    response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << content.length() << "\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";
-    response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
-    response << "Access-Control-Allow-Headers: Content-Type\r\n";
-    response << "\r\n" << content;
-    return response.str();
+// Several named worlds in one process: every zone is a PathfindingService with its own
+// navmesh, query pool and crowd, and its own update thread. The zones share the HTTP
+// server (one I/O loop and its workers), one fork-join pool for crowd shards and
+// line-of-sight batches, and the mapping of any indexed navmesh file that more than one of
+// them streams. Zone 0 also answers requests that name no zone.
+class ZoneHost {
+public:
+    struct Zone {
+        std::string key;
+        std::unique_ptr<PathfindingService> service;
+        std::unique_ptr<SharedAgentRing> agentRing;
+        std::thread updateThread;
+    };
+    
+private:
+    std::vector<std::unique_ptr<Zone>> zones;
+    ShardWorkerPool workers;
+    NavMeshFileCache navMeshFiles;
+    
+public:
+    // workerThreads: threads in the shared pool besides the ones calling into it (0 = one
+    // less than the hardware threads)
+    explicit ZoneHost(int workerThreads = 0) {
+        if (workerThreads <= 0) workerThreads = (int)std::thread::hardware_concurrency() - 1;
+        workers.start(std::max(1, workerThreads));
+    }
+    
+    ~ZoneHost() {
+        stopUpdateLoops();
+        zones.clear();
+        workers.stop();
+    }
+    
+    ZoneHost(const ZoneHost&) = delete;
+    ZoneHost& operator=(const ZoneHost&) = delete;
+    
+    // Keys go into URLs and file names: letters, digits, '-' and '_'
+    static bool isValidKey(std::string_view key) {
+        if (key.empty() || key.size() > 64) return false;
+        for (char c : key) {
+            if (!isalnum((unsigned char)c) && c != '-' && c != '_') return false;
+        }
+        return true;
+    }
+    
+    // The new zone's service, ready to be configured and initialized; null for a bad or taken key
+    PathfindingService* addZone(const std::string& key) {
+        if (!isValidKey(key) || find(key)) return nullptr;
+        auto zone = std::make_unique<Zone>();
+        zone->key = key;
+        zone->service = std::make_unique<PathfindingService>();
+        zone->service->joinZoneHost(key, (int)zones.size(), &navMeshFiles, &workers);
+        zones.push_back(std::move(zone));
+        return zones.back()->service.get();
+    }
+    
+    PathfindingService* find(std::string_view key) const {
+        for (const auto& zone : zones) {
+            if (zone->key == key) return zone->service.get();
+        }
+        return nullptr;
+    }
+    
+    size_t size() const { return zones.size(); }
+    Zone& zone(size_t index) { return *zones[index]; }
+    
+    // Shared-memory agent ring per zone: zone 0 keeps the plain name, the others append their key
+    bool openAgentRing(size_t index, const std::string& baseName, uint32_t slots) {
+        Zone& target = *zones[index];
+        const std::string name = index == 0 ? baseName : baseName + "-" + target.key;
+        auto ring = std::make_unique<SharedAgentRing>();
+        if (!ring->create(name, slots, target.service->getMaxAgents())) return false;
+        target.agentRing = std::move(ring);
+        target.service->attachAgentRing(target.agentRing.get());
+        std::cout << "[ZoneHost] Zone '" << target.key << "' publishes agent state to shared memory '" << name << "'" << std::endl;
+        return true;
+    }
+    
+    // One update thread per zone; each sleeps between its fixed steps. Returns once every
+    // loop runs, so a stopUpdateLoops right after cannot be missed.
+    void startUpdateLoops() {
+        for (auto& zone : zones) {
+            if (zone->updateThread.joinable()) continue;
+            PathfindingService* service = zone->service.get();
+            zone->updateThread = std::thread([service]() { service->runUpdateLoop(); });
+            while (!service->isUpdateLoopRunning()) std::this_thread::yield();
+        }
+    }
+    
+    void stopUpdateLoops() {
+        for (auto& zone : zones) zone->service->stopUpdateLoop();
+        for (auto& zone : zones) {
+            if (zone->updateThread.joinable()) zone->updateThread.join();
+        }
+    }
+    
+    int workerThreads() const { return workers.threadCount(); }
+    size_t sharedNavMeshFiles() { return navMeshFiles.openFiles(); }
+};
+
+std::string makeHttpResponse(std::string_view content, std::string_view contentType = "application/json") {
+    static const std::string_view head = "HTTP/1.1 200 OK\r\nContent-Type: ";
+    static const std::string_view tail = "\r\nAccess-Control-Allow-Origin: *\r\n"
+                                         "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                                         "Access-Control-Allow-Headers: Content-Type\r\n\r\n";
+    char length[24];
+    auto lengthEnd = std::to_chars(length, length + sizeof(length), content.size()).ptr;
+    
+    std::string response;
+    response.reserve(head.size() + contentType.size() + 18 + (lengthEnd - length) + tail.size() + content.size());
+    response.append(head.data(), head.size());
+    response.append(contentType.data(), contentType.size());
+    response.append("\r\nContent-Length: ");
+    response.append(length, lengthEnd);
+    response.append(tail.data(), tail.size());
+    response.append(content.data(), content.size());
+    return response;
+}
+
+bool parseCrowdCommand(const CommandFields& fields, PathfindingService::CrowdCommand& command) {
+    command.npcId.assign(fields.npcId.data(), fields.npcId.size());
+    command.handle = (AgentHandle)fields.handle;
+    command.pos[0] = command.pos[1] = command.pos[2] = 0.0f;
+    command.brakeForce = 10.0f;
+    if (command.npcId.empty() && command.handle == AGENT_HANDLE_NONE) return false;
+    
+    if (fields.op == "add") {
+        if (command.npcId.empty()) return false;
+        command.op = PathfindingService::CommandOp::Add;
+        command.pos[0] = fields.x;
+        command.pos[1] = fields.y;
+        command.pos[2] = fields.z;
+        return true;
+    }
+    if (fields.op == "remove") {
+        command.op = PathfindingService::CommandOp::Remove;
+        return true;
+    }
+    if (fields.op == "setTarget") {
+        if (fields.targetCount < 3) return false;
+        command.op = PathfindingService::CommandOp::SetTarget;
+        command.pos[0] = fields.target[0];
+        command.pos[1] = fields.target[1];
+        command.pos[2] = fields.target[2];
+        return true;
+    }
+    if (fields.op == "stop") {
+        command.op = PathfindingService::CommandOp::Stop;
+        return true;
+    }
+    if (fields.op == "chase") {
+        if (fields.targetCount < 3 || fields.targetId.empty()) return false;
+        command.op = PathfindingService::CommandOp::Chase;
+        command.targetId.assign(fields.targetId.data(), fields.targetId.size());
+        command.pos[0] = fields.target[0];
+        command.pos[1] = fields.target[1];
+        command.pos[2] = fields.target[2];
+        return true;
+    }
+    if (fields.op == "forceStop") {
+        command.op = PathfindingService::CommandOp::ForceStop;
+        if (fields.brakeForce != 0.0f) command.brakeForce = fields.brakeForce;
+        return true;
+    }
+    return false;
+}
+
+static std::string_view successJson(bool success) {
+    return success ? "{\"success\": true}" : "{\"success\": false}";
+}
+
+static void writeCaptureStatus(JsonWriter& json, bool success, const TraceStats& stats) {
+    json.raw("{\"success\": ").boolean(success)
+        .raw(", \"capturing\": ").boolean(stats.active)
+        .raw(", \"path\": ").string(stats.path)
+        .raw(", \"records\": ").number(stats.records)
+        .raw(", \"bytes\": ").number(stats.bytes)
+        .raw(", \"dropped\": ").number(stats.dropped).raw('}');
+}
+
+static void writeReloadStatus(JsonWriter& json, bool success, const std::string& path, const PathfindingService::NavMeshReloadStats& stats) {
+    json.raw("{\"success\": ").boolean(success)
+        .raw(", \"path\": ").string(path)
+        .raw(", \"reloading\": ").boolean(stats.reloading)
+        .raw(", \"reloads\": ").number(stats.reloads)
+        .raw(", \"failures\": ").number(stats.failures)
+        .raw(", \"lastLoadMs\": ").number((float)stats.lastLoadMs)
+        .raw(", \"lastSwapMs\": ").number((float)stats.lastSwapMs)
+        .raw(", \"lastCarried\": ").number((unsigned long long)stats.lastCarried)
+        .raw(", \"lastDropped\": ").number((unsigned long long)stats.lastDropped).raw('}');
 }
 
-std::string extractString(const std::string& json, const std::string& key) {
-    std::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]+)\"");
-    std::smatch match;
-    return std::regex_search(json, match, pattern) ? match[1].str() : "";
+static void writeCrowdStateStatus(JsonWriter& json, bool success, size_t agents, const std::string& path, const CrowdStateStats& stats) {
+    json.raw("{\"success\": ").boolean(success)
+        .raw(", \"agents\": ").number((unsigned long long)agents)
+        .raw(", \"path\": ").string(path)
+        .raw(", \"saves\": ").number(stats.saves)
+        .raw(", \"restores\": ").number(stats.restores)
+        .raw(", \"lastSaveMs\": ").number((float)stats.lastSaveMs)
+        .raw(", \"lastRestoreMs\": ").number((float)stats.lastRestoreMs)
+        .raw(", \"lastDroppedAgents\": ").number((unsigned long long)stats.lastDroppedAgents).raw('}');
 }
 
-float extractFloat(const std::string& json, const std::string& key) {
-    std::regex pattern("\"" + key + "\"\\s*:\\s*(-?\\d*\\.?\\d+)");
-    std::smatch match;
-    return std::regex_search(json, match, pattern) ? std::stof(match[1].str()) : 0.0f;
+// /pathResult body, written into buffer
+std::string_view writePathResultJson(std::string& buffer, PathTicketState state, const PathTicketResult& result) {
+    static const char* stateNames[] = {"unknown", "pending", "done", "failed"};
+    JsonWriter json(buffer);
+    json.raw("{\"success\": true, \"state\": \"").raw(stateNames[state])
+        .raw("\", \"partial\": ").boolean(result.partial)
+        .raw(", \"polys\": ").number(result.polyCount)
+        .raw(", \"legs\": ").number(result.legs)
+        .raw(", \"path\": [");
+    for (size_t i = 0; i + 2 < result.points.size(); i += 3) {
+        if (i > 0) json.raw(", ");
+        json.floats(&result.points[i], 3);
+    }
+    json.raw("]}");
+    return json.str();
 }
 
-std::vector<float> extractArray(const std::string& json, const std::string& key) {
-    std::vector<float> result;
-    std::regex pattern("\"" + key + "\"\\s*:\\s*\\[([^\\]]+)\\]");
-    std::smatch match;
-    if (std::regex_search(json, match, pattern)) {
-        std::string content = match[1].str();
-        std::regex floatPattern("(-?\\d*\\.?\\d+)");
-        auto it = std::sregex_iterator(content.begin(), content.end(), floatPattern);
-        for (; it != std::sregex_iterator(); ++it) {
-            result.push_back(std::stof((*it)[1].str()));
-        }
-    }
-    return result;
+// IPC_OP_PATH_RESULT response frame
+std::string writePathResultFrame(uint32_t requestId, uint16_t opcode, PathTicketState state, const PathTicketResult& result) {
+    IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+    writer.write<uint8_t>((uint8_t)state);
+    writer.write<uint8_t>(result.partial ? 1 : 0);
+    writer.write<uint32_t>((uint32_t)result.polyCount);
+    writer.write<uint32_t>((uint32_t)(result.points.size() / 3));
+    writer.writeFloats(result.points.data(), (int)result.points.size());
+    return writer.finish();
 }
 
 std::string handleHttpRequest(const std::string& method, const std::string& path, const std::string& body, PathfindingService& service) {
+    // Parsed fields and the response body are per worker thread and reused, so steady-state
+    // requests only allocate for the returned response and the npc id strings
+    static thread_local RequestFields fields;
+    static thread_local std::string responseBody;
+    
     if (method == "POST") {
+        parseRequestFields(body, fields);
+        JsonWriter json(responseBody);
+        std::string npcId(fields.npcId);
+        // Agent endpoints take "handle" (from /addAggroedNPC or /batch) in place of "npcId"
+        const AgentHandle handle = (AgentHandle)fields.handle;
+        
         if (path == "/getClosestNavPoint") {
-            auto result = service.getClosestNavPoint(extractFloat(body, "x"), extractFloat(body, "y"), extractFloat(body, "z"));
-            std::ostringstream json;
-            json << "{\"success\": " << (result.empty() ? "false" : "true") << ", \"point\": " << (result.empty() ? "null" : "{\"x\":" + std::to_string(result[0]) + ",\"y\":" + std::to_string(result[1]) + ",\"z\":" + std::to_string(result[2]) + "}") << "}";
+            auto result = service.getClosestNavPoint(fields.x, fields.y, fields.z);
+            if (result.empty()) return makeHttpResponse("{\"success\": false, \"point\": null}");
+            json.raw("{\"success\": true, \"point\": {\"x\":").number(result[0])
+                .raw(",\"y\":").number(result[1])
+                .raw(",\"z\":").number(result[2]).raw("}}");
             return makeHttpResponse(json.str());
         }
         if (path == "/hasLineOfSight") {
-            auto start = extractArray(body, "start"), end = extractArray(body, "end");
-            if (start.size() >= 3 && end.size() >= 3) {
-                bool hasLOS = service.hasLineOfSight(start[0], start[1], start[2], end[0], end[1], end[2]);
-                return makeHttpResponse("{\"success\": true, \"hasLineOfSight\": " + std::string(hasLOS ? "true" : "false") + "}");
+            if (fields.startCount >= 3 && fields.endCount >= 3) {
+                bool hasLOS = service.hasLineOfSight(fields.start[0], fields.start[1], fields.start[2], fields.end[0], fields.end[1], fields.end[2]);
+                return makeHttpResponse(hasLOS ? "{\"success\": true, \"hasLineOfSight\": true}" : "{\"success\": true, \"hasLineOfSight\": false}");
             }
         }
         if (path == "/setNPCTarget") {
-            auto target = extractArray(body, "target");
-            if (!extractString(body, "npcId").empty() && target.size() >= 3) {
-                bool success = service.setNPCTarget(extractString(body, "npcId"), target[0], target[1], target[2]);
-                return makeHttpResponse("{\"success\": " + std::string(success ? "true" : "false") + "}");
+            if (handle != AGENT_HANDLE_NONE && fields.targetCount >= 3) {
+                return makeHttpResponse(successJson(service.setNPCTarget(handle, fields.target[0], fields.target[1], fields.target[2])));
+            }
+            if (!npcId.empty() && fields.targetCount >= 3) {
+                return makeHttpResponse(successJson(service.setNPCTarget(npcId, fields.target[0], fields.target[1], fields.target[2])));
             }
         }
+        // Response: {"success": true, "handle": N} - N addresses the agent in later calls until it is removed
         if (path == "/addAggroedNPC") {
-            if (!extractString(body, "npcId").empty()) {
-                bool success = service.addAggroedNPC(extractString(body, "npcId"), extractFloat(body, "x"), extractFloat(body, "y"), extractFloat(body, "z"));
-                return makeHttpResponse("{\"success\": " + std::string(success ? "true" : "false") + "}");
+            if (!npcId.empty()) {
+                AgentHandle added = service.addAggroedNPC(npcId, fields.x, fields.y, fields.z);
+                json.raw("{\"success\": ").boolean(added != AGENT_HANDLE_NONE)
+                    .raw(", \"handle\": ").number((unsigned long long)added).raw('}');
+                return makeHttpResponse(json.str());
             }
         }
         if (path == "/removeAggroedNPC") {
-            if (!extractString(body, "npcId").empty()) {
-                bool success = service.removeAggroedNPC(extractString(body, "npcId"));
-                return makeHttpResponse("{\"success\": " + std::string(success ? "true" : "false") + "}");
+            if (handle != AGENT_HANDLE_NONE) return makeHttpResponse(successJson(service.removeAggroedNPC(handle)));
+            if (!npcId.empty()) {
+                return makeHttpResponse(successJson(service.removeAggroedNPC(npcId)));
             }
         }
         if (path == "/stopNPC") {
-            std::string npcId = extractString(body, "npcId");
+            if (handle != AGENT_HANDLE_NONE) return makeHttpResponse(successJson(service.stopNPC(handle)));
             if (!npcId.empty()) {
-                bool success = service.stopNPC(npcId);
-                return makeHttpResponse("{\"success\": " + std::string(success ? "true" : "false") + "}");
+                return makeHttpResponse(successJson(service.stopNPC(npcId)));
             }
         }
         // NEW: Force stop endpoint
         if (path == "/forceStopNPC") {
-            std::string npcId = extractString(body, "npcId");
-            float brakeForce = extractFloat(body, "brakeForce");
+            float brakeForce = fields.brakeForce;
             if (brakeForce == 0.0f) brakeForce = 10.0f; // Default brake force
             
+            if (handle != AGENT_HANDLE_NONE) return makeHttpResponse(successJson(service.forceStopNPC(handle, brakeForce)));
             if (!npcId.empty()) {
-                bool success = service.forceStopNPC(npcId, brakeForce);
-                return makeHttpResponse("{\"success\": " + std::string(success ? "true" : "false") + "}");
+                return makeHttpResponse(successJson(service.forceStopNPC(npcId, brakeForce)));
             }
         }
         // NEW: Target reached check endpoint
         if (path == "/isAgentAtTarget") {
-            std::string npcId = extractString(body, "npcId");
-            if (!npcId.empty()) {
-                bool atTarget = service.isAgentAtTarget(npcId);
-                return makeHttpResponse("{\"success\": true, \"atTarget\": " + std::string(atTarget ? "true" : "false") + "}");
+            if (!npcId.empty() || handle != AGENT_HANDLE_NONE) {
+                bool atTarget = handle != AGENT_HANDLE_NONE ? service.isAgentAtTarget(handle) : service.isAgentAtTarget(npcId);
+                return makeHttpResponse(atTarget ? "{\"success\": true, \"atTarget\": true}" : "{\"success\": true, \"atTarget\": false}");
             }
         }
         if (path == "/getAgentPosition") {
-            auto pos = service.getAgentPosition(extractString(body, "npcId"));
-            std::ostringstream json;
-            json << "{\"success\": " << (pos.empty() ? "false" : "true") << ", \"position\": " << (pos.empty() ? "null" : "[" + std::to_string(pos[0]) + "," + std::to_string(pos[1]) + "," + std::to_string(pos[2]) + "]") << "}";
+            auto pos = handle != AGENT_HANDLE_NONE ? service.getAgentPosition(handle) : service.getAgentPosition(npcId);
+            if (pos.empty()) return makeHttpResponse("{\"success\": false, \"position\": null}");
+            json.raw("{\"success\": true, \"position\": ").floats(pos.data(), 3).raw('}');
             return makeHttpResponse(json.str());
         }
         if (path == "/getAgentVelocity") {
-            auto vel = service.getAgentVelocity(extractString(body, "npcId"));
-            std::ostringstream json;
-            json << "{\"success\": " << (vel.empty() ? "false" : "true") << ", \"velocity\": " << (vel.empty() ? "null" : "[" + std::to_string(vel[0]) + "," + std::to_string(vel[1]) + "," + std::to_string(vel[2]) + "]") << "}";
+            auto vel = handle != AGENT_HANDLE_NONE ? service.getAgentVelocity(handle) : service.getAgentVelocity(npcId);
+            if (vel.empty()) return makeHttpResponse("{\"success\": false, \"velocity\": null}");
+            json.raw("{\"success\": true, \"velocity\": ").floats(vel.data(), 3).raw('}');
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Ordered batch of crowd mutations applied between two crowd updates
+        // Body: {"commands": [{"op": "add"|"remove"|"setTarget"|"stop"|"forceStop"|"chase", "npcId": "...", ...}, ...]}
+        // "chase" takes "targetId" and "target": agents chasing the same targetId share one flow field
+        // Every op but "add" may give "handle" instead of "npcId"
+        // Response: {"success": true, "tick": N, "results": [true, false, ...], "handles": [N, 0, ...]} - one entry
+        // per command, in order; handles[i] is the agent command i addressed (the new one for "add"), 0 if it failed
+        if (path == "/batch") {
+            std::vector<PathfindingService::CrowdCommand> commands;
+            std::vector<bool> parsed;
+            commands.reserve(fields.commands.size());
+            parsed.reserve(fields.commands.size());
+            for (const auto& commandFields : fields.commands) {
+                PathfindingService::CrowdCommand command;
+                bool ok = parseCrowdCommand(commandFields, command);
+                parsed.push_back(ok);
+                if (ok) commands.push_back(std::move(command));
+            }
+            
+            unsigned long long tick = 0;
+            std::vector<AgentHandle> handles;
+            auto applied = service.applyBatch(commands, tick, &handles);
+            json.raw("{\"success\": true, \"tick\": ").number(tick).raw(", \"results\": [");
+            for (size_t i = 0, next = 0; i < parsed.size(); i++) {
+                bool success = parsed[i] && applied[next++];
+                if (i > 0) json.raw(',');
+                json.boolean(success);
+            }
+            json.raw("], \"handles\": [");
+            for (size_t i = 0, next = 0; i < parsed.size(); i++) {
+                if (i > 0) json.raw(',');
+                json.number(parsed[i] ? (unsigned long long)handles[next++] : 0ULL);
+            }
+            json.raw("]}");
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Bulk agent state - replaces per-agent isAgentAtTarget/getAgentPosition/getAgentVelocity polling
+        // Filter with "npcIds" or "handles" (every agent when both are absent)
+        // Response: {"success": true, "tick": N, "agents": {"npcId": [px,py,pz, vx,vy,vz, targetState, atTarget, handle], ...}}
+        if (path == "/getAgentStates") {
+            float threshold = fields.threshold;
+            if (threshold <= 0.0f) threshold = 2.0f; // Same default as isAgentAtTarget
+            
+            unsigned long long tick = 0;
+            std::vector<PathfindingService::AgentState> states;
+            if (!fields.handles.empty()) {
+                states = service.getAgentStates(fields.handles, tick, threshold);
+            } else {
+                static thread_local std::vector<std::string> npcIds;
+                npcIds.resize(fields.npcIds.size());
+                for (size_t i = 0; i < fields.npcIds.size(); i++) npcIds[i].assign(fields.npcIds[i].data(), fields.npcIds[i].size());
+                states = service.getAgentStates(npcIds, tick, threshold);
+            }
+            json.raw("{\"success\": true, \"tick\": ").number(tick).raw(", \"agents\": {");
+            for (size_t i = 0; i < states.size(); i++) {
+                const auto& state = states[i];
+                if (i > 0) json.raw(',');
+                json.string(state.npcId).raw(":[");
+                for (int k = 0; k < 3; k++) json.fixed(state.pos[k], 3).raw(',');
+                for (int k = 0; k < 3; k++) json.fixed(state.vel[k], 3).raw(',');
+                json.number(state.targetState).raw(',').raw(state.atTarget ? '1' : '0').raw(',')
+                    .number((unsigned long long)state.handle).raw(']');
+            }
+            json.raw("}}");
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Player positions that navmesh tiles are streamed around (ignored when streaming is off)
+        // Body: {"points": [[x,y,z], ...]} - replaces the previous set
+        if (path == "/setInterestPoints") {
+            service.setInterestPoints(fields.points.data(), fields.points.size() / 3);
+            return makeHttpResponse(successJson(true));
+        }
+        // NEW: Targetable players for /nearestTargets, sent once per server tick
+        // Body: {"playerIds": [...], "points": [[x,y,z], ...]} - replaces the previous set
+        if (path == "/setPlayers") {
+            service.setPlayers(fields.playerIds, fields.points.data(), fields.points.size() / 3);
+            return makeHttpResponse(successJson(true));
+        }
+        // NEW: Nearest player for many NPCs at once, from the grid instead of NPC x player loops in JS
+        // Body: {"points": [[x,y,z], ...], "radii": [r, ...] or "radius": r, "lineOfSight": bool}
+        // -> {"targets": [playerId or null, ...], "distances": [...]}
+        if (path == "/nearestTargets") {
+            const size_t count = fields.points.size() / 3;
+            static thread_local std::vector<float> queries;
+            static thread_local std::vector<PathfindingService::TargetMatch> matches;
+            queries.resize(count * 4);
+            for (size_t i = 0; i < count; i++) {
+                memcpy(&queries[i * 4], &fields.points[i * 3], sizeof(float) * 3);
+                queries[i * 4 + 3] = i < fields.radii.size() ? fields.radii[i] : fields.radius;
+            }
+            auto grid = service.findNearestTargets(queries.data(), count, fields.lineOfSight, matches);
+            json.raw("{\"success\": true, \"players\": ").number((unsigned long long)grid->size()).raw(", \"targets\": [");
+            for (size_t i = 0; i < count; i++) {
+                if (i > 0) json.raw(',');
+                if (matches[i].player >= 0) json.string(grid->id(matches[i].player));
+                else json.raw("null");
+            }
+            json.raw("], \"distances\": [");
+            for (size_t i = 0; i < count; i++) {
+                if (i > 0) json.raw(',');
+                json.number(matches[i].distance);
+            }
+            json.raw("]}");
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Load the navmesh file again (e.g. after replacing it) without a restart; returns
+        // once the load started, GET /navmesh tells when it was swapped in
+        if (path == "/reloadNavMesh") {
+            bool started = service.reloadNavMesh();
+            writeReloadStatus(json, started, service.getNavMeshPath(), service.getReloadStats());
+            return makeHttpResponse(json.str());
+        }
+        // NEW: {"op": "save" | "restore"} the whole crowd to or from the crowd state file, e.g.
+        // around a deploy. Restore replaces every agent; handles stay as they were saved.
+        if (path == "/crowdState") {
+            bool ok = false;
+            size_t agents = 0;
+            if (fields.op == "save") ok = service.saveCrowdState(service.getCrowdStatePath(), &agents);
+            else if (fields.op == "restore") ok = service.restoreCrowdState(service.getCrowdStatePath(), 0, &agents);
+            writeCrowdStateStatus(json, ok, agents, service.getCrowdStatePath(), service.getCrowdStateStats());
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Player constructions and vehicles the baked navmesh lacks. Queued, applied next tick.
+        // Body: {"op": "add" (also moves) | "remove", "obstacles": [{"id", "shape": "box" | "cylinder",
+        //        "center": [x,y,z], "halfExtents": [x,y,z], "yaw", "radius", "height"}, ...]}
+        if (path == "/obstacles") {
+            const bool remove = fields.op == "remove";
+            size_t accepted = 0;
+            for (const auto& obstacle : fields.obstacles) {
+                if (obstacle.id.empty()) continue;
+                if (remove) {
+                    service.removeObstacle(std::string(obstacle.id));
+                    accepted++;
+                    continue;
+                }
+                ObstacleSpec spec;
+                spec.id.assign(obstacle.id.data(), obstacle.id.size());
+                if (obstacle.centerCount < 3) continue;
+                memcpy(spec.center, obstacle.center, sizeof(spec.center));
+                if (obstacle.shape == "cylinder") {
+                    if (obstacle.radius <= 0.0f) continue;
+                    spec.shape = OBSTACLE_CYLINDER;
+                    spec.halfExtents[0] = spec.halfExtents[2] = obstacle.radius;
+                    spec.halfExtents[1] = obstacle.height * 0.5f;
+                } else {
+                    if (obstacle.halfExtentsCount < 3) continue;
+                    memcpy(spec.halfExtents, obstacle.halfExtents, sizeof(spec.halfExtents));
+                    spec.yaw = obstacle.yaw;
+                }
+                service.addObstacle(spec);
+                accepted++;
+            }
+            json.raw("{\"success\": true, \"accepted\": ").number((unsigned long long)accepted).raw('}');
             return makeHttpResponse(json.str());
         }
         if (path == "/testNavMesh") {
-            auto start = extractArray(body, "start"), end = extractArray(body, "end");
-            if (start.size() >= 3 && end.size() >= 3) {
-                auto path = service.testNavMesh(start[0], start[1], start[2], end[0], end[1], end[2]);
-                std::ostringstream json;
-                json << "{\"success\": true, \"path\": [";
+            if (fields.startCount >= 3 && fields.endCount >= 3) {
+                auto path = service.testNavMesh(fields.start[0], fields.start[1], fields.start[2], fields.end[0], fields.end[1], fields.end[2]);
+                json.raw("{\"success\": true, \"path\": [");
                 for (size_t i = 0; i < path.size(); i++) {
-                    if (i > 0) json << ", ";
-                    json << "[" << path[i][0] << ", " << path[i][1] << ", " << path[i][2] << "]";
+                    if (i > 0) json.raw(", ");
+                    json.floats(path[i].data(), 3);
+                }
+                json.raw("]}");
+                return makeHttpResponse(json.str());
+            }
+        }
+        // NEW: Many line-of-sight checks in one request - {"pairs": [[sx,sy,sz,ex,ey,ez], ...]}
+        // -> "visible": u32 words, bit i (LSB first) set when pair i can see its end
+        if (path == "/hasLineOfSightBatch") {
+            static thread_local std::vector<uint8_t> visible;
+            size_t count = fields.pairs.size() / 6;
+            service.hasLineOfSightBatch(fields.pairs.data(), count, visible);
+            json.raw("{\"success\": true, \"count\": ").number((unsigned long long)count).raw(", \"visible\": [");
+            for (size_t word = 0; word * 4 < visible.size(); word++) {
+                unsigned long long bits = 0;
+                for (size_t b = 0; b < 4 && word * 4 + b < visible.size(); b++) bits |= (unsigned long long)visible[word * 4 + b] << (8 * b);
+                if (word > 0) json.raw(',');
+                json.number(bits);
+            }
+            json.raw("]}");
+            return makeHttpResponse(json.str());
+        }
+        // NEW: Ticketed long path - {"start": [x,y,z], "end": [x,y,z]} -> {"ticket": N}
+        if (path == "/requestPath") {
+            if (fields.startCount >= 3 && fields.endCount >= 3) {
+                unsigned long long ticket = service.requestPath(fields.start, fields.end);
+                json.raw("{\"success\": true, \"ticket\": ").number(ticket).raw('}');
+                return makeHttpResponse(json.str());
+            }
+        }
+        // NEW: Long-poll a path ticket - {"ticket": N, "waitMs": 2000}. Under the server the
+        // wait is parked, so no worker sleeps on it; the answer is sent when the ticket finishes.
+        if (path == "/pathResult") {
+            HttpResponder responder = fields.waitMs > 0 ? HttpServer::deferResponse() : HttpResponder();
+            if (responder) {
+                service.pollPathAsync(fields.ticket, (int)fields.waitMs, [responder](PathTicketState state, const PathTicketResult& result) {
+                    std::string body;
+                    responder(makeHttpResponse(writePathResultJson(body, state, result)));
+                });
+                return std::string();
+            }
+            PathTicketResult result;
+            PathTicketState state = service.pollPath(fields.ticket, (int)fields.waitMs, result);
+            return makeHttpResponse(writePathResultJson(responseBody, state, result));
+        }
+        // NEW: Cached path query - {"start": [x,y,z], "end": [x,y,z]}
+        if (path == "/findPath") {
+            if (fields.startCount >= 3 && fields.endCount >= 3) {
+                PathfindingService::PathResult result;
+                service.findPath(fields.start, fields.end, result);
+                json.raw("{\"success\": true, \"found\": ").boolean(result.found)
+                    .raw(", \"partial\": ").boolean(result.partial)
+                    .raw(", \"cached\": ").boolean(result.cached)
+                    .raw(", \"path\": [");
+                for (size_t i = 0; i + 2 < result.points.size(); i += 3) {
+                    if (i > 0) json.raw(", ");
+                    json.floats(&result.points[i], 3);
                 }
-                json << "]}";
+                json.raw("]}");
                 return makeHttpResponse(json.str());
             }
         }
+        // NEW: Request capture - {"op": "start"|"stop"}; the file is set with --capture-path
+        if (path == "/capture") {
+            bool ok = true;
+            if (fields.op == "start") ok = service.startCapture(service.getCapturePath());
+            else if (fields.op == "stop") service.stopCapture();
+            else ok = false;
+            writeCaptureStatus(json, ok, service.getTrace().getStats());
+            return makeHttpResponse(json.str());
+        }
+    }
+    // NEW: Capture status
+    if (method == "GET" && path == "/capture") {
+        JsonWriter json(responseBody);
+        writeCaptureStatus(json, true, service.getTrace().getStats());
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Resident tile status - {"streaming": bool, "residentTiles": N, ..., "tiles": [[x,y,layer], ...]}
+    if (method == "GET" && path == "/tiles") {
+        static thread_local std::vector<int> tileCoords;
+        tileCoords.clear();
+        TileStreamingStats stats = service.getTileStats(&tileCoords);
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"streaming\": ").boolean(stats.enabled)
+            .raw(", \"radius\": ").number(stats.radius)
+            .raw(", \"totalTiles\": ").number((unsigned long long)stats.totalTiles)
+            .raw(", \"residentTiles\": ").number((unsigned long long)stats.residentTiles)
+            .raw(", \"residentBytes\": ").number((unsigned long long)stats.residentBytes)
+            .raw(", \"budgetBytes\": ").number((unsigned long long)stats.budgetBytes)
+            .raw(", \"interestPoints\": ").number((unsigned long long)stats.interestPoints)
+            .raw(", \"loads\": ").number(stats.loads)
+            .raw(", \"evictions\": ").number(stats.evictions)
+            .raw(", \"budgetSkips\": ").number(stats.budgetSkips)
+            .raw(", \"lastPassMs\": ").number((float)stats.lastPassMs)
+            .raw(", \"tiles\": [");
+        for (size_t i = 0; i + 2 < tileCoords.size(); i += 3) {
+            if (i > 0) json.raw(',');
+            json.raw('[').number(tileCoords[i]).raw(',').number(tileCoords[i + 1]).raw(',').number(tileCoords[i + 2]).raw(']');
+        }
+        json.raw("]}");
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Shared flow field counters
+    if (method == "GET" && path == "/flowFields") {
+        FlowFieldStats stats = service.getFlowFieldStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"targets\": ").number((unsigned long long)stats.targets)
+            .raw(", \"chasers\": ").number((unsigned long long)stats.chasers)
+            .raw(", \"fieldPolys\": ").number((unsigned long long)stats.fieldPolys)
+            .raw(", \"builds\": ").number(stats.builds)
+            .raw(", \"steered\": ").number(stats.steered)
+            .raw(", \"fallbacks\": ").number(stats.fallbacks).raw('}');
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Sliced planner queue and per-tick cost
+    if (method == "GET" && path == "/planner") {
+        PathPlannerStats stats = service.getPlannerStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"queued\": ").number((unsigned long long)stats.queued)
+            .raw(", \"running\": ").number((unsigned long long)stats.running)
+            .raw(", \"finished\": ").number((unsigned long long)stats.finished)
+            .raw(", \"issued\": ").number(stats.issued)
+            .raw(", \"completed\": ").number(stats.completed)
+            .raw(", \"failed\": ").number(stats.failed)
+            .raw(", \"restarts\": ").number(stats.restarts)
+            .raw(", \"iterations\": ").number(stats.iterations)
+            .raw(", \"outOfNodes\": ").number(stats.outOfNodes)
+            .raw(", \"parkedPolls\": ").number((unsigned long long)stats.parkedPolls)
+            .raw(", \"lastTickIterations\": ").number(stats.lastTickIterations)
+            .raw(", \"lastTickMs\": ").number((float)stats.lastTickMs)
+            .raw(", \"maxTickMs\": ").number((float)stats.maxTickMs).raw('}');
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Line-of-sight batching and memo counters
+    if (method == "GET" && path == "/lineOfSight") {
+        LosStats stats = service.getLosStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"batches\": ").number(stats.batches)
+            .raw(", \"pairs\": ").number(stats.pairs)
+            .raw(", \"memoHits\": ").number(stats.memoHits)
+            .raw(", \"startLookups\": ").number(stats.startLookups)
+            .raw(", \"raycasts\": ").number(stats.raycasts)
+            .raw(", \"parallelBatches\": ").number(stats.parallelBatches)
+            .raw(", \"memoEntries\": ").number((unsigned long long)stats.memoEntries).raw('}');
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Path cache counters
+    if (method == "GET" && path == "/pathCache") {
+        PathCacheStats stats = service.getPathCacheStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"entries\": ").number((unsigned long long)stats.entries)
+            .raw(", \"capacity\": ").number((unsigned long long)stats.capacity)
+            .raw(", \"hits\": ").number(stats.hits)
+            .raw(", \"misses\": ").number(stats.misses)
+            .raw(", \"stores\": ").number(stats.stores)
+            .raw(", \"evictions\": ").number(stats.evictions)
+            .raw(", \"invalidations\": ").number(stats.invalidations).raw('}');
+        return makeHttpResponse(json.str());
+    }
+    if (method == "GET" && path == "/navmesh") {
+        JsonWriter json(responseBody);
+        writeReloadStatus(json, true, service.getNavMeshPath(), service.getReloadStats());
+        return makeHttpResponse(json.str());
+    }
+    if (method == "GET" && path == "/crowdState") {
+        JsonWriter json(responseBody);
+        CrowdStateStats stats = service.getCrowdStateStats();
+        writeCrowdStateStatus(json, true, stats.lastSavedAgents, service.getCrowdStatePath(), stats);
+        return makeHttpResponse(json.str());
+    }
+    if (method == "GET" && path == "/obstacles") {
+        ObstacleStats stats = service.getObstacleStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"obstacles\": ").number((unsigned long long)stats.obstacles)
+            .raw(", \"blockedPolys\": ").number((unsigned long long)stats.blockedPolys)
+            .raw(", \"edgePolys\": ").number((unsigned long long)stats.edgePolys)
+            .raw(", \"pending\": ").number((unsigned long long)stats.pending)
+            .raw(", \"applied\": ").number(stats.applied)
+            .raw(", \"tileRemarks\": ").number(stats.tileRemarks)
+            .raw(", \"lastApplyMs\": ").number((float)stats.lastApplyMs).raw('}');
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Update loop timing and crowd LOD distribution
+    if (method == "GET" && path == "/scheduler") {
+        TickSchedulerStats stats = service.getSchedulerStats();
+        CrowdLodStats lodStats = service.getLodStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"stepMs\": ").number(stats.stepSeconds * 1000.0f)
+            .raw(", \"ticks\": ").number(stats.ticks)
+            .raw(", \"substeps\": ").number(stats.substeps)
+            .raw(", \"overruns\": ").number(stats.overruns)
+            .raw(", \"catchUpTicks\": ").number(stats.catchUpTicks)
+            .raw(", \"droppedMs\": ").number((float)stats.droppedMs)
+            .raw(", \"lastStepMs\": ").number((float)stats.lastStepMs)
+            .raw(", \"avgStepMs\": ").number((float)stats.avgStepMs)
+            .raw(", \"maxStepMs\": ").number((float)stats.maxStepMs)
+            .raw(", \"lod\": {\"near\": ").number((unsigned long long)lodStats.nearAgents)
+            .raw(", \"mid\": ").number((unsigned long long)lodStats.midAgents)
+            .raw(", \"far\": ").number((unsigned long long)lodStats.farAgents)
+            .raw(", \"paramUpdates\": ").number(lodStats.paramUpdates).raw("}}");
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Crowd shard occupancy and timing
+    if (method == "GET" && path == "/crowd") {
+        CrowdShardStats stats = service.getCrowdStats();
+        JsonWriter json(responseBody);
+        json.raw("{\"success\": true, \"maxAgents\": ").number(stats.capacity)
+            .raw(", \"agents\": ").number(stats.agents)
+            .raw(", \"shards\": ").number(stats.shards)
+            .raw(", \"migrations\": ").number(stats.migrations)
+            .raw(", \"ghosts\": ").number(stats.ghosts)
+            .raw(", \"lastUpdateMs\": ").number((float)stats.lastUpdateMs)
+            .raw(", \"shardAgents\": [");
+        for (size_t i = 0; i < stats.shardAgents.size(); i++) {
+            if (i > 0) json.raw(',');
+            json.number(stats.shardAgents[i]);
+        }
+        json.raw("], \"shardUpdateMs\": [");
+        for (size_t i = 0; i < stats.shardUpdateMs.size(); i++) {
+            if (i > 0) json.raw(',');
+            json.number((float)stats.shardUpdateMs[i]);
+        }
+        json.raw("]}");
+        return makeHttpResponse(json.str());
+    }
+    // NEW: Prometheus text exposition of the request histograms, tick timing and gauges
+    if (method == "GET" && path == "/metrics") {
+        CrowdShardStats crowdStats = service.getCrowdStats();
+        TileStreamingStats tileStats = service.getTileStats();
+        PathCacheStats cacheStats = service.getPathCacheStats();
+        PathPlannerStats plannerStats = service.getPlannerStats();
+        TickSchedulerStats schedulerStats = service.getSchedulerStats();
+        LosStats losStats = service.getLosStats();
+        AgentStreamStats streamStats = service.getAgentStreamStats();
+        ObstacleStats obstacleStats = service.getObstacleStats();
+        PathfindingService::NavMeshReloadStats reloadStats = service.getReloadStats();
+
+        MetricsWriter out(responseBody);
+        service.getMetrics().write(out);
+        out.single("pathfinding_planner_out_of_nodes_total", "counter", "Sliced planner legs that ran out of query nodes (DT_OUT_OF_NODES)", plannerStats.outOfNodes)
+            .single("pathfinding_planner_queued", "gauge", "Path tickets waiting for a search slot", (unsigned long long)plannerStats.queued)
+            .single("pathfinding_planner_running", "gauge", "Path tickets being searched", (unsigned long long)plannerStats.running)
+            .single("pathfinding_planner_parked_polls", "gauge", "Path result long-polls parked until their ticket finishes", (unsigned long long)plannerStats.parkedPolls)
+            .single("pathfinding_agents", "gauge", "Active crowd agents", (unsigned long long)crowdStats.agents)
+            .single("pathfinding_agent_capacity", "gauge", "Crowd agent capacity over every shard", (unsigned long long)crowdStats.capacity)
+            .single("pathfinding_crowd_shards", "gauge", "dtCrowd shards", (unsigned long long)crowdStats.shards)
+            .single("pathfinding_crowd_migrations_total", "counter", "Agents moved to another shard", crowdStats.migrations)
+            .single("pathfinding_crowd_ghosts", "gauge", "Border agents mirrored into a neighbour shard last tick", (unsigned long long)crowdStats.ghosts)
+            .single("pathfinding_tick_overruns_total", "counter", "Update steps that took longer than the fixed step", schedulerStats.overruns)
+            .single("pathfinding_tick_dropped_seconds_total", "counter", "Wall time dropped by the catch-up cap", schedulerStats.droppedMs / 1000.0)
+            .single("pathfinding_tiles_resident", "gauge", "Navmesh tiles currently loaded", (unsigned long long)tileStats.residentTiles)
+            .single("pathfinding_tiles_total", "gauge", "Navmesh tiles in the file", (unsigned long long)tileStats.totalTiles)
+            .single("pathfinding_tile_resident_bytes", "gauge", "Tile data currently loaded", (unsigned long long)tileStats.residentBytes)
+            .single("pathfinding_path_cache_entries", "gauge", "Corridors in the path cache", (unsigned long long)cacheStats.entries)
+            .single("pathfinding_path_cache_hits_total", "counter", "Path cache hits", cacheStats.hits)
+            .single("pathfinding_path_cache_misses_total", "counter", "Path cache misses", cacheStats.misses)
+            .single("pathfinding_los_memo_entries", "gauge", "Memoized line-of-sight results", (unsigned long long)losStats.memoEntries)
+            .single("pathfinding_los_raycasts_total", "counter", "Line-of-sight raycasts run", losStats.raycasts)
+            .single("pathfinding_obstacles", "gauge", "Dynamic obstacles on the navmesh", (unsigned long long)obstacleStats.obstacles)
+            .single("pathfinding_obstacle_blocked_polys", "gauge", "Polys excluded by a dynamic obstacle", (unsigned long long)obstacleStats.blockedPolys)
+            .single("pathfinding_navmesh_reloads_total", "counter", "Navmesh reloads swapped in", reloadStats.reloads)
+            .single("pathfinding_navmesh_reload_swap_seconds", "gauge", "Navmesh held exclusively by the last reload swap", reloadStats.lastSwapMs / 1000.0)
+            .single("pathfinding_agent_stream_frames_total", "counter", "Agent stream frames encoded", streamStats.frames)
+            .single("pathfinding_agent_stream_keyframes_total", "counter", "Agent stream keyframes encoded", streamStats.keyframes)
+            .single("pathfinding_agent_stream_bytes_total", "counter", "Agent stream bytes encoded, before per-subscriber fan-out", streamStats.bytes)
+            .single("pathfinding_process_resident_bytes", "gauge", "Resident memory of the service process", processResidentBytes());
+        return makeHttpResponse(out.str(), "text/plain; version=0.0.4");
     }
     if (method == "GET" && path == "/health") {
-        return makeHttpResponse("{\"status\": \"ok\", \"service\": \"64-bit pathfinding enhanced\"}");
+        JsonWriter json(responseBody);
+        json.raw("{\"status\": \"ok\", \"service\": \"64-bit pathfinding enhanced\", \"maxAgents\": ").number(service.getMaxAgents())
+            .raw(", \"zone\": ").string(service.getZoneKey())
+            .raw(", \"zoneIndex\": ").number(service.getZoneIndex()).raw('}');
+        return makeHttpResponse(json.str());
     }
     if (method == "OPTIONS") {
         return makeHttpResponse("", "text/plain");
@@ -511,68 +2598,510 @@ std::string handleHttpRequest(const std::string& method, const std::string& path
     return makeHttpResponse("{\"success\": false, \"error\": \"Unknown endpoint\"}", "application/json");
 }
 
-void runHttpServer(PathfindingService& service, int port = 8080) {
-    WSADATA wsaData;
-    WSAStartup(MAKEWORD(2, 2), &wsaData);
-    
-    SOCKET serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    char opt = 1;
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(port);
-    
-    bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
-    listen(serverSocket, 5);
-    
-    std::cout << "[HttpServer] Enhanced 64-bit pathfinding service listening on port " << port << std::endl;
-    
-    while (true) {
-        SOCKET clientSocket = accept(serverSocket, nullptr, nullptr);
-        if (clientSocket == INVALID_SOCKET) continue;
-        
-        std::thread([clientSocket, &service]() {
-            char buffer[8192];
-            int received = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-            if (received > 0) {
-                buffer[received] = '\0';
-                std::string request(buffer);
-                std::istringstream rs(request);
-                std::string method, path;
-                rs >> method >> path;
-                size_t bodyPos = request.find("\r\n\r\n");
-                std::string body = (bodyPos != std::string::npos) ? request.substr(bodyPos + 4) : "";
-                std::string response = handleHttpRequest(method, path, body, service);
-                send(clientSocket, response.c_str(), (int)response.length(), 0);
-            }
-            closesocket(clientSocket);
-        }).detach();
-    }
-    
-    closesocket(serverSocket);
-    WSACleanup();
+// Binary counterpart of handleHttpRequest - see pathfinding-ipc.h for the frame layouts
+std::string handleBinaryRequest(const std::string& frame, PathfindingService& service) {
+    IpcReader reader(frame);
+    uint32_t requestId = reader.read<uint32_t>();
+    uint16_t opcode = reader.read<uint16_t>();
+    reader.read<uint16_t>(); // zone, routed by runHttpServer
+    if (!reader.ok()) {
+        return IpcWriter(0, 0, IPC_STATUS_BAD_REQUEST).finish();
+    }
+    
+    switch (opcode) {
+        case IPC_OP_HEALTH: {
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint32_t>(IPC_PROTOCOL_VERSION);
+            return writer.finish();
+        }
+        case IPC_OP_GET_CLOSEST_NAV_POINT: {
+            float pos[3];
+            reader.readFloats(pos, 3);
+            if (!reader.ok()) break;
+            auto result = service.getClosestNavPoint(pos[0], pos[1], pos[2]);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint8_t>(result.empty() ? 0 : 1);
+            float point[3] = {0.0f, 0.0f, 0.0f};
+            if (!result.empty()) memcpy(point, result.data(), sizeof(point));
+            writer.writeFloats(point, 3);
+            return writer.finish();
+        }
+        case IPC_OP_HAS_LINE_OF_SIGHT: {
+            float ends[6];
+            reader.readFloats(ends, 6);
+            if (!reader.ok()) break;
+            bool hasLOS = service.hasLineOfSight(ends[0], ends[1], ends[2], ends[3], ends[4], ends[5]);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint8_t>(hasLOS ? 1 : 0);
+            return writer.finish();
+        }
+        case IPC_OP_BATCH: {
+            uint16_t count = reader.read<uint16_t>();
+            std::vector<PathfindingService::CrowdCommand> commands;
+            std::vector<bool> parsed;
+            commands.reserve(count);
+            parsed.reserve(count);
+            for (uint16_t i = 0; i < count && reader.ok(); i++) {
+                uint8_t op = reader.read<uint8_t>();
+                PathfindingService::CrowdCommand command;
+                command.npcId = reader.readString();
+                reader.readFloats(command.pos, 3);
+                command.brakeForce = reader.read<float>();
+                if (command.brakeForce == 0.0f) command.brakeForce = 10.0f;
+                command.handle = reader.read<uint32_t>();
+                if (op == (uint8_t)PathfindingService::CommandOp::Chase) command.targetId = reader.readString();
+                bool ok = op <= (uint8_t)PathfindingService::CommandOp::Chase &&
+                          (!command.npcId.empty() || (command.handle != AGENT_HANDLE_NONE && op != (uint8_t)PathfindingService::CommandOp::Add));
+                command.op = (PathfindingService::CommandOp)op;
+                parsed.push_back(ok);
+                if (ok) commands.push_back(command);
+            }
+            if (!reader.ok()) break;
+            
+            unsigned long long tick = 0;
+            std::vector<AgentHandle> handles;
+            auto applied = service.applyBatch(commands, tick, &handles);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint64_t>(tick);
+            writer.write<uint16_t>((uint16_t)parsed.size());
+            for (size_t i = 0, next = 0; i < parsed.size(); i++) {
+                bool success = parsed[i] && applied[next++];
+                writer.write<uint8_t>(success ? 1 : 0);
+            }
+            for (size_t i = 0, next = 0; i < parsed.size(); i++) {
+                writer.write<uint32_t>(parsed[i] ? handles[next++] : AGENT_HANDLE_NONE);
+            }
+            return writer.finish();
+        }
+        case IPC_OP_GET_AGENT_STATES: {
+            float threshold = reader.read<float>();
+            if (threshold <= 0.0f) threshold = 2.0f;
+            uint16_t idCount = reader.read<uint16_t>();
+            std::vector<std::string> npcIds;
+            npcIds.reserve(idCount);
+            for (uint16_t i = 0; i < idCount && reader.ok(); i++) {
+                npcIds.push_back(reader.readString());
+            }
+            uint16_t handleCount = reader.read<uint16_t>();
+            std::vector<AgentHandle> handles(handleCount);
+            for (uint16_t i = 0; i < handleCount && reader.ok(); i++) handles[i] = reader.read<uint32_t>();
+            if (!reader.ok()) break;
+            
+            unsigned long long tick = 0;
+            auto states = handles.empty() ? service.getAgentStates(npcIds, tick, threshold) : service.getAgentStates(handles, tick, threshold);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.reserve(states.size() * 52);
+            writer.write<uint64_t>(tick);
+            writer.write<uint16_t>((uint16_t)states.size());
+            for (const auto& state : states) {
+                writer.writeString(state.npcId);
+                writer.writeFloats(state.pos, 3);
+                writer.writeFloats(state.vel, 3);
+                writer.write<uint8_t>((uint8_t)state.targetState);
+                writer.write<uint8_t>(state.atTarget ? 1 : 0);
+                writer.write<uint32_t>(state.handle);
+            }
+            return writer.finish();
+        }
+        case IPC_OP_TEST_NAVMESH: {
+            float ends[6];
+            reader.readFloats(ends, 6);
+            if (!reader.ok()) break;
+            auto path = service.testNavMesh(ends[0], ends[1], ends[2], ends[3], ends[4], ends[5]);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint16_t>((uint16_t)path.size());
+            for (const auto& point : path) writer.writeFloats(point.data(), 3);
+            return writer.finish();
+        }
+        case IPC_OP_LINE_OF_SIGHT_BATCH: {
+            uint16_t count = reader.read<uint16_t>();
+            static thread_local std::vector<float> pairs;
+            static thread_local std::vector<uint8_t> visible;
+            pairs.resize((size_t)count * 6);
+            reader.readFloats(pairs.data(), (int)pairs.size());
+            if (!reader.ok()) break;
+            service.hasLineOfSightBatch(pairs.data(), count, visible);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint16_t>(count);
+            for (uint8_t bits : visible) writer.write<uint8_t>(bits);
+            return writer.finish();
+        }
+        case IPC_OP_REQUEST_PATH: {
+            float ends[6];
+            reader.readFloats(ends, 6);
+            if (!reader.ok()) break;
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint64_t>(service.requestPath(ends, ends + 3));
+            return writer.finish();
+        }
+        case IPC_OP_PATH_RESULT: {
+            uint64_t ticket = reader.read<uint64_t>();
+            uint32_t waitMs = reader.read<uint32_t>();
+            if (!reader.ok()) break;
+            const int wait = (int)std::min<uint32_t>(waitMs, 0x7fffffff);
+            // Parked under the server: frames behind this one are answered meanwhile
+            HttpResponder responder = wait > 0 ? HttpServer::deferResponse() : HttpResponder();
+            if (responder) {
+                service.pollPathAsync(ticket, wait, [responder, requestId, opcode](PathTicketState state, const PathTicketResult& result) {
+                    responder(writePathResultFrame(requestId, opcode, state, result));
+                });
+                return std::string();
+            }
+            PathTicketResult result;
+            PathTicketState state = service.pollPath(ticket, wait, result);
+            return writePathResultFrame(requestId, opcode, state, result);
+        }
+        case IPC_OP_SET_PLAYERS: {
+            uint16_t count = reader.read<uint16_t>();
+            static thread_local std::vector<std::string> ids;
+            static thread_local std::vector<std::string_view> idViews;
+            static thread_local std::vector<float> points;
+            ids.resize(count);
+            idViews.resize(count);
+            points.resize((size_t)count * 3);
+            for (uint16_t i = 0; i < count && reader.ok(); i++) {
+                ids[i] = reader.readString();
+                reader.readFloats(&points[(size_t)i * 3], 3);
+            }
+            if (!reader.ok()) break;
+            for (uint16_t i = 0; i < count; i++) idViews[i] = ids[i];
+            service.setPlayers(idViews, points.data(), count);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint32_t>(count);
+            return writer.finish();
+        }
+        case IPC_OP_NEAREST_TARGETS: {
+            bool lineOfSight = reader.read<uint8_t>() != 0;
+            uint16_t count = reader.read<uint16_t>();
+            static thread_local std::vector<float> queries;
+            static thread_local std::vector<PathfindingService::TargetMatch> matches;
+            queries.resize((size_t)count * 4);
+            reader.readFloats(queries.data(), (int)queries.size());
+            if (!reader.ok()) break;
+            auto grid = service.findNearestTargets(queries.data(), count, lineOfSight, matches);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint16_t>(count);
+            for (const auto& match : matches) {
+                writer.writeString(match.player >= 0 ? grid->id(match.player) : std::string());
+                writer.write<float>(match.distance);
+            }
+            return writer.finish();
+        }
+        case IPC_OP_FIND_PATH: {
+            float ends[6];
+            reader.readFloats(ends, 6);
+            if (!reader.ok()) break;
+            PathfindingService::PathResult result;
+            service.findPath(ends, ends + 3, result);
+            IpcWriter writer(requestId, opcode, IPC_STATUS_OK);
+            writer.write<uint8_t>(result.found ? 1 : 0);
+            writer.write<uint8_t>(result.partial ? 1 : 0);
+            writer.write<uint8_t>(result.cached ? 1 : 0);
+            writer.write<uint16_t>((uint16_t)(result.points.size() / 3));
+            writer.writeFloats(result.points.data(), (int)result.points.size());
+            return writer.finish();
+        }
+        default:
+            return IpcWriter(requestId, opcode, IPC_STATUS_UNKNOWN_OPCODE).finish();
+    }
+    return IpcWriter(requestId, opcode, IPC_STATUS_BAD_REQUEST).finish();
+}
+
+#ifdef _WIN32
+static const int IPC_BINARY_PORT = 8081; // Node's net module has no AF_UNIX client on Windows
+#else
+static const char* IPC_SOCKET_PATH = "/tmp/destromod-pathfinding.sock";
+#endif
+static const char* IPC_AGENT_RING_NAME = "destromod-agents";
+
+// Endpoint labels for request metrics; anything else is counted as "other"
+static const char* const HTTP_METRIC_PATHS[] = {
+    "/getClosestNavPoint", "/hasLineOfSight", "/hasLineOfSightBatch", "/testNavMesh", "/findPath",
+    "/requestPath", "/pathResult", "/setNPCTarget", "/stopNPC", "/forceStopNPC", "/addAggroedNPC",
+    "/removeAggroedNPC", "/isAgentAtTarget", "/getAgentPosition", "/getAgentVelocity", "/getAgentStates",
+    "/batch", "/setInterestPoints", "/tiles", "/flowFields", "/planner", "/lineOfSight", "/pathCache",
+    "/scheduler", "/crowd", "/capture", "/metrics", "/health", "/setPlayers", "/nearestTargets", "/obstacles",
+    "/reloadNavMesh", "/navmesh", "/crowdState", "/zones"
+};
+static const char* const IPC_METRIC_OPS[] = {
+    "health", "getClosestNavPoint", "hasLineOfSight", "batch", "getAgentStates", "testNavMesh",
+    "findPath", "lineOfSightBatch", "requestPath", "pathResult", "setPlayers", "nearestTargets"
+};
+
+// "/zones/<key>/<endpoint>" -> key and "/<endpoint>"; false for a path that names no zone
+static bool splitZonePath(std::string_view target, std::string_view& key, std::string_view& path) {
+    static const std::string_view prefix = "/zones/";
+    if (target.size() <= prefix.size() || target.substr(0, prefix.size()) != prefix) return false;
+    size_t slash = target.find('/', prefix.size());
+    if (slash == std::string_view::npos) return false;
+    key = target.substr(prefix.size(), slash - prefix.size());
+    path = target.substr(slash);
+    return true;
+}
+
+// GET /zones: every zone with the index binary clients put in their frame header
+static std::string handleZonesRequest(ZoneHost& host) {
+    static thread_local std::string responseBody;
+    JsonWriter json(responseBody);
+    json.raw("{\"workers\": ").number(host.workerThreads())
+        .raw(", \"sharedNavMeshFiles\": ").number((unsigned long long)host.sharedNavMeshFiles())
+        .raw(", \"zones\": [");
+    for (size_t i = 0; i < host.size(); i++) {
+        PathfindingService& service = *host.zone(i).service;
+        if (i > 0) json.raw(", ");
+        json.raw("{\"key\": ").string(service.getZoneKey())
+            .raw(", \"index\": ").number(service.getZoneIndex())
+            .raw(", \"navmesh\": ").string(service.getNavMeshPath())
+            .raw(", \"agents\": ").number(service.getCrowdStats().agents)
+            .raw(", \"maxAgents\": ").number(service.getMaxAgents())
+            .raw(", \"tick\": ").number(service.getTick()).raw('}');
+    }
+    json.raw("]}");
+    return makeHttpResponse(json.str());
+}
+
+void runHttpServer(ZoneHost& host, int port = 8080, int workerCount = 0) {
+    // Per zone: its service and its metric ids, fixed before the first request so recording
+    // never looks anything up under a lock
+    struct ZoneRoute {
+        PathfindingService* service;
+        std::string streamPath;
+        std::unordered_map<std::string, int> httpEndpoints;
+        int httpOther;
+        std::vector<int> ipcEndpoints;
+        int ipcOther;
+    };
+    std::vector<ZoneRoute> routes(host.size());
+    for (size_t i = 0; i < host.size(); i++) {
+        ZoneRoute& route = routes[i];
+        route.service = host.zone(i).service.get();
+        route.streamPath = "/zones/" + host.zone(i).key + "/agentStream";
+        ServiceMetrics& metrics = route.service->getMetrics();
+        for (const char* path : HTTP_METRIC_PATHS) route.httpEndpoints[path] = metrics.addEndpoint("http", path);
+        route.httpOther = metrics.addEndpoint("http", "other");
+        for (const char* op : IPC_METRIC_OPS) route.ipcEndpoints.push_back(metrics.addEndpoint("ipc", op));
+        route.ipcOther = metrics.addEndpoint("ipc", "other");
+    }
+    auto findRoute = [&routes](std::string_view key) -> ZoneRoute* {
+        for (auto& route : routes) {
+            if (route.service->getZoneKey() == key) return &route;
+        }
+        return nullptr;
+    };
+    
+    HttpServer server([&host, &routes, findRoute](const HttpRequest& request) {
+        auto start = std::chrono::steady_clock::now();
+        if (request.path == "/zones") {
+            std::string response = handleZonesRequest(host);
+            routes[0].service->getMetrics().recordRequest(routes[0].httpEndpoints.at("/zones"), std::chrono::steady_clock::now() - start);
+            return response;
+        }
+        
+        std::string_view key, zonePath;
+        ZoneRoute* route = &routes[0];
+        std::string endpointPath;
+        if (splitZonePath(request.path, key, zonePath)) {
+            route = findRoute(key);
+            if (!route) return makeHttpResponse("{\"success\": false, \"error\": \"Unknown zone\"}");
+            endpointPath.assign(zonePath.data(), zonePath.size());
+        }
+        const std::string& path = endpointPath.empty() ? request.path : endpointPath;
+        
+        PathfindingService& service = *route->service;
+        if (service.getTrace().isActive() && path != "/capture") {
+            service.getTrace().recordHttp(service.getTick(), request.method, path, request.body);
+        }
+        std::string response = handleHttpRequest(request.method, path, request.body, service);
+        auto endpoint = route->httpEndpoints.find(path);
+        service.getMetrics().recordRequest(endpoint != route->httpEndpoints.end() ? endpoint->second : route->httpOther, std::chrono::steady_clock::now() - start);
+        return response;
+    }, workerCount);
+    
+    if (!server.listen(port)) {
+        std::cerr << "[HttpServer] Could not listen on port " << port << std::endl;
+        return;
+    }
+    
+    // The HTTP/JSON API stays as the compatibility and debug path; tick-critical calls use the binary transport.
+    // The u16 after the opcode picks the zone by index.
+    auto binaryHandler = [&routes](const std::string& frame) {
+        const size_t zone = frame.size() >= IPC_HEADER_BYTES ? (size_t)((uint8_t)frame[6] | ((uint8_t)frame[7] << 8)) : 0;
+        if (zone >= routes.size()) {
+            IpcReader reader(frame);
+            uint32_t requestId = reader.read<uint32_t>();
+            uint16_t opcode = reader.read<uint16_t>();
+            return IpcWriter(requestId, opcode, IPC_STATUS_UNKNOWN_ZONE).finish();
+        }
+        ZoneRoute& route = routes[zone];
+        PathfindingService& service = *route.service;
+        if (service.getTrace().isActive()) service.getTrace().recordFrame(service.getTick(), frame);
+        auto start = std::chrono::steady_clock::now();
+        std::string response = handleBinaryRequest(frame, service);
+        // Opcode sits after the u32 request id
+        size_t opcode = frame.size() >= 6 ? (size_t)((uint8_t)frame[4] | ((uint8_t)frame[5] << 8)) : route.ipcEndpoints.size();
+        service.getMetrics().recordRequest(opcode < route.ipcEndpoints.size() ? route.ipcEndpoints[opcode] : route.ipcOther, std::chrono::steady_clock::now() - start);
+        return response;
+    };
+#ifdef _WIN32
+    bool binaryReady = server.listenBinaryTcp(IPC_BINARY_PORT, binaryHandler);
+    std::string binaryEndpoint = "127.0.0.1:" + std::to_string(IPC_BINARY_PORT);
+#else
+    bool binaryReady = server.listenBinaryUnix(IPC_SOCKET_PATH, binaryHandler);
+    std::string binaryEndpoint = IPC_SOCKET_PATH;
+#endif
+    if (binaryReady) {
+        std::cout << "[HttpServer] Binary IPC transport listening on " << binaryEndpoint << std::endl;
+    } else {
+        std::cerr << "[HttpServer] Binary IPC transport unavailable, HTTP only" << std::endl;
+    }
+    
+    // Push alternative to polling /getAgentStates, see pathfinding-agentstream.h. Every zone
+    // streams under its own prefix; zone 0 also on the plain path.
+    for (size_t i = 0; i < routes.size(); i++) {
+        PathfindingService* service = routes[i].service;
+        const std::string zonePath = routes[i].streamPath;
+        const std::string plainPath = i == 0 ? "/agentStream" : std::string();
+        server.addStream(zonePath, "application/octet-stream", [service]() { service->requestAgentStreamKeyframe(); });
+        if (!plainPath.empty()) server.addStream(plainPath, "application/octet-stream", [service]() { service->requestAgentStreamKeyframe(); });
+        service->attachAgentStream([&server, zonePath, plainPath]() {
+            return server.subscriberCount(zonePath) > 0 || (!plainPath.empty() && server.subscriberCount(plainPath) > 0);
+        }, [&server, zonePath, plainPath](const std::string& frame, bool keyframe) {
+            server.broadcast(zonePath, frame, keyframe);
+            if (!plainPath.empty()) server.broadcast(plainPath, frame, keyframe);
+        });
+    }
+    
+    std::cout << "[HttpServer] Enhanced 64-bit pathfinding service listening on port " << port << " (" << routes.size() << " zones)" << std::endl;
+    server.run();
+    for (auto& route : routes) route.service->attachAgentStream(nullptr, nullptr);
+}
+
+// Benchmarks and tools include this file with PATHFINDING_SERVICE_NO_MAIN to reuse the service
+#ifndef PATHFINDING_SERVICE_NO_MAIN
+static const char* NAVMESH_TESM_PATH = "all_tiles_navmesh_v10_64bit.bin";
+static const char* NAVMESH_INDEXED_PATH = "all_tiles_navmesh_v10_64bit.navidx";
+static const int CROWD_STATE_SAVE_SECONDS = 5;
+static const int CROWD_STATE_MAX_AGE_SECONDS = 120;
+static const char* DEFAULT_ZONE_KEY = "default";
+
+// Zone 0 keeps a configured file name; the others get their key before the extension
+// ("crowd.state" -> "crowd-z2016.state"), so zones never write over each other
+static std::string zoneFilePath(const std::string& path, const std::string& key, size_t zoneIndex) {
+    if (zoneIndex == 0) return path;
+    size_t dot = path.find_last_of('.');
+    size_t separator = path.find_last_of("/\\");
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) return path + "-" + key;
+    return path.substr(0, dot) + "-" + key + path.substr(dot);
 }
 
-int main() {
-    PathfindingService service;
-    if (!service.initialize("all_tiles_navmesh_v10_64bit.bin")) {
-        std::cerr << "Failed to initialize enhanced pathfinding service. Make sure the navmesh file is present." << std::endl;
-        std::cout << "Press Enter to exit..." << std::endl;
-        std::cin.get();
-        return 1;
+int main(int argc, char** argv) {
+    // pathfinding-service --convert [input.bin] [output.navidx]
+    if (argc > 1 && std::string(argv[1]) == "--convert") {
+        std::string input = argc > 2 ? argv[2] : NAVMESH_TESM_PATH;
+        std::string output = argc > 3 ? argv[3] : NAVMESH_INDEXED_PATH;
+        return convertTesmToIndexed(input, output) ? 0 : 1;
+    }
+    
+    // Prefer the indexed navmesh when it has been generated next to the TESM dump
+    std::string navmeshPath = std::ifstream(NAVMESH_INDEXED_PATH).good() ? NAVMESH_INDEXED_PATH : NAVMESH_TESM_PATH;
+    
+    // --zone <key>=<navmesh file> hosts one more world, addressed as /zones/<key>/... over HTTP
+    // and by its index over binary IPC; the first one also answers unprefixed requests.
+    // Without any, a single "default" zone serves the navmesh found above.
+    std::vector<std::pair<std::string, std::string>> zoneConfigs;
+    // --stream-radius <units> enables tile streaming, --stream-budget-mb <mb> caps resident tile data,
+    // --max-agents <n> sets the total crowd capacity, --crowd-shards <n> how many crowds share it
+    TileStreamingConfig streaming;
+    // --lod-near/--lod-far <units> set the crowd LOD distances (--lod-near 0 turns LOD off)
+    int maxAgents = 0, crowdShards = 0;
+    // --capture <file> records every request from startup, --capture-path <file> only sets where POST /capture writes
+    std::string capturePath;
+    bool captureAtStart = false;
+    // --crowd-state <file> restores the crowd saved there at startup (if recent) and saves it every few seconds
+    std::string crowdStatePath;
+    // --workers <n> sizes the pool every zone's crowd shards and line-of-sight batches share
+    int workerThreads = 0;
+    CrowdLodConfig lodConfig;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--lod-near") {
+            lodConfig.nearDistance = (float)atof(argv[++i]);
+            lodConfig.enabled = lodConfig.nearDistance > 0.0f;
+        } else if (arg == "--lod-far") {
+            lodConfig.farDistance = (float)atof(argv[++i]);
+        } else if (arg == "--max-agents") {
+            maxAgents = atoi(argv[++i]);
+        } else if (arg == "--capture") {
+            capturePath = argv[++i];
+            captureAtStart = true;
+        } else if (arg == "--capture-path") {
+            capturePath = argv[++i];
+        } else if (arg == "--crowd-state") {
+            crowdStatePath = argv[++i];
+        } else if (arg == "--crowd-shards") {
+            crowdShards = atoi(argv[++i]);
+        } else if (arg == "--stream-radius") {
+            streaming.radius = (float)atof(argv[++i]);
+            streaming.enabled = streaming.radius > 0.0f;
+        } else if (arg == "--stream-budget-mb") {
+            streaming.budgetBytes = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else if (arg == "--workers") {
+            workerThreads = atoi(argv[++i]);
+        } else if (arg == "--zone") {
+            std::string zone = argv[++i];
+            size_t equals = zone.find('=');
+            if (equals == std::string::npos) {
+                std::cerr << "Expected --zone <key>=<navmesh file>, got " << zone << std::endl;
+                return 1;
+            }
+            zoneConfigs.emplace_back(zone.substr(0, equals), zone.substr(equals + 1));
+        }
+    }
+    if (zoneConfigs.empty()) zoneConfigs.emplace_back(DEFAULT_ZONE_KEY, navmeshPath);
+    
+    ZoneHost host(workerThreads);
+    for (const auto& config : zoneConfigs) {
+        const std::string& key = config.first;
+        PathfindingService* service = host.addZone(key);
+        if (!service) {
+            std::cerr << "Zone key '" << key << "' is invalid or used twice (letters, digits, '-' and '_' only)" << std::endl;
+            return 1;
+        }
+        const size_t index = host.size() - 1;
+        service->setTileStreaming(streaming);
+        service->setCrowdCapacity(maxAgents, crowdShards);
+        service->setCrowdLod(lodConfig);
+        if (!capturePath.empty()) service->setCapturePath(zoneFilePath(capturePath, key, index));
+        if (!crowdStatePath.empty()) service->setCrowdStatePath(zoneFilePath(crowdStatePath, key, index));
+        std::cout << "[ZoneHost] Zone '" << key << "' (index " << index << ")" << std::endl;
+        if (!service->initialize(config.second)) {
+            std::cerr << "Failed to initialize enhanced pathfinding service. Make sure the navmesh file is present." << std::endl;
+            std::cout << "Press Enter to exit..." << std::endl;
+            std::cin.get();
+            return 1;
+        }
     }
     
-    std::thread updateThread([&service]() {
-        while (true) {
-            service.update(0.025f);
-            std::this_thread::sleep_for(std::chrono::milliseconds(33));
+    for (size_t i = 0; i < host.size(); i++) {
+        PathfindingService& service = *host.zone(i).service;
+        // 4 slots gives readers three ticks of slack before a slot is reused
+        if (!host.openAgentRing(i, IPC_AGENT_RING_NAME, 4)) {
+            std::cerr << "[PathfindingService] Shared-memory agent ring unavailable for zone '" << service.getZoneKey() << "'" << std::endl;
+        }
+        
+        if (captureAtStart) service.startCapture(service.getCapturePath());
+        
+        // Before the update loop and the server start, so the game server finds its agents in place
+        if (!crowdStatePath.empty()) {
+            service.restoreCrowdState(service.getCrowdStatePath(), CROWD_STATE_MAX_AGE_SECONDS);
+            service.startCrowdAutosave(CROWD_STATE_SAVE_SECONDS);
         }
-    });
+    }
     
-    runHttpServer(service, 8080);
+    // 40 Hz of simulated time per zone, paced by the real clock
+    host.startUpdateLoops();
     
-    updateThread.join();
+    runHttpServer(host, 8080);
     return 0;
-}
\ No newline at end of file
+}
+#endif // PATHFINDING_SERVICE_NO_MAIN
@@ -0,0 +1,431 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Spatially sharded crowd
+// The world's XZ plane is cut into square regions, grouped into square blocks that each
+// belong to one of several dtCrowd shards, so a shard owns whole neighbourhoods and only
+// meets other shards along block borders. Shards never touch each other's agents, so all
+// of them can run dtCrowd::update at the same time on a small fork-join pool. Agents close
+// to a border are mirrored into the shard across it as ghosts for that update: read-only
+// copies its agents steer around, dropped again once the shards have stepped. Agents that
+// walk into a region owned by another shard are moved across, keeping their corridor and
+// velocity.
+//
+// Agents are addressed by a handle: shard * capacity + index inside the shard.
+// ===================================================================================
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "DetourNavMesh.h"
+#include "DetourCrowd.h"
+#include "pathfinding-pathcache.h"
+
+// Fork-join pool: run(count, job) calls job(0..count-1) across the workers and the
+// calling thread and returns once every call has finished. Several threads may run jobs
+// at once (crowds of different zones, line-of-sight batches); idle workers help with the
+// oldest job that still has calls left.
+class ShardWorkerPool {
+private:
+    struct Job {
+        const std::function<void(int)>* fn;
+        int count;
+        std::atomic<int> next;
+        int finished;       // Calls completed, under mutex
+        int helpers;        // Workers still inside work() for this job, under mutex
+
+        Job(const std::function<void(int)>* job, int jobCount) : fn(job), count(jobCount), next(0), finished(0), helpers(0) {}
+    };
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::deque<Job*> jobs;  // Jobs with calls not yet handed out
+    bool stopping;
+
+    // Returns how many calls this thread made
+    static int work(Job& job) {
+        int made = 0;
+        for (int i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+            (*job.fn)(i);
+            made++;
+        }
+        return made;
+    }
+
+    // Under mutex, once every call of job has been handed out
+    void retire(Job& job) {
+        auto it = std::find(jobs.begin(), jobs.end(), &job);
+        if (it != jobs.end()) jobs.erase(it);
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            Job* job = jobs.front();
+            job->helpers++;
+            lock.unlock();
+            int made = work(*job);
+            lock.lock();
+            retire(*job);
+            job->finished += made;
+            job->helpers--;
+            if (job->finished == job->count && job->helpers == 0) jobDone.notify_all();
+        }
+    }
+
+public:
+    ShardWorkerPool() : stopping(false) {}
+
+    ~ShardWorkerPool() {
+        stop();
+    }
+
+    // threadCount extra threads; the caller of run() always works too
+    void start(int threadCount) {
+        stopping = false;
+        for (int i = 0; i < threadCount; i++) threads.emplace_back([this]() { workerLoop(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& thread : threads) {
+            if (thread.joinable()) thread.join();
+        }
+        threads.clear();
+    }
+
+    int threadCount() const { return (int)threads.size(); }
+
+    void run(int count, const std::function<void(int)>& fn) {
+        if (threads.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) fn(i);
+            return;
+        }
+        Job job(&fn, count);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(&job);
+        }
+        jobReady.notify_all();
+        int made = work(job);
+        std::unique_lock<std::mutex> lock(mutex);
+        retire(job);
+        job.finished += made;
+        // Helpers touch the job until they have counted their calls
+        jobDone.wait(lock, [&job]() { return job.finished == job.count && job.helpers == 0; });
+    }
+};
+
+struct CrowdShardStats {
+    int shards = 0;
+    int capacity = 0;
+    int agents = 0;
+    int ghosts = 0;                         // Border agents mirrored into a neighbour shard last tick
+    std::vector<int> shardAgents;
+    std::vector<double> shardUpdateMs;      // Last tick, per shard
+    unsigned long long migrations = 0;
+    double lastUpdateMs = 0.0;              // Wall time of the last parallel update
+};
+
+// Update thread only, apart from getStats
+class ShardedCrowd {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const int BLOCK_REGIONS = 4;     // Regions along each side of a shard's block
+
+    std::vector<dtCrowd*> shards;
+    std::vector<double> shardUpdateMs;
+    std::vector<std::vector<int>> ghosts;   // Per shard: indices of this update's ghost agents
+    int capacity;               // Total agents over every shard; also each shard's own size
+    int agentCount;
+    float regionSize;
+    float migrationMargin;      // How far into a foreign region an agent must be before it moves
+    ShardWorkerPool workers;
+    ShardWorkerPool* pool;      // workers, or a pool shared with other crowds
+
+    mutable std::mutex statsMutex;
+    CrowdShardStats stats;
+
+    static int regionIndex(float v, float size) {
+        return (int)std::floor(v / size);
+    }
+
+    static int floorDiv(int v, int d) {
+        return v >= 0 ? v / d : -((-v + d - 1) / d);
+    }
+
+    // Blocks are dealt out row by row over a grid about sqrt(shards) wide, so blocks that
+    // share an edge along x never share a shard
+    int shardOfRegion(int rx, int rz) const {
+        const int count = (int)shards.size();
+        const int row = (int)std::ceil(std::sqrt((double)count));
+        const int block = floorDiv(rx, BLOCK_REGIONS) + floorDiv(rz, BLOCK_REGIONS) * row;
+        return ((block % count) + count) % count;
+    }
+
+    // Before the shards step: mirror every agent within its collision query range of
+    // another shard's ground into that shard, moving as it does
+    void addGhosts() {
+        int mirrored = 0;
+        const int count = (int)shards.size();
+        for (int shard = 0; shard < count; shard++) {
+            dtCrowd* from = shards[shard];
+            const int agentTotal = from->getAgentCount();
+            for (int i = 0; i < agentTotal; i++) {
+                const dtCrowdAgent* agent = from->getAgent(i);
+                if (!agent || !agent->active || agent->state != DT_CROWDAGENT_STATE_WALKING) continue;
+                if (agent->params.userData == &ghosts) continue;   // Added by this pass
+
+                const float range = agent->params.collisionQueryRange;
+                int neighbours[8];
+                int neighbourCount = 0;
+                for (int dz = -1; dz <= 1; dz++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        if (dx == 0 && dz == 0) continue;
+                        const float probe[3] = {agent->npos[0] + dx * range, agent->npos[1], agent->npos[2] + dz * range};
+                        const int target = shardAt(probe);
+                        if (target == shard || std::find(neighbours, neighbours + neighbourCount, target) != neighbours + neighbourCount) continue;
+                        neighbours[neighbourCount++] = target;
+                    }
+                }
+
+                for (int n = 0; n < neighbourCount; n++) {
+                    dtCrowd* to = shards[neighbours[n]];
+                    dtCrowdAgentParams params = agent->params;
+                    params.updateFlags = 0;     // Its own steering is thrown away
+                    params.userData = &ghosts;
+                    int index = to->addAgent(agent->npos, &params);
+                    if (index < 0) continue;
+                    dtCrowdAgent* ghost = to->getEditableAgent(index);
+                    memcpy(ghost->vel, agent->vel, sizeof(ghost->vel));
+                    memcpy(ghost->dvel, agent->dvel, sizeof(ghost->dvel));
+                    to->requestMoveVelocity(index, agent->vel);    // Keeps dvel at its velocity for the avoidance sampling
+                    ghosts[neighbours[n]].push_back(index);
+                    mirrored++;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.ghosts = mirrored;
+    }
+
+    void removeGhosts() {
+        for (int shard = 0; shard < (int)shards.size(); shard++) {
+            for (int index : ghosts[shard]) shards[shard]->removeAgent(index);
+            ghosts[shard].clear();
+        }
+    }
+
+    bool validHandle(int handle) const {
+        return handle >= 0 && handle < capacity * (int)shards.size();
+    }
+
+    bool wellInsideRegion(const float* pos) const {
+        float fx = pos[0] - regionIndex(pos[0], regionSize) * regionSize;
+        float fz = pos[2] - regionIndex(pos[2], regionSize) * regionSize;
+        return fx >= migrationMargin && fx <= regionSize - migrationMargin &&
+               fz >= migrationMargin && fz <= regionSize - migrationMargin;
+    }
+
+public:
+    ShardedCrowd() : capacity(0), agentCount(0), regionSize(512.0f), migrationMargin(8.0f), pool(&workers) {}
+
+    ~ShardedCrowd() {
+        destroy();
+    }
+
+    // sharedWorkers: step the shards on that pool instead of starting one for this crowd
+    bool init(int shardCount, int maxAgents, float maxAgentRadius, dtNavMesh* navMesh, float shardRegionSize, ShardWorkerPool* sharedWorkers = nullptr) {
+        destroy();
+        if (shardCount < 1) shardCount = 1;
+        capacity = maxAgents;
+        regionSize = shardRegionSize;
+        for (int i = 0; i < shardCount; i++) {
+            dtCrowd* crowd = dtAllocCrowd();
+            if (!crowd || !crowd->init(maxAgents, maxAgentRadius, navMesh)) {
+                if (crowd) dtFreeCrowd(crowd);
+                destroy();
+                return false;
+            }
+            shards.push_back(crowd);
+        }
+        shardUpdateMs.assign(shards.size(), 0.0);
+        ghosts.assign(shards.size(), std::vector<int>());
+        pool = sharedWorkers ? sharedWorkers : &workers;
+        if (!sharedWorkers) workers.start(shardCount - 1);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats = CrowdShardStats();
+        stats.shards = shardCount;
+        stats.capacity = capacity;
+        stats.shardAgents.assign(shards.size(), 0);
+        stats.shardUpdateMs.assign(shards.size(), 0.0);
+        return true;
+    }
+
+    void destroy() {
+        workers.stop();
+        for (dtCrowd* crowd : shards) dtFreeCrowd(crowd);
+        shards.clear();
+        agentCount = 0;
+    }
+
+    void setObstacleAvoidanceParams(int index, const dtObstacleAvoidanceParams* params) {
+        for (dtCrowd* crowd : shards) crowd->setObstacleAvoidanceParams(index, params);
+    }
+
+    void setQueryFilter(int index, const dtQueryFilter& filter) {
+        for (dtCrowd* crowd : shards) *crowd->getEditableFilter(index) = filter;
+    }
+
+    bool isReady() const { return !shards.empty(); }
+    int shardCount() const { return (int)shards.size(); }
+    int getCapacity() const { return capacity; }
+    int getAgentCount() const { return agentCount; }
+
+    int shardAt(const float* pos) const {
+        if (shards.size() == 1) return 0;
+        return shardOfRegion(regionIndex(pos[0], regionSize), regionIndex(pos[2], regionSize));
+    }
+
+    dtCrowd* crowdOf(int handle) const { return validHandle(handle) ? shards[handle / capacity] : nullptr; }
+    dtCrowd* crowdAt(const float* pos) const { return shards[shardAt(pos)]; }
+
+    const dtCrowdAgent* getAgent(int handle) {
+        return validHandle(handle) ? shards[handle / capacity]->getAgent(handle % capacity) : nullptr;
+    }
+
+    dtCrowdAgent* getEditableAgent(int handle) {
+        return validHandle(handle) ? shards[handle / capacity]->getEditableAgent(handle % capacity) : nullptr;
+    }
+
+    // Returns the new agent's handle, or -1 when the total capacity is used up
+    int addAgent(const float* pos, const dtCrowdAgentParams* params) {
+        if (agentCount >= capacity) return -1;
+        int shard = shardAt(pos);
+        int index = shards[shard]->addAgent(pos, params);
+        if (index < 0) return -1;
+        agentCount++;
+        return shard * capacity + index;
+    }
+
+    void removeAgent(int handle) {
+        if (!validHandle(handle)) return;
+        shards[handle / capacity]->removeAgent(handle % capacity);
+        agentCount--;
+    }
+
+    bool requestMoveTarget(int handle, dtPolyRef ref, const float* pos) {
+        return validHandle(handle) && shards[handle / capacity]->requestMoveTarget(handle % capacity, ref, pos);
+    }
+
+    bool resetMoveTarget(int handle) {
+        return validHandle(handle) && shards[handle / capacity]->resetMoveTarget(handle % capacity);
+    }
+
+    void updateAgentParameters(int handle, const dtCrowdAgentParams* params) {
+        if (validHandle(handle)) shards[handle / capacity]->updateAgentParameters(handle % capacity, params);
+    }
+
+    // Every shard steps on its own worker; the navmesh is only read. Ghosts exist only for
+    // the length of this call, so nothing outside ever sees their handles.
+    void update(float deltaTime) {
+        auto start = Clock::now();
+        if (shards.size() > 1) addGhosts();
+        std::function<void(int)> step = [this, deltaTime](int shard) {
+            auto shardStart = Clock::now();
+            shards[shard]->update(deltaTime, nullptr);
+            shardUpdateMs[shard] = std::chrono::duration<double, std::milli>(Clock::now() - shardStart).count();
+        };
+        pool->run((int)shards.size(), step);
+        removeGhosts();
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.lastUpdateMs = elapsed;
+        stats.shardUpdateMs = shardUpdateMs;
+    }
+
+    // After update: moves agents that are well inside another shard's region. Each move
+    // is reported as (old handle, new handle) so callers can re-key their own tables.
+    void migrate(std::vector<std::pair<int, int>>& moved) {
+        moved.clear();
+        if (shards.size() > 1) {
+            for (int shard = 0; shard < (int)shards.size(); shard++) {
+                dtCrowd* from = shards[shard];
+                for (int i = 0; i < from->getAgentCount(); i++) {
+                    const dtCrowdAgent* agent = from->getAgent(i);
+                    if (!agent || !agent->active || agent->state == DT_CROWDAGENT_STATE_OFFMESH) continue;
+                    int target = shardAt(agent->npos);
+                    if (target == shard || !wellInsideRegion(agent->npos)) continue;
+
+                    dtCrowd* to = shards[target];
+                    int index = to->addAgent(agent->npos, &agent->params);
+                    if (index < 0) continue;
+                    dtCrowdAgent* copy = to->getEditableAgent(index);
+                    memcpy(copy->vel, agent->vel, sizeof(copy->vel));
+                    memcpy(copy->dvel, agent->dvel, sizeof(copy->dvel));
+
+                    switch (agent->targetState) {
+                        case DT_CROWDAGENT_TARGET_VALID:
+                            if (agent->corridor.getPathCount() > 0 && agent->corridor.getFirstPoly() == copy->corridor.getFirstPoly()) {
+                                applyAgentCorridor(copy, agent->corridor.getPath(), agent->corridor.getPathCount(), agent->targetRef, agent->targetPos);
+                            } else {
+                                to->requestMoveTarget(index, agent->targetRef, agent->targetPos);
+                            }
+                            break;
+                        case DT_CROWDAGENT_TARGET_REQUESTING:
+                        case DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE:
+                        case DT_CROWDAGENT_TARGET_WAITING_FOR_PATH:
+                            to->requestMoveTarget(index, agent->targetRef, agent->targetPos);
+                            break;
+                        case DT_CROWDAGENT_TARGET_VELOCITY:
+                            to->requestMoveVelocity(index, agent->targetPos);
+                            break;
+                        default:
+                            break;
+                    }
+
+                    from->removeAgent(i);
+                    moved.push_back(std::make_pair(shard * capacity + i, target * capacity + index));
+                }
+            }
+        }
+
+        std::vector<int> perShard(shards.size(), 0);
+        for (int shard = 0; shard < (int)shards.size(); shard++) {
+            for (int i = 0; i < shards[shard]->getAgentCount(); i++) {
+                const dtCrowdAgent* agent = shards[shard]->getAgent(i);
+                if (agent && agent->active) perShard[shard]++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.agents = agentCount;
+        stats.shardAgents = perShard;
+        stats.migrations += moved.size();
+    }
+
+    CrowdShardStats getStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+};
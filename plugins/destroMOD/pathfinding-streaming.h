@@ -0,0 +1,264 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Navmesh tile streaming
+// Keeps only the tiles around registered interest points (players, crowd agents)
+// resident. A background thread works out which tiles are wanted, copies them out of
+// the indexed file mapping and swaps them in and out of the dtNavMesh under the
+// navmesh write lock. Tiles that leave every radius stay cached until they go idle or
+// the memory budget needs the space, oldest first.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "DetourNavMesh.h"
+#include "pathfinding-navmesh.h"
+
+struct TileStreamingConfig {
+    bool enabled = false;
+    float radius = 300.0f;                      // World units around each interest point
+    size_t budgetBytes = 256u * 1024u * 1024u;  // Resident tile data cap
+    int intervalMs = 250;
+    int idleSeconds = 30;                       // Unwanted tiles are kept this long unless the budget needs the space
+};
+
+struct TileStreamingStats {
+    bool enabled = false;
+    size_t totalTiles = 0;
+    size_t residentTiles = 0;
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+    float radius = 0.0f;
+    size_t interestPoints = 0;
+    unsigned long long loads = 0;
+    unsigned long long evictions = 0;
+    unsigned long long budgetSkips = 0;     // Wanted tiles left out because the budget was full
+    unsigned long long passes = 0;
+    double lastPassMs = 0.0;
+};
+
+class TileStreamer {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    IndexedNavMeshFile& file;
+    dtNavMesh* navMesh;
+    std::shared_mutex* navMeshMutex;
+    TileStreamingConfig config;
+
+    // Per directory entry - touched only by the streaming thread
+    std::vector<uint8_t> resident;
+    std::vector<Clock::time_point> lastWanted;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cellTiles;   // (x, y) -> entries, one per layer
+
+    std::mutex interestMutex;
+    std::map<std::string, std::vector<float>> interestGroups;       // group -> x,y,z triplets
+
+    std::thread worker;
+    std::atomic<bool> running;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    mutable std::mutex statsMutex;
+    TileStreamingStats stats;
+    std::vector<int> residentCoords;    // x, y, layer per resident tile
+    std::atomic<unsigned long long> generation;
+
+    static uint64_t cellKey(int x, int y) {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+public:
+    TileStreamer(IndexedNavMeshFile& navMeshFile, dtNavMesh* mesh, std::shared_mutex& meshMutex, const TileStreamingConfig& streamingConfig)
+        : file(navMeshFile), navMesh(mesh), navMeshMutex(&meshMutex), config(streamingConfig), running(false), generation(0) {
+        const auto& tiles = file.tiles();
+        resident.assign(tiles.size(), 0);
+        lastWanted.assign(tiles.size(), Clock::time_point());
+        for (size_t i = 0; i < tiles.size(); i++) {
+            if (file.isTileValid(i)) cellTiles[cellKey(tiles[i].x, tiles[i].y)].push_back((uint32_t)i);
+        }
+        stats.enabled = true;
+        stats.totalTiles = tiles.size();
+        stats.budgetBytes = config.budgetBytes;
+        stats.radius = config.radius;
+    }
+
+    ~TileStreamer() {
+        stop();
+    }
+
+    void start() {
+        if (running.exchange(true)) return;
+        worker = std::thread([this]() {
+            while (running.load()) {
+                pass();
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait_for(lock, std::chrono::milliseconds(config.intervalMs), [this]() { return !running.load(); });
+            }
+        });
+    }
+
+    // Tiles stay in the navmesh and are freed with it
+    void stop() {
+        if (!running.exchange(false)) return;
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // Stopped streamers only: later passes take meshMutex, e.g. once a navmesh filled under
+    // its own staging lock starts being served
+    void rebindMutex(std::shared_mutex& meshMutex) {
+        navMeshMutex = &meshMutex;
+    }
+
+    // Replaces one group's points (flat x,y,z triplets)
+    void setInterestPoints(const std::string& group, const float* points, size_t count) {
+        std::lock_guard<std::mutex> lock(interestMutex);
+        interestGroups[group].assign(points, points + count * 3);
+    }
+
+    // Takes over every group of another streamer, e.g. the one of the navmesh being replaced
+    void copyInterestPoints(TileStreamer& from) {
+        std::map<std::string, std::vector<float>> groups;
+        {
+            std::lock_guard<std::mutex> lock(from.interestMutex);
+            groups = from.interestGroups;
+        }
+        std::lock_guard<std::mutex> lock(interestMutex);
+        interestGroups.swap(groups);
+    }
+
+    TileStreamingStats getStats(std::vector<int>* tileCoords = nullptr) const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (tileCoords) *tileCoords = residentCoords;
+        return stats;
+    }
+
+    // Bumped whenever tiles were added or removed
+    unsigned long long getGeneration() const {
+        return generation.load(std::memory_order_acquire);
+    }
+
+    // One streaming step: mark wanted tiles, pick evictions by age, then swap under the write lock
+    void pass() {
+        auto startTime = Clock::now();
+        const auto& tiles = file.tiles();
+
+        std::vector<float> points;
+        {
+            std::lock_guard<std::mutex> lock(interestMutex);
+            for (const auto& group : interestGroups) points.insert(points.end(), group.second.begin(), group.second.end());
+        }
+
+        std::vector<uint8_t> wanted(tiles.size(), 0);
+        const float* orig = file.origin();
+        int reachX = (int)std::ceil(config.radius / file.tileWidth());
+        int reachY = (int)std::ceil(config.radius / file.tileHeight());
+        for (size_t p = 0; p + 2 < points.size(); p += 3) {
+            int tx = (int)std::floor((points[p] - orig[0]) / file.tileWidth());
+            int ty = (int)std::floor((points[p + 2] - orig[2]) / file.tileHeight());
+            for (int y = ty - reachY; y <= ty + reachY; y++) {
+                for (int x = tx - reachX; x <= tx + reachX; x++) {
+                    auto it = cellTiles.find(cellKey(x, y));
+                    if (it == cellTiles.end()) continue;
+                    for (uint32_t index : it->second) {
+                        wanted[index] = 1;
+                        lastWanted[index] = startTime;
+                    }
+                }
+            }
+        }
+
+        size_t residentBytes = 0;
+        std::vector<uint32_t> toLoad, evictable;
+        size_t loadBytes = 0;
+        for (size_t i = 0; i < tiles.size(); i++) {
+            if (resident[i]) {
+                residentBytes += tiles[i].size;
+                if (!wanted[i]) evictable.push_back((uint32_t)i);
+            } else if (wanted[i]) {
+                toLoad.push_back((uint32_t)i);
+                loadBytes += tiles[i].size;
+            }
+        }
+
+        // Least recently wanted first; idle tiles always go, the rest only under budget pressure
+        std::sort(evictable.begin(), evictable.end(), [this](uint32_t a, uint32_t b) { return lastWanted[a] < lastWanted[b]; });
+        std::vector<uint32_t> toEvict;
+        size_t evictBytes = 0;
+        auto idleLimit = std::chrono::seconds(config.idleSeconds);
+        for (uint32_t index : evictable) {
+            bool idle = startTime - lastWanted[index] >= idleLimit;
+            bool overBudget = residentBytes - evictBytes + loadBytes > config.budgetBytes;
+            if (!idle && !overBudget) break;
+            toEvict.push_back(index);
+            evictBytes += tiles[index].size;
+        }
+
+        unsigned long long budgetSkips = 0;
+        while (!toLoad.empty() && residentBytes - evictBytes + loadBytes > config.budgetBytes) {
+            loadBytes -= tiles[toLoad.back()].size;
+            toLoad.pop_back();
+            budgetSkips++;
+        }
+
+        // Copies are made outside the lock so queries only wait for the link stitching
+        std::vector<unsigned char*> prepared(toLoad.size());
+        for (size_t i = 0; i < toLoad.size(); i++) prepared[i] = file.copyTile(toLoad[i]);
+
+        unsigned long long loaded = 0, evicted = 0;
+        if (!toEvict.empty() || !toLoad.empty()) {
+            std::unique_lock<std::shared_mutex> lock(*navMeshMutex);
+            for (uint32_t index : toEvict) {
+                const NavIndexTile& entry = tiles[index];
+                dtTileRef ref = navMesh->getTileRefAt(entry.x, entry.y, entry.layer);
+                if (ref && dtStatusSucceed(navMesh->removeTile(ref, nullptr, nullptr))) {
+                    resident[index] = 0;
+                    residentBytes -= entry.size;
+                    evicted++;
+                }
+            }
+            for (size_t i = 0; i < toLoad.size(); i++) {
+                const NavIndexTile& entry = tiles[toLoad[i]];
+                if (prepared[i] && dtStatusSucceed(navMesh->addTile(prepared[i], (int)entry.size, DT_TILE_FREE_DATA, 0, nullptr))) {
+                    resident[toLoad[i]] = 1;
+                    residentBytes += entry.size;
+                    loaded++;
+                } else if (prepared[i]) {
+                    dtFree(prepared[i]);
+                }
+            }
+            if (loaded || evicted) generation.fetch_add(1, std::memory_order_release);
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (loaded || evicted) {
+            residentCoords.clear();
+            for (size_t i = 0; i < tiles.size(); i++) {
+                if (!resident[i]) continue;
+                residentCoords.push_back(tiles[i].x);
+                residentCoords.push_back(tiles[i].y);
+                residentCoords.push_back(tiles[i].layer);
+            }
+        }
+        stats.residentTiles = residentCoords.size() / 3;
+        stats.residentBytes = residentBytes;
+        stats.interestPoints = points.size() / 3;
+        stats.loads += loaded;
+        stats.evictions += evicted;
+        stats.budgetSkips += budgetSkips;
+        stats.passes++;
+        stats.lastPassMs = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count();
+    }
+};
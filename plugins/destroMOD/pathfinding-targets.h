@@ -0,0 +1,123 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Player grid
+// Uniform grid over the x/z plane holding every targetable player, rebuilt in one go
+// from the positions the game server sends once per tick. Entries are stored sorted by
+// cell, so a cell is one contiguous range of the arrays and a radius query walks only
+// the cells its square touches. A built grid is never modified: the service publishes
+// each new one as an immutable snapshot, like the crowd state, and queries keep
+// whichever grid they started with.
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+
+class PlayerGrid {
+private:
+    struct CellRange {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    float cellSize;
+    std::vector<std::string> ids;
+    std::vector<float> positions;       // x,y,z triplets, same order as ids
+    std::unordered_map<uint64_t, CellRange> cells;
+    int minCell[2];
+    int maxCell[2];
+
+    int cellOf(float value) const { return (int)std::floor(value / cellSize); }
+
+    static uint64_t cellKey(int cx, int cz) {
+        return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cz;
+    }
+
+public:
+    explicit PlayerGrid(float cellWorldSize) : cellSize(cellWorldSize) {
+        minCell[0] = minCell[1] = 0;
+        maxCell[0] = maxCell[1] = -1;
+    }
+
+    // points: count * x,y,z
+    void build(const std::vector<std::string_view>& playerIds, const float* points, size_t count) {
+        std::vector<uint64_t> keys(count);
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0u);
+        minCell[0] = minCell[1] = INT32_MAX;
+        maxCell[0] = maxCell[1] = INT32_MIN;
+        for (size_t i = 0; i < count; i++) {
+            int cx = cellOf(points[i * 3]);
+            int cz = cellOf(points[i * 3 + 2]);
+            keys[i] = cellKey(cx, cz);
+            minCell[0] = std::min(minCell[0], cx);
+            minCell[1] = std::min(minCell[1], cz);
+            maxCell[0] = std::max(maxCell[0], cx);
+            maxCell[1] = std::max(maxCell[1], cz);
+        }
+        std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+        ids.clear();
+        positions.clear();
+        cells.clear();
+        ids.reserve(count);
+        positions.reserve(count * 3);
+        cells.reserve(count);
+        for (uint32_t i : order) {
+            const uint32_t at = (uint32_t)ids.size();
+            auto cell = cells.emplace(keys[i], CellRange{at, at}).first;
+            cell->second.end = at + 1;
+            ids.emplace_back(i < playerIds.size() ? playerIds[i] : std::string_view());
+            positions.insert(positions.end(), points + i * 3, points + i * 3 + 3);
+        }
+    }
+
+    size_t size() const { return ids.size(); }
+    size_t cellCount() const { return cells.size(); }
+    const std::string& id(int player) const { return ids[player]; }
+    const float* position(int player) const { return &positions[(size_t)player * 3]; }
+
+    // Up to maxResults (distance, player) pairs within radius of pos, nearest first.
+    // Distance is 3D; the grid only prunes on x/z.
+    void query(const float* pos, float radius, size_t maxResults, std::vector<std::pair<float, int>>& out) const {
+        out.clear();
+        if (ids.empty() || maxResults == 0 || !(radius >= 0.0f)) return;
+        const float radius2 = radius * radius;
+        auto consider = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const float* p = &positions[(size_t)i * 3];
+                float dx = p[0] - pos[0], dy = p[1] - pos[1], dz = p[2] - pos[2];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 <= radius2) out.emplace_back(d2, (int)i);
+            }
+        };
+
+        // Clamp the square to the occupied cells; when it still spans more cells than are
+        // occupied, a plain scan of the occupied ones is cheaper
+        const int x0 = std::max(minCell[0], cellOf(pos[0] - radius)), x1 = std::min(maxCell[0], cellOf(pos[0] + radius));
+        const int z0 = std::max(minCell[1], cellOf(pos[2] - radius)), z1 = std::min(maxCell[1], cellOf(pos[2] + radius));
+        if (x0 > x1 || z0 > z1) return;
+        if ((double)(x1 - x0 + 1) * (double)(z1 - z0 + 1) > (double)cells.size()) {
+            consider(0, (uint32_t)ids.size());
+        } else {
+            for (int cx = x0; cx <= x1; cx++) {
+                for (int cz = z0; cz <= z1; cz++) {
+                    auto cell = cells.find(cellKey(cx, cz));
+                    if (cell != cells.end()) consider(cell->second.begin, cell->second.end);
+                }
+            }
+        }
+
+        const size_t keep = std::min(maxResults, out.size());
+        std::partial_sort(out.begin(), out.begin() + keep, out.end());
+        out.resize(keep);
+        for (auto& hit : out) hit.first = std::sqrt(hit.first);
+    }
+};
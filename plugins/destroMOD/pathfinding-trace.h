@@ -0,0 +1,329 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Request capture trace
+// Capture mode appends every incoming HTTP request and IPC frame to a compact binary
+// trace, stamped with the time since capture started and the crowd tick it arrived
+// on, plus a snapshot of every agent's position every few ticks. Request threads only
+// append to an in-memory buffer; a writer thread flushes it to disk. TraceReader reads
+// the file back for the replay tool (bench/trace-replay.cpp).
+//
+// Layout, little-endian:
+//   header  u32 magic 'PFTR', u32 version, u64 start tick, u64 start unix ms,
+//           u32 snapshot interval (ticks), u32 reserved
+//   record  u32 size (bytes after this field), u8 kind, u8 reserved, u16 reserved,
+//           u64 ns since start, u64 tick, payload:
+//     TRACE_HTTP      u8 method length, method, u16 path length, path, body (rest)
+//     TRACE_IPC       frame without its u32 length prefix (rest)
+//     TRACE_SNAPSHOT  u32 count, count * (u16 id length, id, f32 pos[3], f32 target[3], u8 target state)
+// ===================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+static const uint32_t TRACE_MAGIC = 0x52544650;    // 'PFTR'
+static const uint32_t TRACE_VERSION = 1;
+
+enum TraceRecordKind : uint8_t {
+    TRACE_HTTP = 1,
+    TRACE_IPC = 2,
+    TRACE_SNAPSHOT = 3
+};
+
+struct TraceFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t startTick;
+    uint64_t startUnixMs;
+    uint32_t snapshotInterval;
+    uint32_t reserved;
+};
+
+struct TraceRecordHeader {
+    uint32_t size;
+    uint8_t kind;
+    uint8_t reserved0;
+    uint16_t reserved1;
+    uint64_t timeNs;
+    uint64_t tick;
+};
+
+static_assert(sizeof(TraceFileHeader) == 32, "TraceFileHeader layout");
+static_assert(sizeof(TraceRecordHeader) == 24, "TraceRecordHeader layout");
+
+struct TraceStats {
+    bool active = false;
+    std::string path;
+    unsigned long long records = 0;
+    unsigned long long bytes = 0;
+    unsigned long long dropped = 0;     // Records lost because the writer fell too far behind
+};
+
+class TraceWriter {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+    std::atomic<bool> active;
+    std::atomic<bool> snapshotPending;  // First snapshot right after start, whatever the tick
+    Clock::time_point startTime;
+    uint32_t snapshotInterval;
+
+    std::mutex mutex;
+    std::condition_variable flushSignal;
+    std::string pending;
+    FILE* file;
+    std::thread writer;
+    bool stopping;
+    TraceStats stats;
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Caller holds mutex
+    void beginRecord(TraceRecordKind kind, unsigned long long tick, size_t payloadSize) {
+        TraceRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.size = (uint32_t)(sizeof(TraceRecordHeader) - sizeof(uint32_t) + payloadSize);
+        header.kind = kind;
+        header.timeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+        header.tick = tick;
+        pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        stats.records++;
+        stats.bytes += sizeof(header) + payloadSize;
+    }
+
+    // Caller holds mutex; false (and counted) when the record would overflow the buffer
+    bool reserve(size_t payloadSize) {
+        if (pending.size() + sizeof(TraceRecordHeader) + payloadSize <= MAX_PENDING_BYTES) return true;
+        stats.dropped++;
+        return false;
+    }
+
+    void writerLoop() {
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            flushSignal.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stopping; });
+            batch.swap(pending);
+            bool done = stopping;
+            lock.unlock();
+            if (!batch.empty()) fwrite(batch.data(), 1, batch.size(), file);
+            batch.clear();
+            if (done) return;
+            lock.lock();
+        }
+    }
+
+public:
+    TraceWriter() : active(false), snapshotPending(false), snapshotInterval(40), file(nullptr), stopping(false) {}
+
+    ~TraceWriter() {
+        close();
+    }
+
+    // Truncates path; a capture already running is closed first
+    bool open(const std::string& path, unsigned long long startTick, uint32_t snapshotTicks) {
+        close();
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) return false;
+
+        TraceFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = TRACE_MAGIC;
+        header.version = TRACE_VERSION;
+        header.startTick = startTick;
+        header.startUnixMs = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        header.snapshotInterval = snapshotTicks;
+        fwrite(&header, sizeof(header), 1, out);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        file = out;
+        pending.clear();
+        stopping = false;
+        startTime = Clock::now();
+        snapshotInterval = snapshotTicks > 0 ? snapshotTicks : 1;
+        stats = TraceStats();
+        stats.path = path;
+        stats.active = true;
+        stats.bytes = sizeof(header);
+        writer = std::thread([this]() { writerLoop(); });
+        snapshotPending = true;
+        active = true;
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!file) return;
+            active = false;
+            stopping = true;
+        }
+        flushSignal.notify_all();
+        if (writer.joinable()) writer.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        fclose(file);
+        file = nullptr;
+        stats.active = false;
+    }
+
+    bool isActive() const { return active.load(std::memory_order_relaxed); }
+
+    void recordHttp(unsigned long long tick, const std::string& method, const std::string& path, const std::string& body) {
+        if (!isActive()) return;
+        const size_t methodLength = std::min<size_t>(method.size(), 255);
+        const size_t pathLength = std::min<size_t>(path.size(), 65535);
+        const size_t payload = 1 + methodLength + 2 + pathLength + body.size();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!active || !reserve(payload)) return;
+        beginRecord(TRACE_HTTP, tick, payload);
+        put<uint8_t>(pending, (uint8_t)methodLength);
+        pending.append(method.data(), methodLength);
+        put<uint16_t>(pending, (uint16_t)pathLength);
+        pending.append(path.data(), pathLength);
+        pending.append(body);
+    }
+
+    void recordFrame(unsigned long long tick, const std::string& frame) {
+        if (!isActive()) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!active || !reserve(frame.size())) return;
+        beginRecord(TRACE_IPC, tick, frame.size());
+        pending.append(frame);
+    }
+
+    // Update thread: true when this tick's agents should be snapshotted
+    bool snapshotDue(unsigned long long tick) {
+        if (!isActive()) return false;
+        return snapshotPending.exchange(false) || tick % snapshotInterval == 0;
+    }
+
+    // Agents: anything with npcId, pos, targetPos and targetState
+    template <typename Agents>
+    void recordSnapshot(unsigned long long tick, const Agents& agents) {
+        std::string payload;
+        put<uint32_t>(payload, (uint32_t)agents.size());
+        for (const auto& agent : agents) {
+            const size_t idLength = std::min<size_t>(agent.npcId.size(), 65535);
+            put<uint16_t>(payload, (uint16_t)idLength);
+            payload.append(agent.npcId.data(), idLength);
+            payload.append(reinterpret_cast<const char*>(agent.pos), sizeof(float) * 3);
+            payload.append(reinterpret_cast<const char*>(agent.targetPos), sizeof(float) * 3);
+            put<uint8_t>(payload, (uint8_t)agent.targetState);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!active || !reserve(payload.size())) return;
+        beginRecord(TRACE_SNAPSHOT, tick, payload.size());
+        pending.append(payload);
+    }
+
+    TraceStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
+
+struct TraceRecord {
+    TraceRecordKind kind;
+    uint64_t timeNs;
+    uint64_t tick;
+    std::string payload;
+};
+
+struct TraceAgent {
+    std::string npcId;
+    float pos[3];
+    float targetPos[3];
+    int targetState;
+};
+
+class TraceReader {
+private:
+    FILE* file;
+    TraceFileHeader fileHeader;
+
+public:
+    TraceReader() : file(nullptr) {
+        memset(&fileHeader, 0, sizeof(fileHeader));
+    }
+
+    ~TraceReader() {
+        if (file) fclose(file);
+    }
+
+    bool open(const std::string& path) {
+        file = fopen(path.c_str(), "rb");
+        if (!file) return false;
+        return fread(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+               fileHeader.magic == TRACE_MAGIC && fileHeader.version == TRACE_VERSION;
+    }
+
+    const TraceFileHeader& header() const { return fileHeader; }
+
+    // False at the end of the file or on a truncated record
+    bool next(TraceRecord& record) {
+        TraceRecordHeader header;
+        if (!file || fread(&header, sizeof(header), 1, file) != 1) return false;
+        if (header.size < sizeof(header) - sizeof(uint32_t)) return false;
+        record.kind = (TraceRecordKind)header.kind;
+        record.timeNs = header.timeNs;
+        record.tick = header.tick;
+        record.payload.resize(header.size - (sizeof(header) - sizeof(uint32_t)));
+        return record.payload.empty() || fread(&record.payload[0], 1, record.payload.size(), file) == record.payload.size();
+    }
+
+    static bool parseHttp(const std::string& payload, std::string& method, std::string& path, std::string& body) {
+        size_t at = 0;
+        if (payload.size() < 1) return false;
+        size_t methodLength = (uint8_t)payload[at++];
+        if (payload.size() < at + methodLength + 2) return false;
+        method.assign(payload, at, methodLength);
+        at += methodLength;
+        uint16_t pathLength;
+        memcpy(&pathLength, payload.data() + at, sizeof(pathLength));
+        at += 2;
+        if (payload.size() < at + pathLength) return false;
+        path.assign(payload, at, pathLength);
+        body.assign(payload, at + pathLength, std::string::npos);
+        return true;
+    }
+
+    static bool parseSnapshot(const std::string& payload, std::vector<TraceAgent>& agents) {
+        agents.clear();
+        if (payload.size() < 4) return false;
+        uint32_t count;
+        memcpy(&count, payload.data(), sizeof(count));
+        size_t at = 4;
+        for (uint32_t i = 0; i < count; i++) {
+            uint16_t idLength;
+            if (payload.size() < at + 2) return false;
+            memcpy(&idLength, payload.data() + at, sizeof(idLength));
+            at += 2;
+            if (payload.size() < at + idLength + sizeof(float) * 6 + 1) return false;
+            TraceAgent agent;
+            agent.npcId.assign(payload, at, idLength);
+            at += idLength;
+            memcpy(agent.pos, payload.data() + at, sizeof(agent.pos));
+            at += sizeof(agent.pos);
+            memcpy(agent.targetPos, payload.data() + at, sizeof(agent.targetPos));
+            at += sizeof(agent.targetPos);
+            agent.targetState = (uint8_t)payload[at++];
+            agents.push_back(agent);
+        }
+        return true;
+    }
+};
@@ -7,8 +7,10 @@
 "use strict";
 
 const path = require('path');
+const fs = require('fs');
 const serverModulePath = path.join(process.cwd(), 'node_modules/h1z1-server');
 const { getCurrentServerTimeWrapper, getDistance } = require(path.join(serverModulePath, 'out/utils/utils'));
+const { PathfindingIpcClient, SharedAgentReader, AgentStreamClient } = require('./pathfindingIpc.js');
 
 class PathfindingManager {
     constructor(plugin) {
@@ -16,8 +18,8 @@ class PathfindingManager {
         this.isReady = false;
         
         // Enhanced agent tracking
-        this.maxAgents = 50;
-        this.agents = new Map(); // npcId -> { addedAt, lastUsed, forceStopped }
+        this.maxAgents = 50; // Replaced by the service's crowd capacity once connected
+        this.agents = new Map(); // npcId -> { handle, addedAt, lastUsed, forceStopped }
         this.server = null;
 
         // Track aggro states
@@ -39,8 +41,49 @@ class PathfindingManager {
         this._lastCleanupTime = 0;
         this._cleanupInterval = 300000; // Every 300 seconds
         
-        // C++ service URL
+        // C++ service URL. One service can host several zones (see plugin.js); this server's
+        // requests then go under /zones/<key> and its binary frames carry the zone's index.
         this.serviceUrl = 'http://localhost:8080';
+        this.zone = '';
+        this.zoneIndex = 0;
+
+        // Crowd tick that produced the last agent snapshot
+        this.lastStateTick = 0;
+
+        // Binary transport for tick-critical calls; HTTP stays as the fallback/debug path
+        this.ipc = null;
+        this.agentRing = null;
+        this.agentStream = null;
+
+        // Crowd mutations issued in the same server tick go out as one /batch request
+        this._pendingCommands = [];
+        this._flushScheduled = false;
+
+        // Player positions for navmesh tile streaming (agents are tracked by the service itself)
+        this._lastInterestUpdate = 0;
+        this._interestInterval = 1000;
+
+        // Line-of-sight checks asked for during one server tick go out as one batch;
+        // callers read the last answer for their pair without waiting
+        this._losResults = new Map(); // "npcId|targetId" -> { visible, at }
+        this._pendingLos = new Map(); // "npcId|targetId" -> [sx, sy, sz, ex, ey, ez]
+        this._losFlushScheduled = false;
+        this._losMaxAge = 5000;
+
+        // Nearest-player lookups asked for during one server tick go out as one query against the
+        // service's player grid, right after the tick's player positions; answered like lineOfSight
+        this._players = new Map(); // characterId -> character, as last sent to /setPlayers
+        this._targetResults = new Map(); // npcId -> { playerId, at }
+        this._pendingTargets = new Map(); // npcId -> [x, y, z, radius]
+        this._targetFlushScheduled = false;
+        this._playerGracePeriod = 10000; // New players are not targeted for this long
+
+        // Player constructions and vehicles are not in the baked navmesh; the service blocks
+        // their footprint as dynamic obstacles, keyed by characterId
+        this._worldDataPath = path.join(process.cwd(), 'h1emu/worlddata');
+        this._obstacles = new Map(); // characterId -> "x,y,z,yaw" as last sent
+        this._lastObstacleSync = 0;
+        this._obstacleInterval = 2000;
     }
 
     setServer(server) {
@@ -49,11 +92,17 @@ class PathfindingManager {
 
     async initialize() {
         console.log(`[${this.plugin.name}] Initializing 64-bit pathfinding service...`);
+        this.zone = this.plugin.config?.pathfindingZone || '';
+        if (this.zone) this.serviceUrl = `http://localhost:8080/zones/${encodeURIComponent(this.zone)}`;
         try {
             // Test connection to C++ service
             const response = await fetch(`${this.serviceUrl}/health`);
             if (response.ok) {
-                console.log(`[${this.plugin.name}] Connected to 64-bit C++ pathfinding service`);
+                const health = await response.json();
+                if (health.status !== 'ok') throw new Error(health.error || 'Service not responding');
+                if (health.maxAgents > 0) this.maxAgents = health.maxAgents;
+                this.zoneIndex = health.zoneIndex || 0;
+                console.log(`[${this.plugin.name}] Connected to 64-bit C++ pathfinding service (${this.maxAgents} agents${this.zone ? `, zone ${this.zone}` : ''})`);
             } else {
                 throw new Error('Service not responding');
             }
@@ -63,8 +112,33 @@ class PathfindingManager {
             return false;
         }
         
+        this.ipc = new PathfindingIpcClient(undefined, this.zoneIndex);
+        if (await this.ipc.connect()) {
+            console.log(`[${this.plugin.name}] Using binary IPC transport for crowd commands`);
+        } else {
+            this.ipc = null;
+        }
+        this.agentRing = new SharedAgentReader(SharedAgentReader.pathForZone(this.zone, this.zoneIndex));
+        if (this.agentRing.open()) {
+            console.log(`[${this.plugin.name}] Reading agent state from shared memory`);
+        } else {
+            this.agentRing = null;
+        }
+        // Without shared memory, have the service push each tick instead of polling it
+        if (!this.agentRing) {
+            this.agentStream = new AgentStreamClient(`${this.serviceUrl}/agentStream`, (type, npcId, handle) => this._onAgentStreamEvent(type, npcId, handle));
+            if (await this.agentStream.connect()) {
+                console.log(`[${this.plugin.name}] Receiving agent state from the push stream`);
+            } else {
+                this.agentStream.close();
+                this.agentStream = null;
+            }
+        }
+
         this.isReady = true;
         console.log(`[${this.plugin.name}] 64-bit pathfinding system ready!`);
+
+        await this._loadWorldObstacles();
         
         this.startCleanup();
         return true;
@@ -134,6 +208,297 @@ class PathfindingManager {
         return null;
     }
 
+    // Last known line of sight between an NPC and a target (true until the first answer arrives).
+    // The pair is re-checked in the next batch, so the answer trails by at most one server tick.
+    lineOfSight(npcId, targetId, fromPos, toPos) {
+        const key = `${npcId}|${targetId}`;
+        this._pendingLos.set(key, [fromPos[0], fromPos[1], fromPos[2], toPos[0], toPos[1], toPos[2]]);
+        if (!this._losFlushScheduled && this.isReady) {
+            this._losFlushScheduled = true;
+            setImmediate(() => this._flushLineOfSight());
+        }
+        const known = this._losResults.get(key);
+        return known ? known.visible : true;
+    }
+
+    // pairs: [[sx, sy, sz, ex, ey, ez], ...] -> array of booleans, or null if the request failed
+    async hasLineOfSightBatch(pairs) {
+        if (!this.isReady || pairs.length === 0) return pairs.length === 0 ? [] : null;
+        try {
+            if (this.ipc?.isConnected) return await this.ipc.lineOfSightBatch(pairs);
+            const response = await fetch(`${this.serviceUrl}/hasLineOfSightBatch`, {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify({ pairs: pairs })
+            });
+            const result = await response.json();
+            if (!result.success) return null;
+            return pairs.map((pair, i) => ((result.visible[i >> 5] >>> (i & 31)) & 1) === 1);
+        } catch (error) {
+            console.warn(`[${this.plugin.name}] Line of sight batch failed:`, error.message);
+            return null;
+        }
+    }
+
+    async _flushLineOfSight() {
+        const pending = this._pendingLos;
+        this._pendingLos = new Map();
+        this._losFlushScheduled = false;
+        if (pending.size === 0) return;
+
+        const keys = Array.from(pending.keys());
+        const visible = await this.hasLineOfSightBatch(Array.from(pending.values()));
+        if (!visible) return;
+
+        const now = Date.now();
+        keys.forEach((key, i) => this._losResults.set(key, { visible: visible[i], at: now }));
+        if (this._losResults.size > keys.length * 4) {
+            for (const [key, entry] of this._losResults) {
+                if (now - entry.at > this._losMaxAge) this._losResults.delete(key);
+            }
+        }
+    }
+
+    // Last known nearest targetable player within radius of an NPC that the navmesh gives it
+    // line of sight to, or null. Undefined while the service is unavailable, so callers can
+    // fall back to scanning players themselves. Trails by at most one server tick.
+    nearestTarget(npcId, pos, radius) {
+        if (!this.isReady || !this.server) return undefined;
+        this._pendingTargets.set(npcId, [pos[0], pos[1], pos[2], radius]);
+        if (!this._targetFlushScheduled) {
+            this._targetFlushScheduled = true;
+            setImmediate(() => this._flushTargets());
+        }
+        const known = this._targetResults.get(npcId);
+        const player = known?.playerId ? this._players.get(known.playerId) : null;
+        return player && player.isAlive ? player : null;
+    }
+
+    // Every alive player past the spawn grace period, for the service's player grid
+    async _publishPlayers() {
+        const now = Date.now();
+        const ids = [];
+        const points = [];
+        this._players.clear();
+        for (const client of Object.values(this.server._clients || {})) {
+            const character = client?.character;
+            if (!character || character.isHumanNPC || !character.isAlive || !character.state?.position) continue;
+            if (character.gameReadyTime && now - character.gameReadyTime < this._playerGracePeriod) continue;
+            const id = String(character.characterId);
+            const pos = character.state.position;
+            ids.push(id);
+            points.push([pos[0], pos[1], pos[2]]);
+            this._players.set(id, character);
+        }
+
+        if (this.ipc?.isConnected) return this.ipc.setPlayers(ids, points);
+        await fetch(`${this.serviceUrl}/setPlayers`, {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ playerIds: ids, points: points })
+        });
+        return ids.length;
+    }
+
+    async _flushTargets() {
+        const pending = this._pendingTargets;
+        this._pendingTargets = new Map();
+        this._targetFlushScheduled = false;
+        if (pending.size === 0) return;
+
+        try {
+            await this._publishPlayers();
+            const npcIds = Array.from(pending.keys());
+            const queries = Array.from(pending.values());
+            let targets;
+            if (this.ipc?.isConnected) {
+                targets = (await this.ipc.nearestTargets(queries, true)).targets;
+            } else {
+                const response = await fetch(`${this.serviceUrl}/nearestTargets`, {
+                    method: 'POST',
+                    headers: { 'Content-Type': 'application/json' },
+                    body: JSON.stringify({
+                        points: queries.map(query => [query[0], query[1], query[2]]),
+                        radii: queries.map(query => query[3]),
+                        lineOfSight: true
+                    })
+                });
+                const result = await response.json();
+                if (!result.success) return;
+                targets = result.targets;
+            }
+
+            const now = Date.now();
+            npcIds.forEach((npcId, i) => this._targetResults.set(npcId, { playerId: targets[i], at: now }));
+            if (this._targetResults.size > npcIds.length * 4) {
+                for (const [npcId, entry] of this._targetResults) {
+                    if (now - entry.at > this._losMaxAge) this._targetResults.delete(npcId);
+                }
+            }
+        } catch (error) {
+            console.warn(`[${this.plugin.name}] Nearest target query failed:`, error.message);
+        }
+    }
+
+    // Footprint of a construction piece or vehicle as a box, half extents along its own axes.
+    // Anything not listed gets the default for its kind.
+    static obstacleFootprint(kind, entity) {
+        const vehicles = {
+            1: [1.3, 1.2, 2.6],   // Offroader
+            2: [1.3, 1.2, 3.0],   // Pickup
+            3: [1.2, 1.0, 2.6],   // Police car
+            5: [0.8, 0.8, 1.2]    // ATV
+        };
+        if (kind === 'vehicle') return vehicles[entity.vehicleId] || [1.2, 1.0, 2.5];
+        return [1.0, 1.5, 1.0];
+    }
+
+    // Obstacle spec for an entity with position and rotation, or null. Constructions store
+    // Euler angles (yaw in [1]), vehicles a quaternion.
+    static obstacleOf(kind, entity) {
+        const pos = entity.state?.position || entity.position;
+        const rot = entity.state?.rotation || entity.rotation;
+        if (!entity.characterId || !pos || pos.length < 3) return null;
+        let yaw = 0;
+        if (rot && kind === 'vehicle') yaw = 2 * Math.atan2(rot[1] || 0, rot[3] || 1);
+        else if (rot) yaw = rot[1] || 0;
+        return {
+            id: String(entity.characterId),
+            shape: 'box',
+            center: [pos[0], pos[1], pos[2]],
+            halfExtents: PathfindingManager.obstacleFootprint(kind, entity),
+            yaw: yaw
+        };
+    }
+
+    // Placement rounded so jitter in saved or streamed positions does not count as a move
+    static obstacleKey(obstacle) {
+        return obstacle.center.map(v => v.toFixed(1)).concat(obstacle.yaw.toFixed(2)).join(',');
+    }
+
+    async _sendObstacles(op, obstacles) {
+        if (obstacles.length === 0) return;
+        const response = await fetch(`${this.serviceUrl}/obstacles`, {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ op: op, obstacles: obstacles })
+        });
+        return response.json();
+    }
+
+    // Startup: every saved base and vehicle in one request. Construction saves nest pieces
+    // under their foundations, so anything with a characterId and a position counts.
+    async _loadWorldObstacles() {
+        const obstacles = [];
+        const collect = (kind, value) => {
+            if (!value || typeof value !== 'object') return;
+            const obstacle = Array.isArray(value) ? null : PathfindingManager.obstacleOf(kind, value);
+            if (obstacle) obstacles.push(obstacle);
+            for (const child of Object.values(value)) collect(kind, child);
+        };
+        for (const [file, kind] of [['construction.json', 'construction'], ['worldconstruction.json', 'construction'], ['vehicles.json', 'vehicle']]) {
+            try {
+                collect(kind, JSON.parse(fs.readFileSync(path.join(this._worldDataPath, file), 'utf8')));
+            } catch (error) {
+                if (error.code !== 'ENOENT') console.warn(`[${this.plugin.name}] Could not read ${file}:`, error.message);
+            }
+        }
+
+        try {
+            const result = await this._sendObstacles('add', obstacles);
+            for (const obstacle of obstacles) this._obstacles.set(obstacle.id, PathfindingManager.obstacleKey(obstacle));
+            if (obstacles.length > 0) console.log(`[${this.plugin.name}] Blocked ${result?.accepted ?? 0} constructions and vehicles on the navmesh`);
+        } catch (error) {
+            console.warn(`[${this.plugin.name}] Obstacle bulk load failed:`, error.message);
+        }
+    }
+
+    // Keep the service's obstacles in step with the live world: new or moved entities are
+    // re-added, ones gone from the server are removed. Only changes go out.
+    _syncObstacles(now) {
+        if (now - this._lastObstacleSync < this._obstacleInterval) return;
+        this._lastObstacleSync = now;
+        // Until the server has loaded its world, the saved data is all there is
+        if (!this.server._vehicles && !this.server._constructionFoundations) return;
+
+        const seen = new Set();
+        const changed = [];
+        const visit = (kind, dictionary) => {
+            for (const entity of Object.values(dictionary || {})) {
+                const obstacle = PathfindingManager.obstacleOf(kind, entity);
+                if (!obstacle) continue;
+                seen.add(obstacle.id);
+                const key = PathfindingManager.obstacleKey(obstacle);
+                if (this._obstacles.get(obstacle.id) === key) continue;
+                this._obstacles.set(obstacle.id, key);
+                changed.push(obstacle);
+            }
+        };
+        visit('vehicle', this.server._vehicles);
+        visit('construction', this.server._constructionFoundations);
+        visit('construction', this.server._constructionDoors);
+        visit('construction', this.server._constructionSimple);
+        visit('construction', this.server._lootableConstruction);
+        visit('construction', this.server._worldLootableConstruction);
+        visit('construction', this.server._worldSimpleConstruction);
+
+        const removed = [];
+        for (const id of this._obstacles.keys()) {
+            if (!seen.has(id)) removed.push({ id: id });
+        }
+        for (const obstacle of removed) this._obstacles.delete(obstacle.id);
+
+        Promise.all([this._sendObstacles('add', changed), this._sendObstacles('remove', removed)]).catch((error) => {
+            console.warn(`[${this.plugin.name}] Obstacle sync failed:`, error.message);
+        });
+    }
+
+    // NEW: Queue a crowd mutation for the next /batch flush.
+    // Resolves to the command's success flag, or null if the request itself failed.
+    // Agents added before carry their service handle, which skips the service's id lookup;
+    // an 'add' gets its new handle written back to command.handle.
+    _queueCommand(command) {
+        const handle = command.op !== 'add' ? this.agents.get(command.npcId)?.handle : 0;
+        if (handle) command.handle = handle;
+        return new Promise((resolve) => {
+            this._pendingCommands.push({ command, resolve });
+            if (!this._flushScheduled) {
+                this._flushScheduled = true;
+                setImmediate(() => this._flushCommands());
+            }
+        });
+    }
+
+    async _flushCommands() {
+        const pending = this._pendingCommands;
+        this._pendingCommands = [];
+        this._flushScheduled = false;
+        if (pending.length === 0) return;
+
+        try {
+            const commands = pending.map(entry => entry.command);
+            let result;
+            if (this.ipc?.isConnected) {
+                const reply = await this.ipc.batch(commands);
+                result = { success: true, results: reply.results, handles: reply.handles };
+            } else {
+                const response = await fetch(`${this.serviceUrl}/batch`, {
+                    method: 'POST',
+                    headers: { 'Content-Type': 'application/json' },
+                    body: JSON.stringify({ commands: commands })
+                });
+                result = await response.json();
+            }
+            pending.forEach((entry, i) => {
+                if (entry.command.op === 'add') entry.command.handle = result.handles?.[i] || 0;
+                entry.resolve(result.success ? !!result.results[i] : false);
+            });
+        } catch (error) {
+            console.warn(`[${this.plugin.name}] Batch of ${pending.length} crowd commands failed:`, error.message);
+            pending.forEach(entry => entry.resolve(null));
+        }
+    }
+
     startCleanup() {
         setInterval(() => {
             this.cleanup();
@@ -205,22 +570,20 @@ class PathfindingManager {
             npc.state.position[2] = position.z;
 
             // Add agent to C++ service
-            const response = await fetch(`${this.serviceUrl}/addAggroedNPC`, {
-                method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
-                body: JSON.stringify({
-                    npcId: npc.characterId,
-                    x: position.x,
-                    y: position.y,
-                    z: position.z
-                })
-            });
+            const command = {
+                op: 'add',
+                npcId: npc.characterId,
+                x: position.x,
+                y: position.y,
+                z: position.z
+            };
+            const success = await this._queueCommand(command);
 
-            const result = await response.json();
-            if (result.success) {
+            if (success) {
                 const now = Date.now();
                 
                 this.agents.set(npc.characterId, {
+                    handle: command.handle,
                     addedAt: now,
                     lastUsed: now,
                     forceStopped: false
@@ -270,23 +633,19 @@ class PathfindingManager {
     async removeAgentFromCrowd(npcId) {
         if (!this.agents.has(npcId)) return;
 
-        try {
-            await fetch(`${this.serviceUrl}/removeAggroedNPC`, {
-                method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
-                body: JSON.stringify({ npcId: npcId })
-            });
-            
-            this.agents.delete(npcId);
-            this.pathfindingStats.activeAgents = this.agents.size;
-            
-        } catch (error) {
-            console.warn(`[${this.plugin.name}] Error removing agent for NPC ${npcId}:`, error.message);
+        const result = await this._queueCommand({ op: 'remove', npcId: npcId });
+        if (result === null) {
+            console.warn(`[${this.plugin.name}] Error removing agent for NPC ${npcId}`);
+            return;
         }
+
+        this.agents.delete(npcId);
+        this.pathfindingStats.activeAgents = this.agents.size;
     }
 
-    // MODIFIED: Use C++ service for setting targets
-    async setNPCTarget(npcId, targetPosition) {
+    // MODIFIED: Use C++ service for setting targets.
+    // With a targetId (e.g. the chased player's characterId) every NPC chasing it shares one flow field.
+    async setNPCTarget(npcId, targetPosition, targetId = null) {
         if (!this.isReady || !this.agents.has(npcId)) return false;
 
         try {
@@ -305,17 +664,15 @@ class PathfindingManager {
             agentData.lastUsed = Date.now();
             agentData.forceStopped = false; // Clear force stop flag when setting new target
             
-            const response = await fetch(`${this.serviceUrl}/setNPCTarget`, {
-                method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
-                body: JSON.stringify({
-                    npcId: npcId,
-                    target: [targetPosition[0], targetPosition[1], targetPosition[2]]
-                })
-            });
+            const command = {
+                op: targetId ? 'chase' : 'setTarget',
+                npcId: npcId,
+                target: [targetPosition[0], targetPosition[1], targetPosition[2]]
+            };
+            if (targetId) command.targetId = String(targetId);
+            const success = await this._queueCommand(command);
 
-            const result = await response.json();
-            if (result.success) {
+            if (success) {
                 this.pathfindingStats.pathsCalculated++;
                 return true;
             }
@@ -331,19 +688,15 @@ class PathfindingManager {
     async stopNPC(npcId) {
         if (!this.isReady || !this.agents.has(npcId)) return;
         
-        try {
-            await fetch(`${this.serviceUrl}/stopNPC`, {
-                method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
-                body: JSON.stringify({ npcId: npcId })
-            });
-            
-            const agentData = this.agents.get(npcId);
-            if (agentData) {
-                agentData.lastUsed = Date.now();
-            }
-        } catch (error) {
-            console.warn(`[${this.plugin.name}] Error stopping NPC ${npcId}:`, error.message);
+        const result = await this._queueCommand({ op: 'stop', npcId: npcId });
+        if (result === null) {
+            console.warn(`[${this.plugin.name}] Error stopping NPC ${npcId}`);
+            return;
+        }
+
+        const agentData = this.agents.get(npcId);
+        if (agentData) {
+            agentData.lastUsed = Date.now();
         }
     }
 
@@ -351,28 +704,25 @@ class PathfindingManager {
     async forceStopNPC(npcId) {
         if (!this.isReady || !this.agents.has(npcId)) return;
         
-        try {
-            // Send force stop with brake parameter
-            await fetch(`${this.serviceUrl}/forceStopNPC`, {
-                method: 'POST',
-                headers: { 'Content-Type': 'application/json' },
-                body: JSON.stringify({ 
-                    npcId: npcId,
-                    brakeForce: 10.0 // High brake force for immediate stop
-                })
-            });
-            
-            const agentData = this.agents.get(npcId);
-            if (agentData) {
-                agentData.lastUsed = Date.now();
-                agentData.forceStopped = true; // Mark as force stopped
-            }
-            
-            this.pathfindingStats.forceStops++;
-            console.log(`[${this.plugin.name}] Force stopped NPC ${npcId} with brake force`);
-        } catch (error) {
-            console.warn(`[${this.plugin.name}] Error force stopping NPC ${npcId}:`, error.message);
+        // Send force stop with brake parameter
+        const result = await this._queueCommand({
+            op: 'forceStop',
+            npcId: npcId,
+            brakeForce: 10.0 // High brake force for immediate stop
+        });
+        if (result === null) {
+            console.warn(`[${this.plugin.name}] Error force stopping NPC ${npcId}`);
+            return;
         }
+
+        const agentData = this.agents.get(npcId);
+        if (agentData) {
+            agentData.lastUsed = Date.now();
+            agentData.forceStopped = true; // Mark as force stopped
+        }
+
+        this.pathfindingStats.forceStops++;
+        console.log(`[${this.plugin.name}] Force stopped NPC ${npcId} with brake force`);
     }
 
     // NEW: Check if agent has reached target (for callback mechanism)
@@ -398,13 +748,54 @@ class PathfindingManager {
         }
     }
 
-    // MODIFIED: Enhanced update method with dead NPC handling
+    // NEW: One bulk request for every agent's position, velocity and target state
+    async getAgentStates(npcIds = []) {
+        if (!this.isReady) return null;
+
+        try {
+            // Shared memory first (newest published tick), then the push stream, then the binary socket
+            const snapshot = this.agentRing?.read() || this.agentStream?.read() || (this.ipc?.isConnected ? await this.ipc.getAgentStates(npcIds) : null);
+            if (snapshot) {
+                this.lastStateTick = snapshot.tick;
+                return snapshot.agents;
+            }
+
+            const response = await fetch(`${this.serviceUrl}/getAgentStates`, {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify({ npcIds: npcIds })
+            });
+
+            const result = await response.json();
+            if (result.success) {
+                this.lastStateTick = result.tick;
+                return result.agents;
+            }
+        } catch (error) {
+            console.warn(`[${this.plugin.name}] Error fetching agent states:`, error.message);
+        }
+        return null;
+    }
+
+    // Agent stream events. Target arrivals are picked up from the state flags in update();
+    // an agent the service dropped loses its cached handle so later commands go by npc id.
+    _onAgentStreamEvent(type, npcId, handle) {
+        if (type !== 'removed' || !npcId) return;
+        const agentData = this.agents.get(npcId);
+        if (agentData && agentData.handle === handle) agentData.handle = 0;
+    }
+
+    // MODIFIED: Enhanced update method with dead NPC handling - one snapshot request per tick
 async update(deltaTime) {
     if (!this.isReady || !this.server) return;
 
     this.pathfindingStats.crowdUpdates++;
 
     const now = Date.now();
+    this._publishInterestPoints(now);
+    this._syncObstacles(now);
+
+    const liveAgents = [];
     for (const [npcId, agentData] of this.agents.entries()) {
         const npc = this.server._npcs[npcId];
         
@@ -414,77 +805,87 @@ async update(deltaTime) {
             this.removeAgentFromCrowd(npcId);
             continue;
         }
+        liveAgents.push(npcId);
+    }
+    if (liveAgents.length === 0) return;
+
+    // [px, py, pz, vx, vy, vz, targetState, atTarget] per npcId
+    const states = await this.getAgentStates();
+    if (!states) return;
+
+    for (const npcId of liveAgents) {
+        const agentData = this.agents.get(npcId);
+        const npc = this.server._npcs[npcId];
+        const state = states[npcId];
+        if (!agentData || !npc || !state) continue;
 
         try {
             agentData.lastUsed = now;
 
-            // NEW: Check if agent reached target before position update
-            if (!agentData.forceStopped) {
-                const reachedTarget = await this.checkAgentTargetReached(npcId);
-                if (reachedTarget) {
-                    console.log(`[${this.plugin.name}] NPC ${npcId} reached pathfinding target`);
-                    await this.forceStopNPC(npcId);
-                    }
+            // NEW: Check if agent reached target before position update.
+            // Not awaited so every stop issued this tick shares one /batch request.
+            let reachedTarget = false;
+            if (!agentData.forceStopped && state[7]) {
+                reachedTarget = true;
+                this.pathfindingStats.targetReached++;
+                console.log(`[${this.plugin.name}] NPC ${npcId} reached pathfinding target`);
+                this.forceStopNPC(npcId);
             }
 
-            // Get agent position and velocity from C++ service
-            const [posResponse, velResponse] = await Promise.all([
-                fetch(`${this.serviceUrl}/getAgentPosition`, {
-                    method: 'POST',
-                    headers: { 'Content-Type': 'application/json' },
-                    body: JSON.stringify({ npcId: npcId })
-                }),
-                fetch(`${this.serviceUrl}/getAgentVelocity`, {
-                    method: 'POST',
-                    headers: { 'Content-Type': 'application/json' },
-                    body: JSON.stringify({ npcId: npcId })
-                })
-            ]);
-
-            const posResult = await posResponse.json();
-const velResult = await velResponse.json();
-
-
-            if (posResult.success && posResult.position) {
-                // Update NPC position directly from crowd
-                npc.state.position[0] = posResult.position[0];
-                npc.state.position[1] = posResult.position[1];
-                npc.state.position[2] = posResult.position[2];
-                
-                let horizontalSpeed = 0;
-                let verticalSpeed = 0;
-                let orientation = npc.state.orientation;
-                
-                // --- THE CRITICAL FIX IS HERE ---
-                // Check the forceStopped flag BEFORE processing velocity.
-                if (agentData.forceStopped) {
-                    // If the AI has commanded a force stop, we IGNORE the C++ velocity
-                    // and send a zero-velocity packet to guarantee the client stops prediction.
-                    npc.velocity = { x: 0, y: 0, z: 0 };
-                    horizontalSpeed = 0;
-                    verticalSpeed = 0;
-                }
-                else if (velResult.success && velResult.velocity) {
-                    const vel = velResult.velocity;
-                    npc.velocity = { x: vel[0], y: vel[1], z: vel[2] };
-                    horizontalSpeed = Math.sqrt(vel[0] * vel[0] + vel[2] * vel[2]);
-                    verticalSpeed = vel[1];
-                    if (horizontalSpeed > 0.1) {
-                        orientation = Math.atan2(vel[0], vel[2]);
-                    }
-                } else {
-                    npc.velocity = { x: 0, y: 0, z: 0 };
+            // Update NPC position directly from crowd
+            npc.state.position[0] = state[0];
+            npc.state.position[1] = state[1];
+            npc.state.position[2] = state[2];
+            
+            let horizontalSpeed = 0;
+            let verticalSpeed = 0;
+            let orientation = npc.state.orientation;
+            
+            // --- THE CRITICAL FIX IS HERE ---
+            // Check the forceStopped flag BEFORE processing velocity.
+            if (agentData.forceStopped || reachedTarget) {
+                // If the AI has commanded a force stop, we IGNORE the C++ velocity
+                // and send a zero-velocity packet to guarantee the client stops prediction.
+                npc.velocity = { x: 0, y: 0, z: 0 };
+            } else {
+                npc.velocity = { x: state[3], y: state[4], z: state[5] };
+                horizontalSpeed = Math.sqrt(state[3] * state[3] + state[5] * state[5]);
+                verticalSpeed = state[4];
+                if (horizontalSpeed > 0.1) {
+                    orientation = Math.atan2(state[3], state[5]);
                 }
-
-                // The packet is now always sent, but its speed will be zero if force stopped.
-                this.sendMovementPacket(npc, orientation, horizontalSpeed, verticalSpeed);
             }
+
+            // The packet is now always sent, but its speed will be zero if force stopped.
+            this.sendMovementPacket(npc, orientation, horizontalSpeed, verticalSpeed);
         } catch (error) {
             console.warn(`[${this.plugin.name}] Error updating agent for NPC ${npcId}:`, error.message);
         }
     }
 }
 
+    // NEW: Tell the service where players are so it keeps their navmesh tiles loaded
+    _publishInterestPoints(now) {
+        if (now - this._lastInterestUpdate < this._interestInterval) return;
+        this._lastInterestUpdate = now;
+
+        const points = [];
+        for (const client of Object.values(this.server._clients || {})) {
+            const character = client?.character;
+            if (!character || character.isHumanNPC || !character.state?.position) continue;
+            const pos = character.state.position;
+            points.push([pos[0], pos[1], pos[2]]);
+        }
+
+        fetch(`${this.serviceUrl}/setInterestPoints`, {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ points: points })
+        }).catch((error) => {
+            console.warn(`[${this.plugin.name}] Interest point update failed:`, error.message);
+        });
+    }
+
     // Helper method for finding closest player (used in update)
     findClosestPlayerForNPC(npc, aiManager) {
         if (!aiManager.playerEntities) return null;
@@ -587,6 +988,66 @@ const velResult = await velResponse.json();
             return [];
         }
     }
+
+    // Long routes of any length, planned a slice per crowd tick on the service. Resolves to
+    // { partial, path: [Float32Array, ...] }, or null if planning failed or timed out.
+    async planPath(a, b, timeoutMs = 15000) {
+        if (!this.isReady) return null;
+
+        try {
+            const ticket = this.ipc?.isConnected
+                ? await this.ipc.requestPath(a, b)
+                : (await (await fetch(`${this.serviceUrl}/requestPath`, {
+                    method: 'POST',
+                    headers: { 'Content-Type': 'application/json' },
+                    body: JSON.stringify({ start: [a[0], a[1], a[2]], end: [b[0], b[1], b[2]] })
+                })).json()).ticket;
+            if (!ticket) return null;
+
+            // The service parks each long-poll until the ticket finishes, holding up neither
+            // its workers nor the IPC connection
+            const deadline = Date.now() + timeoutMs;
+            while (Date.now() < deadline) {
+                const waitMs = Math.min(2000, Math.max(0, deadline - Date.now()));
+                const result = this.ipc?.isConnected
+                    ? await this.ipc.pathResult(ticket, waitMs)
+                    : await (await fetch(`${this.serviceUrl}/pathResult`, {
+                        method: 'POST',
+                        headers: { 'Content-Type': 'application/json' },
+                        body: JSON.stringify({ ticket, waitMs })
+                    })).json();
+                if (result.state === 'pending') continue;
+                if (result.state !== 'done') return null;
+                return { partial: result.partial, path: result.path.map(point => new Float32Array([point[0], point[1], point[2]])) };
+            }
+        } catch (e) {
+            console.warn(`[${this.plugin.name}] planPath failed:`, e.message);
+        }
+        return null;
+    }
+
+    // Straight-line waypoints between two points; repeated routes are served from the service's path cache
+    async findPath(a, b) {
+        if (!this.isReady) return [];
+
+        try {
+            const result = this.ipc?.isConnected
+                ? await this.ipc.findPath(a, b)
+                : await (await fetch(`${this.serviceUrl}/findPath`, {
+                    method: 'POST',
+                    headers: { 'Content-Type': 'application/json' },
+                    body: JSON.stringify({
+                        start: [a[0], a[1], a[2]],
+                        end: [b[0], b[1], b[2]]
+                    })
+                })).json();
+            if (!result.found) return [];
+            return result.path.map(point => new Float32Array([point[0], point[1], point[2]]));
+        } catch (e) {
+            console.warn(`[${this.plugin.name}] findPath failed:`, e.message);
+            return [];
+        }
+    }
 }
 
 module.exports = PathfindingManager;
\ No newline at end of file
@@ -0,0 +1,531 @@
+// ======================================================================
+// Binary IPC client for the C++ pathfinding service
+// Mirrors the frame layouts documented in pathfinding-ipc.h
+// ======================================================================
+
+"use strict";
+
+const net = require('net');
+const fs = require('fs');
+const http = require('http');
+
+const IPC_OP = {
+    HEALTH: 0,
+    GET_CLOSEST_NAV_POINT: 1,
+    HAS_LINE_OF_SIGHT: 2,
+    BATCH: 3,
+    GET_AGENT_STATES: 4,
+    TEST_NAVMESH: 5,
+    FIND_PATH: 6,
+    LINE_OF_SIGHT_BATCH: 7,
+    REQUEST_PATH: 8,
+    PATH_RESULT: 9,
+    SET_PLAYERS: 10,
+    NEAREST_TARGETS: 11
+};
+
+const PATH_TICKET_STATES = ['unknown', 'pending', 'done', 'failed'];
+
+const BATCH_OP = { add: 0, remove: 1, setTarget: 2, stop: 3, forceStop: 4, chase: 5 };
+
+const DEFAULT_ENDPOINT = process.platform === 'win32'
+    ? { host: '127.0.0.1', port: 8081 }
+    : { path: '/tmp/destromod-pathfinding.sock' };
+
+const AGENT_RING_PATH = '/dev/shm/destromod-agents';
+const RING_MAGIC = 0x52474144;
+const RING_HEADER_BYTES = 64;
+const SLOT_HEADER_BYTES = 24;
+const RECORD_ID_BYTES = 32;
+
+class PathfindingIpcClient {
+    // zoneIndex: the zone's index from GET /zones (or /health); 0 for a single-zone service
+    constructor(endpoint = DEFAULT_ENDPOINT, zoneIndex = 0) {
+        this.endpoint = endpoint;
+        this.zoneIndex = zoneIndex;
+        this.socket = null;
+        this.nextRequestId = 1;
+        this.pending = new Map(); // requestId -> { resolve, reject }
+        this.inbound = Buffer.alloc(0);
+    }
+
+    connect() {
+        return new Promise((resolve) => {
+            const socket = net.createConnection(this.endpoint);
+            socket.setNoDelay(true);
+            socket.once('connect', () => {
+                this.socket = socket;
+                resolve(true);
+            });
+            socket.once('error', () => resolve(false));
+            socket.on('data', (chunk) => this._onData(chunk));
+            socket.on('close', () => {
+                this.socket = null;
+                for (const entry of this.pending.values()) entry.reject(new Error('IPC connection closed'));
+                this.pending.clear();
+            });
+        });
+    }
+
+    get isConnected() {
+        return this.socket !== null;
+    }
+
+    _onData(chunk) {
+        this.inbound = this.inbound.length ? Buffer.concat([this.inbound, chunk]) : chunk;
+        while (this.inbound.length >= 4) {
+            const length = this.inbound.readUInt32LE(0);
+            if (this.inbound.length < 4 + length) break;
+            const frame = this.inbound.subarray(4, 4 + length);
+            this.inbound = this.inbound.subarray(4 + length);
+
+            const requestId = frame.readUInt32LE(0);
+            const status = frame.readUInt16LE(6);
+            const entry = this.pending.get(requestId);
+            if (!entry) continue;
+            this.pending.delete(requestId);
+            if (status === 0) {
+                entry.resolve(frame.subarray(8));
+            } else {
+                entry.reject(new Error(`IPC request failed with status ${status}`));
+            }
+        }
+    }
+
+    request(opcode, payload = Buffer.alloc(0)) {
+        if (!this.socket) return Promise.reject(new Error('IPC not connected'));
+        const requestId = this.nextRequestId++ >>> 0;
+        const header = Buffer.alloc(12);
+        header.writeUInt32LE(8 + payload.length, 0);
+        header.writeUInt32LE(requestId, 4);
+        header.writeUInt16LE(opcode, 8);
+        header.writeUInt16LE(this.zoneIndex, 10);
+        return new Promise((resolve, reject) => {
+            this.pending.set(requestId, { resolve, reject });
+            this.socket.write(Buffer.concat([header, payload]));
+        });
+    }
+
+    // commands: [{ op, npcId, handle, x, y, z, target, brakeForce, targetId }] as sent to /batch
+    async batch(commands) {
+        const parts = [];
+        const count = Buffer.alloc(2);
+        count.writeUInt16LE(commands.length, 0);
+        parts.push(count);
+        for (const command of commands) {
+            const id = Buffer.from(command.npcId, 'utf8');
+            const targetId = command.op === 'chase' ? Buffer.from(command.targetId, 'utf8') : null;
+            const record = Buffer.alloc(1 + 2 + id.length + 20 + (targetId ? 2 + targetId.length : 0));
+            const pos = command.target || [command.x || 0, command.y || 0, command.z || 0];
+            let offset = record.writeUInt8(BATCH_OP[command.op], 0);
+            offset = record.writeUInt16LE(id.length, offset);
+            offset += id.copy(record, offset);
+            offset = record.writeFloatLE(pos[0], offset);
+            offset = record.writeFloatLE(pos[1], offset);
+            offset = record.writeFloatLE(pos[2], offset);
+            offset = record.writeFloatLE(command.brakeForce || 0, offset);
+            offset = record.writeUInt32LE(command.handle || 0, offset);
+            if (targetId) {
+                offset = record.writeUInt16LE(targetId.length, offset);
+                targetId.copy(record, offset);
+            }
+            parts.push(record);
+        }
+
+        const response = await this.request(IPC_OP.BATCH, Buffer.concat(parts));
+        const tick = Number(response.readBigUInt64LE(0));
+        const resultCount = response.readUInt16LE(8);
+        const results = [];
+        const handles = [];
+        for (let i = 0; i < resultCount; i++) results.push(response.readUInt8(10 + i) === 1);
+        for (let i = 0; i < resultCount; i++) handles.push(response.readUInt32LE(10 + resultCount + i * 4));
+        return { tick, results, handles };
+    }
+
+    // Same shape as /getAgentStates: { tick, agents: { npcId: [px,py,pz, vx,vy,vz, targetState, atTarget, handle] } }
+    async getAgentStates(npcIds = [], threshold = 0, handles = []) {
+        const ids = npcIds.map(id => Buffer.from(id, 'utf8'));
+        const payload = Buffer.alloc(8 + ids.reduce((sum, id) => sum + 2 + id.length, 0) + handles.length * 4);
+        let offset = payload.writeFloatLE(threshold, 0);
+        offset = payload.writeUInt16LE(ids.length, offset);
+        for (const id of ids) {
+            offset = payload.writeUInt16LE(id.length, offset);
+            offset += id.copy(payload, offset);
+        }
+        offset = payload.writeUInt16LE(handles.length, offset);
+        for (const handle of handles) offset = payload.writeUInt32LE(handle, offset);
+
+        const response = await this.request(IPC_OP.GET_AGENT_STATES, payload);
+        const tick = Number(response.readBigUInt64LE(0));
+        const count = response.readUInt16LE(8);
+        const agents = {};
+        offset = 10;
+        for (let i = 0; i < count; i++) {
+            const idLength = response.readUInt16LE(offset);
+            const npcId = response.toString('utf8', offset + 2, offset + 2 + idLength);
+            offset += 2 + idLength;
+            const state = [];
+            for (let f = 0; f < 6; f++) state.push(response.readFloatLE(offset + f * 4));
+            state.push(response.readUInt8(offset + 24), response.readUInt8(offset + 25), response.readUInt32LE(offset + 26));
+            agents[npcId] = state;
+            offset += 30;
+        }
+        return { tick, agents };
+    }
+
+    async hasLineOfSight(fromPos, toPos) {
+        const payload = Buffer.alloc(24);
+        for (let i = 0; i < 3; i++) {
+            payload.writeFloatLE(fromPos[i], i * 4);
+            payload.writeFloatLE(toPos[i], 12 + i * 4);
+        }
+        const response = await this.request(IPC_OP.HAS_LINE_OF_SIGHT, payload);
+        return response.readUInt8(0) === 1;
+    }
+
+    async getClosestNavPoint(pos) {
+        const payload = Buffer.alloc(12);
+        for (let i = 0; i < 3; i++) payload.writeFloatLE(pos[i], i * 4);
+        const response = await this.request(IPC_OP.GET_CLOSEST_NAV_POINT, payload);
+        if (response.readUInt8(0) !== 1) return null;
+        return { x: response.readFloatLE(1), y: response.readFloatLE(5), z: response.readFloatLE(9) };
+    }
+
+    // pairs: [[sx, sy, sz, ex, ey, ez], ...] -> array of booleans
+    async lineOfSightBatch(pairs) {
+        const payload = Buffer.alloc(2 + pairs.length * 24);
+        let offset = payload.writeUInt16LE(pairs.length, 0);
+        for (const pair of pairs) {
+            for (let i = 0; i < 6; i++) offset = payload.writeFloatLE(pair[i], offset);
+        }
+        const response = await this.request(IPC_OP.LINE_OF_SIGHT_BATCH, payload);
+        const count = response.readUInt16LE(0);
+        const visible = new Array(count);
+        for (let i = 0; i < count; i++) visible[i] = ((response[2 + (i >> 3)] >> (i & 7)) & 1) === 1;
+        return visible;
+    }
+
+    // playerIds[i] stands at points[i] = [x, y, z]; replaces the previous set
+    async setPlayers(playerIds, points) {
+        const ids = playerIds.map(id => Buffer.from(String(id), 'utf8'));
+        const payload = Buffer.alloc(2 + ids.reduce((sum, id) => sum + 2 + id.length + 12, 0));
+        let offset = payload.writeUInt16LE(ids.length, 0);
+        ids.forEach((id, i) => {
+            offset = payload.writeUInt16LE(id.length, offset);
+            offset += id.copy(payload, offset);
+            for (let k = 0; k < 3; k++) offset = payload.writeFloatLE(points[i][k], offset);
+        });
+        const response = await this.request(IPC_OP.SET_PLAYERS, payload);
+        return response.readUInt32LE(0);
+    }
+
+    // queries: [[x, y, z, radius], ...] -> { targets: [playerId or null, ...], distances: [...] }
+    async nearestTargets(queries, lineOfSight = true) {
+        const payload = Buffer.alloc(3 + queries.length * 16);
+        let offset = payload.writeUInt8(lineOfSight ? 1 : 0, 0);
+        offset = payload.writeUInt16LE(queries.length, offset);
+        for (const query of queries) {
+            for (let i = 0; i < 4; i++) offset = payload.writeFloatLE(query[i], offset);
+        }
+        const response = await this.request(IPC_OP.NEAREST_TARGETS, payload);
+        const count = response.readUInt16LE(0);
+        const targets = new Array(count);
+        const distances = new Array(count);
+        offset = 2;
+        for (let i = 0; i < count; i++) {
+            const idLength = response.readUInt16LE(offset);
+            targets[i] = idLength > 0 ? response.toString('utf8', offset + 2, offset + 2 + idLength) : null;
+            offset += 2 + idLength;
+            distances[i] = response.readFloatLE(offset);
+            offset += 4;
+        }
+        return { targets, distances };
+    }
+
+    async requestPath(fromPos, toPos) {
+        const payload = Buffer.alloc(24);
+        for (let i = 0; i < 3; i++) {
+            payload.writeFloatLE(fromPos[i], i * 4);
+            payload.writeFloatLE(toPos[i], 12 + i * 4);
+        }
+        const response = await this.request(IPC_OP.REQUEST_PATH, payload);
+        return Number(response.readBigUInt64LE(0));
+    }
+
+    // Long-polls up to waitMs; the service parks the wait, so other requests on this socket are not held up
+    async pathResult(ticket, waitMs = 0) {
+        const payload = Buffer.alloc(12);
+        payload.writeBigUInt64LE(BigInt(ticket), 0);
+        payload.writeUInt32LE(waitMs >>> 0, 8);
+        const response = await this.request(IPC_OP.PATH_RESULT, payload);
+        const count = response.readUInt32LE(6);
+        const path = [];
+        for (let i = 0; i < count; i++) {
+            const offset = 10 + i * 12;
+            path.push([response.readFloatLE(offset), response.readFloatLE(offset + 4), response.readFloatLE(offset + 8)]);
+        }
+        return {
+            state: PATH_TICKET_STATES[response.readUInt8(0)] || 'unknown',
+            partial: response.readUInt8(1) === 1,
+            polys: response.readUInt32LE(2),
+            path
+        };
+    }
+
+    // { found, partial, cached, path: [[x,y,z], ...] }
+    async findPath(fromPos, toPos) {
+        const payload = Buffer.alloc(24);
+        for (let i = 0; i < 3; i++) {
+            payload.writeFloatLE(fromPos[i], i * 4);
+            payload.writeFloatLE(toPos[i], 12 + i * 4);
+        }
+        const response = await this.request(IPC_OP.FIND_PATH, payload);
+        const count = response.readUInt16LE(3);
+        const path = [];
+        for (let i = 0; i < count; i++) {
+            const offset = 5 + i * 12;
+            path.push([response.readFloatLE(offset), response.readFloatLE(offset + 4), response.readFloatLE(offset + 8)]);
+        }
+        return { found: response.readUInt8(0) === 1, partial: response.readUInt8(1) === 1, cached: response.readUInt8(2) === 1, path };
+    }
+
+    close() {
+        if (this.socket) this.socket.destroy();
+        this.socket = null;
+    }
+}
+
+// Reads the newest tick from the service's shared-memory agent ring.
+// Node has no mmap, so each read is one pread of the newest slot into a reused buffer
+// (Linux /dev/shm only); a native mmap addon could read the same layout in place.
+class SharedAgentReader {
+    // Zone 0 publishes to the plain ring name, other zones append their key
+    static pathForZone(zoneKey, zoneIndex) {
+        return zoneIndex > 0 ? `${AGENT_RING_PATH}-${zoneKey}` : AGENT_RING_PATH;
+    }
+
+    constructor(ringPath = AGENT_RING_PATH) {
+        this.ringPath = ringPath;
+        this.fd = null;
+        this.header = Buffer.alloc(RING_HEADER_BYTES);
+        this.slot = null;
+        this.lastSeq = 0;
+    }
+
+    open() {
+        try {
+            this.fd = fs.openSync(this.ringPath, 'r');
+            fs.readSync(this.fd, this.header, 0, RING_HEADER_BYTES, 0);
+            if (this.header.readUInt32LE(0) !== RING_MAGIC) {
+                this.close();
+                return false;
+            }
+            this.slotCount = this.header.readUInt32LE(8);
+            this.slotBytes = this.header.readUInt32LE(12);
+            this.recordBytes = this.header.readUInt32LE(20);
+            this.slot = Buffer.alloc(this.slotBytes);
+            return true;
+        } catch (error) {
+            this.fd = null;
+            return false;
+        }
+    }
+
+    get isOpen() {
+        return this.fd !== null;
+    }
+
+    // Returns { tick, agents } or null if no complete new tick could be read
+    read(retries = 3) {
+        if (this.fd === null) return null;
+        for (let attempt = 0; attempt < retries; attempt++) {
+            fs.readSync(this.fd, this.header, 0, RING_HEADER_BYTES, 0);
+            const seq = this.header.readBigUInt64LE(24);
+            if (seq === 0n) return null;
+
+            const slotIndex = Number(seq % BigInt(this.slotCount));
+            fs.readSync(this.fd, this.slot, 0, this.slotBytes, RING_HEADER_BYTES + slotIndex * this.slotBytes);
+            const seqEnd = this.slot.readBigUInt64LE(0);
+            const seqBegin = this.slot.readBigUInt64LE(this.slotBytes - 8);
+            if (seqEnd !== seq || seqBegin !== seq) continue; // Torn by a concurrent publish - retry
+
+            const tick = Number(this.slot.readBigUInt64LE(8));
+            const count = this.slot.readUInt32LE(16);
+            const agents = {};
+            for (let i = 0; i < count; i++) {
+                const offset = SLOT_HEADER_BYTES + i * this.recordBytes;
+                const idEnd = this.slot.indexOf(0, offset);
+                const npcId = this.slot.toString('utf8', offset, idEnd < 0 || idEnd > offset + RECORD_ID_BYTES ? offset + RECORD_ID_BYTES : idEnd);
+                const base = offset + RECORD_ID_BYTES;
+                agents[npcId] = [
+                    this.slot.readFloatLE(base), this.slot.readFloatLE(base + 4), this.slot.readFloatLE(base + 8),
+                    this.slot.readFloatLE(base + 12), this.slot.readFloatLE(base + 16), this.slot.readFloatLE(base + 20),
+                    this.slot.readUInt8(base + 24), this.slot.readUInt8(base + 25)
+                ];
+            }
+            this.lastSeq = Number(seq);
+            return { tick, agents };
+        }
+        return null;
+    }
+
+    close() {
+        if (this.fd !== null) fs.closeSync(this.fd);
+        this.fd = null;
+    }
+}
+
+// Pushed agent state from GET /agentStream (layout in pathfinding-agentstream.h).
+// Applies every frame to a handle -> state table as it arrives, so read() is a copy
+// of the newest tick with no round trip. Reconnects after a drop; the service sends a
+// keyframe to every new subscriber.
+const STREAM_KEYFRAME = 1;
+const STREAM_FIELD = { ID: 1, POS_ABS: 2, POS_DELTA: 4, VEL: 8, STATE: 16 };
+const STREAM_EVENTS = { 1: 'targetReached', 2: 'removed' };
+
+class AgentStreamClient {
+    constructor(url = 'http://localhost:8080/agentStream', onEvent = null) {
+        this.url = url;
+        this.onEvent = onEvent;
+        this.request = null;
+        this.pending = Buffer.alloc(0);
+        this.agents = new Map(); // handle -> { npcId, pos: [x,y,z] in steps, vel, state }
+        this.tick = 0;
+        this.synced = false;
+        this.positionStep = 1;
+        this.velocityStep = 1;
+        this.closed = false;
+        this.reconnectDelay = 1000;
+    }
+
+    // Resolves true once the first keyframe has been applied
+    connect(timeout = 2000) {
+        this.closed = false;
+        return new Promise((resolve) => {
+            let settled = false;
+            const settle = (ok) => {
+                if (!settled) {
+                    settled = true;
+                    resolve(ok);
+                }
+            };
+            const timer = setTimeout(() => settle(false), timeout);
+            this._open(() => {
+                clearTimeout(timer);
+                settle(true);
+            });
+        });
+    }
+
+    _open(onSynced) {
+        this.pending = Buffer.alloc(0);
+        this.synced = false;
+        this.request = http.get(this.url, (response) => {
+            if (response.statusCode !== 200) {
+                response.resume();
+                return;
+            }
+            response.on('data', (data) => {
+                this.pending = this.pending.length ? Buffer.concat([this.pending, data]) : data;
+                let offset = 0;
+                while (this.pending.length - offset >= 4) {
+                    const size = this.pending.readUInt32LE(offset);
+                    if (this.pending.length - offset - 4 < size) break;
+                    this._applyFrame(this.pending.subarray(offset + 4, offset + 4 + size));
+                    offset += 4 + size;
+                    if (this.synced && onSynced) {
+                        onSynced();
+                        onSynced = null;
+                    }
+                }
+                this.pending = this.pending.subarray(offset);
+            });
+            response.on('end', () => this._dropped());
+        });
+        this.request.on('error', () => this._dropped());
+    }
+
+    _dropped() {
+        this.synced = false;
+        this.request = null;
+        if (!this.closed) setTimeout(() => this._open(null), this.reconnectDelay);
+    }
+
+    _applyFrame(frame) {
+        const kind = frame.readUInt8(0);
+        if (kind !== STREAM_KEYFRAME && !this.synced) return;
+        if (kind === STREAM_KEYFRAME) {
+            this.agents.clear();
+            this.synced = true;
+        }
+        this.tick = Number(frame.readBigUInt64LE(4));
+        this.positionStep = frame.readFloatLE(12);
+        this.velocityStep = frame.readFloatLE(16);
+        const agentCount = frame.readUInt32LE(20);
+        const eventCount = frame.readUInt32LE(24);
+        let at = 28;
+        for (let i = 0; i < agentCount; i++) {
+            const handle = frame.readUInt32LE(at);
+            const fields = frame.readUInt8(at + 4);
+            at += 5;
+            let agent = this.agents.get(handle);
+            if (!agent) {
+                agent = { npcId: '', pos: [0, 0, 0], vel: [0, 0, 0], state: 0 };
+                this.agents.set(handle, agent);
+            }
+            if (fields & STREAM_FIELD.ID) {
+                const length = frame.readUInt16LE(at);
+                agent.npcId = frame.toString('utf8', at + 2, at + 2 + length);
+                at += 2 + length;
+            }
+            if (fields & STREAM_FIELD.POS_ABS) {
+                for (let k = 0; k < 3; k++) agent.pos[k] = frame.readInt32LE(at + k * 4);
+                at += 12;
+            } else if (fields & STREAM_FIELD.POS_DELTA) {
+                for (let k = 0; k < 3; k++) agent.pos[k] += frame.readInt16LE(at + k * 2);
+                at += 6;
+            }
+            if (fields & STREAM_FIELD.VEL) {
+                for (let k = 0; k < 3; k++) agent.vel[k] = frame.readInt16LE(at + k * 2);
+                at += 6;
+            }
+            if (fields & STREAM_FIELD.STATE) agent.state = frame.readUInt8(at++);
+        }
+        for (let i = 0; i < eventCount; i++, at += 5) {
+            const type = STREAM_EVENTS[frame.readUInt8(at)];
+            const handle = frame.readUInt32LE(at + 1);
+            const agent = this.agents.get(handle);
+            if (type === 'removed') this.agents.delete(handle);
+            if (this.onEvent && type) this.onEvent(type, agent ? agent.npcId : null, handle);
+        }
+    }
+
+    get isConnected() {
+        return this.synced;
+    }
+
+    // Same shape as SharedAgentReader.read(), plus the handle as a ninth element; null until synced
+    read() {
+        if (!this.synced) return null;
+        const agents = {};
+        const p = this.positionStep;
+        const v = this.velocityStep;
+        for (const [handle, agent] of this.agents) {
+            agents[agent.npcId] = [
+                agent.pos[0] * p, agent.pos[1] * p, agent.pos[2] * p,
+                agent.vel[0] * v, agent.vel[1] * v, agent.vel[2] * v,
+                agent.state & 0x7f, agent.state >> 7, handle
+            ];
+        }
+        return { tick: this.tick, agents };
+    }
+
+    close() {
+        this.closed = true;
+        if (this.request) this.request.destroy();
+        this.request = null;
+        this.synced = false;
+    }
+}
+
+module.exports = { PathfindingIpcClient, SharedAgentReader, AgentStreamClient, IPC_OP };
@@ -73,22 +73,43 @@ class DestroMOD_AI_Plugin {
     console.log(`[${this.name}] Starting 64-bit pathfinding service...`);
         
     // Launch the C++ service
-    const servicePath = path.join(__dirname, 'pathfinding-service.exe');
-    this.pathfindingProcess = spawn(servicePath, [], {
-        cwd: __dirname,
-        stdio: ['ignore', 'pipe', 'pipe']
-    });
+    const serviceBinary = process.platform === 'win32' ? 'pathfinding-service.exe' : 'pathfinding-service';
+    const servicePath = path.join(__dirname, serviceBinary);
+    const serviceArgs = [];
+    if (this.config.pathfindingMaxAgents > 0) serviceArgs.push('--max-agents', String(this.config.pathfindingMaxAgents));
+    if (this.config.pathfindingCrowdShards > 0) serviceArgs.push('--crowd-shards', String(this.config.pathfindingCrowdShards));
+    // Tile streaming keeps only the navmesh around players and zombies resident (needs the indexed .navidx file)
+    if (this.config.pathfindingStreamRadius > 0) {
+        serviceArgs.push('--stream-radius', String(this.config.pathfindingStreamRadius));
+        serviceArgs.push('--stream-budget-mb', String(this.config.pathfindingStreamBudgetMB || 256));
+    }
+    // One service can host every zone server on the machine: pathfindingZones maps zone keys to
+    // navmesh files, and each server picks its own with pathfindingZone
+    for (const [zone, navmesh] of Object.entries(this.config.pathfindingZones || {})) {
+        serviceArgs.push('--zone', `${zone}=${navmesh}`);
+    }
 
-    this.pathfindingProcess.stdout.on('data', (data) => {
-        console.log(`[PathfindingService] ${data.toString().trim()}`);
-    });
+    // Another zone server may have started the shared service already
+    const serviceRunning = await fetch('http://localhost:8080/zones').then((response) => response.ok, () => false);
+    if (serviceRunning) {
+        console.log(`[${this.name}] Pathfinding service already running, joining it`);
+    } else {
+        this.pathfindingProcess = spawn(servicePath, serviceArgs, {
+            cwd: __dirname,
+            stdio: ['ignore', 'pipe', 'pipe']
+        });
 
-    this.pathfindingProcess.stderr.on('data', (data) => {
-        console.error(`[PathfindingService] ERROR: ${data.toString().trim()}`);
-    });
+        this.pathfindingProcess.stdout.on('data', (data) => {
+            console.log(`[PathfindingService] ${data.toString().trim()}`);
+        });
 
-    // Wait a few seconds for service to start
-    await new Promise(resolve => setTimeout(resolve, 3000));
+        this.pathfindingProcess.stderr.on('data', (data) => {
+            console.error(`[PathfindingService] ERROR: ${data.toString().trim()}`);
+        });
+
+        // Wait a few seconds for service to start
+        await new Promise(resolve => setTimeout(resolve, 3000));
+    }
 
     console.log(`[${this.name}] Initializing AI with AGGRO-BASED pathfinding`);
 
@@ -0,0 +1,130 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - AgentIdIndex / AgentTable tests
+// Handle reuse after removal, restores onto a saved handle, and migration re-keying.
+// ===================================================================================
+
+#include <string>
+#include <vector>
+
+#include "test-check.h"
+#include "../pathfinding-agents.h"
+
+static void testIdIndexProbeRuns() {
+    // Values are indices into keys, like the slots AgentTable stores
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; i++) keys.push_back("npc_" + std::to_string(i));
+    auto keyOf = [&keys](int value) { return std::string_view(keys[value]); };
+
+    AgentIdIndex index;
+    for (int i = 0; i < (int)keys.size(); i++) index.insert(keys[i], i);
+    CHECK(index.size() == keys.size());
+    for (int i = 0; i < (int)keys.size(); i++) CHECK(index.find(keys[i], keyOf) == i);
+    CHECK(index.find("npc_missing", keyOf) == -1);
+
+    // Erasing every other id must not cut the probe runs of the ones left
+    for (int i = 0; i < (int)keys.size(); i += 2) CHECK(index.erase(keys[i], keyOf));
+    CHECK(!index.erase(keys[0], keyOf));
+    CHECK(index.size() == keys.size() / 2);
+    for (int i = 0; i < (int)keys.size(); i++) CHECK(index.find(keys[i], keyOf) == (i % 2 ? i : -1));
+
+    index.clear();
+    CHECK(index.size() == 0);
+    CHECK(index.find(keys[1], keyOf) == -1);
+}
+
+static void testHandleReuse() {
+    AgentTable table;
+    int a = table.add("alpha", 10);
+    int b = table.add("bravo", 11);
+    CHECK(a >= 0 && b >= 0 && a != b);
+    CHECK(table.size() == 2);
+
+    AgentHandle alpha = table.handleOf(a);
+    CHECK(alpha != AGENT_HANDLE_NONE);
+    CHECK(table.resolve(alpha) == a);
+    CHECK(table.find("alpha") == a);
+    CHECK(table.crowdHandle(a) == 10);
+    CHECK(table.resolve(AGENT_HANDLE_NONE) == -1);
+
+    // The freed slot is reused, but under a new generation: the old handle stays dead
+    table.remove(a);
+    CHECK(table.size() == 1);
+    CHECK(table.resolve(alpha) == -1);
+    CHECK(table.find("alpha") == -1);
+    int c = table.add("charlie", 12);
+    CHECK(c == a);
+    AgentHandle charlie = table.handleOf(c);
+    CHECK(charlie != alpha);
+    CHECK(agentHandleSlot(charlie) == agentHandleSlot(alpha));
+    CHECK(table.resolve(alpha) == -1);
+    CHECK(table.resolve(charlie) == c);
+    CHECK(table.npcId(c) == "charlie");
+
+    // Removing twice is harmless
+    table.remove(c);
+    table.remove(c);
+    CHECK(table.size() == 1);
+}
+
+static void testAddAt() {
+    AgentTable table;
+    int kept = table.add("kept", 0);
+    int gone = table.add("gone", 1);
+    AgentHandle goneHandle = table.handleOf(gone);
+    table.remove(gone);
+
+    // A restored agent takes its saved slot and generation back when the slot is free
+    const AgentHandle saved = makeAgentHandle(5, 7);
+    int slot = table.addAt("restored", 2, saved);
+    CHECK(slot == 5);
+    CHECK(table.handleOf(slot) == saved);
+    CHECK(table.resolve(saved) == slot);
+
+    // The slots added to reach it are free and usable
+    std::vector<int> filled;
+    for (int i = 0; i < 4; i++) filled.push_back(table.add("fill_" + std::to_string(i), 10 + i));
+    for (int s : filled) CHECK(s != kept && s != slot && s >= 0 && s < 5);
+    CHECK(table.resolve(goneHandle) == -1);
+
+    // A taken slot falls back to a fresh one
+    int clash = table.addAt("clash", 20, saved);
+    CHECK(clash >= 0 && clash != slot);
+    CHECK(table.resolve(saved) == slot);
+    CHECK(table.find("clash") == clash);
+
+    // No handle is an ordinary add
+    int plain = table.addAt("plain", 21, AGENT_HANDLE_NONE);
+    CHECK(plain >= 0 && table.find("plain") == plain);
+}
+
+static void testMigrate() {
+    AgentTable table;
+    table.reserve(8, 16);
+    int a = table.add("a", 0);
+    int b = table.add("b", 1);
+    int c = table.add("c", 2);
+
+    // a and b trade crowd handles and c moves to a handle nobody had: every old handle is
+    // resolved before any is rebound
+    std::vector<std::pair<int, int>> moved = {{0, 1}, {1, 0}, {2, 9}, {7, 8}};
+    table.migrate(moved);
+    CHECK(table.crowdHandle(a) == 1);
+    CHECK(table.crowdHandle(b) == 0);
+    CHECK(table.crowdHandle(c) == 9);
+    CHECK(table.find("c") == c);
+
+    // Removal after a move clears the new crowd handle, so a later move from it is ignored
+    table.remove(c);
+    moved = {{9, 3}};
+    table.migrate(moved);
+    CHECK(table.crowdHandle(c) == -1);
+    CHECK(table.size() == 2);
+}
+
+int main() {
+    testIdIndexProbeRuns();
+    testHandleReuse();
+    testAddAt();
+    testMigrate();
+    return testResult("agents");
+}
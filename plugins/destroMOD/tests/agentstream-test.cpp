@@ -0,0 +1,271 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - AgentStreamEncoder tests
+// Frames are decoded the way a subscriber would and the rebuilt agent table is compared
+// with what was encoded: keyframes, thresholded deltas, absolute fallbacks for long
+// jumps, target-reached and removal events, and slot reuse.
+// ===================================================================================
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+
+#include "test-check.h"
+#include "../pathfinding-agentstream.h"
+
+struct StreamAgent {
+    AgentHandle handle;
+    std::string npcId;
+    float pos[3];
+    float vel[3];
+    int targetState;
+    bool atTarget;
+};
+
+static StreamAgent makeAgent(AgentHandle handle, const std::string& npcId, float x, float y, float z) {
+    return StreamAgent{handle, npcId, {x, y, z}, {0.0f, 0.0f, 0.0f}, 1, false};
+}
+
+// A subscriber's view of the crowd, rebuilt from frames
+struct DecodedAgent {
+    std::string npcId;
+    int32_t pos[3];
+    int16_t vel[3];
+    uint8_t state;
+};
+
+struct DecodedFrame {
+    uint8_t kind = 0;
+    unsigned long long tick = 0;
+    float positionStep = 0.0f;
+    uint32_t agentCount = 0;
+    std::vector<uint8_t> fields;
+    std::vector<std::pair<uint8_t, AgentHandle>> events;
+};
+
+class StreamReader {
+private:
+    const std::string& data;
+    size_t at;
+
+public:
+    bool valid;
+
+    explicit StreamReader(const std::string& frame) : data(frame), at(0), valid(true) {}
+
+    template <typename T>
+    T read() {
+        T value = T();
+        if (data.size() - at < sizeof(T)) {
+            valid = false;
+            return value;
+        }
+        memcpy(&value, data.data() + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+
+    std::string readString(size_t length) {
+        if (data.size() - at < length) {
+            valid = false;
+            return std::string();
+        }
+        std::string value = data.substr(at, length);
+        at += length;
+        return value;
+    }
+
+    bool atEnd() const { return at == data.size(); }
+};
+
+static bool decodeFrame(const std::string& frame, std::map<AgentHandle, DecodedAgent>& table, DecodedFrame& out) {
+    StreamReader reader(frame);
+    const uint32_t size = reader.read<uint32_t>();
+    if (size != frame.size() - sizeof(uint32_t)) return false;
+    out.kind = reader.read<uint8_t>();
+    reader.read<uint8_t>();
+    reader.read<uint16_t>();
+    out.tick = reader.read<uint64_t>();
+    out.positionStep = reader.read<float>();
+    reader.read<float>();
+    out.agentCount = reader.read<uint32_t>();
+    const uint32_t eventCount = reader.read<uint32_t>();
+    if (out.kind == AGENT_STREAM_KEYFRAME) table.clear();
+
+    for (uint32_t i = 0; i < out.agentCount && reader.valid; i++) {
+        const AgentHandle handle = reader.read<uint32_t>();
+        const uint8_t fields = reader.read<uint8_t>();
+        out.fields.push_back(fields);
+        DecodedAgent& agent = table[handle];
+        if (fields & AGENT_STREAM_ID) agent.npcId = reader.readString(reader.read<uint16_t>());
+        if (fields & AGENT_STREAM_POS_ABS) {
+            for (int k = 0; k < 3; k++) agent.pos[k] = reader.read<int32_t>();
+        } else if (fields & AGENT_STREAM_POS_DELTA) {
+            for (int k = 0; k < 3; k++) agent.pos[k] += reader.read<int16_t>();
+        }
+        if (fields & AGENT_STREAM_VEL) {
+            for (int k = 0; k < 3; k++) agent.vel[k] = reader.read<int16_t>();
+        }
+        if (fields & AGENT_STREAM_STATE) agent.state = reader.read<uint8_t>();
+    }
+    for (uint32_t i = 0; i < eventCount && reader.valid; i++) {
+        const uint8_t type = reader.read<uint8_t>();
+        const AgentHandle handle = reader.read<uint32_t>();
+        out.events.push_back({type, handle});
+        if (type == AGENT_STREAM_REMOVED) table.erase(handle);
+    }
+    return reader.valid && reader.atEnd();
+}
+
+// Every agent is known to the subscriber, within threshold of where it really is
+static void checkTable(const std::map<AgentHandle, DecodedAgent>& table, const std::vector<StreamAgent>& agents, float step, float tolerance) {
+    CHECK(table.size() == agents.size());
+    for (const auto& agent : agents) {
+        auto it = table.find(agent.handle);
+        CHECK(it != table.end());
+        if (it == table.end()) continue;
+        CHECK(it->second.npcId == agent.npcId);
+        for (int k = 0; k < 3; k++) CHECK_NEAR(it->second.pos[k] * step, agent.pos[k], tolerance);
+    }
+}
+
+static void testKeyframeAndDeltas() {
+    AgentStreamEncoder encoder;
+    const AgentStreamConfig config;
+    const float step = config.positionStep;
+    std::map<AgentHandle, DecodedAgent> table;
+    bool keyframe = false;
+
+    std::vector<StreamAgent> agents = {
+        makeAgent(makeAgentHandle(0, 1), "zombie_0", 10.0f, 0.0f, -4.0f),
+        makeAgent(makeAgentHandle(1, 1), "zombie_1", -250.5f, 12.25f, 3000.0f),
+        makeAgent(makeAgentHandle(2, 3), "zombie_2", 0.0f, 0.0f, 0.0f),
+    };
+
+    // The first frame is a keyframe listing everyone in full
+    DecodedFrame first;
+    CHECK(decodeFrame(encoder.encode(1, agents, keyframe), table, first));
+    CHECK(keyframe);
+    CHECK(first.kind == AGENT_STREAM_KEYFRAME);
+    CHECK(first.tick == 1);
+    CHECK(first.positionStep == step);
+    CHECK(first.agentCount == 3);
+    for (uint8_t fields : first.fields) CHECK(fields == (AGENT_STREAM_ID | AGENT_STREAM_POS_ABS | AGENT_STREAM_VEL | AGENT_STREAM_STATE));
+    checkTable(table, agents, step, step * 0.5f);
+
+    // Nothing moved: an empty delta
+    DecodedFrame idle;
+    CHECK(decodeFrame(encoder.encode(2, agents, keyframe), table, idle));
+    CHECK(!keyframe);
+    CHECK(idle.kind == AGENT_STREAM_DELTA);
+    CHECK(idle.agentCount == 0);
+    CHECK(idle.events.empty());
+
+    // Drift below the threshold is held back until it adds up past it
+    for (unsigned long long tick = 3; tick < 40; tick++) {
+        agents[0].pos[0] += 0.01f;
+        DecodedFrame drift;
+        CHECK(decodeFrame(encoder.encode(tick, agents, keyframe), table, drift));
+        CHECK(drift.agentCount <= 1);
+        checkTable(table, agents, step, config.positionThreshold + step);
+    }
+
+    // A short move goes out as a delta, a long jump falls back to absolute
+    agents[1].pos[2] += 1.5f;
+    agents[2].pos[0] += 1000.0f;
+    DecodedFrame moved;
+    CHECK(decodeFrame(encoder.encode(40, agents, keyframe), table, moved));
+    CHECK(moved.agentCount == 2);
+    CHECK(moved.fields.size() == 2 && moved.fields[0] == AGENT_STREAM_POS_DELTA && moved.fields[1] == AGENT_STREAM_POS_ABS);
+    checkTable(table, agents, step, step * 0.5f);
+
+    // Velocity and target state changes are sent on their own
+    agents[0].vel[1] = 2.0f;
+    agents[1].targetState = 2;
+    DecodedFrame changed;
+    CHECK(decodeFrame(encoder.encode(41, agents, keyframe), table, changed));
+    CHECK(changed.fields.size() == 2 && changed.fields[0] == AGENT_STREAM_VEL && changed.fields[1] == AGENT_STREAM_STATE);
+    CHECK_NEAR(table[agents[0].handle].vel[1] * config.velocityStep, 2.0f, config.velocityStep);
+    CHECK(table[agents[1].handle].state == 2);
+}
+
+static void testEvents() {
+    AgentStreamEncoder encoder;
+    const float step = AgentStreamConfig().positionStep;
+    std::map<AgentHandle, DecodedAgent> table;
+    bool keyframe = false;
+
+    std::vector<StreamAgent> agents = {
+        makeAgent(makeAgentHandle(0, 1), "a", 0.0f, 0.0f, 0.0f),
+        makeAgent(makeAgentHandle(1, 1), "b", 5.0f, 0.0f, 0.0f),
+        makeAgent(makeAgentHandle(2, 1), "c", 9.0f, 0.0f, 0.0f),
+    };
+    DecodedFrame frame;
+    CHECK(decodeFrame(encoder.encode(1, agents, keyframe), table, frame));
+
+    // Reaching the target raises an event and resends the state with the at-target bit
+    agents[1].atTarget = true;
+    DecodedFrame reached;
+    CHECK(decodeFrame(encoder.encode(2, agents, keyframe), table, reached));
+    CHECK(reached.events.size() == 1);
+    CHECK(reached.events.size() == 1 && reached.events[0].first == AGENT_STREAM_TARGET_REACHED && reached.events[0].second == agents[1].handle);
+    CHECK(table[agents[1].handle].state & 0x80);
+
+    // Staying there does not raise it again
+    DecodedFrame still;
+    CHECK(decodeFrame(encoder.encode(3, agents, keyframe), table, still));
+    CHECK(still.events.empty());
+
+    // An agent missing from the tick is removed
+    const AgentHandle gone = agents[2].handle;
+    agents.pop_back();
+    DecodedFrame removed;
+    CHECK(decodeFrame(encoder.encode(4, agents, keyframe), table, removed));
+    CHECK(removed.events.size() == 1 && removed.events[0].first == AGENT_STREAM_REMOVED && removed.events[0].second == gone);
+    checkTable(table, agents, step, step * 0.5f);
+
+    // A reused slot under a new generation removes the old agent and introduces the new one
+    const AgentHandle replaced = agents[0].handle;
+    agents[0] = makeAgent(makeAgentHandle(0, 2), "d", 1.0f, 2.0f, 3.0f);
+    DecodedFrame reused;
+    CHECK(decodeFrame(encoder.encode(5, agents, keyframe), table, reused));
+    CHECK(reused.events.size() == 1 && reused.events[0].first == AGENT_STREAM_REMOVED && reused.events[0].second == replaced);
+    CHECK(reused.fields.size() == 1 && (reused.fields[0] & AGENT_STREAM_ID) && (reused.fields[0] & AGENT_STREAM_POS_ABS));
+    checkTable(table, agents, step, step * 0.5f);
+}
+
+static void testResync() {
+    AgentStreamEncoder encoder;
+    const float step = AgentStreamConfig().positionStep;
+    std::vector<StreamAgent> agents = {makeAgent(makeAgentHandle(3, 1), "a", 1.0f, 1.0f, 1.0f)};
+    std::map<AgentHandle, DecodedAgent> table;
+    bool keyframe = false;
+    DecodedFrame frame;
+
+    encoder.encode(1, agents, keyframe);
+    encoder.encode(2, agents, keyframe);
+    CHECK(!keyframe);
+
+    // A subscriber joining late starts from a keyframe alone
+    encoder.requestKeyframe();
+    CHECK(decodeFrame(encoder.encode(3, agents, keyframe), table, frame));
+    CHECK(keyframe);
+    checkTable(table, agents, step, step * 0.5f);
+
+    encoder.reset();
+    encoder.encode(4, agents, keyframe);
+    CHECK(keyframe);
+
+    AgentStreamStats stats = encoder.getStats();
+    CHECK(stats.frames == 4);
+    CHECK(stats.keyframes == 3);
+    CHECK(stats.agentsSent == 3);
+    CHECK(stats.events == 0);
+}
+
+int main() {
+    testKeyframeAndDeltas();
+    testEvents();
+    testResync();
+    return testResult("agentstream");
+}
@@ -0,0 +1,34 @@
+@echo off
+echo Building and running pathfinding unit tests...
+
+REM Setup Visual Studio x64 environment (adjust path to your VS installation)
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvars64.bat"
+if %ERRORLEVEL% NEQ 0 (
+    echo Visual Studio x64 environment setup failed!
+    pause
+    exit /b 1
+)
+
+REM The tests only include the Detour headers; nothing links against Detour
+set DETOUR_INCLUDE=M:\H1_Tool_Projects\recastnavigation-main\Detour\Include
+set DETOUR_CROWD_INCLUDE=M:\H1_Tool_Projects\recastnavigation-main\DetourCrowd\Include
+
+set FAILED=0
+for %%T in (agents ipc pathcache agentstream targets crowdstate) do (
+    cl /std:c++17 /O1 /MD /EHsc /I"%DETOUR_INCLUDE%" /I"%DETOUR_CROWD_INCLUDE%" /DDT_POLYREF64=1 %%T-test.cpp /link ws2_32.lib /OUT:%%T-test.exe
+    if errorlevel 1 (
+        echo Build of %%T-test failed!
+        set FAILED=1
+    ) else (
+        %%T-test.exe
+        if errorlevel 1 set FAILED=1
+    )
+)
+
+if %FAILED% EQU 0 (
+    echo All tests passed!
+) else (
+    echo Tests failed!
+)
+
+pause
@@ -0,0 +1,36 @@
+#!/bin/sh
+echo "Building and running pathfinding unit tests (POSIX)..."
+
+# The tests only include the Detour headers; nothing links against Detour
+RECAST_ROOT=${RECAST_ROOT:-$HOME/recastnavigation-main}
+DETOUR_INCLUDE=${DETOUR_INCLUDE:-$RECAST_ROOT/Detour/Include}
+DETOUR_CROWD_INCLUDE=${DETOUR_CROWD_INCLUDE:-$RECAST_ROOT/DetourCrowd/Include}
+
+failed=0
+for test in agents ipc pathcache agentstream targets crowdstate; do
+    ${CXX:-g++} -std=c++17 \
+       -O1 \
+       -g \
+       -Wall \
+       -pthread \
+       -I"$DETOUR_INCLUDE" \
+       -I"$DETOUR_CROWD_INCLUDE" \
+       -DDT_POLYREF64=1 \
+       $TEST_FLAGS \
+       $test-test.cpp \
+       -o $test-test
+
+    if [ $? -ne 0 ]; then
+        echo "Build of $test-test failed!"
+        failed=1
+        continue
+    fi
+    ./$test-test || failed=1
+done
+
+if [ $failed -eq 0 ]; then
+    echo "All tests passed!"
+else
+    echo "Tests failed!"
+    exit 1
+fi
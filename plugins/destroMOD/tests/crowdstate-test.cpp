@@ -0,0 +1,134 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - CrowdState tests
+// Encode/decode round trip, the file write/read pair, and rejection of foreign and
+// truncated buffers.
+// ===================================================================================
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include "test-check.h"
+#include "../pathfinding-crowdstate.h"
+
+static CrowdStateAgent makeAgent(const std::string& npcId, AgentHandle handle, float base, const std::string& chaseTarget) {
+    CrowdStateAgent agent;
+    agent.npcId = npcId;
+    agent.handle = handle;
+    for (int i = 0; i < 3; i++) {
+        agent.pos[i] = base + i;
+        agent.vel[i] = base * 0.5f - i;
+        agent.targetPos[i] = base * 2.0f + i * 0.25f;
+    }
+    agent.targetState = DT_CROWDAGENT_TARGET_VALID;
+    agent.chaseTarget = chaseTarget;
+    memset(&agent.params, 0, sizeof(agent.params));
+    agent.params.radius = 0.6f;
+    agent.params.height = 2.0f;
+    agent.params.maxAcceleration = 8.0f;
+    agent.params.maxSpeed = base;
+    agent.params.collisionQueryRange = 7.2f;
+    agent.params.pathOptimizationRange = 18.0f;
+    agent.params.separationWeight = 2.0f;
+    agent.params.updateFlags = 0x1f;
+    agent.params.obstacleAvoidanceType = 3;
+    agent.params.queryFilterType = 1;
+    return agent;
+}
+
+static CrowdState makeState() {
+    CrowdState state;
+    state.tick = 123456789012ULL;
+    state.savedUnixMs = 1700000000000ULL;
+    state.agents.push_back(makeAgent("zombie_1", makeAgentHandle(0, 1), 3.5f, ""));
+    state.agents.push_back(makeAgent("zombie_2", makeAgentHandle(42, 9), -7.25f, "player_7"));
+    state.agents.push_back(makeAgent(std::string(), AGENT_HANDLE_NONE, 0.0f, ""));
+    return state;
+}
+
+static void checkSameAgent(const CrowdStateAgent& a, const CrowdStateAgent& b) {
+    CHECK(a.npcId == b.npcId);
+    CHECK(a.handle == b.handle);
+    for (int i = 0; i < 3; i++) {
+        CHECK(a.pos[i] == b.pos[i]);
+        CHECK(a.vel[i] == b.vel[i]);
+        CHECK(a.targetPos[i] == b.targetPos[i]);
+    }
+    CHECK(a.targetState == b.targetState);
+    CHECK(a.chaseTarget == b.chaseTarget);
+    CHECK(a.params.radius == b.params.radius);
+    CHECK(a.params.height == b.params.height);
+    CHECK(a.params.maxAcceleration == b.params.maxAcceleration);
+    CHECK(a.params.maxSpeed == b.params.maxSpeed);
+    CHECK(a.params.collisionQueryRange == b.params.collisionQueryRange);
+    CHECK(a.params.pathOptimizationRange == b.params.pathOptimizationRange);
+    CHECK(a.params.separationWeight == b.params.separationWeight);
+    CHECK(a.params.updateFlags == b.params.updateFlags);
+    CHECK(a.params.obstacleAvoidanceType == b.params.obstacleAvoidanceType);
+    CHECK(a.params.queryFilterType == b.params.queryFilterType);
+}
+
+static void checkSameState(const CrowdState& a, const CrowdState& b) {
+    CHECK(a.tick == b.tick);
+    CHECK(a.savedUnixMs == b.savedUnixMs);
+    CHECK(a.agents.size() == b.agents.size());
+    for (size_t i = 0; i < a.agents.size() && i < b.agents.size(); i++) checkSameAgent(a.agents[i], b.agents[i]);
+}
+
+static void testRoundTrip() {
+    const CrowdState state = makeState();
+    std::string data;
+    encodeCrowdState(state, data);
+
+    CrowdState decoded;
+    CHECK(decodeCrowdState(data, decoded));
+    checkSameState(state, decoded);
+
+    // Decoding replaces whatever the state held before
+    CHECK(decodeCrowdState(data, decoded));
+    CHECK(decoded.agents.size() == state.agents.size());
+
+    CrowdState empty;
+    encodeCrowdState(empty, data);
+    CHECK(decodeCrowdState(data, decoded));
+    CHECK(decoded.agents.empty());
+}
+
+static void testRejects() {
+    std::string data;
+    encodeCrowdState(makeState(), data);
+    CrowdState decoded;
+
+    // Every strict prefix is truncated somewhere
+    for (size_t length = 0; length < data.size(); length++) {
+        CHECK(!decodeCrowdState(data.substr(0, length), decoded));
+    }
+
+    std::string foreign = data;
+    foreign[0] ^= 0x55;
+    CHECK(!decodeCrowdState(foreign, decoded));
+
+    std::string future = data;
+    future[4] = (char)(CROWD_STATE_VERSION + 1);
+    CHECK(!decodeCrowdState(future, decoded));
+}
+
+static void testFile() {
+    const std::string path = "crowdstate-test.bin";
+    const CrowdState state = makeState();
+    CHECK(writeCrowdState(path, state));
+
+    CrowdState decoded;
+    CHECK(readCrowdState(path, decoded));
+    checkSameState(state, decoded);
+    std::remove(path.c_str());
+
+    CHECK(!readCrowdState(path, decoded));
+}
+
+int main() {
+    testRoundTrip();
+    testRejects();
+    testFile();
+    return testResult("crowdstate");
+}
@@ -0,0 +1,105 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - IpcReader / IpcWriter tests
+// Writer frames read back field for field, and the reader's bounds handling: a read
+// past the end, a string longer than what is left, and a start past the frame all
+// fail the reader for good and yield empty values.
+// ===================================================================================
+
+#include <string>
+#include <cstring>
+
+#include "test-check.h"
+#include "../pathfinding-ipc.h"
+
+static void testRoundTrip() {
+    IpcWriter writer(77, IPC_OP_FIND_PATH, IPC_STATUS_OK);
+    const float points[6] = {1.0f, -2.5f, 3.0f, 1e6f, 0.0f, -0.125f};
+    writer.write<uint8_t>(1);
+    writer.write<uint64_t>(0x0123456789abcdefULL);
+    writer.writeFloats(points, 6);
+    writer.writeString("zombie_7");
+    writer.writeString("");
+    writer.writeString(std::string(70000, 'x'));
+    const std::string frame = writer.finish();
+
+    uint32_t length = 0;
+    memcpy(&length, frame.data(), sizeof(length));
+    CHECK(length == frame.size() - sizeof(uint32_t));
+
+    IpcReader reader(frame, sizeof(uint32_t));
+    CHECK(reader.read<uint32_t>() == 77);
+    CHECK(reader.read<uint16_t>() == IPC_OP_FIND_PATH);
+    CHECK(reader.read<uint16_t>() == IPC_STATUS_OK);
+    CHECK(reader.read<uint8_t>() == 1);
+    CHECK(reader.read<uint64_t>() == 0x0123456789abcdefULL);
+    float read[6];
+    reader.readFloats(read, 6);
+    for (int i = 0; i < 6; i++) CHECK(read[i] == points[i]);
+    CHECK(reader.readString() == "zombie_7");
+    CHECK(reader.readString().empty());
+    // Strings are cut to what a u16 length can say
+    CHECK(reader.readString() == std::string(0xffff, 'x'));
+    CHECK(reader.ok());
+
+    // Exactly at the end: the next read fails
+    CHECK(reader.read<uint8_t>() == 0);
+    CHECK(!reader.ok());
+}
+
+static void testBounds() {
+    std::string frame;
+    const uint16_t value = 0xbeef;
+    frame.append(reinterpret_cast<const char*>(&value), sizeof(value));
+
+    // A read wider than what is left fails and stays failed, even for reads that would fit
+    IpcReader wide(frame);
+    CHECK(wide.read<uint32_t>() == 0);
+    CHECK(!wide.ok());
+    CHECK(wide.read<uint8_t>() == 0);
+    CHECK(!wide.ok());
+
+    IpcReader narrow(frame);
+    CHECK(narrow.read<uint16_t>() == 0xbeef);
+    CHECK(narrow.ok());
+
+    // A string whose length runs past the frame
+    std::string truncated;
+    const uint16_t claimed = 10;
+    truncated.append(reinterpret_cast<const char*>(&claimed), sizeof(claimed));
+    truncated.append("abc");
+    IpcReader strings(truncated);
+    CHECK(strings.readString().empty());
+    CHECK(!strings.ok());
+
+    // A length field cut in half
+    IpcReader half(std::string(1, '\x05'));
+    CHECK(half.readString().empty());
+    CHECK(!half.ok());
+
+    float points[3] = {9.0f, 9.0f, 9.0f};
+    IpcReader floats(frame);
+    floats.readFloats(points, 3);
+    CHECK(!floats.ok());
+    CHECK(points[0] == 0.0f && points[1] == 0.0f && points[2] == 0.0f);
+
+    // Starting past the frame is invalid from the outset; starting at its end is not
+    IpcReader past(frame, frame.size() + 1);
+    CHECK(!past.ok());
+    CHECK(past.read<uint8_t>() == 0);
+    IpcReader end(frame, frame.size());
+    CHECK(end.ok());
+    CHECK(end.read<uint8_t>() == 0);
+    CHECK(!end.ok());
+
+    const std::string empty;
+    IpcReader nothing(empty);
+    CHECK(nothing.ok());
+    CHECK(nothing.readString().empty());
+    CHECK(!nothing.ok());
+}
+
+int main() {
+    testRoundTrip();
+    testBounds();
+    return testResult("ipc");
+}
@@ -0,0 +1,101 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - PathCache tests
+// LRU order and eviction, in-place refresh of a stored key, and the whole-cache drop
+// when the tile generation moves.
+// ===================================================================================
+
+#include <vector>
+
+#include "test-check.h"
+#include "../pathfinding-pathcache.h"
+
+static PathCacheKey key(dtPolyRef start, dtPolyRef end) {
+    return PathCacheKey{start, end, PATH_FILTER_DEFAULT};
+}
+
+static void testLru() {
+    PathCache cache(2);
+    const dtPolyRef a[] = {1, 2, 3};
+    const dtPolyRef b[] = {4, 5};
+    const dtPolyRef c[] = {6};
+    std::vector<dtPolyRef> polys;
+
+    CHECK(!cache.lookup(key(1, 3), 1, polys));
+    cache.store(key(1, 3), 1, a, 3);
+    cache.store(key(4, 5), 1, b, 2);
+    CHECK(cache.lookup(key(1, 3), 1, polys));
+    CHECK(polys == std::vector<dtPolyRef>(a, a + 3));
+
+    // (1,3) was just used, so the full cache evicts (4,5) for the new entry
+    cache.store(key(6, 6), 1, c, 1);
+    CHECK(cache.lookup(key(1, 3), 1, polys));
+    CHECK(!cache.lookup(key(4, 5), 1, polys));
+    CHECK(cache.lookup(key(6, 6), 1, polys));
+    CHECK(polys.size() == 1 && polys[0] == 6);
+
+    // The filter is part of the key
+    CHECK(!cache.lookup(PathCacheKey{1, 3, PATH_FILTER_DEFAULT + 1}, 1, polys));
+
+    PathCacheStats stats = cache.getStats();
+    CHECK(stats.entries == 2);
+    CHECK(stats.capacity == 2);
+    CHECK(stats.stores == 3);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 3);
+    CHECK(stats.invalidations == 0);
+}
+
+static void testRefresh() {
+    PathCache cache(2);
+    const dtPolyRef first[] = {1, 2};
+    const dtPolyRef second[] = {1, 7, 2};
+    std::vector<dtPolyRef> polys;
+
+    cache.store(key(1, 2), 1, first, 2);
+    cache.store(key(1, 2), 1, second, 3);
+    CHECK(cache.lookup(key(1, 2), 1, polys));
+    CHECK(polys == std::vector<dtPolyRef>(second, second + 3));
+    CHECK(cache.getStats().entries == 1);
+    CHECK(cache.getStats().stores == 1);
+
+    // Empty corridors and a zero-capacity cache store nothing
+    cache.store(key(3, 4), 1, first, 0);
+    CHECK(!cache.lookup(key(3, 4), 1, polys));
+    PathCache disabled(0);
+    disabled.store(key(1, 2), 1, first, 2);
+    CHECK(!disabled.lookup(key(1, 2), 1, polys));
+    CHECK(disabled.getStats().entries == 0);
+}
+
+static void testGeneration() {
+    PathCache cache(4);
+    const dtPolyRef path[] = {1, 2};
+    std::vector<dtPolyRef> polys;
+
+    cache.store(key(1, 2), 5, path, 2);
+    cache.store(key(2, 1), 5, path, 2);
+    CHECK(cache.lookup(key(1, 2), 5, polys));
+
+    // A new tile generation drops everything stored under the old one, counted once
+    CHECK(!cache.lookup(key(1, 2), 6, polys));
+    CHECK(!cache.lookup(key(2, 1), 6, polys));
+    CHECK(cache.getStats().entries == 0);
+    CHECK(cache.getStats().invalidations == 1);
+
+    // Moving again with nothing stored is not an invalidation
+    CHECK(!cache.lookup(key(1, 2), 7, polys));
+    CHECK(cache.getStats().invalidations == 1);
+
+    cache.store(key(1, 2), 7, path, 2);
+    cache.clear();
+    CHECK(!cache.lookup(key(1, 2), 7, polys));
+    CHECK(cache.getStats().invalidations == 2);
+}
+
+int main() {
+    testLru();
+    testRefresh();
+    testGeneration();
+    return testResult("pathcache");
+}
@@ -0,0 +1,127 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - PlayerGrid tests
+// Nearest-player queries checked against a brute-force scan over random players,
+// across cell borders, negative coordinates, and radii both inside and past the
+// occupied cells.
+// ===================================================================================
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+#include "test-check.h"
+#include "../pathfinding-targets.h"
+
+static std::vector<std::pair<float, int>> bruteForce(const std::vector<float>& points, const float* pos, float radius, size_t maxResults) {
+    std::vector<std::pair<float, int>> hits;
+    for (size_t i = 0; i < points.size() / 3; i++) {
+        float dx = points[i * 3] - pos[0], dy = points[i * 3 + 1] - pos[1], dz = points[i * 3 + 2] - pos[2];
+        float d = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (d <= radius) hits.emplace_back(d, (int)i);
+    }
+    std::sort(hits.begin(), hits.end());
+    if (hits.size() > maxResults) hits.resize(maxResults);
+    return hits;
+}
+
+static void testSmall() {
+    PlayerGrid grid(16.0f);
+    std::vector<std::string> names = {"near", "far", "above", "across"};
+    std::vector<std::string_view> ids(names.begin(), names.end());
+    const float points[] = {
+        1.0f, 0.0f, 1.0f,
+        100.0f, 0.0f, 100.0f,
+        0.0f, 10.0f, 0.0f,       // Same cell as the query, but 10 up
+        -17.0f, 0.0f, 0.0f,      // Neighbouring cell
+    };
+    grid.build(ids, points, 4);
+    CHECK(grid.size() == 4);
+    CHECK(grid.cellCount() == 3);
+
+    const float origin[3] = {0.0f, 0.0f, 0.0f};
+    std::vector<std::pair<float, int>> hits;
+    grid.query(origin, 20.0f, 8, hits);
+    CHECK(hits.size() == 3);
+    if (hits.size() == 3) {
+        CHECK(grid.id(hits[0].second) == "near");
+        CHECK_NEAR(hits[0].first, std::sqrt(2.0f), 1e-5);
+        CHECK(grid.id(hits[1].second) == "above");
+        CHECK_NEAR(hits[1].first, 10.0f, 1e-5);
+        CHECK(grid.id(hits[2].second) == "across");
+        CHECK(grid.position(hits[2].second)[0] == -17.0f);
+    }
+
+    // Distance is 3D: the player straight above is out of a 5 unit radius
+    grid.query(origin, 5.0f, 8, hits);
+    CHECK(hits.size() == 1 && grid.id(hits[0].second) == "near");
+
+    grid.query(origin, 200.0f, 2, hits);
+    CHECK(hits.size() == 2);
+
+    grid.query(origin, 20.0f, 0, hits);
+    CHECK(hits.empty());
+    grid.query(origin, -1.0f, 8, hits);
+    CHECK(hits.empty());
+
+    const float nowhere[3] = {5000.0f, 0.0f, 5000.0f};
+    grid.query(nowhere, 50.0f, 8, hits);
+    CHECK(hits.empty());
+
+    // Rebuilding replaces the players; an empty grid answers nothing
+    grid.build(std::vector<std::string_view>(), nullptr, 0);
+    CHECK(grid.size() == 0);
+    grid.query(origin, 20.0f, 8, hits);
+    CHECK(hits.empty());
+}
+
+static void testAgainstBruteForce() {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coordinate(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> height(-5.0f, 5.0f);
+
+    const size_t count = 400;
+    std::vector<std::string> names;
+    std::vector<float> points;
+    for (size_t i = 0; i < count; i++) {
+        names.push_back("player_" + std::to_string(i));
+        points.push_back(coordinate(random));
+        points.push_back(height(random));
+        points.push_back(coordinate(random));
+    }
+    std::vector<std::string_view> ids(names.begin(), names.end());
+
+    PlayerGrid grid(32.0f);
+    grid.build(ids, points.data(), count);
+    CHECK(grid.size() == count);
+
+    const float radii[] = {0.0f, 10.0f, 40.0f, 150.0f, 1000.0f};
+    const size_t limits[] = {1, 5, count};
+    std::vector<std::pair<float, int>> hits;
+    for (int q = 0; q < 200; q++) {
+        const float pos[3] = {coordinate(random) * 1.2f, height(random), coordinate(random) * 1.2f};
+        for (float radius : radii) {
+            for (size_t limit : limits) {
+                grid.query(pos, radius, limit, hits);
+                std::vector<std::pair<float, int>> expected = bruteForce(points, pos, radius, limit);
+                CHECK(hits.size() == expected.size());
+                for (size_t i = 0; i < hits.size() && i < expected.size(); i++) {
+                    // Grid indices are its own order and equal distances may come either way
+                    // round, so compare distances and check each hit against its own player
+                    CHECK_NEAR(hits[i].first, expected[i].first, 1e-3);
+                    const std::string& id = grid.id(hits[i].second);
+                    const int player = std::stoi(id.substr(id.find('_') + 1));
+                    CHECK(std::equal(points.begin() + player * 3, points.begin() + player * 3 + 3, grid.position(hits[i].second)));
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    testSmall();
+    testAgainstBruteForce();
+    return testResult("targets");
+}
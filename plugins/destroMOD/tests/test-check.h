@@ -0,0 +1,31 @@
+// ===================================================================================
+// destroMOD Pathfinding Service - Unit test checks
+// Each test is its own executable over one header-only module. CHECK reports a failed
+// condition and carries on, so one run lists every failure; main returns testResult().
+// ===================================================================================
+
+#pragma once
+
+#include <iostream>
+#include <cmath>
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) CHECK(std::fabs((double)(actual) - (double)(expected)) <= (tolerance))
+
+inline int testResult(const char* name) {
+    if (testFailures == 0) {
+        std::cout << "[PASS] " << name << std::endl;
+        return 0;
+    }
+    std::cout << "[FAIL] " << name << ": " << testFailures << " failed checks" << std::endl;
+    return 1;
+}